@@ -0,0 +1,1093 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MAP_HUGETLB, madvise
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "khash_frozen.h"
+#include "khash_bitset.h"
+
+// Benchmarks for khash.h. Usage: ./bench_khash [section] [n]
+// With no section every benchmark runs; n scales the table sizes.
+
+KHASH_MMAP_INIT(i64, khint64_t, khint64_t, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_INIT(swiss64, khint64_t, khint64_t, KH_MAP | KH_SWISS, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_INIT(rh64, khint64_t, khint64_t, KH_MAP | KH_ROBINHOOD, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_MAP_INIT_STR(str, khint64_t)
+KHASH_INIT(hstr, kh_cstr_t, khint64_t, KH_MAP | KH_STORE_HASH, kh_str_hash_func, kh_str_hash_equal)
+KHASH_INIT(ids, kh_cstr_t, khint32_t, KH_MAP | KH_STORE_HASH, kh_str_hash_func, kh_str_hash_equal)
+KHASH_INTERN_INIT(atoms)
+KHASH_MAP_INIT_INT(i32, khint32_t)
+KHASH_INIT(kvi32, khint32_t, khint32_t, KH_MAP | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(swissi32, khint32_t, khint32_t, KH_MAP | KH_SWISS, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(kvswissi32, khint32_t, khint32_t, KH_MAP | KH_SWISS | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_FROZEN_MAP_INIT_INT64(fi64, i64, khint64_t)
+KHASH_MAP_INIT_STR_SEEDED(sstr, khint64_t)
+#define str_hash_wy_seeded(key, seed) ((khint_t)kh_wyhash(key, strlen(key), seed))
+KHASH_INIT_SEEDED(wystr, kh_cstr_t, khint64_t, KH_MAP, str_hash_wy_seeded, kh_str_hash_equal)
+KHASH_INIT(wy, kh_cstr_t, khint64_t, KH_MAP, kh_str_hash_wy, kh_str_hash_equal)
+KHASH_MAP_INIT_SV(view, khint64_t)
+KHASH_SET_INIT_INT(iset)
+
+static double now_sec()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Timed loops that do not modify the table are repeated this many times
+#define BENCH_REPS 3
+
+static double min_time(double a, double b)
+{
+    return a < b ? a : b;
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next()
+{
+    return splittable64(rng_state += 0x9e3779b97f4a7c15ULL);
+}
+
+// n distinct random keys followed by n keys that are (almost surely) absent
+static khint64_t *make_keys(size_t n)
+{
+    khint64_t *keys = malloc(2 * n * sizeof(khint64_t));
+    for (size_t i = 0; i < 2 * n; i++)
+        keys[i] = (khint64_t)(rng_next() >> 1);
+    return keys;
+}
+
+// Queries mixing hits and misses in random order
+static khint64_t *make_queries(const khint64_t *keys, size_t n)
+{
+    khint64_t *q = malloc(n * sizeof(khint64_t));
+    for (size_t i = 0; i < n; i++)
+        q[i] = keys[rng_next() % (2 * n)];
+    return q;
+}
+
+#define BENCH_BATCH(name, label, keys, queries, n)                                                       \
+    {                                                                                                    \
+        khash_t(name) *h = kh_init(name);                                                                \
+        khint_t *its = malloc(n * sizeof(khint_t));                                                      \
+        int ret;                                                                                         \
+        double t0 = now_sec();                                                                           \
+        kh_resize(name, h, (khint_t)(n / __ac_HASH_UPPER) + 1);                                          \
+        for (size_t i = 0; i < n; i++)                                                                   \
+            kh_put(name, h, keys[i], &ret);                                                              \
+        double t_put = now_sec() - t0;                                                                   \
+        kh_destroy(name, h);                                                                             \
+        h = kh_init(name);                                                                               \
+        t0 = now_sec();                                                                                  \
+        kh_put_batch(name, h, keys, n, its, NULL);                                                       \
+        double t_put_batch = now_sec() - t0;                                                             \
+        size_t hits = 0, hits_batch = 0;                                                                 \
+        double t_get = 1e9, t_get_batch = 1e9;                                                           \
+        for (int rep = 0; rep < BENCH_REPS; rep++)                                                       \
+        { /* lookups are repeated and the best time is kept */                                           \
+            hits = hits_batch = 0;                                                                       \
+            t0 = now_sec();                                                                              \
+            for (size_t i = 0; i < n; i++)                                                               \
+                hits += kh_get(name, h, queries[i]) != kh_end(h);                                        \
+            t_get = min_time(t_get, now_sec() - t0);                                                     \
+            t0 = now_sec();                                                                              \
+            kh_get_batch(name, h, queries, n, its);                                                      \
+            for (size_t i = 0; i < n; i++)                                                               \
+                hits_batch += its[i] != kh_end(h);                                                       \
+            t_get_batch = min_time(t_get_batch, now_sec() - t0);                                         \
+        }                                                                                                \
+        if (hits != hits_batch)                                                                          \
+            printf("  MISMATCH: %zu vs %zu hits\n", hits, hits_batch);                                   \
+        printf("  %-8s put %6.1f ns  put_batch %6.1f ns  get %6.1f ns  get_batch %6.1f ns  (%.0f MB)\n", \
+               label, t_put * 1e9 / n, t_put_batch * 1e9 / n, t_get * 1e9 / n, t_get_batch * 1e9 / n,    \
+               (double)kh_n_buckets(h) * (2 * sizeof(khint64_t)) / (1 << 20));                           \
+        kh_destroy(name, h);                                                                             \
+        free(its);                                                                                       \
+    }
+
+// kh_get_batch/kh_put_batch against plain loops over kh_get/kh_put
+static void bench_batch(size_t n)
+{
+    printf("Batched vs. one-at-a-time access, %zu int64 keys, 50%% hits:\n", n);
+    khint64_t *keys = make_keys(n);
+    khint64_t *queries = make_queries(keys, n);
+    BENCH_BATCH(i64, "quad", keys, queries, n);
+    BENCH_BATCH(swiss64, "swiss", keys, queries, n);
+    free(keys);
+    free(queries);
+}
+
+// Worst single kh_put with and without incremental rehashing
+static void bench_incremental(size_t n)
+{
+    printf("Insert latency, %zu int64 keys:\n", n);
+    khint64_t *keys = make_keys(n);
+    for (int step = 0; step <= 64; step += 64)
+    {
+        khash_t(i64) *h = kh_init(i64);
+        kh_set_incremental(h, step);
+        double worst = 0.0, t_all = now_sec();
+        int ret;
+        for (size_t i = 0; i < n; i++)
+        {
+            double t0 = now_sec();
+            kh_put(i64, h, keys[i], &ret);
+            double t = now_sec() - t0;
+            if (t > worst)
+                worst = t;
+        }
+        t_all = now_sec() - t_all;
+        printf("  rehash step %-3d  total %7.1f ms  worst put %8.3f ms\n", step, t_all * 1e3, worst * 1e3);
+        kh_destroy(i64, h);
+    }
+    free(keys);
+}
+
+// n URL-like strings of about 80 bytes sharing long prefixes, then n absent ones
+static char **make_urls(size_t n)
+{
+    char **urls = malloc(2 * n * sizeof(char *));
+    for (size_t i = 0; i < 2 * n; i++)
+    {
+        uint64_t r = rng_next();
+        urls[i] = malloc(96);
+        snprintf(urls[i], 96, "https://www.example.com/static/assets/images/%04u/%016llx-%08x.png",
+                 (unsigned)(r % 1000), (unsigned long long)r, (unsigned)i);
+    }
+    return urls;
+}
+
+#define BENCH_STR(name, label, urls, n)                                                          \
+    {                                                                                            \
+        khash_t(name) *h = kh_init(name);                                                        \
+        int ret;                                                                                 \
+        double t0 = now_sec();                                                                   \
+        for (size_t i = 0; i < n; i++)                                                           \
+            kh_put(name, h, urls[i], &ret);                                                      \
+        double t_put = now_sec() - t0, t_resize = 1e9, t_get = 1e9;                              \
+        size_t hits = 0;                                                                         \
+        for (int rep = 0; rep < BENCH_REPS; rep++)                                               \
+        {                                                                                        \
+            hits = 0;                                                                            \
+            t0 = now_sec();                                                                      \
+            for (size_t i = 0; i < 2 * n; i++)                                                   \
+                hits += kh_get(name, h, urls[i]) != kh_end(h);                                   \
+            t_get = min_time(t_get, now_sec() - t0);                                             \
+            t0 = now_sec();                                                                      \
+            kh_resize(name, h, kh_n_buckets(h)); /* same size: a pure rehash */                  \
+            t_resize = min_time(t_resize, now_sec() - t0);                                       \
+        }                                                                                        \
+        printf("  %-12s put %6.1f ns  get %6.1f ns  rehash %7.1f ms  (%zu hits)\n", label,       \
+               t_put * 1e9 / n, t_get * 1e9 / (2 * n), t_resize * 1e3, hits);                   \
+        kh_destroy(name, h);                                                                     \
+    }
+
+// String keys with and without KH_STORE_HASH
+static void bench_store_hash(size_t n)
+{
+    n /= 8;
+    printf("Stored hashes, %zu URL keys, 50%% hits:\n", n);
+    char **urls = make_urls(n);
+    BENCH_STR(str, "str", urls, n);
+    BENCH_STR(hstr, "str+hash", urls, n);
+    for (size_t i = 0; i < 2 * n; i++)
+        free(urls[i]);
+    free(urls);
+}
+
+// Interning short strings: strdup per new key against the table's arena
+static void bench_intern(size_t n)
+{
+    printf("Interning %zu short strings, about half of them repeats:\n", n);
+    char **words = malloc(n * sizeof(char *));
+    for (size_t i = 0; i < n; i++)
+    {
+        words[i] = malloc(24);
+        snprintf(words[i], 24, "w%llx", (unsigned long long)(rng_next() % (n / 2 + 1)));
+    }
+    int ret;
+    double t0 = now_sec();
+    khash_t(ids) *h = kh_init(ids);
+    for (size_t i = 0; i < n; i++)
+    {
+        khint_t k = kh_put(ids, h, words[i], &ret);
+        if (ret > 0)
+        {
+            size_t len = strlen(words[i]) + 1;
+            kh_key(h, k) = memcpy(malloc(len), words[i], len);
+            kh_value(h, k) = (khint32_t)kh_size(h) - 1;
+        }
+    }
+    double t_dup = now_sec() - t0;
+    khint_t n_unique = kh_size(h);
+    t0 = now_sec();
+    const char *key;
+    khint32_t id;
+    kh_foreach(h, key, id, free((char *)key));
+    (void)id;
+    kh_destroy(ids, h);
+    double t_dup_free = now_sec() - t0;
+
+    t0 = now_sec();
+    khash_t(atoms) *a = kh_init(atoms);
+    for (size_t i = 0; i < n; i++)
+        kh_intern(atoms, a, words[i]);
+    double t_arena = now_sec() - t0;
+    size_t bytes = a->arena->bytes;
+    t0 = now_sec();
+    kh_destroy(atoms, a);
+    double t_arena_free = now_sec() - t0;
+
+    printf("  strdup  %6.1f ns/string  free %7.2f ms  (%d strings, %d mallocs)\n", t_dup * 1e9 / n,
+           t_dup_free * 1e3, (int)n_unique, (int)n_unique);
+    printf("  arena   %6.1f ns/string  free %7.2f ms  (%.1f MB of string bytes)\n", t_arena * 1e9 / n,
+           t_arena_free * 1e3, bytes / 1048576.0);
+    for (size_t i = 0; i < n; i++)
+        free(words[i]);
+    free(words);
+}
+
+// Cost of the index width: run as ./bench_khash width and ./bench_khash64 width
+static void bench_width(size_t n)
+{
+    printf("%d-bit khint_t, %zu int64 keys:\n", (int)sizeof(khint_t) * 8, n);
+    khint64_t *keys = make_keys(n);
+    khint64_t *queries = make_queries(keys, n);
+    khash_t(i64) *h = kh_init(i64);
+    int ret;
+    double t0 = now_sec();
+    for (size_t i = 0; i < n; i++)
+        kh_put(i64, h, keys[i], &ret);
+    double t_put = now_sec() - t0, t_get = 1e9;
+    size_t hits = 0;
+    for (int rep = 0; rep < BENCH_REPS; rep++)
+    {
+        hits = 0;
+        t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            hits += kh_get(i64, h, queries[i]) != kh_end(h);
+        t_get = min_time(t_get, now_sec() - t0);
+    }
+    khint_t nb = kh_n_buckets(h);
+    double table = (double)nb * 2 * sizeof(khint64_t) + __ac_fsize(nb) * sizeof(khint32_t);
+    printf("  put %6.1f ns  get %6.1f ns  (%zu hits)  table %.1f MB  iterators %.1f MB\n",
+           t_put * 1e9 / n, t_get * 1e9 / n, hits, table / (1 << 20), (double)n * sizeof(khint_t) / (1 << 20));
+    kh_destroy(i64, h);
+    free(keys);
+    free(queries);
+}
+
+// The probe side of a hash join: every lookup hits and reads the value
+#define BENCH_LAYOUT(name, label, keys, probes, n)                           \
+    {                                                                        \
+        khash_t(name) *h = kh_init(name);                                    \
+        int ret;                                                             \
+        for (size_t i = 0; i < n; i++)                                       \
+        {                                                                    \
+            khint_t k = kh_put(name, h, keys[i], &ret);                      \
+            kh_value(h, k) = (khint32_t)i;                                   \
+        }                                                                    \
+        double t_get = 1e9;                                                  \
+        uint64_t sum = 0;                                                    \
+        for (int rep = 0; rep < BENCH_REPS; rep++)                           \
+        {                                                                    \
+            sum = 0;                                                         \
+            double t0 = now_sec();                                           \
+            for (size_t i = 0; i < n; i++)                                   \
+                sum += kh_value(h, kh_get(name, h, probes[i]));              \
+            t_get = min_time(t_get, now_sec() - t0);                         \
+        }                                                                    \
+        printf("  %-18s %6.1f ns/hit  (sum %llu)\n", label, t_get * 1e9 / n, \
+               (unsigned long long)sum);                                     \
+        kh_destroy(name, h);                                                 \
+    }
+
+// Separate key and value arrays against interleaved pairs, int32 -> int32
+static void bench_layout(size_t n)
+{
+    printf("Layout, %zu int32 -> int32 pairs, all lookups hit:\n", n);
+    khint32_t *keys = malloc(n * sizeof(khint32_t)), *probes = malloc(n * sizeof(khint32_t));
+    for (size_t i = 0; i < n; i++)
+        keys[i] = (khint32_t)i * 2654435761u; /* distinct: the multiplier is odd */
+    for (size_t i = 0; i < n; i++)
+        probes[i] = keys[rng_next() % n];
+    BENCH_LAYOUT(i32, "quad", keys, probes, n);
+    BENCH_LAYOUT(kvi32, "quad interleaved", keys, probes, n);
+    BENCH_LAYOUT(swissi32, "swiss", keys, probes, n);
+    BENCH_LAYOUT(kvswissi32, "swiss interleaved", keys, probes, n);
+    free(keys);
+    free(probes);
+}
+
+// Bump allocator over one reserved mapping; the last block grows in place
+typedef struct
+{
+    char *base, *top;
+    size_t cap;
+    void *last;
+} bench_arena_t;
+
+static void *arena_alloc(void *ctx, size_t size)
+{
+    bench_arena_t *a = ctx;
+    size = (size + 63) & ~(size_t)63;
+    if ((size_t)(a->top - a->base) + size > a->cap)
+        return NULL;
+    a->last = a->top;
+    a->top += size;
+    return a->last;
+}
+
+static void *arena_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    bench_arena_t *a = ctx;
+    if (p == a->last && (size_t)((char *)p - a->base) + new_size <= a->cap)
+    {
+        a->top = (char *)p + ((new_size + 63) & ~(size_t)63);
+        return p;
+    }
+    void *q = arena_alloc(ctx, new_size);
+    if (q)
+        memcpy(q, p, old_size < new_size ? old_size : new_size);
+    return q;
+}
+
+static void arena_release(void *ctx, void *p, size_t size)
+{
+    (void)ctx, (void)p, (void)size; // everything goes at once with the mapping
+}
+
+// Large blocks get their own mapping of 2 MB pages: MAP_HUGETLB when pages are
+// reserved (vm.nr_hugepages), else transparent huge pages through madvise()
+#define HUGE_PAGE ((size_t)2 << 20)
+#define HUGE_MIN ((size_t)1 << 20)
+
+static size_t huge_round(size_t size)
+{
+    return (size + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+}
+
+static void *huge_alloc(void *ctx, size_t size)
+{
+    int *fallbacks = ctx;
+    if (size < HUGE_MIN)
+        return malloc(size);
+    void *p = mmap(NULL, huge_round(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+        return p;
+    ++*fallbacks;
+    p = mmap(NULL, huge_round(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    madvise(p, huge_round(size), MADV_HUGEPAGE);
+    return p;
+}
+
+static void huge_release(void *ctx, void *p, size_t size)
+{
+    (void)ctx;
+    if (size < HUGE_MIN)
+        free(p);
+    else
+        munmap(p, huge_round(size));
+}
+
+static void *huge_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    if (old_size < HUGE_MIN && new_size < HUGE_MIN)
+        return realloc(p, new_size);
+    if (old_size >= HUGE_MIN && huge_round(new_size) == huge_round(old_size))
+        return p;
+    void *q = huge_alloc(ctx, new_size);
+    if (q)
+    {
+        memcpy(q, p, old_size < new_size ? old_size : new_size);
+        huge_release(ctx, p, old_size);
+    }
+    return q;
+}
+
+// The same int32 map on the system allocator, an arena and 2 MB pages.
+// The allocators are meant for big tables: try ./bench_khash alloc 100000000
+static void bench_alloc(size_t n)
+{
+    printf("Allocators, %zu int32 keys, 50%% hits:\n", n);
+    khint32_t *keys = malloc(2 * n * sizeof(khint32_t));
+    for (size_t i = 0; i < 2 * n; i++)
+        keys[i] = (khint32_t)rng_next();
+    khint32_t *queries = malloc(n * sizeof(khint32_t));
+    for (size_t i = 0; i < n; i++)
+        queries[i] = keys[rng_next() % (2 * n)];
+
+    // Room for the final table plus every smaller one it grew through
+    bench_arena_t arena = {NULL, NULL, 0, NULL};
+    arena.cap = huge_round((size_t)kroundup64(n) * 4 * (2 * sizeof(khint32_t) + 1) + HUGE_PAGE);
+    arena.base = mmap(NULL, arena.cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena.base == MAP_FAILED)
+    {
+        fprintf(stderr, "  cannot reserve %zu MB for the arena\n", arena.cap >> 20);
+        free(keys);
+        free(queries);
+        return;
+    }
+    arena.top = arena.base;
+    int fallbacks = 0;
+    kalloc_t backends[3] = {{0},
+                            {arena_alloc, arena_resize, arena_release, &arena},
+                            {huge_alloc, huge_resize, huge_release, &fallbacks}};
+    const char *labels[3] = {"system", "arena", "hugepage"};
+
+    for (int b = 0; b < 3; b++)
+    {
+        int ret;
+        double t0 = now_sec();
+        khash_t(i32) *h = kh_init_with_alloc(i32, b ? &backends[b] : NULL);
+        for (size_t i = 0; i < n; i++)
+        {
+            khint_t k = kh_put(i32, h, keys[i], &ret);
+            kh_value(h, k) = (khint32_t)i;
+        }
+        double t_put = now_sec() - t0, t_get = 1e9;
+        size_t hits = 0;
+        for (int rep = 0; rep < BENCH_REPS; rep++)
+        {
+            hits = 0;
+            t0 = now_sec();
+            for (size_t i = 0; i < n; i++)
+                hits += kh_get(i32, h, queries[i]) != kh_end(h);
+            t_get = min_time(t_get, now_sec() - t0);
+        }
+        t0 = now_sec();
+        kh_destroy(i32, h);
+        double t_free = now_sec() - t0;
+        printf("  %-8s  put %6.1f ns  get %6.1f ns  destroy %8.2f ms  (%zu hits)\n", labels[b], t_put * 1e9 / n,
+               t_get * 1e9 / n, t_free * 1e3, hits);
+    }
+    if (fallbacks)
+        printf("  (no MAP_HUGETLB pages reserved: %d hugepage blocks used madvise instead)\n", fallbacks);
+    munmap(arena.base, arena.cap);
+    free(keys);
+    free(queries);
+}
+
+// n live keys; each round inserts n new keys and deletes the n oldest, one of each at a time
+#define BENCH_CHURN(name, label, keys, n, rounds)                                                              \
+    {                                                                                                          \
+        khash_t(name) *h = kh_init(name);                                                                      \
+        int ret;                                                                                               \
+        for (size_t i = 0; i < n; i++)                                                                         \
+            kh_put(name, h, keys[i], &ret);                                                                    \
+        for (int r = 1; r <= rounds; r++)                                                                      \
+        {                                                                                                      \
+            double t0 = now_sec();                                                                             \
+            for (size_t i = (size_t)r * n; i < (size_t)(r + 1) * n; i++)                                       \
+            {                                                                                                  \
+                kh_put(name, h, keys[i], &ret);                                                                \
+                kh_del(name, h, kh_get(name, h, keys[i - n]));                                                 \
+            }                                                                                                  \
+            double t_churn = now_sec() - t0;                                                                   \
+            t0 = now_sec();                                                                                    \
+            size_t hits = 0;                                                                                   \
+            for (size_t i = 0; i < n; i++) /* keys deleted in this round */                                    \
+                hits += kh_get(name, h, keys[(size_t)r * n - n + i]) != kh_end(h);                             \
+            double t_miss = now_sec() - t0;                                                                    \
+            kh_probe_stat_t st = kh_probe_stats(name, h);                                                      \
+            printf("  %-9s  round %d  put+del %6.1f ns  miss %5.1f ns  probes avg %.2f max %3d var %5.2f%s\n", \
+                   label, r, t_churn * 1e9 / n, t_miss * 1e9 / n, st.avg_probes, st.max_probes, st.variance,   \
+                   hits ? "  (deleted keys found!)" : "");                                                     \
+        }                                                                                                      \
+        kh_destroy(name, h);                                                                                   \
+    }
+
+// Tombstones against backward-shift deletion under a steady 50/50 insert/delete load
+static void bench_churn(size_t n)
+{
+    const int rounds = 4;
+    printf("Churn, %zu live int64 keys, %d rounds of %zu inserts and deletes:\n", n, rounds, n);
+    khint64_t *keys = malloc((rounds + 1) * n * sizeof(khint64_t));
+    for (size_t i = 0; i < (rounds + 1) * n; i++)
+        keys[i] = (khint64_t)(rng_next() >> 1);
+    BENCH_CHURN(i64, "quad", keys, n, rounds);
+    BENCH_CHURN(swiss64, "swiss", keys, n, rounds);
+    BENCH_CHURN(rh64, "robinhood", keys, n, rounds);
+    free(keys);
+}
+
+// Fills n_buckets buckets to load factor f and reports bytes per key against lookup cost
+#define BENCH_LOAD(name, label, keys, queries, n_buckets, f)                                        \
+    {                                                                                               \
+        khash_t(name) *h = kh_init(name);                                                           \
+        kh_set_load(name, h, f, 0);                                                                 \
+        kh_resize(name, h, n_buckets);                                                              \
+        size_t n = (size_t)kh_n_buckets(h) * f - 1, hits = 0;                                       \
+        int ret;                                                                                    \
+        for (size_t i = 0; i < n; i++)                                                              \
+            kh_put(name, h, keys[i], &ret);                                                         \
+        double t_get = 1e9;                                                                         \
+        for (int rep = 0; rep < BENCH_REPS; rep++)                                                  \
+        { /* half of the queries hit */                                                             \
+            hits = 0;                                                                               \
+            double t0 = now_sec();                                                                  \
+            for (size_t i = 0; i < n; i++)                                                          \
+                hits += kh_get(name, h, keys[queries[i] % (2 * n)]) != kh_end(h);                   \
+            t_get = min_time(t_get, now_sec() - t0);                                                \
+        }                                                                                           \
+        double bytes = (double)kmem_usage_total(kh_memory_usage(name, h));                          \
+        kh_probe_stat_t st = kh_probe_stats(name, h);                                               \
+        printf("  %-9s  %4.2f  %6.1f  %7.1f  %6.3f  %4d  %6.3f  (%zu hits)\n", label, f, bytes / n, \
+               t_get * 1e9 / n, st.avg_probes, st.max_probes, st.variance, hits);                   \
+        kh_destroy(name, h);                                                                        \
+    }
+
+// Memory against lookup latency across load factors; the columns are meant for plotting
+static void bench_load(size_t n)
+{
+    static const double loads[] = {0.5, 0.6, 0.7, 0.77, 0.85, 0.9, 0.95};
+    khint_t n_buckets = (khint_t)n;
+    __ac_roundup(n_buckets);
+    printf("Load factor, %d buckets of int64 keys:\n", (int)n_buckets);
+    printf("  engine     load  B/key  get(ns)  probes   max     var\n");
+    khint64_t *keys = malloc(2 * (size_t)n_buckets * sizeof(khint64_t));
+    uint64_t *queries = malloc((size_t)n_buckets * sizeof(uint64_t));
+    for (size_t i = 0; i < 2 * (size_t)n_buckets; i++)
+        keys[i] = (khint64_t)(rng_next() >> 1);
+    for (size_t i = 0; i < (size_t)n_buckets; i++) // keys[q % (2 * n)] is present for half of them
+        queries[i] = rng_next();
+    for (size_t j = 0; j < sizeof(loads) / sizeof(loads[0]); j++)
+    {
+        BENCH_LOAD(i64, "quad", keys, queries, n_buckets, loads[j]);
+        BENCH_LOAD(swiss64, "swiss", keys, queries, n_buckets, loads[j]);
+        BENCH_LOAD(rh64, "robinhood", keys, queries, n_buckets, loads[j]);
+    }
+    free(keys);
+    free(queries);
+}
+
+// Summing the values of a table: testing every bucket with kh_exist() against
+// kh_foreach_value(), which skips empty buckets a flags word at a time.
+static void bench_scan(size_t n)
+{
+    static const double loads[] = {0.05, 0.3, 0.6};
+    khint_t n_buckets = (khint_t)n;
+    __ac_roundup(n_buckets);
+    printf("Scan, %d buckets of int64 keys, ns/bucket:\n", (int)n_buckets);
+    printf("  load  kh_exist  kh_foreach\n");
+    int ret;
+    for (size_t j = 0; j < sizeof(loads) / sizeof(loads[0]); j++)
+    {
+        khash_t(i64) *h = kh_init(i64);
+        kh_resize(i64, h, n_buckets);
+        for (size_t i = 0; i < (size_t)(n_buckets * loads[j]); i++)
+        {
+            khint_t k = kh_put(i64, h, (khint64_t)rng_next(), &ret);
+            kh_value(h, k) = (khint64_t)i;
+        }
+        khint64_t sum0 = 0, sum1 = 0, v;
+        double t0 = now_sec();
+        for (khint_t k = kh_begin(h); k != kh_end(h); ++k)
+            if (kh_exist(h, k))
+                sum0 += kh_value(h, k);
+        double t1 = now_sec();
+        kh_foreach_value(h, v, sum1 += v);
+        double t2 = now_sec();
+        if (sum0 != sum1)
+            printf("  sums differ\n");
+        printf("  %4.2f  %8.2f  %10.2f\n", (double)kh_size(h) / kh_end(h), (t1 - t0) * 1e9 / kh_end(h),
+               (t2 - t1) * 1e9 / kh_end(h));
+        kh_destroy(i64, h);
+    }
+}
+
+// Start-up cost of a table: rebuilding it against mapping a saved copy. The
+// file is still in the page cache, so the first lookups fault pages in from
+// memory, not from disk.
+static void bench_mmap(size_t n)
+{
+    static const char *path = "bench_khash.tmp";
+    printf("Rebuild vs. kh_load_mmap, %zu int64 keys:\n", n);
+    khint64_t *keys = make_keys(n);
+    khint64_t *queries = make_queries(keys, n);
+    int ret;
+    double t0 = now_sec();
+    khash_t(i64) *h = kh_init(i64);
+    for (size_t i = 0; i < n; i++)
+    {
+        khint_t k = kh_put(i64, h, keys[i], &ret);
+        kh_value(h, k) = (khint64_t)i;
+    }
+    double t_build = now_sec() - t0;
+    t0 = now_sec();
+    if (kh_save(i64, h, path) != 0)
+    {
+        printf("  cannot write %s\n", path);
+        kh_destroy(i64, h);
+        free(keys);
+        free(queries);
+        return;
+    }
+    double t_save = now_sec() - t0;
+    kh_destroy(i64, h);
+    t0 = now_sec();
+    h = kh_load_mmap(i64, path);
+    double t_load = now_sec() - t0;
+    size_t hits = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < n; i++)
+        hits += kh_get(i64, h, queries[i]) != kh_end(h);
+    double t_first = now_sec() - t0;
+    t0 = now_sec();
+    for (size_t i = 0; i < n; i++)
+        hits += kh_get(i64, h, queries[i]) != kh_end(h);
+    double t_get = now_sec() - t0;
+    printf("  build %8.1f ms  save %8.1f ms  load_mmap %6.3f ms (%.0f MB)\n", t_build * 1e3, t_save * 1e3,
+           t_load * 1e3, (double)kh_n_buckets(h) * (2 * sizeof(khint64_t)) / (1 << 20));
+    printf("  get on the mapping: first pass %6.1f ns, second pass %6.1f ns  (%zu hits)\n", t_first * 1e9 / n,
+           t_get * 1e9 / n, hits / 2);
+    kh_destroy(i64, h);
+    remove(path);
+    free(keys);
+    free(queries);
+}
+
+// Lookups in a frozen table against the tables it could be frozen from
+static void bench_frozen(size_t n)
+{
+    printf("Frozen vs. open addressing, %zu int64 keys, 50%% hits:\n", n);
+    printf("  table    build(ms)  get(ns)  B/key\n");
+    khint64_t *keys = make_keys(n);
+    khint64_t *queries = make_queries(keys, n);
+    khash_t(i64) *h = kh_init(i64);
+    khash_t(swiss64) *s = kh_init(swiss64);
+    int ret;
+    double t0 = now_sec();
+    for (size_t i = 0; i < n; i++)
+    {
+        khint_t k = kh_put(i64, h, keys[i], &ret);
+        kh_value(h, k) = (khint64_t)i;
+    }
+    double t_quad = now_sec() - t0;
+    t0 = now_sec();
+    for (size_t i = 0; i < n; i++)
+    {
+        khint_t k = kh_put(swiss64, s, keys[i], &ret);
+        kh_value(s, k) = (khint64_t)i;
+    }
+    double t_swiss = now_sec() - t0;
+    t0 = now_sec();
+    khash_f_t(fi64) *f = kh_freeze(fi64, h);
+    double t_frozen = now_sec() - t0;
+    double g_quad = 1e9, g_swiss = 1e9, g_frozen = 1e9;
+    size_t hits[3] = {0, 0, 0};
+    for (int rep = 0; rep < BENCH_REPS; rep++)
+    {
+        memset(hits, 0, sizeof(hits));
+        t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            hits[0] += kh_get(i64, h, queries[i]) != kh_end(h);
+        g_quad = min_time(g_quad, now_sec() - t0);
+        t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            hits[1] += kh_get(swiss64, s, queries[i]) != kh_end(s);
+        g_swiss = min_time(g_swiss, now_sec() - t0);
+        t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            hits[2] += kh_f_get(fi64, f, queries[i]) != kh_f_end(f);
+        g_frozen = min_time(g_frozen, now_sec() - t0);
+    }
+    if (hits[0] != hits[1] || hits[0] != hits[2])
+        printf("  MISMATCH: %zu, %zu and %zu hits\n", hits[0], hits[1], hits[2]);
+    khint_t nb = kh_n_buckets(h);
+    double b_quad = (double)nb * 2 * sizeof(khint64_t) + __ac_fsize(nb) * sizeof(khint32_t);
+    double b_swiss = (double)kh_n_buckets(s) * (2 * sizeof(khint64_t) + 1) + __ac_fsize(kh_n_buckets(s)) * 4;
+    double b_frozen = (double)kh_f_size(f) * 2 * sizeof(khint64_t) + (double)f->n_groups * sizeof(uint16_t) +
+                      (double)(f->n_slots - kh_f_size(f)) * sizeof(uint32_t);
+    printf("  quad     %9.1f  %7.1f  %5.1f\n", t_quad * 1e3, g_quad * 1e9 / n, b_quad / n);
+    printf("  swiss    %9.1f  %7.1f  %5.1f\n", t_swiss * 1e3, g_swiss * 1e9 / n, b_swiss / n);
+    printf("  frozen   %9.1f  %7.1f  %5.1f  (freezing the quad table)\n", t_frozen * 1e3, g_frozen * 1e9 / n,
+           b_frozen / n);
+    kh_f_destroy(fi64, f);
+    kh_destroy(i64, h);
+    kh_destroy(swiss64, s);
+    free(keys);
+    free(queries);
+}
+
+#define FLOOD_LEN 32
+
+// n keys of FLOOD_LEN bytes: colliding under X31, under kh_wyhash() whatever its seed, or random
+static char **make_flood(size_t n, int kind)
+{
+    static const uint64_t wy_s1 = 0xe7037ed1a0b428dbULL;
+    char **keys = malloc(n * sizeof(char *));
+    for (size_t i = 0; i < n; i++)
+    {
+        char *k = keys[i] = malloc(FLOOD_LEN + 1);
+        if (kind == 0) // "Aa" and "BB" add the same to an X31 hash
+            for (int j = 0; j < FLOOD_LEN / 2; j++)
+                memcpy(k + 2 * j, i >> j & 1 ? "BB" : "Aa", 2);
+        else if (kind == 1) // a block starting with a wyhash constant zeroes the seed, and the rest is alike
+        {
+            memcpy(k, &wy_s1, 8);
+            for (int j = 0, r = (int)i; j < 8; j++, r /= 255)
+                k[8 + j] = (char)(r % 255 + 1);
+            memcpy(k + 16, "/static/tail.png", 16);
+        }
+        else
+            for (int j = 0; j < FLOOD_LEN; j++)
+                k[j] = "0123456789abcdef"[rng_next() & 15];
+        k[FLOOD_LEN] = 0;
+    }
+    return keys;
+}
+
+#define BENCH_FLOOD(name, label, sets, n)                                                 \
+    {                                                                                     \
+        double t[3];                                                                      \
+        size_t hits = 0;                                                                  \
+        for (int s = 0; s < 3; s++)                                                       \
+        {                                                                                 \
+            khash_t(name) *h = kh_init(name);                                             \
+            int ret;                                                                      \
+            double t0 = now_sec();                                                        \
+            for (size_t i = 0; i < n; i++)                                                \
+                kh_put(name, h, sets[s][i], &ret);                                        \
+            for (size_t i = 0; i < n; i++)                                                \
+                hits += kh_get(name, h, sets[s][i]) != kh_end(h);                         \
+            t[s] = now_sec() - t0;                                                        \
+            kh_destroy(name, h);                                                          \
+        }                                                                                 \
+        printf("  %-16s %10.1f %10.1f %10.1f  (%zu hits)\n", label, t[0] * 1e9 / (2 * n), \
+               t[1] * 1e9 / (2 * n), t[2] * 1e9 / (2 * n), hits);                         \
+    }
+
+// Hash flooding: keys chosen to collide against per-table seeded hashing
+static void bench_flood(size_t n)
+{
+    n >>= 10; // colliding keys cost O(n) each
+    if (n > (size_t)1 << (FLOOD_LEN / 2))
+        n = (size_t)1 << (FLOOD_LEN / 2);
+    printf("Hash flooding, %zu keys of %d bytes, ns per put or get:\n", n, FLOOD_LEN);
+    char **sets[3] = {make_flood(n, 0), make_flood(n, 1), make_flood(n, 2)};
+    printf("  %-16s %10s %10s %10s\n", "", "x31 keys", "wy keys", "random");
+    BENCH_FLOOD(str, "x31", sets, n);
+    BENCH_FLOOD(wystr, "wyhash seeded", sets, n);
+    BENCH_FLOOD(sstr, "guarded seeded", sets, n);
+    for (int s = 0; s < 3; s++)
+    {
+        for (size_t i = 0; i < n; i++)
+            free(sets[s][i]);
+        free(sets[s]);
+    }
+}
+
+// Look up every token of buf: copied out and null terminated for a C string table, or in place as a view
+#define BENCH_TOKENS(name, label, buf, len, key_of)                                    \
+    {                                                                                  \
+        double t = 1e9;                                                                \
+        size_t hits = 0, n_tok = 0;                                                    \
+        char tmp[64];                                                                  \
+        for (int rep = 0; rep < BENCH_REPS; rep++)                                     \
+        {                                                                              \
+            hits = n_tok = 0;                                                          \
+            double t0 = now_sec();                                                     \
+            for (const char *p = buf, *end = buf + len; p < end; n_tok++)              \
+            {                                                                          \
+                const char *q = memchr(p, ' ', (size_t)(end - p));                     \
+                size_t l = (size_t)((q ? q : end) - p);                                \
+                hits += kh_get(name, h_##name, key_of(p, l, tmp)) != kh_end(h_##name); \
+                p += l + 1;                                                            \
+            }                                                                          \
+            t = min_time(t, now_sec() - t0);                                           \
+        }                                                                              \
+        printf("  %-20s %6.1f ns/token  (%zu hits)\n", label, t * 1e9 / n_tok, hits);  \
+    }
+
+static const char *token_copy(const char *p, size_t l, char *tmp)
+{
+    memcpy(tmp, p, l);
+    tmp[l] = 0;
+    return tmp;
+}
+
+#define token_view(p, l, tmp) ((void)tmp, kh_sv(p, l))
+
+// A parser's hot loop: tokens of a large buffer looked up in a table of n / 64 words
+static void bench_view(size_t n)
+{
+    size_t n_words = n >> 6, len = 0;
+    printf("Token lookups, %zu space separated tokens from %zu words, half of them absent:\n", n, n_words);
+    char **words = malloc(2 * n_words * sizeof(char *));
+    for (size_t i = 0; i < 2 * n_words; i++)
+    {
+        words[i] = malloc(32);
+        snprintf(words[i], 32, "w%llx", (unsigned long long)(rng_next() >> (rng_next() % 40)));
+    }
+    khash_t(str) *h_str = kh_init(str);
+    khash_t(wy) *h_wy = kh_init(wy);
+    khash_t(view) *h_view = kh_init(view);
+    int ret;
+    for (size_t i = 0; i < n_words; i++)
+    {
+        kh_put(str, h_str, words[i], &ret);
+        kh_put(wy, h_wy, words[i], &ret);
+        kh_put(view, h_view, kh_sv_str(words[i]), &ret);
+    }
+    char *buf = malloc(n * 32);
+    for (size_t i = 0; i < n; i++)
+    {
+        const char *w = words[rng_next() % (2 * n_words)];
+        size_t l = strlen(w);
+        memcpy(buf + len, w, l);
+        buf[len + l] = ' ';
+        len += l + 1;
+    }
+    len--;
+    BENCH_TOKENS(str, "copy + str (x31)", buf, len, token_copy);
+    BENCH_TOKENS(wy, "copy + str (wyhash)", buf, len, token_copy);
+    BENCH_TOKENS(view, "view", buf, len, token_view);
+    kh_destroy(str, h_str);
+    kh_destroy(wy, h_wy);
+    kh_destroy(view, h_view);
+    for (size_t i = 0; i < 2 * n_words; i++)
+        free(words[i]);
+    free(words);
+    free(buf);
+}
+
+// n IDs drawn at 80% density from [lo, lo + 1.25 n)
+static khint32_t *make_ids(size_t n, size_t lo)
+{
+    khint32_t *ids = malloc(n * sizeof(khint32_t));
+    for (size_t i = 0, x = lo; i < n; x++)
+        if (rng_next() % 5)
+            ids[i++] = (khint32_t)x;
+    return ids;
+}
+
+// Sets of dense IDs as a khash set and as a bitset, and the intersection of two of them
+static void bench_bitset(size_t n)
+{
+    printf("Sets of %zu IDs at 80%% density, two of them overlapping by 80%%:\n", n);
+    khint32_t *ids[2] = {make_ids(n, 0), make_ids(n, n / 4)};
+    khint32_t *queries = malloc(n * sizeof(khint32_t));
+    for (size_t i = 0; i < n; i++)
+        queries[i] = (khint32_t)(rng_next() % (n + n / 2));
+    khash_t(iset) *h[2];
+    kh_bitset_t *s[2];
+    double t_put[2] = {0, 0}, t_get[2] = {1e9, 1e9}, t_and[2] = {1e9, 1e9}, t_count[2] = {1e9, 1e9};
+    size_t hits[2] = {0, 0}, both[2] = {0, 0}, count[2] = {0, 0};
+    int ret;
+    for (int j = 0; j < 2; j++)
+    {
+        h[j] = kh_init(iset);
+        s[j] = kh_b_init();
+        double t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            kh_put(iset, h[j], ids[j][i], &ret);
+        t_put[0] += now_sec() - t0;
+        t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            kh_b_put(s[j], ids[j][i], &ret);
+        t_put[1] += now_sec() - t0;
+    }
+    for (int rep = 0; rep < BENCH_REPS; rep++)
+    {
+        hits[0] = hits[1] = 0;
+        double t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            hits[0] += kh_get(iset, h[0], queries[i]) != kh_end(h[0]);
+        t_get[0] = min_time(t_get[0], now_sec() - t0);
+        t0 = now_sec();
+        for (size_t i = 0; i < n; i++)
+            hits[1] += kh_b_get(s[0], queries[i]);
+        t_get[1] = min_time(t_get[1], now_sec() - t0);
+
+        // Intersection: look the keys of one table up in the other
+        t0 = now_sec();
+        khash_t(iset) *hi = kh_init(iset);
+        for (khint_t k = kh_begin(h[0]); k != kh_end(h[0]); ++k)
+            if (kh_exist(h[0], k) && kh_get(iset, h[1], kh_key(h[0], k)) != kh_end(h[1]))
+                kh_put(iset, hi, kh_key(h[0], k), &ret);
+        t_and[0] = min_time(t_and[0], now_sec() - t0);
+        both[0] = kh_size(hi);
+        kh_destroy(iset, hi);
+        t0 = now_sec();
+        kh_bitset_t *si = kh_b_intersect(s[0], s[1]);
+        t_and[1] = min_time(t_and[1], now_sec() - t0);
+        both[1] = kh_b_size(si);
+        kh_b_destroy(si);
+
+        count[0] = 0;
+        t0 = now_sec();
+        for (khint_t k = kh_begin(h[0]); k != kh_end(h[0]); ++k)
+            count[0] += kh_exist(h[0], k) && kh_get(iset, h[1], kh_key(h[0], k)) != kh_end(h[1]);
+        t_count[0] = min_time(t_count[0], now_sec() - t0);
+        t0 = now_sec();
+        count[1] = kh_b_intersect_size(s[0], s[1]);
+        t_count[1] = min_time(t_count[1], now_sec() - t0);
+    }
+    size_t bytes[2] = {kmem_usage_total(kh_memory_usage(iset, h[0])), kmem_usage_total(kh_b_memory_usage(s[0]))};
+    const char *labels[2] = {"khash set", "bitset"};
+    for (int j = 0; j < 2; j++)
+        printf("  %-10s put %5.1f ns  get %5.1f ns (%zu hits)  %5.2f bytes/key  "
+               "intersect %7.2f ms (%zu)  count %7.3f ms (%zu)\n",
+               labels[j], t_put[j] * 1e9 / (2 * n), t_get[j] * 1e9 / n, hits[j], (double)bytes[j] / n,
+               t_and[j] * 1e3, both[j], t_count[j] * 1e3, count[j]);
+    for (int j = 0; j < 2; j++)
+    {
+        kh_destroy(iset, h[j]);
+        kh_b_destroy(s[j]);
+        free(ids[j]);
+    }
+    free(queries);
+}
+
+static void add_counts(khint64_t *d, const khint64_t *s, void *ud)
+{
+    (void)ud;
+    *d += *s;
+}
+
+// Reduce of per-thread counts: a kh_get/kh_put loop per key against kh_merge, which grows once and reuses hashes
+#define BENCH_MERGE(name, label, keys, n, parts)                                                             \
+    {                                                                                                        \
+        khash_t(name) *part[parts];                                                                          \
+        int ret;                                                                                             \
+        for (int j = 0; j < (parts); j++)                                                                    \
+        { /* each part counts an overlapping window of the keys */                                           \
+            part[j] = kh_init(name);                                                                         \
+            size_t lo = (size_t)j * (n) / (2 * (parts));                                                     \
+            for (size_t i = lo; i < lo + (n) / 2; i++)                                                       \
+            {                                                                                                \
+                khint_t x = kh_put(name, part[j], keys[i], &ret);                                            \
+                kh_value(part[j], x) = ret ? 1 : kh_value(part[j], x) + 1;                                   \
+            }                                                                                                \
+        }                                                                                                    \
+        double t_loop = 1e9, t_merge = 1e9;                                                                  \
+        size_t keys_in[2] = {0, 0};                                                                          \
+        for (int rep = 0; rep < BENCH_REPS; rep++)                                                           \
+        {                                                                                                    \
+            khash_t(name) *d = kh_init(name);                                                                \
+            double t0 = now_sec();                                                                           \
+            for (int j = 0; j < (parts); j++)                                                                \
+                for (khint_t k = kh_begin(part[j]); k != kh_end(part[j]); ++k)                               \
+                {                                                                                            \
+                    if (!kh_exist(part[j], k))                                                               \
+                        continue;                                                                            \
+                    khint_t x = kh_put(name, d, kh_key(part[j], k), &ret);                                   \
+                    kh_value(d, x) = (ret ? 0 : kh_value(d, x)) + kh_value(part[j], k);                      \
+                }                                                                                            \
+            t_loop = min_time(t_loop, now_sec() - t0);                                                       \
+            keys_in[0] = kh_size(d);                                                                         \
+            kh_destroy(name, d);                                                                             \
+            d = kh_init(name);                                                                               \
+            t0 = now_sec();                                                                                  \
+            for (int j = 0; j < (parts); j++)                                                                \
+                kh_merge(name, d, part[j], add_counts, NULL);                                                \
+            t_merge = min_time(t_merge, now_sec() - t0);                                                     \
+            keys_in[1] = kh_size(d);                                                                         \
+            kh_destroy(name, d);                                                                             \
+        }                                                                                                    \
+        if (keys_in[0] != keys_in[1])                                                                        \
+            printf("  MISMATCH: %zu vs %zu keys\n", keys_in[0], keys_in[1]);                                 \
+        printf("  %-12s loop %7.1f ms  kh_merge %7.1f ms  (%zu keys)\n", label, t_loop * 1e3, t_merge * 1e3, \
+               keys_in[1]);                                                                                  \
+        for (int j = 0; j < (parts); j++)                                                                    \
+            kh_destroy(name, part[j]);                                                                       \
+    }
+
+// Merging per-thread tables into one, and intersecting two tables
+static void bench_algebra(size_t n)
+{
+    printf("Merging 4 partial tables of %zu keys each, 3/4 shared with the next:\n", n / 2);
+    khint64_t *keys = make_keys(n);
+    BENCH_MERGE(i64, "int64", keys, n, 4);
+    BENCH_MERGE(swiss64, "int64/swiss", keys, n, 4);
+    char **urls = make_urls(n / 8);
+    BENCH_MERGE(str, "url", urls, n / 8, 4);
+    BENCH_MERGE(hstr, "url+hash", urls, n / 8, 4);
+    for (size_t i = 0; i < n / 4; i++)
+        free(urls[i]);
+    free(urls);
+
+    // Intersection: look the keys of the smaller table up in the larger one
+    khash_t(i64) *a = kh_init(i64), *b = kh_init(i64);
+    int ret;
+    for (size_t i = 0; i < n; i++)
+        kh_put(i64, i < n / 2 ? b : a, keys[i], &ret);
+    for (size_t i = 0; i < n / 4; i++)
+        kh_put(i64, b, keys[i * 4], &ret);
+    double t_loop = 1e9, t_op = 1e9;
+    size_t both[2] = {0, 0};
+    for (int rep = 0; rep < BENCH_REPS; rep++)
+    {
+        double t0 = now_sec();
+        khash_t(i64) *d = kh_init(i64);
+        for (khint_t k = kh_begin(b); k != kh_end(b); ++k)
+            if (kh_exist(b, k) && kh_get(i64, a, kh_key(b, k)) != kh_end(a))
+                kh_put(i64, d, kh_key(b, k), &ret);
+        t_loop = min_time(t_loop, now_sec() - t0);
+        both[0] = kh_size(d);
+        kh_destroy(i64, d);
+        d = kh_init(i64);
+        kh_union(i64, d, a);
+        t0 = now_sec();
+        kh_intersect(i64, d, b);
+        t_op = min_time(t_op, now_sec() - t0);
+        both[1] = kh_size(d);
+        kh_destroy(i64, d);
+    }
+    printf("  intersect %zu with %zu keys: loop %7.1f ms  kh_intersect %7.1f ms  (%zu vs %zu kept)\n",
+           (size_t)kh_size(a), (size_t)kh_size(b), t_loop * 1e3, t_op * 1e3, both[0], both[1]);
+    kh_destroy(i64, a);
+    kh_destroy(i64, b);
+    free(keys);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*run)(size_t n);
+} bench_t;
+
+static const bench_t benches[] = {
+    {"batch", bench_batch},
+    {"incremental", bench_incremental},
+    {"width", bench_width},
+    {"storehash", bench_store_hash},
+    {"intern", bench_intern},
+    {"alloc", bench_alloc},
+    {"churn", bench_churn},
+    {"load", bench_load},
+    {"scan", bench_scan},
+    {"mmap", bench_mmap},
+    {"frozen", bench_frozen},
+    {"layout", bench_layout},
+    {"flood", bench_flood},
+    {"view", bench_view},
+    {"bitset", bench_bitset},
+    {"algebra", bench_algebra},
+};
+
+int main(int argc, char *argv[])
+{
+    const char *section = argc > 1 ? argv[1] : "all";
+    size_t n = argc > 2 ? strtoull(argv[2], NULL, 10) : (size_t)1 << 23;
+    int found = 0;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+    {
+        if (strcmp(section, "all") != 0 && strcmp(section, benches[i].name) != 0)
+            continue;
+        benches[i].run(n);
+        found = 1;
+    }
+    if (!found)
+    {
+        fprintf(stderr, "unknown benchmark: %s\n", section);
+        return 1;
+    }
+    return 0;
+}
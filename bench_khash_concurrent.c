@@ -0,0 +1,295 @@
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t, nanosleep
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "khash_concurrent.h"
+#include "khash_parallel.h"
+
+// Throughput of the concurrent map against a khash behind a rwlock, and of
+// the sharded table against a khash behind a mutex for pure inserts; misses
+// in a sharded KH_SWISS map by number of shards; and throughput of kh_build()
+// against a loop of kh_put(), of kh_resize() on one thread and on all of
+// them, and of kh_par_scan().
+// Usage: ./bench_khash_concurrent [n_keys] [ms_per_run]
+
+KHASH_CONCURRENT_INIT(c64, khint64_t, khint64_t, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_PARALLEL_INIT(m64, khint64_t, khint64_t, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_MAP_INIT_INT64(serial64, khint64_t)
+KHASH_SHARDED_INIT(s64, khint64_t, khint64_t, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_SHARDED_INIT(sw64, khint64_t, khint64_t, KH_MAP | KH_SWISS, kh_int64_hash_func, kh_int64_hash_equal)
+
+typedef struct
+{
+    khash_c_t(c64) *ch;
+    khash_t(m64) *h;
+    pthread_rwlock_t *lock;
+    _Atomic int *stop;
+    int writer;
+    uint64_t seed, n_keys, ops;
+} worker_t;
+
+static double now_sec()
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *run_concurrent(void *p)
+{
+    worker_t *w = p;
+    int r = w->writer ? -1 : kh_c_register(c64, w->ch);
+    khint64_t v;
+    while (!atomic_load_explicit(w->stop, memory_order_relaxed))
+    {
+        khint64_t key = (khint64_t)(splittable64(w->seed++) % w->n_keys);
+        if (w->writer)
+        { // keep the size steady: replace one key, drop another
+            kh_c_put(c64, w->ch, key, key);
+            kh_c_del(c64, w->ch, (key + w->n_keys / 2) % w->n_keys);
+        }
+        else
+            kh_c_get(c64, w->ch, r, key, &v);
+        w->ops++;
+    }
+    return NULL;
+}
+
+static void *run_locked(void *p)
+{
+    worker_t *w = p;
+    int ret;
+    while (!atomic_load_explicit(w->stop, memory_order_relaxed))
+    {
+        khint64_t key = (khint64_t)(splittable64(w->seed++) % w->n_keys);
+        if (w->writer)
+        {
+            pthread_rwlock_wrlock(w->lock);
+            khint_t k = kh_put(m64, w->h, key, &ret);
+            kh_value(w->h, k) = key;
+            kh_del(m64, w->h, kh_get(m64, w->h, (key + w->n_keys / 2) % w->n_keys));
+            pthread_rwlock_unlock(w->lock);
+        }
+        else
+        {
+            pthread_rwlock_rdlock(w->lock);
+            khint_t k = kh_get(m64, w->h, key);
+            if (k != kh_end(w->h))
+                w->ops += kh_value(w->h, k) == (khint64_t)-1; // keep the load
+            pthread_rwlock_unlock(w->lock);
+        }
+        w->ops++;
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    khash_s_t(s64) *sh;
+    khash_t(m64) *h;
+    pthread_mutex_t *lock;
+    uint64_t begin, end;
+} inserter_t;
+
+static void *insert_sharded(void *p)
+{
+    inserter_t *w = p;
+    for (uint64_t i = w->begin; i < w->end; i++)
+        kh_s_put(s64, w->sh, (khint64_t)splittable64(i), (khint64_t)i);
+    return NULL;
+}
+
+static void *insert_locked(void *p)
+{
+    inserter_t *w = p;
+    int ret;
+    for (uint64_t i = w->begin; i < w->end; i++)
+    {
+        pthread_mutex_lock(w->lock);
+        khint_t k = kh_put(m64, w->h, (khint64_t)splittable64(i), &ret);
+        kh_value(w->h, k) = (khint64_t)i;
+        pthread_mutex_unlock(w->lock);
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    khash_t(m64) *h;
+    khint64_t sum[64];
+} scan_t;
+
+static void sum_part(void *arg, int t, khint_t begin, khint_t end)
+{
+    scan_t *s = arg;
+    khint64_t v, sum = 0;
+    kh_foreach_value_range(s->h, begin, end, v, sum += v);
+    s->sum[t] = sum;
+}
+
+// Inserts n_keys fresh keys split over n_threads; returns Mops/s
+static double run_inserts(void *(*fn)(void *), int n_threads, uint64_t n_keys)
+{
+    pthread_t tid[64];
+    inserter_t w[64];
+    pthread_mutex_t lock;
+    pthread_mutex_init(&lock, NULL);
+    khash_s_t(s64) *sh = kh_s_init(s64, 6);
+    khash_t(m64) *h = kh_init(m64);
+    double t0 = now_sec();
+    for (int t = 0; t < n_threads; t++)
+    {
+        w[t] = (inserter_t){sh, h, &lock, n_keys * t / n_threads, n_keys * (t + 1) / n_threads};
+        pthread_create(&tid[t], NULL, fn, &w[t]);
+    }
+    for (int t = 0; t < n_threads; t++)
+        pthread_join(tid[t], NULL);
+    double mops = n_keys / (now_sec() - t0) / 1e6;
+    kh_s_destroy(s64, sh);
+    kh_destroy(m64, h);
+    pthread_mutex_destroy(&lock);
+    return mops;
+}
+
+// Runs n_threads workers, the first n_writers of them writing; returns Mops/s
+static double run(void *(*fn)(void *), khash_c_t(c64) *ch, khash_t(m64) *h, pthread_rwlock_t *lock,
+                  int n_threads, int n_writers, uint64_t n_keys, double seconds)
+{
+    pthread_t tid[64];
+    worker_t w[64];
+    _Atomic int stop = 0;
+    double t0 = now_sec(); // workers start running as they are created
+    for (int t = 0; t < n_threads; t++)
+    {
+        w[t] = (worker_t){ch, h, lock, &stop, t < n_writers, (uint64_t)t << 40, n_keys, 0};
+        pthread_create(&tid[t], NULL, fn, &w[t]);
+    }
+    struct timespec ts = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&ts, NULL);
+    atomic_store(&stop, 1);
+    uint64_t ops = 0;
+    for (int t = 0; t < n_threads; t++)
+    {
+        pthread_join(tid[t], NULL);
+        ops += w[t].ops;
+    }
+    return ops / (now_sec() - t0) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t n_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    double seconds = (argc > 2 ? atof(argv[2]) : 200) / 1e3;
+
+    khash_c_t(c64) *ch = kh_c_init(c64);
+    khash_t(m64) *h = kh_init(m64);
+    pthread_rwlock_t lock;
+    pthread_rwlock_init(&lock, NULL);
+    int ret;
+    for (uint64_t i = 0; i < n_keys; i += 2)
+    {
+        kh_c_put(c64, ch, (khint64_t)i, (khint64_t)i);
+        khint_t k = kh_put(m64, h, (khint64_t)i, &ret);
+        kh_value(h, k) = (khint64_t)i;
+    }
+
+    printf("Concurrent map vs. khash + rwlock, %llu keys, Mops/s:\n", (unsigned long long)n_keys);
+    printf("  threads  writers  concurrent  rwlock\n");
+    for (int n_threads = 1; n_threads <= 64; n_threads <<= 1)
+    {
+        int writers[3] = {0, 1, n_threads / 4};
+        for (int j = 0; j < 3; j++)
+        {
+            if (writers[j] >= n_threads || (j > 0 && writers[j] <= writers[j - 1]))
+                continue;
+            double c = run(run_concurrent, ch, h, &lock, n_threads, writers[j], n_keys, seconds);
+            double l = run(run_locked, ch, h, &lock, n_threads, writers[j], n_keys, seconds);
+            printf("  %7d  %7d  %10.2f  %6.2f\n", n_threads, writers[j], c, l);
+        }
+    }
+
+    printf("\nSharded (64 shards) vs. khash + mutex, inserting %llu keys, Mops/s:\n", (unsigned long long)n_keys);
+    printf("  threads  sharded  mutex\n");
+    for (int n_threads = 1; n_threads <= 64; n_threads <<= 1)
+    {
+        double s = run_inserts(insert_sharded, n_threads, n_keys);
+        double l = run_inserts(insert_locked, n_threads, n_keys);
+        printf("  %7d  %7.2f  %5.2f\n", n_threads, s, l);
+    }
+
+    printf("\nSharded KH_SWISS map of %llu keys, lookups that miss, ns/op:\n", (unsigned long long)n_keys);
+    printf("  shards  ns/op\n");
+    for (int bits = 0; bits <= 12; bits += 6)
+    { // the shard index must leave the tags of each shard varied
+        khash_s_t(sw64) *sw = kh_s_init(sw64, bits);
+        for (uint64_t i = 0; i < n_keys; i++)
+            kh_s_put(sw64, sw, (khint64_t)i, (khint64_t)i);
+        double t = now_sec();
+        for (uint64_t i = 0; i < n_keys; i++)
+            kh_s_get(sw64, sw, (khint64_t)(i + n_keys), NULL);
+        printf("  %6d  %5.1f\n", 1 << bits, (now_sec() - t) * 1e9 / n_keys);
+        kh_s_destroy(sw64, sw);
+    }
+
+    printf("\nkh_build() vs. kh_put() from arrays of %llu keys, a quarter of them repeats, Mops/s:\n",
+           (unsigned long long)n_keys);
+    khint64_t *keys = malloc(n_keys * sizeof(*keys)), *vals = malloc(n_keys * sizeof(*vals));
+    for (uint64_t i = 0; i < n_keys; i++)
+    {
+        keys[i] = (khint64_t)splittable64(i % (n_keys - n_keys / 4));
+        vals[i] = (khint64_t)i;
+    }
+    double t0 = now_sec();
+    khash_t(m64) *b = kh_init(m64);
+    for (uint64_t i = 0; i < n_keys; i++)
+    {
+        khint_t k = kh_put(m64, b, keys[i], &ret);
+        kh_value(b, k) = vals[i];
+    }
+    printf("  kh_put  %7.2f\n", n_keys / (now_sec() - t0) / 1e6);
+    kh_destroy(m64, b);
+    printf("  threads  kh_build\n");
+    for (int n_threads = 1; n_threads <= 64; n_threads <<= 1)
+    {
+        t0 = now_sec();
+        b = kh_build(m64, keys, vals, n_keys, n_threads);
+        printf("  %7d  %8.2f\n", n_threads, n_keys / (now_sec() - t0) / 1e6);
+        kh_destroy(m64, b);
+    }
+
+    printf("\nkh_resize() of %llu keys to twice the buckets, ms:\n", (unsigned long long)n_keys);
+    khash_t(serial64) *sh = kh_init(serial64);
+    b = kh_build(m64, keys, vals, n_keys, 1);
+    for (uint64_t i = 0; i < n_keys; i++)
+    {
+        khint_t k = kh_put(serial64, sh, keys[i], &ret);
+        kh_value(sh, k) = vals[i];
+    }
+    t0 = now_sec();
+    kh_resize(serial64, sh, kh_end(sh) * 2);
+    printf("  1 thread    %8.1f\n", (now_sec() - t0) * 1e3);
+    t0 = now_sec();
+    kh_resize(m64, b, kh_end(b) * 2);
+    printf("  %3d threads %8.1f\n", __kh_par_threads(), (now_sec() - t0) * 1e3);
+    kh_destroy(serial64, sh);
+
+    printf("\nkh_par_scan() summing %llu values in %llu buckets, GB/s of buckets:\n", (unsigned long long)kh_size(b),
+           (unsigned long long)kh_end(b));
+    printf("  threads  GB/s\n");
+    double bytes = (double)kh_end(b) * (2 * sizeof(khint64_t) + 0.25);
+    for (int n_threads = 1; n_threads <= 64; n_threads <<= 1)
+    {
+        scan_t s = {b, {0}};
+        t0 = now_sec();
+        kh_par_scan(b, n_threads, sum_part, &s);
+        printf("  %7d  %4.2f\n", n_threads, bytes / (now_sec() - t0) / 1e9);
+    }
+    kh_destroy(m64, b);
+    free(keys);
+    free(vals);
+
+    pthread_rwlock_destroy(&lock);
+    kh_c_destroy(c64, ch);
+    kh_destroy(m64, h);
+    return 0;
+}
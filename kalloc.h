@@ -0,0 +1,187 @@
+#ifndef KALLOC_H_
+#define KALLOC_H_
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Default memory allocation functions; define them before including any of
+   the headers to replace them everywhere */
+#ifndef kcalloc
+#define kcalloc(N, Z) calloc(N, Z)
+#endif
+#ifndef kmalloc
+#define kmalloc(Z) malloc(Z)
+#endif
+#ifndef krealloc
+#define krealloc(P, Z) realloc(P, Z)
+#endif
+#ifndef kfree
+#define kfree(P) free(P)
+#endif
+
+/*
+  Allocator of a single hash table or vector, for per-request arenas, pools
+  or huge pages. Callers always pass the size a block was allocated with to
+  resize and release, so a backend does not have to record it; they never
+  pass NULL to either. ctx is handed to every call unchanged.
+
+  An example:
+
+static void *my_alloc(void *ctx, size_t size) { return pool_alloc(ctx, size); }
+...
+kalloc_t a = {my_alloc, my_resize, my_release, pool};
+khash_t(32) *h = kh_init_with_alloc(32, &a); // a must outlive h
+ */
+typedef struct kalloc_s
+{
+    void *(*alloc)(void *ctx, size_t size);
+    void *(*resize)(void *ctx, void *p, size_t old_size, size_t new_size);
+    void (*release)(void *ctx, void *p, size_t size);
+    void *ctx;
+} kalloc_t;
+
+/* The functions below use kmalloc() and friends when a is NULL */
+
+static inline void *kalloc_malloc(const kalloc_t *a, size_t size)
+{
+    return a ? a->alloc(a->ctx, size) : kmalloc(size);
+}
+
+static inline void *kalloc_calloc(const kalloc_t *a, size_t size)
+{
+    if (!a)
+        return kcalloc(1, size);
+    void *p = a->alloc(a->ctx, size);
+    if (p)
+        memset(p, 0, size);
+    return p;
+}
+
+static inline void *kalloc_realloc(const kalloc_t *a, void *p, size_t old_size, size_t new_size)
+{
+    if (!a)
+        return krealloc(p, new_size);
+    return p ? a->resize(a->ctx, p, old_size, new_size) : a->alloc(a->ctx, new_size);
+}
+
+static inline void kalloc_free(const kalloc_t *a, void *p, size_t size)
+{
+    if (!a)
+        kfree(p);
+    else if (p)
+        a->release(a->ctx, p, size);
+}
+
+/*
+  Bytes held by a container, as reported by kh_memory_usage() and
+  vtype##_memory_usage(). The four parts add up to what the container has
+  allocated; a vector does not count its own struct, which callers embed.
+ */
+typedef struct kmem_usage_s
+{
+    size_t live;       /* keys, values and elements in use */
+    size_t slack;      /* room for elements that is not in use: empty buckets, spare capacity */
+    size_t tombstones; /* buckets of deleted keys that are not reclaimed yet */
+    size_t overhead;   /* bookkeeping: table headers, flags, control bytes, stored hashes */
+} kmem_usage_t;
+
+static inline size_t kmem_usage_total(kmem_usage_t u)
+{
+    return u.live + u.slack + u.tombstones + u.overhead;
+}
+
+/* Add u to the running sum *acc, to report many containers as one */
+static inline void kmem_usage_add(kmem_usage_t *acc, kmem_usage_t u)
+{
+    acc->live += u.live;
+    acc->slack += u.slack;
+    acc->tombstones += u.tombstones;
+    acc->overhead += u.overhead;
+}
+
+/*
+  Allocator that counts what its containers hold, and forwards to parent
+  (NULL for kmalloc() and friends). Give one tally to every container of a
+  kind, e.g. all the caches of a process, to tell how much of its memory
+  each kind takes; the counters are atomic, so one tally may serve
+  containers on several threads. The tally must outlive its containers.
+
+  An example:
+
+kalloc_tally_t t;
+kalloc_tally_init(&t, NULL);
+khash_t(32) *h = kh_init_with_alloc(32, &t.a);
+...
+printf("%zu bytes, at most %zu\n", kalloc_tally_bytes(&t), kalloc_tally_peak(&t));
+ */
+typedef struct kalloc_tally_s
+{
+    kalloc_t a;               /* the allocator to hand to containers */
+    const kalloc_t *parent;   /* where the memory comes from */
+    atomic_size_t bytes;      /* held now */
+    atomic_size_t peak;       /* most held at once */
+    atomic_size_t n_blocks;   /* blocks held now */
+} kalloc_tally_t;
+
+static inline void __kalloc_tally_grow(kalloc_tally_t *t, size_t size)
+{
+    size_t now = atomic_fetch_add_explicit(&t->bytes, size, memory_order_relaxed) + size;
+    size_t peak = atomic_load_explicit(&t->peak, memory_order_relaxed);
+    while (now > peak && !atomic_compare_exchange_weak_explicit(&t->peak, &peak, now, memory_order_relaxed,
+                                                                memory_order_relaxed))
+        ;
+}
+
+static inline void *__kalloc_tally_alloc(void *ctx, size_t size)
+{
+    kalloc_tally_t *t = (kalloc_tally_t *)ctx;
+    void *p = kalloc_malloc(t->parent, size);
+    if (p)
+    {
+        __kalloc_tally_grow(t, size);
+        atomic_fetch_add_explicit(&t->n_blocks, 1, memory_order_relaxed);
+    }
+    return p;
+}
+
+static inline void *__kalloc_tally_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    kalloc_tally_t *t = (kalloc_tally_t *)ctx;
+    void *q = kalloc_realloc(t->parent, p, old_size, new_size);
+    if (q)
+    {
+        atomic_fetch_sub_explicit(&t->bytes, old_size, memory_order_relaxed);
+        __kalloc_tally_grow(t, new_size);
+    }
+    return q;
+}
+
+static inline void __kalloc_tally_release(void *ctx, void *p, size_t size)
+{
+    kalloc_tally_t *t = (kalloc_tally_t *)ctx;
+    kalloc_free(t->parent, p, size);
+    atomic_fetch_sub_explicit(&t->bytes, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&t->n_blocks, 1, memory_order_relaxed);
+}
+
+static inline void kalloc_tally_init(kalloc_tally_t *t, const kalloc_t *parent)
+{
+    t->a = (kalloc_t){__kalloc_tally_alloc, __kalloc_tally_resize, __kalloc_tally_release, t};
+    t->parent = parent;
+    atomic_init(&t->bytes, 0);
+    atomic_init(&t->peak, 0);
+    atomic_init(&t->n_blocks, 0);
+}
+
+static inline size_t kalloc_tally_bytes(const kalloc_tally_t *t)
+{
+    return atomic_load_explicit((atomic_size_t *)&t->bytes, memory_order_relaxed);
+}
+
+static inline size_t kalloc_tally_peak(const kalloc_tally_t *t)
+{
+    return atomic_load_explicit((atomic_size_t *)&t->peak, memory_order_relaxed);
+}
+
+#endif // KALLOC_H_
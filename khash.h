@@ -124,9 +124,12 @@ int main() {
 
 #define AC_VERSION_KHASH_H "0.2.8"
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#include "kalloc.h"
 
 typedef int32_t khint32_t;
 typedef uint32_t khuint32_t;
@@ -149,7 +152,13 @@ typedef uint64_t khuint64_t;
 #endif
 #endif /* klib_unused */
 
+/* Define KHASH_64 before including khash.h for 64-bit hashes and iterators,
+   lifting the limit of 2^30 buckets a table can have otherwise */
+#ifdef KHASH_64
+typedef khuint64_t khint_t;
+#else
 typedef khint32_t khint_t;
+#endif
 typedef khint_t khiter_t;
 
 /* Hash table probe statistics structure */
@@ -160,6 +169,66 @@ typedef struct
     double variance;   /* Variance of probe counts */
 } kh_probe_stat_t;
 
+/* Probe lengths told apart by kh_stats_t; longer probes count as the longest */
+#ifndef KH_STATS_HIST
+#define KH_STATS_HIST 16
+#endif
+
+/* Running counters of a table, kept when compiled with -DKHASH_STATS; see kh_stats() */
+typedef struct
+{
+    uint64_t n_hit, n_miss; /* lookups by kh_get() and kh_get_batch() that found the key, and that did not */
+    uint64_t n_probe;       /* buckets visited by those lookups; groups of buckets with KH_SWISS */
+    uint64_t probe_hist[KH_STATS_HIST]; /* lookups by buckets visited, 0 to KH_STATS_HIST - 1 or more */
+    uint64_t n_put, n_insert; /* kh_put() and kh_put_batch() keys, and those that were added */
+    uint64_t n_del;           /* keys removed by kh_del() */
+    uint64_t n_resize;        /* times the keys moved to new buckets: grows, shrinks and clean-ups */
+    uint64_t resize_ns;       /* wall time of those moves, in nanoseconds */
+} kh_stats_t;
+
+#ifdef KHASH_STATS
+#define __KH_STATS_FIELD kh_stats_t stats; /* KHASH_STATS counters */
+/* The counters of h, which may be const: lookups count too */
+#define __kh_stats_of(h) ((kh_stats_t *)&(h)->stats)
+static kh_inline uint64_t __kh_stats_clock(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+static kh_inline void __kh_stats_lookup(kh_stats_t *s, khint_t n_probes, int hit)
+{
+    /* no branch on the outcome: it would stall the next lookups whenever mispredicted */
+    s->n_hit += hit != 0;
+    s->n_miss += hit == 0;
+    s->n_probe += n_probes;
+    ++s->probe_hist[n_probes < KH_STATS_HIST ? n_probes : KH_STATS_HIST - 1];
+}
+#define __kh_stat_lookup(h, n_probes, hit) __kh_stats_lookup(__kh_stats_of(h), n_probes, hit)
+#define __kh_stat_put(h, ret) (++__kh_stats_of(h)->n_put, __kh_stats_of(h)->n_insert += (ret) > 0)
+#define __kh_stat_del(h) (++__kh_stats_of(h)->n_del)
+#define __kh_stat_resize(h, t0) (++__kh_stats_of(h)->n_resize, __kh_stats_of(h)->resize_ns += __kh_stats_clock() - (t0))
+#else
+#define __KH_STATS_FIELD
+static kh_inline uint64_t __kh_stats_clock(void)
+{
+    return 0;
+}
+#define __kh_stat_lookup(h, n_probes, hit) ((void)0)
+#define __kh_stat_put(h, ret) ((void)0)
+#define __kh_stat_del(h) ((void)0)
+#define __kh_stat_resize(h, t0) ((void)(t0))
+#endif
+
+/* Compaction policy of a table and how often it fired; see kh_set_compact() */
+typedef struct
+{
+    double max_tombstones; /* rehash when deleted buckets exceed this fraction of all buckets; 0 never */
+    double min_load;       /* shrink when keys fall below this fraction of all buckets; 0 never */
+    khint_t n_rehash;      /* in-place rehashes by kh_compact(), automatic or not */
+    khint_t n_shrink;      /* shrinks by kh_compact() */
+} kh_compact_t;
+
 #define __ac_isempty(flag, i) ((flag[i >> 4] >> ((i & 0xfU) << 1)) & 2)
 #define __ac_isdel(flag, i) ((flag[i >> 4] >> ((i & 0xfU) << 1)) & 1)
 #define __ac_iseither(flag, i) ((flag[i >> 4] >> ((i & 0xfU) << 1)) & 3)
@@ -167,6 +236,7 @@ typedef struct
 #define __ac_set_isempty_false(flag, i) (flag[i >> 4] &= ~(2ul << ((i & 0xfU) << 1)))
 #define __ac_set_isboth_false(flag, i) (flag[i >> 4] &= ~(3ul << ((i & 0xfU) << 1)))
 #define __ac_set_isdel_true(flag, i) (flag[i >> 4] |= 1ul << ((i & 0xfU) << 1))
+#define __ac_set_isempty_true(flag, i) (flag[i >> 4] |= 2ul << ((i & 0xfU) << 1))
 
 /* size of the flag array, m is the bucket size */
 #define __ac_fsize(m) (((m) >> 4) + 1)
@@ -176,316 +246,1627 @@ typedef struct
 #define kroundup32(x) (--(x), (x) |= (x) >> 1, (x) |= (x) >> 2, (x) |= (x) >> 4, (x) |= (x) >> 8, (x) |= (x) >> 16, ++(x))
 #endif
 
-/* Support custom memory allocation functions */
-#ifndef kcalloc
-#define kcalloc(N, Z) calloc(N, Z)
+/* round a 64 bit integer to the next power of 2 */
+#ifndef kroundup64
+#define kroundup64(x) (--(x), (x) |= (x) >> 1, (x) |= (x) >> 2, (x) |= (x) >> 4, (x) |= (x) >> 8, (x) |= (x) >> 16, (x) |= (x) >> 32, ++(x))
+#endif
+
+/* round a khint_t to the next power of 2 */
+#ifdef KHASH_64
+#define __ac_roundup(x) kroundup64(x)
+#else
+#define __ac_roundup(x) kroundup32(x)
+#endif
+
+/* Table options, passed in the kh_is_map slot of KHASH_INIT() and KHASH_INIT2() */
+#define KH_SET 0   /* keys only */
+#define KH_MAP 1   /* keys with values */
+#define KH_SWISS 2 /* probe groups of control bytes instead of single buckets */
+#define KH_STORE_HASH 4 /* keep each key's hash; fewer key compares, and resizes do not rehash */
+#define KH_ROBINHOOD 8 /* linear probing in Robin Hood order; deletions leave no tombstones */
+#define KH_INTERLEAVED 16 /* keep the key and value of a bucket side by side; maps only */
+#define KH_SEEDED 32 /* hash with a seed drawn for each table; set by KHASH_INIT_SEEDED() */
+#define KH_LOAD(pct) ((pct) << 8) /* grow above pct percent full, 1 to 99; default 77 */
+#define KH_GROWTH(m) (__ac_grow_shift(m) << 16) /* grow m times at a time: 2, 4 or 8; default 2 */
+
+#define __ac_grow_shift(m) ((m) >= 8 ? 3 : (m) >= 4 ? 2 : 1)
+#define __ac_opts_load(kh_opts) ((kh_opts) >> 8 & 0x7f ? ((kh_opts) >> 8 & 0x7f) / 100.0 : __ac_HASH_UPPER)
+#define __ac_opts_grow_shift(kh_opts) ((kh_opts) >> 16 & 3 ? (kh_opts) >> 16 & 3 : 1)
+
+/*
+  The KH_ROBINHOOD engine keeps, in ctrl[i], one more than the distance of
+  bucket i from the home bucket of its key, or 0 if the bucket is empty. Keys
+  of a cluster stay ordered by home bucket: a lookup stops at the first key
+  that is closer to its home than the probe, and kh_del() shifts the rest of
+  the cluster back one bucket instead of leaving a deleted bucket behind.
+  Because keys move, kh_put() and kh_del() invalidate other iterators, and
+  deleting inside a kh_foreach() may skip the key pulled into the current
+  bucket. KH_SWISS takes precedence if both are given.
+ */
+#define __kh_robinhood(kh_opts) (((kh_opts) & (KH_SWISS | KH_ROBINHOOD)) == KH_ROBINHOOD)
+
+/*
+  A KH_INTERLEAVED map keeps its buckets in one array of kh_##name##_pair_t,
+  so a hit reads its key and value from the same cache line; the flags,
+  control bytes and stored hashes stay in arrays of their own. keys points
+  to the key of the first pair and vals to its value, and bucket x lies
+  sizeof(key_stride) keys and sizeof(val_stride) values further on, which
+  the compiler folds into the address computation. A pair whose size is not
+  a multiple of both the key and the value size cannot be walked that way;
+  such maps, like sets, keep separate arrays.
+ */
+#define __kh_stride(kh_opts, pair_t, khkey_t, khval_t, T)                                         \
+    ((kh_opts) & KH_INTERLEAVED && (kh_opts) & KH_MAP && sizeof(pair_t) % sizeof(khkey_t) == 0 && \
+             sizeof(pair_t) % sizeof(khval_t) == 0                                                \
+         ? sizeof(pair_t) / sizeof(T)                                                             \
+         : 1)
+#define __kh_paired(h) (sizeof((h)->key_stride) > 1)
+/* Bytes of the keys and of the values of n buckets; the values of pairs take none of their own */
+#define __kh_keys_bytes(h, n) ((size_t)(n) * sizeof(*(h)->keys) * sizeof((h)->key_stride))
+#define __kh_vals_bytes(h, n) (__kh_paired(h) ? 0 : (size_t)(n) * sizeof(*(h)->vals))
+
+/*
+  Control bytes of the KH_SWISS engine. A full bucket holds the top 7 bits
+  of its hash; free buckets have the top bit set. Buckets are probed in
+  aligned groups of KH_GROUP_WIDTH, so one vector compare filters a whole
+  group and most misses stop at the first group without touching any key.
+ */
+#define __ac_CTRL_EMPTY ((uint8_t)0x80)
+#define __ac_CTRL_DELETED ((uint8_t)0xfe)
+#define __ac_ctrl_tag(k) ((uint8_t)(((uint64_t)(k) << (64 - sizeof(khint_t) * 8)) >> 57))
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define KH_GROUP_WIDTH 32
+#define __ac_GROUP_LOG2 5
+#define __ac_GROUP_BIT_SHIFT 0 /* bit i of a match mask is bucket i */
+typedef __m256i __ac_group_t;
+static kh_inline __ac_group_t __ac_group_load(const uint8_t *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+static kh_inline uint64_t __ac_group_match(__ac_group_t g, uint8_t c)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, _mm256_set1_epi8((char)c)));
+}
+static kh_inline uint64_t __ac_group_match_free(__ac_group_t g)
+{
+    return (uint32_t)_mm256_movemask_epi8(g);
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define KH_GROUP_WIDTH 16
+#define __ac_GROUP_LOG2 4
+#define __ac_GROUP_BIT_SHIFT 0
+typedef __m128i __ac_group_t;
+static kh_inline __ac_group_t __ac_group_load(const uint8_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+static kh_inline uint64_t __ac_group_match(__ac_group_t g, uint8_t c)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+}
+static kh_inline uint64_t __ac_group_match_free(__ac_group_t g)
+{
+    return (uint32_t)_mm_movemask_epi8(g);
+}
+#else /* portable fallback: 8 control bytes in a 64-bit word */
+#define KH_GROUP_WIDTH 8
+#define __ac_GROUP_LOG2 3
+#define __ac_GROUP_BIT_SHIFT 3 /* bit 8*i+7 of a match mask is bucket i */
+typedef uint64_t __ac_group_t;
+static kh_inline __ac_group_t __ac_group_load(const uint8_t *p)
+{
+    uint64_t g;
+    memcpy(&g, p, sizeof(g));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    g = __builtin_bswap64(g);
+#endif
+    return g;
+}
+static kh_inline uint64_t __ac_group_match(__ac_group_t g, uint8_t c)
+{ /* may report false positives after a true match; callers compare keys anyway */
+    uint64_t x = g ^ (0x0101010101010101ULL * c);
+    return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+}
+static kh_inline uint64_t __ac_group_match_free(__ac_group_t g)
+{
+    return g & 0x8080808080808080ULL;
+}
+#endif
+
+#if KH_GROUP_WIDTH == 8
+static kh_inline uint64_t __ac_group_match_empty(__ac_group_t g)
+{ /* exact: EMPTY is the only control byte with bit 7 set and bit 1 clear */
+    return g & ~(g << 6) & 0x8080808080808080ULL;
+}
+#else
+static kh_inline uint64_t __ac_group_match_empty(__ac_group_t g)
+{
+    return __ac_group_match(g, __ac_CTRL_EMPTY);
+}
 #endif
-#ifndef kmalloc
-#define kmalloc(Z) malloc(Z)
+
+/* index of the lowest set bit; x must be non-zero */
+static kh_inline int __ac_ctz64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int n = 0;
+    while (!(x & 1))
+        x >>= 1, ++n;
+    return n;
 #endif
-#ifndef krealloc
-#define krealloc(P, Z) realloc(P, Z)
+}
+
+/* Buckets of a flags word holding keys: bit 2j is set if bucket j is full */
+#define __ac_full_bits(w) (~((uint32_t)(w) | (uint32_t)(w) >> 1) & 0x55555555U)
+
+/* First full bucket in [i, n), or n; skips 16 empty or deleted buckets at a time */
+static kh_inline khint_t __ac_next_full(const khint32_t *flags, khint_t i, khint_t n)
+{
+    if (i >= n)
+        return n;
+    khint_t w = i >> 4;
+    uint32_t m = __ac_full_bits(flags[w]) & (0xffffffffU << ((i & 0xfU) << 1));
+    while (!m)
+    {
+        if (++w >= (n + 15) >> 4)
+            return n;
+        m = __ac_full_bits(flags[w]);
+    }
+    i = (w << 4) + (__ac_ctz64(m) >> 1);
+    return i < n ? i : n;
+}
+
+/* Hint the CPU to start loading an address; a no-op where unsupported */
+#ifndef kh_prefetch
+#if defined(__GNUC__) || defined(__clang__)
+#define kh_prefetch(p) __builtin_prefetch(p)
+#else
+#define kh_prefetch(p) ((void)(p))
 #endif
-#ifndef kfree
-#define kfree(P) free(P)
 #endif
 
+/* Number of keys hashed and prefetched ahead by kh_get_batch() and kh_put_batch() */
+#ifndef KH_BATCH_WINDOW
+#define KH_BATCH_WINDOW 16
+#endif
+
+/* Custom memory allocation: kmalloc() and friends in kalloc.h replace the
+   functions globally, kh_init_with_alloc() for a single table */
+
+/*
+  Bump allocator for the bytes of interned strings (see KHASH_INTERN_INIT())
+  and of keys copied by kh_put_copy().
+  Strings are packed back to back in blocks that never move, so pointers into
+  the arena stay valid until the table is cleared or destroyed. The arena
+  also keeps the string of every ID, in the order they were interned.
+ */
+typedef struct kh_arena_block_s
+{
+    struct kh_arena_block_s *next; /* the previous, full block */
+    size_t used, cap;
+    char data[];
+} kh_arena_block_t;
+
+typedef struct kh_arena_s
+{
+    kh_arena_block_t *head; /* block being filled */
+    size_t bytes;           /* bytes handed out over all blocks */
+    const char **strs;      /* string of each ID */
+    size_t n_strs, m_strs;
+    const kalloc_t *alloc; /* the table's allocator */
+} kh_arena_t;
+
+#ifndef KH_ARENA_BLOCK
+#define KH_ARENA_BLOCK 65536 /* size of the first block; later ones double up to 256 times that */
+#endif
+
+static kh_inline void kh_arena_destroy(kh_arena_t *a)
+{
+    if (!a)
+        return;
+    while (a->head)
+    {
+        kh_arena_block_t *b = a->head;
+        a->head = b->next;
+        kalloc_free(a->alloc, b, sizeof(kh_arena_block_t) + b->cap);
+    }
+    kalloc_free(a->alloc, (void *)a->strs, a->m_strs * sizeof(const char *));
+    kalloc_free(a->alloc, a, sizeof(kh_arena_t));
+}
+
+/* An empty arena taking its memory from alloc; NULL if out of memory */
+static kh_inline kh_arena_t *kh_arena_create(const kalloc_t *alloc)
+{
+    kh_arena_t *a = (kh_arena_t *)kalloc_calloc(alloc, sizeof(kh_arena_t));
+    if (a)
+        a->alloc = alloc;
+    return a;
+}
+
+/* Reserve n bytes, not yet handed out; NULL if out of memory */
+static kh_inline char *kh_arena_reserve(kh_arena_t *a, size_t n)
+{
+    kh_arena_block_t *b = a->head;
+    if (!b || b->cap - b->used < n)
+    {
+        size_t cap = b ? b->cap << 1 : KH_ARENA_BLOCK;
+        if (cap > (size_t)KH_ARENA_BLOCK << 8)
+            cap = (size_t)KH_ARENA_BLOCK << 8;
+        if (cap < n)
+            cap = n;
+        b = (kh_arena_block_t *)kalloc_malloc(a->alloc, sizeof(kh_arena_block_t) + cap);
+        if (!b)
+            return NULL;
+        b->next = a->head;
+        b->used = 0;
+        b->cap = cap;
+        a->head = b;
+    }
+    return b->data + b->used;
+}
+
+/* Hand out n bytes of the last reservation */
+static kh_inline void kh_arena_commit(kh_arena_t *a, size_t n)
+{
+    a->head->used += n;
+    a->bytes += n;
+}
+
 /* Default upper bound of filling factor. */
 static const double __ac_HASH_UPPER = 0.77;
 
+/* Upper bound of the number of elements in n buckets at load factor f; one bucket always stays free. */
+static kh_inline khint_t __ac_load_bound(khint_t n, double f)
+{
+    khint_t u = (khint_t)(n * f + 0.5);
+    return u < n ? u : n - 1;
+}
+
 /* Calculate the upper bound of the number of elements in a hash table given the number of buckets. */
-#define __ac_upper_bound(n) ((khint_t)((n) * __ac_HASH_UPPER + 0.5))
-
-#define __KHASH_TYPE(name, khkey_t, khval_t)              \
-    typedef struct kh_##name##_s                          \
-    {                                                     \
-        khint_t n_buckets, size, n_occupied, upper_bound; \
-        khint32_t *flags;                                 \
-        khkey_t *keys;                                    \
-        khval_t *vals;                                    \
+#define __ac_upper_bound(n) __ac_load_bound(n, __ac_HASH_UPPER)
+
+#define __KHASH_TYPE(name, khkey_t, khval_t, kh_opts)                                          \
+    typedef struct                                                                             \
+    {                                                                                          \
+        khkey_t key;                                                                           \
+        khval_t val;                                                                           \
+    } kh_##name##_pair_t;                                                                      \
+    typedef struct kh_##name##_s                                                               \
+    {                                                                                          \
+        khint_t n_buckets, size, n_occupied, upper_bound;                                      \
+        khint32_t *flags;                                                                      \
+        khkey_t *keys;                                                                         \
+        khval_t *vals;                                                                         \
+        uint8_t *ctrl; /* KH_SWISS control bytes, KH_ROBINHOOD probe distances */              \
+        khint_t *hashes; /* KH_STORE_HASH: hash of the key in each bucket */                   \
+        khint_t rehash_step, rehash_pos; /* incremental rehashing; see kh_set_incremental() */ \
+        struct kh_##name##_s *old; /* buckets still being migrated, or NULL */                 \
+        kh_arena_t *arena; /* storage of interned or copied keys, or NULL */                    \
+        const kalloc_t *alloc; /* allocator of this table; NULL for kmalloc() and friends */   \
+        double max_load; /* load factor above which the table grows; see kh_set_load() */      \
+        int grow_shift; /* the table grows 1 << grow_shift times */                            \
+        kh_compact_t compact; /* compaction policy and counters */                             \
+        uint64_t seed; /* KH_SEEDED: key of the hash function; see kh_reseed() */              \
+        khint_t reseed_probes, n_reseed; /* KH_SEEDED: see kh_set_reseed() */                  \
+        __KH_STATS_FIELD                                                                       \
+        /* only the sizes matter; see KH_INTERLEAVED */                                        \
+        char key_stride[__kh_stride(kh_opts, kh_##name##_pair_t, khkey_t, khval_t, khkey_t)];  \
+        char val_stride[__kh_stride(kh_opts, kh_##name##_pair_t, khkey_t, khval_t, khval_t)];  \
     } kh_##name##_t;
 
-#define __KHASH_PROTOTYPES(name, khkey_t, khval_t)                         \
-    extern kh_##name##_t *kh_init_##name(void);                            \
-    extern void kh_destroy_##name(kh_##name##_t *h);                       \
-    extern void kh_clear_##name(kh_##name##_t *h);                         \
-    extern khint_t kh_get_##name(const kh_##name##_t *h, khkey_t key);     \
-    extern int kh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets);  \
-    extern khint_t kh_put_##name(kh_##name##_t *h, khkey_t key, int *ret); \
-    extern void kh_del_##name(kh_##name##_t *h, khint_t x);                \
-    extern kh_probe_stat_t kh_probe_stat_##name(const kh_##name##_t *h);
-
-#define __KHASH_IMPL(name, SCOPE, khkey_t, khval_t, kh_is_map, __hash_func, __hash_equal)                     \
-    /* Allocate and initialize new hash table */                                                              \
-    SCOPE kh_##name##_t *kh_init_##name(void)                                                                 \
-    {                                                                                                         \
-        return (kh_##name##_t *)kcalloc(1, sizeof(kh_##name##_t));                                            \
-    }                                                                                                         \
-    /* Destroy and release memory of hash table */                                                            \
-    SCOPE void kh_destroy_##name(kh_##name##_t *h)                                                            \
-    {                                                                                                         \
-        if (h)                                                                                                \
-        {                                                                                                     \
-            kfree(h->keys);                                                                                   \
-            kfree(h->flags);                                                                                  \
-            kfree(h->vals);                                                                                   \
-            kfree(h);                                                                                         \
-        }                                                                                                     \
-    }                                                                                                         \
-    /* clear all keys (by setting all flags to empty) */                                                      \
-    SCOPE void kh_clear_##name(kh_##name##_t *h)                                                              \
-    {                                                                                                         \
-        if (h && h->flags)                                                                                    \
-        {                                                                                                     \
-            /* set all flags to empty */                                                                      \
-            memset(h->flags, 0xaa, __ac_fsize(h->n_buckets) * sizeof(khint32_t));                             \
-            h->size = h->n_occupied = 0;                                                                      \
-        }                                                                                                     \
-    }                                                                                                         \
-    SCOPE khint_t kh_get_##name(const kh_##name##_t *h, khkey_t key)                                          \
-    {                                                                                                         \
-        if (h->n_buckets == 0)                                                                                \
-            return 0;                                                                                         \
-        khint_t k, i, last, mask, step = 0;                                                                   \
-        mask = h->n_buckets - 1; /* n_buckets is always power of 2 */                                         \
-        k = __hash_func(key);                                                                                 \
-        i = k & mask;                                                                                         \
-        last = i;                                                                                             \
-        while (!__ac_isempty(h->flags, i) && (__ac_isdel(h->flags, i) || !__hash_equal(h->keys[i], key)))     \
-        {                                                                                                     \
-            i = (i + (++step)) & mask;                                                                        \
-            if (i == last)                                                                                    \
-                return h->n_buckets;                                                                          \
-        }                                                                                                     \
-        return __ac_iseither(h->flags, i) ? h->n_buckets : i;                                                 \
-    }                                                                                                         \
-    SCOPE int kh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets)                                       \
-    { /* Note: if new_n_buckets == old_n_buckets, this function will effectively do a rehash */               \
-        khint32_t *new_flags = NULL;                                                                          \
-        kroundup32(new_n_buckets);                                                                            \
-        if (new_n_buckets < 4)                                                                                \
-            new_n_buckets = 4;                                                                                \
-        if (h->size >= __ac_upper_bound(new_n_buckets))                                                       \
-            return 0; /* requested size is too small, do nothing */                                           \
-        /* hash table size to be changed (shrink or expand); rehash */                                        \
-        khint_t new_fsize = __ac_fsize(new_n_buckets);                                                        \
-        new_flags = (khint32_t *)kmalloc(new_fsize * sizeof(khint32_t));                                      \
-        if (!new_flags)                                                                                       \
-            return -1;                                                                                        \
-        memset(new_flags, 0xaa, new_fsize * sizeof(khint32_t));                                               \
-        if (h->n_buckets < new_n_buckets)                                                                     \
-        { /* expand */                                                                                        \
-            khkey_t *new_keys = (khkey_t *)krealloc(h->keys, new_n_buckets * sizeof(khkey_t));                \
-            if (!new_keys)                                                                                    \
-            {                                                                                                 \
-                kfree(new_flags);                                                                             \
-                return -1;                                                                                    \
-            }                                                                                                 \
-            if (kh_is_map)                                                                                    \
-            {                                                                                                 \
-                khval_t *new_vals = (khval_t *)krealloc(h->vals, new_n_buckets * sizeof(khval_t));            \
-                if (!new_vals)                                                                                \
-                {                                                                                             \
-                    kfree(new_flags);                                                                         \
-                    kfree(new_keys);                                                                          \
-                    return -1;                                                                                \
-                }                                                                                             \
-                h->vals = new_vals;                                                                           \
-            }                                                                                                 \
-            h->keys = new_keys;                                                                               \
-        }                                                                                                     \
-        /* rehashing */                                                                                       \
-        khint_t new_mask = new_n_buckets - 1;                                                                 \
-        for (khint_t j = 0; j != h->n_buckets; ++j)                                                           \
-        {                                                                                                     \
-            if (__ac_iseither(h->flags, j) == 0)                                                              \
-            {                                                                                                 \
-                khkey_t key = h->keys[j];                                                                     \
-                khval_t val;                                                                                  \
-                if (kh_is_map)                                                                                \
-                    val = h->vals[j];                                                                         \
-                __ac_set_isdel_true(h->flags, j);                                                             \
-                while (1)                                                                                     \
-                { /* kick-out process; sort of like in Cuckoo hashing */                                      \
-                    khint_t k, i, step = 0;                                                                   \
-                    k = __hash_func(key);                                                                     \
-                    i = k & new_mask;                                                                         \
-                    while (!__ac_isempty(new_flags, i))                                                       \
-                    {                                                                                         \
-                        i = (i + (++step)) & new_mask;                                                        \
-                    }                                                                                         \
-                    __ac_set_isempty_false(new_flags, i);                                                     \
-                    if (i < h->n_buckets && __ac_iseither(h->flags, i) == 0)                                  \
-                    { /* kick out the existing element */                                                     \
-                        {                                                                                     \
-                            khkey_t tmp = h->keys[i];                                                         \
-                            h->keys[i] = key;                                                                 \
-                            key = tmp;                                                                        \
-                        }                                                                                     \
-                        if (kh_is_map)                                                                        \
-                        {                                                                                     \
-                            khval_t tmp = h->vals[i];                                                         \
-                            h->vals[i] = val;                                                                 \
-                            val = tmp;                                                                        \
-                        }                                                                                     \
-                        __ac_set_isdel_true(h->flags, i); /* mark it as deleted in the old hash table */      \
-                    }                                                                                         \
-                    else                                                                                      \
-                    { /* write the element and jump out of the loop */                                        \
-                        h->keys[i] = key;                                                                     \
-                        if (kh_is_map)                                                                        \
-                            h->vals[i] = val;                                                                 \
-                        break;                                                                                \
-                    }                                                                                         \
-                }                                                                                             \
-            }                                                                                                 \
-        }                                                                                                     \
-        if (h->n_buckets > new_n_buckets)                                                                     \
-        { /* shrink the hash table */                                                                         \
-            h->keys = (khkey_t *)krealloc(h->keys, new_n_buckets * sizeof(khkey_t));                          \
-            if (kh_is_map)                                                                                    \
-                h->vals = (khval_t *)krealloc(h->vals, new_n_buckets * sizeof(khval_t));                      \
-        }                                                                                                     \
-        kfree(h->flags); /* free the working space */                                                         \
-        h->flags = new_flags;                                                                                 \
-        h->n_buckets = new_n_buckets;                                                                         \
-        h->n_occupied = h->size;                                                                              \
-        h->upper_bound = __ac_upper_bound(h->n_buckets);                                                      \
-        return 0;                                                                                             \
-    }                                                                                                         \
-    SCOPE khint_t kh_put_##name(kh_##name##_t *h, khkey_t key, int *ret)                                      \
-    {                                                                                                         \
-        if (h->n_occupied >= h->upper_bound)                                                                  \
-        { /* Need to expand or clean up the hash table */                                                     \
-            if (h->n_buckets > (h->size << 1))                                                                \
-            { /* Too many deleted elements, try to clean up */                                                \
-                if (kh_resize_##name(h, h->n_buckets - 1) < 0)                                                \
-                {                                                                                             \
-                    *ret = -1;                                                                                \
-                    return h->n_buckets;                                                                      \
-                }                                                                                             \
-            }                                                                                                 \
-            else                                                                                              \
-            { /* Need more space, expand the table */                                                         \
-                if (kh_resize_##name(h, h->n_buckets + 1) < 0)                                                \
-                {                                                                                             \
-                    *ret = -1;                                                                                \
-                    return h->n_buckets;                                                                      \
-                }                                                                                             \
-            }                                                                                                 \
-        }                                                                                                     \
-        /* Finding Insert Position */                                                                         \
-        khint_t k, i, last, mask = h->n_buckets - 1, step = 0;                                                \
-        khint_t x, site; /* x is the final position to put, site is the first position of deleted element */  \
-        x = site = h->n_buckets;                                                                              \
-        k = __hash_func(key);                                                                                 \
-        i = k & mask;                                                                                         \
-        if (__ac_isempty(h->flags, i)) /* Found empty slot immediately */                                     \
-            x = i;                     /* for speed up */                                                     \
-        else                                                                                                  \
-        { /* Need to probe further */                                                                         \
-            last = i;                                                                                         \
-            while (!__ac_isempty(h->flags, i) && (__ac_isdel(h->flags, i) || !__hash_equal(h->keys[i], key))) \
-            {                                                                                                 \
-                if (__ac_isdel(h->flags, i) && site == h->n_buckets)                                          \
-                    site = i;                                                                                 \
-                i = (i + (++step)) & mask;                                                                    \
-                if (i == last)                                                                                \
-                {                                                                                             \
-                    x = site;                                                                                 \
-                    break;                                                                                    \
-                }                                                                                             \
-            }                                                                                                 \
-            /* Choose where to put the key */                                                                 \
-            if (x == h->n_buckets)                                                                            \
-            {                                                                                                 \
-                if (__ac_isempty(h->flags, i) && site != h->n_buckets)                                        \
-                    x = site;                                                                                 \
-                else                                                                                          \
-                    x = i;                                                                                    \
-            }                                                                                                 \
-        }                                                                                                     \
-        if (__ac_isempty(h->flags, x))                                                                        \
-        { /* not present at all */                                                                            \
-            h->keys[x] = key;                                                                                 \
-            __ac_set_isboth_false(h->flags, x);                                                               \
-            ++h->size;                                                                                        \
-            ++h->n_occupied;                                                                                  \
-            *ret = 1;                                                                                         \
-        }                                                                                                     \
-        else if (__ac_isdel(h->flags, x))                                                                     \
-        { /* deleted */                                                                                       \
-            h->keys[x] = key;                                                                                 \
-            __ac_set_isboth_false(h->flags, x);                                                               \
-            ++h->size;                                                                                        \
-            *ret = 2;                                                                                         \
-        }                                                                                                     \
-        else                                                                                                  \
-            *ret = 0; /* Don't touch h->keys[x] if present and not deleted */                                 \
-        return x;                                                                                             \
-    }                                                                                                         \
-    SCOPE void kh_del_##name(kh_##name##_t *h, khint_t x)                                                     \
-    {                                                                                                         \
-        if (x != h->n_buckets && !__ac_iseither(h->flags, x))                                                 \
-        {                                                                                                     \
-            __ac_set_isdel_true(h->flags, x);                                                                 \
-            --h->size;                                                                                        \
-        }                                                                                                     \
-    }                                                                                                         \
-    SCOPE kh_probe_stat_t kh_probe_stat_##name(const kh_##name##_t *h)                                        \
-    {                                                                                                         \
-        kh_probe_stat_t stats = {0, 0.0, 0.0};                                                                \
-        khint_t n_filled = 0;                                                                                 \
-        double sum_probes = 0.0;                                                                              \
-        double sum_squares = 0.0;                                                                             \
-        khint_t mask = h->n_buckets - 1;                                                                      \
-                                                                                                              \
-        for (khint_t i = 0; i < h->n_buckets; ++i)                                                            \
-        {                                                                                                     \
-            if (__ac_iseither(h->flags, i))                                                                   \
-                continue;                                                                                     \
-                                                                                                              \
-            /* For each existing key, count probes needed to find it */                                       \
-            khkey_t key = h->keys[i];                                                                         \
-            khint_t k = __hash_func(key);                                                                     \
-            khint_t pos = k & mask;                                                                           \
-            int probes = 1;                                                                                   \
-                                                                                                              \
-            while (!__ac_isempty(h->flags, pos) &&                                                            \
-                   (__ac_isdel(h->flags, pos) || !__hash_equal(h->keys[pos], key)))                           \
-            {                                                                                                 \
-                pos = (pos + probes) & mask;                                                                  \
-                probes++;                                                                                     \
-            }                                                                                                 \
-                                                                                                              \
-            sum_probes += probes;                                                                             \
-            sum_squares += (double)probes * probes;                                                           \
-            if (probes > stats.max_probes)                                                                    \
-                stats.max_probes = probes;                                                                    \
-            n_filled++;                                                                                       \
-        }                                                                                                     \
-                                                                                                              \
-        if (n_filled > 0)                                                                                     \
-        {                                                                                                     \
-            stats.avg_probes = sum_probes / n_filled;                                                         \
-            double mean = stats.avg_probes;                                                                   \
-            stats.variance = (sum_squares / n_filled) - (mean * mean);                                        \
-        }                                                                                                     \
-                                                                                                              \
-        return stats;                                                                                         \
+#define __KHASH_PROTOTYPES(name, khkey_t, khval_t)                                                            \
+    extern kh_##name##_t *kh_init_##name(void);                                                               \
+    extern kh_##name##_t *kh_init_with_alloc_##name(const kalloc_t *a);                                       \
+    extern void kh_destroy_##name(kh_##name##_t *h);                                                          \
+    extern void kh_clear_##name(kh_##name##_t *h);                                                            \
+    extern khint_t kh_get_##name(const kh_##name##_t *h, khkey_t key);                                        \
+    extern int kh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets);                                     \
+    extern khint_t kh_put_##name(kh_##name##_t *h, khkey_t key, int *ret);                                    \
+    extern void kh_del_##name(kh_##name##_t *h, khint_t x);                                                   \
+    extern int kh_migrate_##name(kh_##name##_t *h, khint_t n_steps);                                          \
+    extern int kh_compact_##name(kh_##name##_t *h);                                                           \
+    extern int kh_set_load_##name(kh_##name##_t *h, double max_load, int growth);                             \
+    extern int kh_reseed_##name(kh_##name##_t *h, uint64_t seed);                                             \
+    extern kh_probe_stat_t kh_probe_stat_##name(const kh_##name##_t *h);                                      \
+    extern kmem_usage_t kh_memory_usage_##name(const kh_##name##_t *h);                                       \
+    extern void kh_get_batch_##name(const kh_##name##_t *h, const khkey_t *keys, size_t n, khint_t *out);     \
+    extern int kh_put_batch_##name(kh_##name##_t *h, const khkey_t *keys, size_t n, khint_t *out, int *rets); \
+    extern int kh_union_##name(kh_##name##_t *d, const kh_##name##_t *s);                                     \
+    extern int kh_intersect_##name(kh_##name##_t *d, const kh_##name##_t *s);                                 \
+    extern int kh_difference_##name(kh_##name##_t *d, const kh_##name##_t *s);                                \
+    extern int kh_merge_##name(kh_##name##_t *d, const kh_##name##_t *s,                                      \
+                               void (*combine)(khval_t *, const khval_t *, void *), void *ud);
+
+/* Bucket helpers and the KH_SWISS engine; they are static regardless of SCOPE. */
+#define __KHASH_IMPL_SWISS(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)                                       \
+    /* Release the bucket arrays, which are sized for h->n_buckets */                                                        \
+    static kh_inline klib_unused void __kh_free_buckets_##name(kh_##name##_t *h)                                             \
+    {                                                                                                                        \
+        kalloc_free(h->alloc, h->keys, __kh_keys_bytes(h, h->n_buckets));                                                    \
+        kalloc_free(h->alloc, h->flags, __ac_fsize(h->n_buckets) * sizeof(khint32_t));                                       \
+        if (!__kh_paired(h))                                                                                                 \
+            kalloc_free(h->alloc, h->vals, __kh_vals_bytes(h, h->n_buckets));                                                \
+        kalloc_free(h->alloc, h->ctrl, h->n_buckets);                                                                        \
+        kalloc_free(h->alloc, h->hashes, h->n_buckets * sizeof(khint_t));                                                    \
+    }                                                                                                                        \
+    /* Point vals into the pairs of a KH_INTERLEAVED map */                                                                  \
+    static kh_inline klib_unused void __kh_pair_vals_##name(kh_##name##_t *h)                                                \
+    {                                                                                                                        \
+        if (__kh_paired(h))                                                                                                  \
+            h->vals = h->keys ? (khval_t *)(void *)((char *)h->keys + offsetof(kh_##name##_pair_t, val)) : NULL;             \
+    }                                                                                                                        \
+    /* Give t new, empty buckets, leaving the old ones to the caller; on failure t has none and -1 is returned */            \
+    static kh_inline klib_unused int __kh_alloc_buckets_##name(kh_##name##_t *t, khint_t n_buckets)                          \
+    {                                                                                                                        \
+        khint_t fsize = __ac_fsize(n_buckets);                                                                               \
+        int need_vals = (kh_opts) & KH_MAP && !__kh_paired(t), need_ctrl = (kh_opts) & (KH_SWISS | KH_ROBINHOOD);            \
+        t->n_buckets = n_buckets;                                                                                            \
+        t->flags = (khint32_t *)kalloc_malloc(t->alloc, fsize * sizeof(khint32_t));                                          \
+        t->keys = (khkey_t *)kalloc_malloc(t->alloc, __kh_keys_bytes(t, n_buckets));                                         \
+        t->vals = need_vals ? (khval_t *)kalloc_malloc(t->alloc, __kh_vals_bytes(t, n_buckets)) : NULL;                      \
+        t->ctrl = need_ctrl ? (uint8_t *)kalloc_malloc(t->alloc, n_buckets) : NULL;                                          \
+        t->hashes = (kh_opts) & KH_STORE_HASH ? (khint_t *)kalloc_malloc(t->alloc, n_buckets * sizeof(khint_t)) : NULL;      \
+        if (!t->flags || !t->keys || (need_vals && !t->vals) || (need_ctrl && !t->ctrl) ||                                   \
+            ((kh_opts) & KH_STORE_HASH && !t->hashes))                                                                       \
+        {                                                                                                                    \
+            __kh_free_buckets_##name(t);                                                                                     \
+            t->flags = NULL, t->keys = NULL, t->vals = NULL, t->ctrl = NULL, t->hashes = NULL;                               \
+            return -1;                                                                                                       \
+        }                                                                                                                    \
+        __kh_pair_vals_##name(t);                                                                                            \
+        memset(t->flags, 0xaa, fsize * sizeof(khint32_t));                                                                   \
+        if (need_ctrl) /* KH_ROBINHOOD marks empty buckets with 0 */                                                         \
+            memset(t->ctrl, (kh_opts) & KH_SWISS ? __ac_CTRL_EMPTY : 0, n_buckets);                                          \
+        return 0;                                                                                                            \
+    }                                                                                                                        \
+    /* Does bucket i hold key, whose hash is k? Stored hashes are compared first */                                          \
+    static kh_inline klib_unused int __kh_key_eq_##name(const kh_##name##_t *h, khint_t i, khkey_t key, khint_t k)           \
+    {                                                                                                                        \
+        if ((kh_opts) & KH_STORE_HASH && h->hashes[i] != k)                                                                  \
+            return 0;                                                                                                        \
+        return __hash_equal(kh_key(h, i), key);                                                                              \
+    }                                                                                                                        \
+    /* Hash of the key in bucket i */                                                                                        \
+    static kh_inline klib_unused khint_t __kh_hash_at_##name(const kh_##name##_t *h, khint_t i)                              \
+    {                                                                                                                        \
+        return (kh_opts) & KH_STORE_HASH ? h->hashes[i] : __kh_hash_##name(h, kh_key(h, i));                                 \
+    }                                                                                                                        \
+    /* Find key, whose hash is k; *n_probes is set to the number of groups visited */                                        \
+    static kh_inline klib_unused khint_t __kh_swiss_get_##name(const kh_##name##_t *h, khkey_t key, khint_t k,               \
+                                                               khint_t *n_probes)                                            \
+    {                                                                                                                        \
+        khint_t gmask = (h->n_buckets >> __ac_GROUP_LOG2) - 1;                                                               \
+        khint_t g = (k >> __ac_GROUP_LOG2) & gmask, step = 0;                                                                \
+        uint8_t tag = __ac_ctrl_tag(k);                                                                                      \
+        while (1)                                                                                                            \
+        {                                                                                                                    \
+            __ac_group_t grp = __ac_group_load(h->ctrl + (g << __ac_GROUP_LOG2));                                            \
+            *n_probes = step + 1;                                                                                            \
+            for (uint64_t m = __ac_group_match(grp, tag); m; m &= m - 1)                                                     \
+            {                                                                                                                \
+                khint_t i = (g << __ac_GROUP_LOG2) + (__ac_ctz64(m) >> __ac_GROUP_BIT_SHIFT);                                \
+                if (__kh_key_eq_##name(h, i, key, k))                                                                        \
+                    return i;                                                                                                \
+            }                                                                                                                \
+            if (__ac_group_match_empty(grp) || step == gmask)                                                                \
+                return h->n_buckets;                                                                                         \
+            g = (g + (++step)) & gmask;                                                                                      \
+        }                                                                                                                    \
+    }                                                                                                                        \
+    /* Find the first free bucket for a key known to be absent */                                                            \
+    static kh_inline klib_unused khint_t __kh_swiss_free_slot_##name(const uint8_t *ctrl, khint_t n_buckets, khint_t k)      \
+    {                                                                                                                        \
+        khint_t gmask = (n_buckets >> __ac_GROUP_LOG2) - 1;                                                                  \
+        khint_t g = (k >> __ac_GROUP_LOG2) & gmask, step = 0;                                                                \
+        uint64_t m;                                                                                                          \
+        while (!(m = __ac_group_match_free(__ac_group_load(ctrl + (g << __ac_GROUP_LOG2)))))                                 \
+            g = (g + (++step)) & gmask;                                                                                      \
+        return (g << __ac_GROUP_LOG2) + (__ac_ctz64(m) >> __ac_GROUP_BIT_SHIFT);                                             \
+    }                                                                                                                        \
+    static kh_inline klib_unused int __kh_swiss_resize_##name(kh_##name##_t *h, khint_t new_n_buckets)                       \
+    {                                                                                                                        \
+        kh_##name##_t n = *h;                                                                                                \
+        if (__kh_alloc_buckets_##name(&n, new_n_buckets) < 0)                                                                \
+            return -1;                                                                                                       \
+        for (khint_t j = 0; j != h->n_buckets; ++j)                                                                          \
+        {                                                                                                                    \
+            if (h->ctrl[j] & 0x80)                                                                                           \
+                continue;                                                                                                    \
+            khint_t k = __kh_hash_at_##name(h, j);                                                                           \
+            khint_t i = __kh_swiss_free_slot_##name(n.ctrl, new_n_buckets, k);                                               \
+            n.ctrl[i] = __ac_ctrl_tag(k);                                                                                    \
+            __ac_set_isboth_false(n.flags, i);                                                                               \
+            kh_key(&n, i) = kh_key(h, j);                                                                                    \
+            if ((kh_opts) & KH_MAP)                                                                                          \
+                kh_val(&n, i) = kh_val(h, j);                                                                                \
+            if ((kh_opts) & KH_STORE_HASH)                                                                                   \
+                n.hashes[i] = k;                                                                                             \
+        }                                                                                                                    \
+        __kh_free_buckets_##name(h);                                                                                         \
+        h->ctrl = n.ctrl;                                                                                                    \
+        h->flags = n.flags;                                                                                                  \
+        h->keys = n.keys;                                                                                                    \
+        h->vals = n.vals;                                                                                                    \
+        h->hashes = n.hashes;                                                                                                \
+        h->n_buckets = new_n_buckets;                                                                                        \
+        h->n_occupied = h->size;                                                                                             \
+        h->upper_bound = __ac_load_bound(h->n_buckets, h->max_load);                                                         \
+        return 0;                                                                                                            \
+    }                                                                                                                        \
+    static kh_inline klib_unused khint_t __kh_swiss_put_##name(kh_##name##_t *h, khkey_t key, khint_t k, int *ret)           \
+    {                                                                                                                        \
+        khint_t gmask = (h->n_buckets >> __ac_GROUP_LOG2) - 1;                                                               \
+        khint_t g = (k >> __ac_GROUP_LOG2) & gmask, step = 0, site = h->n_buckets;                                           \
+        uint8_t tag = __ac_ctrl_tag(k);                                                                                      \
+        while (1)                                                                                                            \
+        {                                                                                                                    \
+            __ac_group_t grp = __ac_group_load(h->ctrl + (g << __ac_GROUP_LOG2));                                            \
+            for (uint64_t m = __ac_group_match(grp, tag); m; m &= m - 1)                                                     \
+            {                                                                                                                \
+                khint_t i = (g << __ac_GROUP_LOG2) + (__ac_ctz64(m) >> __ac_GROUP_BIT_SHIFT);                                \
+                if (__kh_key_eq_##name(h, i, key, k))                                                                        \
+                {                                                                                                            \
+                    *ret = 0;                                                                                                \
+                    return i;                                                                                                \
+                }                                                                                                            \
+            }                                                                                                                \
+            if (site == h->n_buckets)                                                                                        \
+            { /* remember the first free bucket, but keep looking for the key */                                             \
+                uint64_t m = __ac_group_match_free(grp);                                                                     \
+                if (m)                                                                                                       \
+                    site = (g << __ac_GROUP_LOG2) + (__ac_ctz64(m) >> __ac_GROUP_BIT_SHIFT);                                 \
+            }                                                                                                                \
+            if (__ac_group_match_empty(grp) || step == gmask)                                                                \
+                break;                                                                                                       \
+            g = (g + (++step)) & gmask;                                                                                      \
+        }                                                                                                                    \
+        if (site == h->n_buckets)                                                                                            \
+        {                                                                                                                    \
+            *ret = -1;                                                                                                       \
+            return site;                                                                                                     \
+        }                                                                                                                    \
+        if (h->ctrl[site] == __ac_CTRL_EMPTY)                                                                                \
+        {                                                                                                                    \
+            ++h->n_occupied;                                                                                                 \
+            *ret = 1;                                                                                                        \
+        }                                                                                                                    \
+        else                                                                                                                 \
+            *ret = 2;                                                                                                        \
+        h->ctrl[site] = tag;                                                                                                 \
+        __ac_set_isboth_false(h->flags, site);                                                                               \
+        kh_key(h, site) = key;                                                                                               \
+        if ((kh_opts) & KH_STORE_HASH)                                                                                       \
+            h->hashes[site] = k;                                                                                             \
+        ++h->size;                                                                                                           \
+        return site;                                                                                                         \
+    }                                                                                                                        \
+    static kh_inline klib_unused void __kh_swiss_del_##name(kh_##name##_t *h, khint_t x)                                     \
+    {                                                                                                                        \
+        /* A group that still has an EMPTY bucket has never been full, so no                                                 \
+           probe sequence has walked past it and the bucket can become EMPTY. */                                             \
+        khint_t g = x >> __ac_GROUP_LOG2;                                                                                    \
+        if (__ac_group_match_empty(__ac_group_load(h->ctrl + (g << __ac_GROUP_LOG2))))                                       \
+        {                                                                                                                    \
+            h->ctrl[x] = __ac_CTRL_EMPTY;                                                                                    \
+            --h->n_occupied;                                                                                                 \
+        }                                                                                                                    \
+        else                                                                                                                 \
+            h->ctrl[x] = __ac_CTRL_DELETED;                                                                                  \
+        __ac_set_isdel_true(h->flags, x);                                                                                    \
+        --h->size;                                                                                                           \
+    }                                                                                                                        \
+    /* Number of groups compared to find key, or to learn it is absent */                                                    \
+    static kh_inline klib_unused int __kh_swiss_probe_count_##name(const kh_##name##_t *h, khkey_t key, khint_t k)           \
+    {                                                                                                                        \
+        khint_t gmask = (h->n_buckets >> __ac_GROUP_LOG2) - 1;                                                               \
+        khint_t g = (k >> __ac_GROUP_LOG2) & gmask, step = 0;                                                                \
+        uint8_t tag = __ac_ctrl_tag(k);                                                                                      \
+        while (1)                                                                                                            \
+        {                                                                                                                    \
+            __ac_group_t grp = __ac_group_load(h->ctrl + (g << __ac_GROUP_LOG2));                                            \
+            for (uint64_t m = __ac_group_match(grp, tag); m; m &= m - 1)                                                     \
+                if (__kh_key_eq_##name(h, (g << __ac_GROUP_LOG2) + (__ac_ctz64(m) >> __ac_GROUP_BIT_SHIFT), key, k))         \
+                    return step + 1;                                                                                         \
+            if (__ac_group_match_empty(grp) || step == gmask)                                                                \
+                return step + 1;                                                                                             \
+            g = (g + (++step)) & gmask;                                                                                      \
+        }                                                                                                                    \
+    }
+
+/* The KH_ROBINHOOD engine; static regardless of SCOPE, like the one above. */
+#define __KHASH_IMPL_ROBINHOOD(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)                          \
+    static kh_inline klib_unused int __kh_rh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets);                \
+    /* Find key, whose hash is k; *n_probes is set to the number of buckets visited */                              \
+    static kh_inline klib_unused khint_t __kh_rh_get_##name(const kh_##name##_t *h, khkey_t key, khint_t k,         \
+                                                            khint_t *n_probes)                                      \
+    {                                                                                                               \
+        khint_t mask = h->n_buckets - 1, i = k & mask;                                                              \
+        unsigned d = 1;                                                                                             \
+        for (; h->ctrl[i] >= d; ++d, i = (i + 1) & mask)                                                            \
+            if (__kh_key_eq_##name(h, i, key, k))                                                                   \
+            {                                                                                                       \
+                *n_probes = d;                                                                                      \
+                return i;                                                                                           \
+            }                                                                                                       \
+        *n_probes = d;                                                                                              \
+        return h->n_buckets;                                                                                        \
+    }                                                                                                               \
+    /* Insert a key known to be absent, shifting the keys after it along the cluster */                             \
+    static kh_inline klib_unused khint_t __kh_rh_place_##name(kh_##name##_t *h, khkey_t key, khint_t k)             \
+    {                                                                                                               \
+        while (1)                                                                                                   \
+        {                                                                                                           \
+            khint_t mask = h->n_buckets - 1, x = k & mask, e;                                                       \
+            unsigned d = 1;                                                                                         \
+            for (; h->ctrl[x] >= d; ++d) /* pass keys at least as far from home */                                  \
+                x = (x + 1) & mask;                                                                                 \
+            int overflow = d > 255;                                                                                 \
+            for (e = x; h->ctrl[e]; e = (e + 1) & mask)                                                             \
+                overflow |= h->ctrl[e] == 255;                                                                      \
+            if (overflow)                                                                                           \
+            { /* a distance would not fit in its byte; only a poor hash gets here */                                \
+                if (__kh_rh_resize_##name(h, h->n_buckets << 1) < 0)                                                \
+                    return h->n_buckets;                                                                            \
+                continue;                                                                                           \
+            }                                                                                                       \
+            __ac_set_isboth_false(h->flags, e);                                                                     \
+            for (khint_t j; e != x; e = j)                                                                          \
+            {                                                                                                       \
+                j = (e - 1) & mask;                                                                                 \
+                h->ctrl[e] = h->ctrl[j] + 1;                                                                        \
+                kh_key(h, e) = kh_key(h, j);                                                                        \
+                if ((kh_opts) & KH_MAP)                                                                             \
+                    kh_val(h, e) = kh_val(h, j);                                                                    \
+                if ((kh_opts) & KH_STORE_HASH)                                                                      \
+                    h->hashes[e] = h->hashes[j];                                                                    \
+            }                                                                                                       \
+            h->ctrl[x] = (uint8_t)d;                                                                                \
+            kh_key(h, x) = key;                                                                                     \
+            if ((kh_opts) & KH_STORE_HASH)                                                                          \
+                h->hashes[x] = k;                                                                                   \
+            ++h->size;                                                                                              \
+            ++h->n_occupied;                                                                                        \
+            return x;                                                                                               \
+        }                                                                                                           \
+    }                                                                                                               \
+    static kh_inline klib_unused int __kh_rh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets)                 \
+    {                                                                                                               \
+        kh_##name##_t o = *h;                                                                                       \
+        if (__kh_alloc_buckets_##name(h, new_n_buckets) < 0)                                                        \
+        {                                                                                                           \
+            *h = o;                                                                                                 \
+            return -1;                                                                                              \
+        }                                                                                                           \
+        h->size = h->n_occupied = 0;                                                                                \
+        h->upper_bound = __ac_load_bound(new_n_buckets, h->max_load);                                               \
+        for (khint_t j = 0; j != o.n_buckets; ++j)                                                                  \
+        {                                                                                                           \
+            if (!o.ctrl[j])                                                                                         \
+                continue;                                                                                           \
+            khint_t i = __kh_rh_place_##name(h, kh_key(&o, j), __kh_hash_at_##name(&o, j));                         \
+            if ((kh_opts) & KH_MAP)                                                                                 \
+                kh_val(h, i) = kh_val(&o, j);                                                                       \
+        }                                                                                                           \
+        __kh_free_buckets_##name(&o);                                                                               \
+        return 0;                                                                                                   \
+    }                                                                                                               \
+    static kh_inline klib_unused khint_t __kh_rh_put_##name(kh_##name##_t *h, khkey_t key, khint_t k, int *ret)     \
+    {                                                                                                               \
+        khint_t n_probes, x = __kh_rh_get_##name(h, key, k, &n_probes);                                             \
+        if (x != h->n_buckets)                                                                                      \
+        {                                                                                                           \
+            *ret = 0;                                                                                               \
+            return x;                                                                                               \
+        }                                                                                                           \
+        x = __kh_rh_place_##name(h, key, k);                                                                        \
+        *ret = x == h->n_buckets ? -1 : 1;                                                                          \
+        return x;                                                                                                   \
+    }                                                                                                               \
+    /* Backward-shift deletion: pull each following key of the cluster one bucket closer to home */                 \
+    static kh_inline klib_unused void __kh_rh_del_##name(kh_##name##_t *h, khint_t x)                               \
+    {                                                                                                               \
+        khint_t mask = h->n_buckets - 1, j = (x + 1) & mask;                                                        \
+        for (; h->ctrl[j] > 1; x = j, j = (j + 1) & mask)                                                           \
+        {                                                                                                           \
+            h->ctrl[x] = h->ctrl[j] - 1;                                                                            \
+            kh_key(h, x) = kh_key(h, j);                                                                            \
+            if ((kh_opts) & KH_MAP)                                                                                 \
+                kh_val(h, x) = kh_val(h, j);                                                                        \
+            if ((kh_opts) & KH_STORE_HASH)                                                                          \
+                h->hashes[x] = h->hashes[j];                                                                        \
+        }                                                                                                           \
+        h->ctrl[x] = 0;                                                                                             \
+        __ac_set_isempty_true(h->flags, x);                                                                         \
+        --h->size;                                                                                                  \
+        --h->n_occupied;                                                                                            \
+    }                                                                                                               \
+    /* Number of buckets visited to find key, or to learn it is absent */                                           \
+    static kh_inline klib_unused int __kh_rh_probe_count_##name(const kh_##name##_t *h, khkey_t key, khint_t k)     \
+    {                                                                                                               \
+        khint_t mask = h->n_buckets - 1, i = k & mask;                                                              \
+        unsigned d = 1;                                                                                             \
+        for (; h->ctrl[i] >= d; ++d, i = (i + 1) & mask)                                                            \
+            if (__kh_key_eq_##name(h, i, key, k))                                                                   \
+                break;                                                                                              \
+        return (int)d;                                                                                              \
+    }
+
+/* The default resize hook: kh_resize() does all the work */
+#define __kh_resize_serial(h, new_n_buckets) 1
+
+#define __KHASH_IMPL(name, SCOPE, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal) \
+    __KHASH_IMPL_HOOKED(name, SCOPE, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal, __kh_resize_serial)
+
+/*
+  __resize_hook(h, new_n_buckets) is tried first by every kh_resize() that
+  changes the table: it returns 0 if it resized the table, -1 if it failed,
+  and 1 to let kh_resize() do the work itself. khash_parallel.h uses it to
+  resize large tables on several threads.
+ */
+#define __KHASH_IMPL_HOOKED(name, SCOPE, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal, __resize_hook)        \
+    __KHASH_IMPL_SWISS(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)                                   \
+    __KHASH_IMPL_ROBINHOOD(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)                               \
+    SCOPE int kh_migrate_##name(kh_##name##_t *h, khint_t n_steps);                                                  \
+    SCOPE kh_probe_stat_t kh_probe_stat_##name(const kh_##name##_t *h);                                              \
+    /* Allocate and initialize new hash table */                                                                     \
+    SCOPE kh_##name##_t *kh_init_with_alloc_##name(const kalloc_t *a)                                                \
+    {                                                                                                                \
+        kh_##name##_t *h = (kh_##name##_t *)kalloc_calloc(a, sizeof(kh_##name##_t));                                 \
+        if (h)                                                                                                       \
+        {                                                                                                            \
+            h->alloc = a;                                                                                            \
+            h->max_load = __ac_opts_load(kh_opts);                                                                   \
+            h->grow_shift = __ac_opts_grow_shift(kh_opts);                                                           \
+            if ((kh_opts) & KH_SEEDED)                                                                               \
+                h->seed = kh_seed_source(h);                                                                         \
+        }                                                                                                            \
+        return h;                                                                                                    \
+    }                                                                                                                \
+    SCOPE kh_##name##_t *kh_init_##name(void)                                                                        \
+    {                                                                                                                \
+        return kh_init_with_alloc_##name(NULL);                                                                      \
+    }                                                                                                                \
+    /* Destroy and release memory of hash table */                                                                   \
+    SCOPE void kh_destroy_##name(kh_##name##_t *h)                                                                   \
+    {                                                                                                                \
+        if (h)                                                                                                       \
+        {                                                                                                            \
+            __kh_free_buckets_##name(h);                                                                             \
+            kh_destroy_##name(h->old);                                                                               \
+            kh_arena_destroy(h->arena);                                                                              \
+            kalloc_free(h->alloc, h, sizeof(kh_##name##_t));                                                         \
+        }                                                                                                            \
+    }                                                                                                                \
+    /* clear all keys (by setting all flags to empty) */                                                             \
+    SCOPE void kh_clear_##name(kh_##name##_t *h)                                                                     \
+    {                                                                                                                \
+        if (h && h->old)                                                                                             \
+        { /* drop the buckets that were still being migrated */                                                      \
+            kh_destroy_##name(h->old);                                                                               \
+            h->old = NULL;                                                                                           \
+        }                                                                                                            \
+        if (h && h->arena)                                                                                           \
+        { /* no key points into the arena any more */                                                                \
+            kh_arena_destroy(h->arena);                                                                              \
+            h->arena = NULL;                                                                                         \
+        }                                                                                                            \
+        if (h && h->flags)                                                                                           \
+        {                                                                                                            \
+            /* set all flags to empty */                                                                             \
+            memset(h->flags, 0xaa, __ac_fsize(h->n_buckets) * sizeof(khint32_t));                                    \
+            if ((kh_opts) & KH_SWISS)                                                                                \
+                memset(h->ctrl, __ac_CTRL_EMPTY, h->n_buckets);                                                      \
+            else if (__kh_robinhood(kh_opts))                                                                        \
+                memset(h->ctrl, 0, h->n_buckets);                                                                    \
+            h->size = h->n_occupied = 0;                                                                             \
+        }                                                                                                            \
+    }                                                                                                                \
+    /* Look up a key whose hash k is already known, counting the buckets visited; the table must not be empty */     \
+    static kh_inline klib_unused khint_t __kh_find_##name(const kh_##name##_t *h, khkey_t key, khint_t k,            \
+                                                          khint_t *n_probes)                                         \
+    {                                                                                                                \
+        if ((kh_opts) & KH_SWISS)                                                                                    \
+            return __kh_swiss_get_##name(h, key, k, n_probes);                                                       \
+        if (__kh_robinhood(kh_opts))                                                                                 \
+            return __kh_rh_get_##name(h, key, k, n_probes);                                                          \
+        khint_t i, last, mask, step = 0;                                                                             \
+        mask = h->n_buckets - 1; /* n_buckets is always power of 2 */                                                \
+        i = k & mask;                                                                                                \
+        last = i;                                                                                                    \
+        while (!__ac_isempty(h->flags, i) && (__ac_isdel(h->flags, i) || !__kh_key_eq_##name(h, i, key, k)))         \
+        {                                                                                                            \
+            i = (i + (++step)) & mask;                                                                               \
+            if (i == last)                                                                                           \
+            {                                                                                                        \
+                *n_probes = step;                                                                                    \
+                return h->n_buckets;                                                                                 \
+            }                                                                                                        \
+        }                                                                                                            \
+        *n_probes = step + 1;                                                                                        \
+        return __ac_iseither(h->flags, i) ? h->n_buckets : i;                                                        \
+    }                                                                                                                \
+    /* Look up a key whose hash k is already known; the table must not be empty */                                   \
+    static kh_inline klib_unused khint_t __kh_get_hashed_##name(const kh_##name##_t *h, khkey_t key, khint_t k)      \
+    {                                                                                                                \
+        khint_t n_probes;                                                                                            \
+        return __kh_find_##name(h, key, k, &n_probes);                                                               \
+    }                                                                                                                \
+    /* Round a bucket count up to one the table can use */                                                           \
+    static kh_inline klib_unused khint_t __kh_fit_buckets_##name(khint_t n_buckets)                                  \
+    {                                                                                                                \
+        __ac_roundup(n_buckets);                                                                                     \
+        if (n_buckets < 4)                                                                                           \
+            n_buckets = 4;                                                                                           \
+        if ((kh_opts) & KH_SWISS && n_buckets < KH_GROUP_WIDTH)                                                      \
+            n_buckets = KH_GROUP_WIDTH;                                                                              \
+        return n_buckets;                                                                                            \
+    }                                                                                                                \
+    static kh_inline klib_unused int __kh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets)                     \
+    { /* Note: if new_n_buckets == old_n_buckets, this function will effectively do a rehash */                      \
+        khint32_t *new_flags = NULL;                                                                                 \
+        if (h->old)                                                                                                  \
+            kh_migrate_##name(h, 0);                                                                                 \
+        new_n_buckets = __kh_fit_buckets_##name(new_n_buckets);                                                      \
+        if (h->size >= __ac_load_bound(new_n_buckets, h->max_load))                                                  \
+            return 0; /* requested size is too small, do nothing */                                                  \
+        {                                                                                                            \
+            int hooked = __resize_hook(h, new_n_buckets);                                                            \
+            if (hooked <= 0)                                                                                         \
+                return hooked;                                                                                       \
+        }                                                                                                            \
+        if ((kh_opts) & KH_SWISS)                                                                                    \
+            return __kh_swiss_resize_##name(h, new_n_buckets);                                                       \
+        if (__kh_robinhood(kh_opts))                                                                                 \
+            return __kh_rh_resize_##name(h, new_n_buckets);                                                          \
+        /* hash table size to be changed (shrink or expand); rehash */                                               \
+        khint_t new_fsize = __ac_fsize(new_n_buckets);                                                               \
+        new_flags = (khint32_t *)kalloc_malloc(h->alloc, new_fsize * sizeof(khint32_t));                             \
+        if (!new_flags)                                                                                              \
+            return -1;                                                                                               \
+        memset(new_flags, 0xaa, new_fsize * sizeof(khint32_t));                                                      \
+        if (h->n_buckets < new_n_buckets)                                                                            \
+        { /* expand */                                                                                               \
+            khkey_t *new_keys = (khkey_t *)kalloc_realloc(h->alloc, h->keys, __kh_keys_bytes(h, h->n_buckets),       \
+                                                          __kh_keys_bytes(h, new_n_buckets));                        \
+            if (!new_keys)                                                                                           \
+            {                                                                                                        \
+                kalloc_free(h->alloc, new_flags, new_fsize * sizeof(khint32_t));                                     \
+                return -1;                                                                                           \
+            }                                                                                                        \
+            h->keys = new_keys; /* a failure below leaves the larger arrays in place, which is harmless */           \
+            __kh_pair_vals_##name(h);                                                                                \
+            if ((kh_opts) & KH_MAP && !__kh_paired(h))                                                               \
+            {                                                                                                        \
+                khval_t *new_vals = (khval_t *)kalloc_realloc(h->alloc, h->vals, h->n_buckets * sizeof(khval_t),     \
+                                                              new_n_buckets * sizeof(khval_t));                      \
+                if (!new_vals)                                                                                       \
+                {                                                                                                    \
+                    kalloc_free(h->alloc, new_flags, new_fsize * sizeof(khint32_t));                                 \
+                    return -1;                                                                                       \
+                }                                                                                                    \
+                h->vals = new_vals;                                                                                  \
+            }                                                                                                        \
+            if ((kh_opts) & KH_STORE_HASH)                                                                           \
+            {                                                                                                        \
+                khint_t *new_hashes = (khint_t *)kalloc_realloc(h->alloc, h->hashes, h->n_buckets * sizeof(khint_t), \
+                                                                new_n_buckets * sizeof(khint_t));                    \
+                if (!new_hashes)                                                                                     \
+                {                                                                                                    \
+                    kalloc_free(h->alloc, new_flags, new_fsize * sizeof(khint32_t));                                 \
+                    return -1;                                                                                       \
+                }                                                                                                    \
+                h->hashes = new_hashes;                                                                              \
+            }                                                                                                        \
+        }                                                                                                            \
+        /* rehashing */                                                                                              \
+        khint_t new_mask = new_n_buckets - 1;                                                                        \
+        for (khint_t j = 0; j != h->n_buckets; ++j)                                                                  \
+        {                                                                                                            \
+            if (__ac_iseither(h->flags, j) == 0)                                                                     \
+            {                                                                                                        \
+                khkey_t key = kh_key(h, j);                                                                          \
+                khval_t val;                                                                                         \
+                khint_t k = __kh_hash_at_##name(h, j);                                                               \
+                if ((kh_opts) & KH_MAP)                                                                              \
+                    val = kh_val(h, j);                                                                              \
+                __ac_set_isdel_true(h->flags, j);                                                                    \
+                while (1)                                                                                            \
+                { /* kick-out process; sort of like in Cuckoo hashing */                                             \
+                    khint_t i, step = 0;                                                                             \
+                    i = k & new_mask;                                                                                \
+                    while (!__ac_isempty(new_flags, i))                                                              \
+                    {                                                                                                \
+                        i = (i + (++step)) & new_mask;                                                               \
+                    }                                                                                                \
+                    __ac_set_isempty_false(new_flags, i);                                                            \
+                    if (i < h->n_buckets && __ac_iseither(h->flags, i) == 0)                                         \
+                    { /* kick out the existing element */                                                            \
+                        {                                                                                            \
+                            khint_t tmp = __kh_hash_at_##name(h, i);                                                 \
+                            if ((kh_opts) & KH_STORE_HASH)                                                           \
+                                h->hashes[i] = k;                                                                    \
+                            k = tmp;                                                                                 \
+                        }                                                                                            \
+                        {                                                                                            \
+                            khkey_t tmp = kh_key(h, i);                                                              \
+                            kh_key(h, i) = key;                                                                      \
+                            key = tmp;                                                                               \
+                        }                                                                                            \
+                        if ((kh_opts) & KH_MAP)                                                                      \
+                        {                                                                                            \
+                            khval_t tmp = kh_val(h, i);                                                              \
+                            kh_val(h, i) = val;                                                                      \
+                            val = tmp;                                                                               \
+                        }                                                                                            \
+                        __ac_set_isdel_true(h->flags, i); /* mark it as deleted in the old hash table */             \
+                    }                                                                                                \
+                    else                                                                                             \
+                    { /* write the element and jump out of the loop */                                               \
+                        kh_key(h, i) = key;                                                                          \
+                        if ((kh_opts) & KH_MAP)                                                                      \
+                            kh_val(h, i) = val;                                                                      \
+                        if ((kh_opts) & KH_STORE_HASH)                                                               \
+                            h->hashes[i] = k;                                                                        \
+                        break;                                                                                       \
+                    }                                                                                                \
+                }                                                                                                    \
+            }                                                                                                        \
+        }                                                                                                            \
+        if (h->n_buckets > new_n_buckets)                                                                            \
+        { /* shrink the hash table */                                                                                \
+            h->keys = (khkey_t *)kalloc_realloc(h->alloc, h->keys, __kh_keys_bytes(h, h->n_buckets),                 \
+                                                __kh_keys_bytes(h, new_n_buckets));                                  \
+            __kh_pair_vals_##name(h);                                                                                \
+            if ((kh_opts) & KH_MAP && !__kh_paired(h))                                                               \
+                h->vals = (khval_t *)kalloc_realloc(h->alloc, h->vals, h->n_buckets * sizeof(khval_t),               \
+                                                    new_n_buckets * sizeof(khval_t));                                \
+            if ((kh_opts) & KH_STORE_HASH)                                                                           \
+                h->hashes = (khint_t *)kalloc_realloc(h->alloc, h->hashes, h->n_buckets * sizeof(khint_t),           \
+                                                      new_n_buckets * sizeof(khint_t));                              \
+        }                                                                                                            \
+        kalloc_free(h->alloc, h->flags, __ac_fsize(h->n_buckets) * sizeof(khint32_t)); /* free the working space */  \
+        h->flags = new_flags;                                                                                        \
+        h->n_buckets = new_n_buckets;                                                                                \
+        h->n_occupied = h->size;                                                                                     \
+        h->upper_bound = __ac_load_bound(h->n_buckets, h->max_load);                                                 \
+        return 0;                                                                                                    \
+    }                                                                                                                \
+    SCOPE int kh_resize_##name(kh_##name##_t *h, khint_t new_n_buckets)                                              \
+    {                                                                                                                \
+        const khint32_t *flags = h->flags; /* every resize that moves the keys allocates new flags */                \
+        uint64_t t0 = __kh_stats_clock();                                                                            \
+        int ret = __kh_resize_##name(h, new_n_buckets);                                                              \
+        if (h->flags != flags)                                                                                       \
+            __kh_stat_resize(h, t0);                                                                                 \
+        return ret;                                                                                                  \
+    }                                                                                                                \
+    /* Insert without checking the capacity; the table must have a free bucket */                                    \
+    static kh_inline klib_unused khint_t __kh_insert_##name(kh_##name##_t *h, khkey_t key, khint_t k, int *ret)      \
+    {                                                                                                                \
+        if ((kh_opts) & KH_SWISS)                                                                                    \
+            return __kh_swiss_put_##name(h, key, k, ret);                                                            \
+        if (__kh_robinhood(kh_opts))                                                                                 \
+            return __kh_rh_put_##name(h, key, k, ret);                                                               \
+        /* Finding Insert Position */                                                                                \
+        khint_t i, last, mask = h->n_buckets - 1, step = 0;                                                          \
+        khint_t x, site; /* x is the final position to put, site is the first position of deleted element */         \
+        x = site = h->n_buckets;                                                                                     \
+        i = k & mask;                                                                                                \
+        if (__ac_isempty(h->flags, i)) /* Found empty slot immediately */                                            \
+            x = i;                     /* for speed up */                                                            \
+        else                                                                                                         \
+        { /* Need to probe further */                                                                                \
+            last = i;                                                                                                \
+            while (!__ac_isempty(h->flags, i) && (__ac_isdel(h->flags, i) || !__kh_key_eq_##name(h, i, key, k)))     \
+            {                                                                                                        \
+                if (__ac_isdel(h->flags, i) && site == h->n_buckets)                                                 \
+                    site = i;                                                                                        \
+                i = (i + (++step)) & mask;                                                                           \
+                if (i == last)                                                                                       \
+                {                                                                                                    \
+                    x = site;                                                                                        \
+                    break;                                                                                           \
+                }                                                                                                    \
+            }                                                                                                        \
+            /* Choose where to put the key */                                                                        \
+            if (x == h->n_buckets)                                                                                   \
+            {                                                                                                        \
+                if (__ac_isempty(h->flags, i) && site != h->n_buckets)                                               \
+                    x = site;                                                                                        \
+                else                                                                                                 \
+                    x = i;                                                                                           \
+            }                                                                                                        \
+        }                                                                                                            \
+        if (__ac_iseither(h->flags, x) && (kh_opts) & KH_STORE_HASH)                                                 \
+            h->hashes[x] = k;                                                                                        \
+        if (__ac_isempty(h->flags, x))                                                                               \
+        { /* not present at all */                                                                                   \
+            kh_key(h, x) = key;                                                                                      \
+            __ac_set_isboth_false(h->flags, x);                                                                      \
+            ++h->size;                                                                                               \
+            ++h->n_occupied;                                                                                         \
+            *ret = 1;                                                                                                \
+        }                                                                                                            \
+        else if (__ac_isdel(h->flags, x))                                                                            \
+        { /* deleted */                                                                                              \
+            kh_key(h, x) = key;                                                                                      \
+            __ac_set_isboth_false(h->flags, x);                                                                      \
+            ++h->size;                                                                                               \
+            *ret = 2;                                                                                                \
+        }                                                                                                            \
+        else                                                                                                         \
+            *ret = 0; /* Don't touch h->keys[x] if present and not deleted */                                        \
+        return x;                                                                                                    \
+    }                                                                                                                \
+    /* Remove the element at x, which must exist */                                                                  \
+    static kh_inline klib_unused void __kh_erase_##name(kh_##name##_t *h, khint_t x)                                 \
+    {                                                                                                                \
+        if ((kh_opts) & KH_SWISS)                                                                                    \
+        {                                                                                                            \
+            __kh_swiss_del_##name(h, x);                                                                             \
+            return;                                                                                                  \
+        }                                                                                                            \
+        if (__kh_robinhood(kh_opts))                                                                                 \
+        {                                                                                                            \
+            __kh_rh_del_##name(h, x);                                                                                \
+            return;                                                                                                  \
+        }                                                                                                            \
+        __ac_set_isdel_true(h->flags, x);                                                                            \
+        --h->size;                                                                                                   \
+    }                                                                                                                \
+    /* Move the element at x of the old buckets into the current ones */                                             \
+    static kh_inline klib_unused khint_t __kh_move_old_##name(kh_##name##_t *h, khint_t x, khint_t k)                \
+    {                                                                                                                \
+        int ret;                                                                                                     \
+        khint_t i = __kh_insert_##name(h, kh_key(h->old, x), k, &ret);                                               \
+        if ((kh_opts) & KH_MAP)                                                                                      \
+            kh_val(h, i) = kh_val(h->old, x);                                                                        \
+        __kh_erase_##name(h->old, x);                                                                                \
+        return i;                                                                                                    \
+    }                                                                                                                \
+    SCOPE int kh_migrate_##name(kh_##name##_t *h, khint_t n_steps)                                                   \
+    {                                                                                                                \
+        kh_##name##_t *o = h->old;                                                                                   \
+        if (!o)                                                                                                      \
+            return 0;                                                                                                \
+        khint_t end = n_steps && o->n_buckets - h->rehash_pos > n_steps ? h->rehash_pos + n_steps : o->n_buckets;    \
+        for (khint_t j = h->rehash_pos; j < end; ++j)                                                                \
+            while (!__ac_iseither(o->flags, j)) /* KH_ROBINHOOD pulls the next key into j */                         \
+                __kh_move_old_##name(h, j, __kh_hash_at_##name(o, j));                                               \
+        h->rehash_pos = end;                                                                                         \
+        if (end == o->n_buckets)                                                                                     \
+        {                                                                                                            \
+            kh_destroy_##name(o);                                                                                    \
+            h->old = NULL;                                                                                           \
+        }                                                                                                            \
+        return h->old != NULL;                                                                                       \
+    }                                                                                                                \
+    /* Set the current buckets aside and start migrating them into new_n_buckets fresh ones */                       \
+    static kh_inline klib_unused int __kh_start_rehash_##name(kh_##name##_t *h, khint_t new_n_buckets)               \
+    {                                                                                                                \
+        kh_##name##_t *o = (kh_##name##_t *)kalloc_malloc(h->alloc, sizeof(kh_##name##_t));                          \
+        if (!o)                                                                                                      \
+            return -1;                                                                                               \
+        *o = *h;                                                                                                     \
+        o->arena = NULL; /* the arena stays with h */                                                                \
+        h->n_buckets = h->size = h->n_occupied = h->upper_bound = 0;                                                 \
+        h->flags = NULL;                                                                                             \
+        h->keys = NULL;                                                                                              \
+        h->vals = NULL;                                                                                              \
+        h->ctrl = NULL;                                                                                              \
+        h->hashes = NULL;                                                                                            \
+        if (kh_resize_##name(h, new_n_buckets) < 0)                                                                  \
+        {                                                                                                            \
+            o->arena = h->arena;                                                                                     \
+            *h = *o;                                                                                                 \
+            kalloc_free(h->alloc, o, sizeof(kh_##name##_t));                                                         \
+            return -1;                                                                                               \
+        }                                                                                                            \
+        h->old = o;                                                                                                  \
+        h->rehash_pos = 0;                                                                                           \
+        return 0;                                                                                                    \
+    }                                                                                                                \
+    static kh_inline klib_unused khint_t __kh_put_hashed_##name(kh_##name##_t *h, khkey_t key, khint_t k, int *ret)  \
+    {                                                                                                                \
+        if (h->old) /* finish the migration early if the new buckets are already full */                             \
+            kh_migrate_##name(h, h->n_occupied >= h->upper_bound ? 0 : h->rehash_step);                              \
+        if (h->n_occupied >= h->upper_bound)                                                                         \
+        { /* Need to expand or clean up the hash table */                                                            \
+            khint_t new_n_buckets;                                                                                   \
+            if (h->n_occupied - h->size >= h->n_occupied / 3)                                                        \
+                new_n_buckets = h->n_buckets - 1; /* Too many deleted elements, try to clean up */                   \
+            else if (h->n_buckets >> (sizeof(khint_t) * 8 - 1 - h->grow_shift))                                      \
+                new_n_buckets = h->n_buckets + 1; /* Need more space; only double near the largest size */           \
+            else                                                                                                     \
+                new_n_buckets = (h->n_buckets << (h->grow_shift - 1)) + 1; /* Need more space, expand the table */   \
+            if ((h->rehash_step && h->size ? __kh_start_rehash_##name(h, new_n_buckets)                              \
+                                           : kh_resize_##name(h, new_n_buckets)) < 0)                                \
+            {                                                                                                        \
+                *ret = -1;                                                                                           \
+                return h->n_buckets;                                                                                 \
+            }                                                                                                        \
+        }                                                                                                            \
+        if (h->old)                                                                                                  \
+        { /* the key may be in the old buckets, including ones the growth above has just set aside */                \
+            khint_t x = __kh_get_hashed_##name(h->old, key, k);                                                      \
+            if (x != h->old->n_buckets)                                                                              \
+            {                                                                                                        \
+                *ret = 0;                                                                                            \
+                return __kh_move_old_##name(h, x, k);                                                                \
+            }                                                                                                        \
+        }                                                                                                            \
+        return __kh_insert_##name(h, key, k, ret);                                                                   \
+    }                                                                                                                \
+    SCOPE khint_t kh_get_##name(const kh_##name##_t *h, khkey_t key)                                                 \
+    {                                                                                                                \
+        if (h->n_buckets == 0)                                                                                       \
+        {                                                                                                            \
+            __kh_stat_lookup(h, 0, 0);                                                                               \
+            return 0;                                                                                                \
+        }                                                                                                            \
+        khint_t k = __kh_hash_##name(h, key), n_probes, x;                                                           \
+        if (h->old)                                                                                                  \
+        { /* migrate a step, and move the key out of the old buckets if it is there */                               \
+            kh_##name##_t *mh = (kh_##name##_t *)h;                                                                  \
+            kh_migrate_##name(mh, h->rehash_step);                                                                   \
+            x = __kh_find_##name(h, key, k, &n_probes);                                                              \
+            if (x == h->n_buckets && h->old)                                                                         \
+            {                                                                                                        \
+                khint_t n_old;                                                                                       \
+                x = __kh_find_##name(h->old, key, k, &n_old);                                                        \
+                x = x == h->old->n_buckets ? h->n_buckets : __kh_move_old_##name(mh, x, k);                          \
+                n_probes += n_old;                                                                                   \
+            }                                                                                                        \
+        }                                                                                                            \
+        else                                                                                                         \
+            x = __kh_find_##name(h, key, k, &n_probes);                                                              \
+        __kh_stat_lookup(h, n_probes, x != h->n_buckets);                                                            \
+        return x;                                                                                                    \
+    }                                                                                                                \
+    /* Recompute the stored hashes after the seed changed */                                                         \
+    static kh_inline klib_unused void __kh_rehash_stored_##name(kh_##name##_t *h)                                    \
+    {                                                                                                                \
+        if ((kh_opts) & KH_STORE_HASH)                                                                               \
+            for (khint_t i = 0; i != h->n_buckets; ++i)                                                              \
+                if (!__ac_iseither(h->flags, i))                                                                     \
+                    h->hashes[i] = __kh_hash_##name(h, kh_key(h, i));                                                \
+    }                                                                                                                \
+    SCOPE int kh_reseed_##name(kh_##name##_t *h, uint64_t seed)                                                      \
+    {                                                                                                                \
+        uint64_t old_seed = h->seed;                                                                                 \
+        if (h->old)                                                                                                  \
+            kh_migrate_##name(h, 0);                                                                                 \
+        h->seed = seed;                                                                                              \
+        if (h->size == 0)                                                                                            \
+            return 0;                                                                                                \
+        __kh_rehash_stored_##name(h);                                                                                \
+        khint_t n = h->n_buckets; /* a full table has to grow: kh_resize() keeps it as it is */                      \
+        if (kh_resize_##name(h, h->size < __ac_load_bound(n, h->max_load) ? n : n << 1) < 0)                         \
+        {                                                                                                            \
+            h->seed = old_seed;                                                                                      \
+            __kh_rehash_stored_##name(h);                                                                            \
+            return -1;                                                                                               \
+        }                                                                                                            \
+        return 0;                                                                                                    \
+    }                                                                                                                \
+    /* Find the key kh_put() just added, whose hash is k; reseed if that takes more than h->reseed_probes probes */  \
+    static kh_inline klib_unused khint_t __kh_check_probes_##name(kh_##name##_t *h, khkey_t key, khint_t k)          \
+    {                                                                                                                \
+        khint_t n_probes, x = __kh_find_##name(h, key, k, &n_probes);                                                \
+        if (n_probes <= h->reseed_probes || kh_reseed_##name(h, kh_seed_source(h)) < 0)                              \
+            return x;                                                                                                \
+        ++h->n_reseed;                                                                                               \
+        if (kh_probe_stat_##name(h).max_probes > (int)h->reseed_probes)                                              \
+            h->reseed_probes = 0; /* a new seed did not help: the hash ignores it, or the limit is too low */        \
+        return __kh_get_hashed_##name(h, key, __kh_hash_##name(h, key));                                             \
+    }                                                                                                                \
+    SCOPE khint_t kh_put_##name(kh_##name##_t *h, khkey_t key, int *ret)                                             \
+    {                                                                                                                \
+        khint_t k = __kh_hash_##name(h, key);                                                                        \
+        khint_t x = __kh_put_hashed_##name(h, key, k, ret);                                                          \
+        if ((kh_opts) & KH_SEEDED && h->reseed_probes && *ret > 0)                                                   \
+            x = __kh_check_probes_##name(h, key, k);                                                                 \
+        __kh_stat_put(h, *ret);                                                                                      \
+        return x;                                                                                                    \
+    }                                                                                                                \
+    /* Bucket count kh_compact() shrinks to: the keys fill at most half of the load limit */                         \
+    static kh_inline klib_unused khint_t __kh_compact_target_##name(const kh_##name##_t *h)                          \
+    {                                                                                                                \
+        return __kh_fit_buckets_##name((khint_t)(h->size / (h->max_load / 2)) + 1);                                  \
+    }                                                                                                                \
+    SCOPE int kh_compact_##name(kh_##name##_t *h)                                                                    \
+    {                                                                                                                \
+        if (h->old)                                                                                                  \
+            kh_migrate_##name(h, 0);                                                                                 \
+        khint_t n = __kh_compact_target_##name(h);                                                                   \
+        if (n < h->n_buckets)                                                                                        \
+        {                                                                                                            \
+            if (kh_resize_##name(h, n) < 0)                                                                          \
+                return -1;                                                                                           \
+            ++h->compact.n_shrink;                                                                                   \
+            return 1;                                                                                                \
+        }                                                                                                            \
+        if (h->n_occupied == h->size)                                                                                \
+            return 0; /* no deleted buckets */                                                                       \
+        if (kh_resize_##name(h, h->n_buckets) < 0)                                                                   \
+            return -1;                                                                                               \
+        ++h->compact.n_rehash;                                                                                       \
+        return 1;                                                                                                    \
+    }                                                                                                                \
+    SCOPE int kh_set_load_##name(kh_##name##_t *h, double max_load, int growth)                                      \
+    {                                                                                                                \
+        h->max_load = max_load > 0.0 && max_load < 1.0 ? max_load : __ac_opts_load(kh_opts);                         \
+        h->grow_shift = growth ? __ac_grow_shift(growth) : __ac_opts_grow_shift(kh_opts);                            \
+        if (h->n_buckets == 0)                                                                                       \
+            return 0;                                                                                                \
+        if (h->old)                                                                                                  \
+            kh_migrate_##name(h, 0);                                                                                 \
+        h->upper_bound = __ac_load_bound(h->n_buckets, h->max_load);                                                 \
+        if (h->n_occupied < h->upper_bound)                                                                          \
+            return 0;                                                                                                \
+        return kh_resize_##name(h, (khint_t)(h->size / h->max_load) + 1); /* too full for the new limit */           \
+    }                                                                                                                \
+    /* Does the compaction policy ask for a kh_compact() after a deletion? */                                        \
+    static kh_inline klib_unused int __kh_should_compact_##name(const kh_##name##_t *h)                              \
+    {                                                                                                                \
+        const kh_compact_t *c = &h->compact;                                                                         \
+        if (c->max_tombstones > 0 && h->n_occupied - h->size > c->max_tombstones * h->n_buckets)                     \
+            return 1;                                                                                                \
+        return c->min_load > 0 && h->size < c->min_load * h->n_buckets &&                                            \
+               __kh_compact_target_##name(h) < h->n_buckets;                                                         \
+    }                                                                                                                \
+    SCOPE void kh_del_##name(kh_##name##_t *h, khint_t x)                                                            \
+    {                                                                                                                \
+        if (x != h->n_buckets && !__ac_iseither(h->flags, x))                                                        \
+        {                                                                                                            \
+            __kh_erase_##name(h, x);                                                                                 \
+            __kh_stat_del(h);                                                                                        \
+        }                                                                                                            \
+        if (h->old)                                                                                                  \
+            kh_migrate_##name(h, h->rehash_step);                                                                    \
+        else if (__kh_should_compact_##name(h))                                                                      \
+            kh_compact_##name(h);                                                                                    \
+    }                                                                                                                \
+    /* Number of buckets visited to find key, or to learn it is absent */                                            \
+    static kh_inline klib_unused int __kh_probe_count_##name(const kh_##name##_t *h, khkey_t key, khint_t k)         \
+    {                                                                                                                \
+        if ((kh_opts) & KH_SWISS)                                                                                    \
+            return __kh_swiss_probe_count_##name(h, key, k);                                                         \
+        if (__kh_robinhood(kh_opts))                                                                                 \
+            return __kh_rh_probe_count_##name(h, key, k);                                                            \
+        khint_t mask = h->n_buckets - 1;                                                                             \
+        khint_t pos = k & mask;                                                                                      \
+        int probes = 1;                                                                                              \
+        while (!__ac_isempty(h->flags, pos) &&                                                                       \
+               (__ac_isdel(h->flags, pos) || !__kh_key_eq_##name(h, pos, key, k)))                                   \
+        {                                                                                                            \
+            pos = (pos + probes) & mask;                                                                             \
+            probes++;                                                                                                \
+            if (probes > (int)h->n_buckets)                                                                          \
+                break;                                                                                               \
+        }                                                                                                            \
+        return probes;                                                                                               \
+    }                                                                                                                \
+    SCOPE kh_probe_stat_t kh_probe_stat_##name(const kh_##name##_t *h)                                               \
+    {                                                                                                                \
+        kh_probe_stat_t stats = {0, 0.0, 0.0};                                                                       \
+        khint_t n_filled = 0;                                                                                        \
+        double sum_probes = 0.0;                                                                                     \
+        double sum_squares = 0.0;                                                                                    \
+                                                                                                                     \
+        /* During a migration, keys in the old buckets cost a miss in the new ones first */                          \
+        for (const kh_##name##_t *t = h; t; t = t == h ? h->old : NULL)                                              \
+        {                                                                                                            \
+            for (khint_t i = 0; i < t->n_buckets; ++i)                                                               \
+            {                                                                                                        \
+                if (__ac_iseither(t->flags, i))                                                                      \
+                    continue;                                                                                        \
+                                                                                                                     \
+                /* For each existing key, count probes needed to find it */                                          \
+                khkey_t key = kh_key(t, i);                                                                          \
+                khint_t k = __kh_hash_at_##name(t, i);                                                               \
+                int probes = __kh_probe_count_##name(t, key, k);                                                     \
+                if (t != h)                                                                                          \
+                    probes += __kh_probe_count_##name(h, key, k);                                                    \
+                                                                                                                     \
+                sum_probes += probes;                                                                                \
+                sum_squares += (double)probes * probes;                                                              \
+                if (probes > stats.max_probes)                                                                       \
+                    stats.max_probes = probes;                                                                       \
+                n_filled++;                                                                                          \
+            }                                                                                                        \
+        }                                                                                                            \
+                                                                                                                     \
+        if (n_filled > 0)                                                                                            \
+        {                                                                                                            \
+            stats.avg_probes = sum_probes / n_filled;                                                                \
+            double mean = stats.avg_probes;                                                                          \
+            stats.variance = (sum_squares / n_filled) - (mean * mean);                                               \
+        }                                                                                                            \
+                                                                                                                     \
+        return stats;                                                                                                \
+    }                                                                                                                \
+    SCOPE kmem_usage_t kh_memory_usage_##name(const kh_##name##_t *h)                                                \
+    {                                                                                                                \
+        kmem_usage_t u = {0, 0, 0, 0};                                                                               \
+        size_t bucket = __kh_keys_bytes(h, 1) + ((kh_opts) & KH_MAP ? __kh_vals_bytes(h, 1) : 0);                    \
+        /* The buckets a migration empties count as tombstones until the old table goes */                           \
+        for (const kh_##name##_t *t = h; t; t = t == h ? h->old : NULL)                                              \
+        {                                                                                                            \
+            u.live += (size_t)t->size * bucket;                                                                      \
+            u.tombstones += (size_t)(t->n_occupied - t->size) * bucket;                                              \
+            u.slack += (size_t)(t->n_buckets - t->n_occupied) * bucket;                                              \
+            u.overhead += sizeof(kh_##name##_t);                                                                     \
+            if (t->n_buckets)                                                                                        \
+                u.overhead += __ac_fsize(t->n_buckets) * sizeof(khint32_t) + (t->ctrl ? t->n_buckets : 0) +          \
+                              ((kh_opts) & KH_STORE_HASH ? t->n_buckets * sizeof(khint_t) : 0);                      \
+        }                                                                                                            \
+        if (h->arena) /* interned strings are live, the rest of their blocks slack */                                \
+        {                                                                                                            \
+            const kh_arena_t *a = h->arena;                                                                          \
+            u.live += a->bytes;                                                                                      \
+            u.overhead += sizeof(kh_arena_t) + a->m_strs * sizeof(const char *);                                     \
+            for (const kh_arena_block_t *b = a->head; b; b = b->next)                                                \
+                u.slack += b->cap, u.overhead += sizeof(kh_arena_block_t);                                           \
+            u.slack -= a->bytes;                                                                                     \
+        }                                                                                                            \
+        return u;                                                                                                    \
+    }                                                                                                                \
+    /* Start loading the home bucket of hash k into cache */                                                         \
+    static kh_inline klib_unused void __kh_prefetch_##name(const kh_##name##_t *h, khint_t k)                        \
+    {                                                                                                                \
+        khint_t i = k & (h->n_buckets - 1);                                                                          \
+        if ((kh_opts) & KH_SWISS)                                                                                    \
+        {                                                                                                            \
+            i &= ~(khint_t)(KH_GROUP_WIDTH - 1);                                                                     \
+            kh_prefetch(h->ctrl + i);                                                                                \
+        }                                                                                                            \
+        else if (__kh_robinhood(kh_opts))                                                                            \
+            kh_prefetch(h->ctrl + i);                                                                                \
+        else                                                                                                         \
+            kh_prefetch(h->flags + (i >> 4));                                                                        \
+        kh_prefetch(&kh_key(h, i));                                                                                  \
+    }                                                                                                                \
+    SCOPE void kh_get_batch_##name(const kh_##name##_t *h, const khkey_t *keys, size_t n, khint_t *out)              \
+    {                                                                                                                \
+        khint_t hs[KH_BATCH_WINDOW];                                                                                 \
+        size_t i, w = n < KH_BATCH_WINDOW ? n : KH_BATCH_WINDOW;                                                     \
+        if (h->n_buckets == 0 || h->old)                                                                             \
+        { /* nothing to prefetch for, or keys may have to be moved one at a time */                                  \
+            for (i = 0; i < n; ++i)                                                                                  \
+                out[i] = kh_get_##name(h, keys[i]);                                                                  \
+            return;                                                                                                  \
+        }                                                                                                            \
+        for (i = 0; i < w; ++i)                                                                                      \
+        { /* fill the window: hash and prefetch ahead of the lookups */                                              \
+            hs[i] = __kh_hash_##name(h, keys[i]);                                                                    \
+            __kh_prefetch_##name(h, hs[i]);                                                                          \
+        }                                                                                                            \
+        for (i = 0; i < n; ++i)                                                                                      \
+        {                                                                                                            \
+            khint_t k = hs[i % KH_BATCH_WINDOW];                                                                     \
+            if (i + KH_BATCH_WINDOW < n)                                                                             \
+            {                                                                                                        \
+                khint_t k2 = __kh_hash_##name(h, keys[i + KH_BATCH_WINDOW]);                                         \
+                hs[i % KH_BATCH_WINDOW] = k2;                                                                        \
+                __kh_prefetch_##name(h, k2);                                                                         \
+            }                                                                                                        \
+            khint_t n_probes;                                                                                        \
+            out[i] = __kh_find_##name(h, keys[i], k, &n_probes);                                                     \
+            __kh_stat_lookup(h, n_probes, out[i] != h->n_buckets);                                                   \
+        }                                                                                                            \
+    }                                                                                                                \
+    SCOPE int kh_put_batch_##name(kh_##name##_t *h, const khkey_t *keys, size_t n, khint_t *out, int *rets)          \
+    {                                                                                                                \
+        khint_t hs[KH_BATCH_WINDOW];                                                                                 \
+        size_t i, w = n < KH_BATCH_WINDOW ? n : KH_BATCH_WINDOW;                                                     \
+        int ret;                                                                                                     \
+        if ((size_t)h->n_occupied + n > (size_t)h->upper_bound)                                                      \
+        { /* make room for n new keys up front so no iterator in out[] is invalidated */                             \
+            size_t want = (size_t)kh_size(h) + n;                                                                    \
+            if ((size_t)(khint_t)want != want || kh_resize_##name(h, (khint_t)(want / h->max_load) + 1) < 0)         \
+                return -1;                                                                                           \
+        }                                                                                                            \
+        for (i = 0; i < w; ++i)                                                                                      \
+        {                                                                                                            \
+            hs[i] = __kh_hash_##name(h, keys[i]);                                                                    \
+            __kh_prefetch_##name(h, hs[i]);                                                                          \
+        }                                                                                                            \
+        for (i = 0; i < n; ++i)                                                                                      \
+        {                                                                                                            \
+            khint_t k = hs[i % KH_BATCH_WINDOW];                                                                     \
+            if (i + KH_BATCH_WINDOW < n)                                                                             \
+            {                                                                                                        \
+                khint_t k2 = __kh_hash_##name(h, keys[i + KH_BATCH_WINDOW]);                                         \
+                hs[i % KH_BATCH_WINDOW] = k2;                                                                        \
+                __kh_prefetch_##name(h, k2);                                                                         \
+            }                                                                                                        \
+            out[i] = __kh_put_hashed_##name(h, keys[i], k, &ret);                                                    \
+            if (ret < 0)                                                                                             \
+                return -1;                                                                                           \
+            __kh_stat_put(h, ret);                                                                                   \
+            if (rets)                                                                                                \
+                rets[i] = ret;                                                                                       \
+        }                                                                                                            \
+        if (__kh_robinhood(kh_opts)) /* later keys may have shifted earlier ones */                                  \
+            for (i = 0; i < n; ++i)                                                                                  \
+                out[i] = __kh_get_hashed_##name(h, keys[i], __kh_hash_##name(h, keys[i]));                           \
+        return 0;                                                                                                    \
+    }                                                                                                                \
+    /* Hash under h of key, whose hash under t, a table of the same kind, is k */                                    \
+    static kh_inline klib_unused khint_t __kh_hash_in_##name(const kh_##name##_t *h, const kh_##name##_t *t,         \
+                                                             khkey_t key, khint_t k)                                 \
+    {                                                                                                                \
+        return (kh_opts) & KH_SEEDED && h->seed != t->seed ? __kh_hash_##name(h, key) : k;                           \
+    }                                                                                                                \
+    /* Find key, whose hash under h is k, in h or its old buckets, migrating nothing; returns its table or NULL */   \
+    static kh_inline klib_unused const kh_##name##_t *__kh_locate_##name(const kh_##name##_t *h, khkey_t key,        \
+                                                                         khint_t k, khint_t *x)                      \
+    {                                                                                                                \
+        khint_t n_probes;                                                                                            \
+        for (const kh_##name##_t *t = h; t; t = t == h ? h->old : NULL)                                              \
+            if (t->n_buckets && (*x = __kh_find_##name(t, key, k, &n_probes)) != t->n_buckets)                       \
+                return t;                                                                                            \
+        return NULL;                                                                                                 \
+    }                                                                                                                \
+    /* Move h into fresh buckets for n keys, keeping the keys found in s (keep_found) or the others. Walks s when    \
+       walk_s, looking its keys up among the old buckets of h, else walks those, looking their keys up in s */       \
+    static kh_inline klib_unused int __kh_rebuild_##name(kh_##name##_t *h, const kh_##name##_t *s, int walk_s,       \
+                                                         int keep_found, khint_t n)                                  \
+    {                                                                                                                \
+        if (__kh_start_rehash_##name(h, (khint_t)(n / h->max_load) + 1) < 0)                                         \
+            return -1;                                                                                               \
+        kh_##name##_t *o = h->old;                                                                                   \
+        const kh_##name##_t *w = walk_s ? s : o, *t, *src;                                                           \
+        khint_t end = __kh_iter_end(w), i, p, k, y, n_probes;                                                        \
+        int ret;                                                                                                     \
+        h->old = NULL; /* its keys are picked, not migrated */                                                       \
+        for (i = __kh_iter_next(w, 0, end); i < end; i = __kh_iter_next(w, i + 1, end))                              \
+        {                                                                                                            \
+            t = __kh_iter_tab(w, i);                                                                                 \
+            p = __kh_iter_pos(w, i);                                                                                 \
+            k = __kh_hash_at_##name(t, p);                                                                           \
+            if (walk_s)                                                                                              \
+            { /* keep the key and value of h, not of s */                                                            \
+                k = __kh_hash_in_##name(o, t, kh_key(t, p), k);                                                      \
+                if (!o->n_buckets || (y = __kh_find_##name(o, kh_key(t, p), k, &n_probes)) == o->n_buckets)          \
+                    continue;                                                                                        \
+                src = o;                                                                                             \
+            }                                                                                                        \
+            else                                                                                                     \
+            {                                                                                                        \
+                khint_t ks = __kh_hash_in_##name(s, o, kh_key(o, p), k);                                             \
+                if ((__kh_locate_##name(s, kh_key(o, p), ks, &y) != NULL) != keep_found)                             \
+                    continue;                                                                                        \
+                src = o, y = p;                                                                                      \
+            }                                                                                                        \
+            khint_t x = __kh_insert_##name(h, kh_key(src, y), k, &ret);                                              \
+            if ((kh_opts) & KH_MAP)                                                                                  \
+                kh_val(h, x) = kh_val(src, y);                                                                       \
+        }                                                                                                            \
+        kh_destroy_##name(o);                                                                                        \
+        return 0;                                                                                                    \
+    }                                                                                                                \
+    /* Add the keys of s to d. Keys in both keep the value of d, get the one of s (overwrite), or are combined */    \
+    static kh_inline klib_unused int __kh_merge_##name(kh_##name##_t *d, const kh_##name##_t *s,                     \
+                                                       void (*combine)(khval_t *, const khval_t *, void *),          \
+                                                       void *ud, int overwrite)                                      \
+    {                                                                                                                \
+        khint_t end = __kh_iter_end(s), i, p, x;                                                                     \
+        int ret;                                                                                                     \
+        if (d->old)                                                                                                  \
+            kh_migrate_##name(d, 0);                                                                                 \
+        if (d == s)                                                                                                  \
+        {                                                                                                            \
+            if ((kh_opts) & KH_MAP && combine)                                                                       \
+                for (i = __ac_next_full(d->flags, 0, d->n_buckets); i < d->n_buckets;                                \
+                     i = __ac_next_full(d->flags, i + 1, d->n_buckets))                                              \
+                {                                                                                                    \
+                    khval_t v = kh_val(d, i);                                                                        \
+                    combine(&kh_val(d, i), &v, ud);                                                                  \
+                }                                                                                                    \
+            return 0;                                                                                                \
+        }                                                                                                            \
+        if ((size_t)d->n_occupied + kh_size(s) > (size_t)d->upper_bound)                                             \
+        { /* make room for every key of s up front, growing at most once */                                          \
+            size_t want = (size_t)d->size + kh_size(s);                                                              \
+            if ((size_t)(khint_t)want != want || kh_resize_##name(d, (khint_t)(want / d->max_load) + 1) < 0)         \
+                return -1;                                                                                           \
+        }                                                                                                            \
+        for (i = __kh_iter_next(s, 0, end); i < end; i = __kh_iter_next(s, i + 1, end))                              \
+        {                                                                                                            \
+            const kh_##name##_t *t = __kh_iter_tab(s, i);                                                            \
+            p = __kh_iter_pos(s, i);                                                                                 \
+            khint_t k = __kh_hash_in_##name(d, t, kh_key(t, p), __kh_hash_at_##name(t, p));                          \
+            x = __kh_insert_##name(d, kh_key(t, p), k, &ret);                                                        \
+            __kh_stat_put(d, ret);                                                                                   \
+            if (!((kh_opts) & KH_MAP))                                                                               \
+                continue;                                                                                            \
+            if (ret)                                                                                                 \
+                kh_val(d, x) = kh_val(t, p);                                                                         \
+            else if (combine)                                                                                        \
+                combine(&kh_val(d, x), &kh_val(t, p), ud);                                                           \
+            else if (overwrite)                                                                                      \
+                kh_val(d, x) = kh_val(t, p);                                                                         \
+        }                                                                                                            \
+        return 0;                                                                                                    \
+    }                                                                                                                \
+    SCOPE int kh_union_##name(kh_##name##_t *d, const kh_##name##_t *s)                                              \
+    {                                                                                                                \
+        return __kh_merge_##name(d, s, NULL, NULL, 0);                                                               \
+    }                                                                                                                \
+    SCOPE int kh_merge_##name(kh_##name##_t *d, const kh_##name##_t *s,                                              \
+                              void (*combine)(khval_t *, const khval_t *, void *), void *ud)                         \
+    {                                                                                                                \
+        return __kh_merge_##name(d, s, combine, ud, 1);                                                              \
+    }                                                                                                                \
+    SCOPE int kh_intersect_##name(kh_##name##_t *d, const kh_##name##_t *s)                                          \
+    {                                                                                                                \
+        if (d == s)                                                                                                  \
+            return 0;                                                                                                \
+        if (d->old)                                                                                                  \
+            kh_migrate_##name(d, 0);                                                                                 \
+        if (kh_size(s) < d->size) /* keys of s found in d */                                                         \
+            return __kh_rebuild_##name(d, s, 1, 1, kh_size(s));                                                      \
+        return __kh_rebuild_##name(d, s, 0, 1, d->size);                                                             \
+    }                                                                                                                \
+    SCOPE int kh_difference_##name(kh_##name##_t *d, const kh_##name##_t *s)                                         \
+    {                                                                                                                \
+        khint_t end = __kh_iter_end(s), i, p, x;                                                                     \
+        if (d == s)                                                                                                  \
+        {                                                                                                            \
+            kh_clear_##name(d);                                                                                      \
+            return 0;                                                                                                \
+        }                                                                                                            \
+        if (d->old)                                                                                                  \
+            kh_migrate_##name(d, 0);                                                                                 \
+        if (kh_size(s) >= d->size) /* keys of d not in s */                                                          \
+            return __kh_rebuild_##name(d, s, 0, 0, d->size);                                                         \
+        for (i = __kh_iter_next(s, 0, end); i < end && d->size; i = __kh_iter_next(s, i + 1, end))                   \
+        { /* delete the keys of s from d */                                                                          \
+            const kh_##name##_t *t = __kh_iter_tab(s, i);                                                            \
+            p = __kh_iter_pos(s, i);                                                                                 \
+            x = __kh_get_hashed_##name(d, kh_key(t, p),                                                              \
+                                       __kh_hash_in_##name(d, t, kh_key(t, p), __kh_hash_at_##name(t, p)));          \
+            if (x != d->n_buckets)                                                                                   \
+                kh_del_##name(d, x);                                                                                 \
+        }                                                                                                            \
+        return 0;                                                                                                    \
     }
 
+/* Declare a table defined with KHASH_INIT2() elsewhere; not for KH_INTERLEAVED tables */
 #define KHASH_DECLARE(name, khkey_t, khval_t) \
-    __KHASH_TYPE(name, khkey_t, khval_t)      \
+    __KHASH_TYPE(name, khkey_t, khval_t, 0)   \
     __KHASH_PROTOTYPES(name, khkey_t, khval_t)
 
+/* How a table hashes a key: __hash_func(key), or __hash_func(key, h->seed) for KHASH_INIT_SEEDED() */
+#define __KHASH_HASH(name, khkey_t, __hash_func)                                               \
+    static kh_inline klib_unused khint_t __kh_hash_##name(const kh_##name##_t *h, khkey_t key) \
+    {                                                                                          \
+        (void)h;                                                                               \
+        return (khint_t)__hash_func(key);                                                      \
+    }
+#define __KHASH_HASH_SEEDED(name, khkey_t, __hash_func)                                        \
+    static kh_inline klib_unused khint_t __kh_hash_##name(const kh_##name##_t *h, khkey_t key) \
+    {                                                                                          \
+        return (khint_t)__hash_func(key, h->seed);                                             \
+    }
+
 #define KHASH_INIT2(name, SCOPE, khkey_t, khval_t, kh_is_map, __hash_func, __hash_equal) \
-    __KHASH_TYPE(name, khkey_t, khval_t)                                                 \
+    __KHASH_TYPE(name, khkey_t, khval_t, kh_is_map)                                      \
+    __KHASH_HASH(name, khkey_t, __hash_func)                                             \
     __KHASH_IMPL(name, SCOPE, khkey_t, khval_t, kh_is_map, __hash_func, __hash_equal)
 
 #define KHASH_INIT(name, khkey_t, khval_t, kh_is_map, __hash_func, __hash_equal) \
     KHASH_INIT2(name, static kh_inline klib_unused, khkey_t, khval_t, kh_is_map, __hash_func, __hash_equal)
 
+#define KHASH_INIT2_SEEDED(name, SCOPE, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal) \
+    __KHASH_TYPE(name, khkey_t, khval_t, kh_opts)                                             \
+    __KHASH_HASH_SEEDED(name, khkey_t, __hash_func)                                           \
+    __KHASH_IMPL(name, SCOPE, khkey_t, khval_t, (kh_opts) | KH_SEEDED, __hash_func, __hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash table whose hash function takes a seed
+  @param  name  Name of the hash table [symbol]
+  @param  khkey_t  Type of keys [type]
+  @param  khval_t  Type of values [type]
+  @param  kh_opts  Options, as for KHASH_INIT() [int]
+  @param  __hash_func  Hash function of a key and a seed [khint_t (khkey_t, uint64_t)]
+  @param  __hash_equal  Comparison function, as for KHASH_INIT()
+  @discussion   kh_init() draws a seed for each table from kh_seed_source(),
+                so keys chosen to collide in one table, or in one run, do
+                not collide in the next. See kh_str_hash_seeded() and
+                kh_int64_hash_seeded(), and kh_set_reseed() to draw a new
+                seed when a kh_put() probes too long anyway.
+ */
+#define KHASH_INIT_SEEDED(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal) \
+    KHASH_INIT2_SEEDED(name, static kh_inline klib_unused, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)
+
+#define __KHASH_IMPL_INTERN(name, SCOPE)                                                              \
+    SCOPE khint32_t kh_intern_##name(kh_##name##_t *h, const char *s, size_t len)                     \
+    {                                                                                                 \
+        int ret;                                                                                      \
+        if (!h->arena && !(h->arena = kh_arena_create(h->alloc)))                                     \
+            return -1;                                                                                \
+        kh_arena_t *a = h->arena;                                                                     \
+        if (a->n_strs == a->m_strs)                                                                   \
+        {                                                                                             \
+            size_t m = a->m_strs ? a->m_strs << 1 : 64;                                               \
+            const char **strs = m <= (size_t)INT32_MAX + 1 /* IDs are khint32_t */                    \
+                                    ? (const char **)kalloc_realloc(a->alloc, (void *)a->strs,        \
+                                                                    a->m_strs * sizeof(const char *), \
+                                                                    m * sizeof(const char *))         \
+                                    : NULL;                                                           \
+            if (!strs)                                                                                \
+                return -1;                                                                            \
+            a->strs = strs;                                                                           \
+            a->m_strs = m;                                                                            \
+        }                                                                                             \
+        /* Copy the key to the free end of the arena first; it is only kept if new */                 \
+        char *p = kh_arena_reserve(a, len + 1);                                                       \
+        if (!p)                                                                                       \
+            return -1;                                                                                \
+        memcpy(p, s, len);                                                                            \
+        p[len] = 0;                                                                                   \
+        khint_t k = kh_put_##name(h, p, &ret);                                                        \
+        if (ret < 0)                                                                                  \
+            return -1;                                                                                \
+        if (ret == 0)                                                                                 \
+            return kh_val(h, k);                                                                      \
+        kh_arena_commit(a, len + 1);                                                                  \
+        a->strs[a->n_strs] = p;                                                                       \
+        return kh_val(h, k) = (khint32_t)a->n_strs++;                                                 \
+    }                                                                                                 \
+    SCOPE khint32_t kh_intern_get_##name(const kh_##name##_t *h, const char *s)                       \
+    {                                                                                                 \
+        khint_t k = kh_get_##name(h, s);                                                              \
+        return k == kh_end(h) ? -1 : kh_val(h, k);                                                    \
+    }
+
+/*! @function
+  @abstract     Instantiate a string interning table
+  @param  name  Name of the hash table [symbol]
+  @discussion   A map from strings to IDs 0, 1, 2... in the order the strings
+                were first seen. The table copies the bytes of each new string
+                into an arena it owns, so callers need not keep their strings
+                alive, and kh_destroy() frees all of them at once. Do not use
+                kh_put() or kh_del() on such a table; kh_get() and iteration
+                are fine.
+ */
+#define KHASH_INTERN_INIT(name)                                                                         \
+    KHASH_INIT(name, kh_cstr_t, khint32_t, KH_MAP | KH_STORE_HASH, kh_str_hash_func, kh_str_hash_equal) \
+    __KHASH_IMPL_INTERN(name, static kh_inline klib_unused)
+
+/* kh_put_copy() of the tables of kh_strview_t keys */
+#define __KHASH_IMPL_SV(name, SCOPE)                                                           \
+    SCOPE khint_t kh_put_copy_##name(kh_##name##_t *h, kh_strview_t key, int *ret)             \
+    {                                                                                          \
+        khint_t x = kh_put_##name(h, key, ret);                                                \
+        if (*ret <= 0)                                                                         \
+            return x;                                                                          \
+        /* the key is new: point it to a copy of its bytes, which hash and compare the same */ \
+        char *p = NULL;                                                                        \
+        if (h->arena || (h->arena = kh_arena_create(h->alloc)))                                \
+            p = kh_arena_reserve(h->arena, key.len + 1);                                       \
+        if (!p)                                                                                \
+        {                                                                                      \
+            kh_del_##name(h, x);                                                               \
+            *ret = -1;                                                                         \
+            return kh_end(h);                                                                  \
+        }                                                                                      \
+        if (key.len)                                                                           \
+            memcpy(p, key.s, key.len);                                                         \
+        p[key.len] = 0;                                                                        \
+        kh_arena_commit(h->arena, key.len + 1);                                                \
+        kh_key(h, x).s = p;                                                                    \
+        return x;                                                                              \
+    }
+
 /**************************************
  *       Common hash functions        *
  **************************************/
@@ -528,7 +1909,11 @@ static inline uint64_t splittable64(uint64_t x)
 
 static inline khint_t kh_int32_hash_func(uint32_t key)
 {
+#ifdef KHASH_64
+    return (khint_t)splittable64(key); /* spread 32-bit keys over all 64 bits */
+#else
     return (khint_t)murmurhash32_mix32(key);
+#endif
 }
 
 static inline khint_t kh_int64_hash_func(uint64_t x)
@@ -538,24 +1923,209 @@ static inline khint_t kh_int64_hash_func(uint64_t x)
 
 #define KH_FNV_SEED 11
 
+/* The string hashes below work in uint64_t: their low 32 bits are the same as
+   with 32-bit arithmetic, and unsigned overflow is well defined */
 static inline khint_t kh_fnv_hash_str(const char *s)
 { /* FNV1a */
-    khint_t h = KH_FNV_SEED ^ 2166136261U;
+#ifdef KHASH_64
+    uint64_t h = KH_FNV_SEED ^ 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+#else
+    uint64_t h = KH_FNV_SEED ^ 2166136261U;
+    const uint64_t prime = 16777619;
+#endif
     const unsigned char *t = (const unsigned char *)s;
     for (; *t; ++t)
-        h ^= *t, h *= 16777619;
-    return h;
+        h ^= *t, h *= prime;
+    return (khint_t)h;
 }
 
 static kh_inline khint_t __ac_X31_hash_string(const char *s)
 {
-    khint_t h = (khint_t)*s;
+    uint64_t h = (uint64_t)*s;
     if (h)
         for (++s; *s; ++s)
-            h = (h << 5) - h + (khint_t)*s;
-    return h;
+            h = (h << 5) - h + (uint64_t)*s;
+    return (khint_t)h;
+}
+
+/*
+  wyhash (https://github.com/wangyi-fudan/wyhash, public domain): reads 8 or
+  16 bytes per step and mixes them with one 64x64->128 bit multiply, so it
+  runs at several bytes per cycle on long keys where X31 and FNV take one
+  byte per step, and its output passes SMHasher, so the low bits used to
+  pick a bucket are as good as the high ones.
+ */
+#ifndef KH_WYHASH_SEED
+#define KH_WYHASH_SEED 0x2d358dccaa6c78a5ULL
+#endif
+
+static kh_inline void __ac_wymum(uint64_t *a, uint64_t *b)
+{ /* the 128-bit product of *a and *b: low half in *a, high half in *b */
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 u128;
+    u128 r = (u128)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static kh_inline uint64_t __ac_wymix(uint64_t a, uint64_t b)
+{
+    __ac_wymum(&a, &b);
+    return a ^ b;
+}
+
+/* With keep set, xor the factors back into the product, so that a factor of
+   zero, which an attacker can get by matching a key block to a constant,
+   does not wipe out the seed; upstream calls this WYHASH_CONDOM */
+static kh_inline void __ac_wymum_keep(uint64_t *a, uint64_t *b, int keep)
+{
+    uint64_t x = *a, y = *b;
+    __ac_wymum(a, b);
+    if (keep)
+        *a ^= x, *b ^= y;
+}
+
+static kh_inline uint64_t __ac_wymix_keep(uint64_t a, uint64_t b, int keep)
+{
+    __ac_wymum_keep(&a, &b, keep);
+    return a ^ b;
+}
+
+static kh_inline uint64_t __ac_wyr8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static kh_inline uint64_t __ac_wyr4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static kh_inline uint64_t __ac_wyhash(const void *key, size_t len, uint64_t seed, int keep)
+{
+    static const uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL;
+    static const uint64_t s2 = 0x8ebc6af09c88c6e3ULL, s3 = 0x589965cc75374cc3ULL;
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t a, b;
+    seed ^= __ac_wymix_keep(seed ^ s0, s1, keep);
+    if (len <= 16)
+    {
+        if (len >= 4)
+        { /* two overlapping 4-byte reads from each end cover 4..16 bytes */
+            a = (__ac_wyr4(p) << 32) | __ac_wyr4(p + ((len >> 3) << 2));
+            b = (__ac_wyr4(p + len - 4) << 32) | __ac_wyr4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else
+    {
+        size_t i = len;
+        if (i > 48)
+        { /* three independent lanes hide the multiply latency */
+            uint64_t see1 = seed, see2 = seed;
+            do
+            {
+                seed = __ac_wymix_keep(__ac_wyr8(p) ^ s1, __ac_wyr8(p + 8) ^ seed, keep);
+                see1 = __ac_wymix_keep(__ac_wyr8(p + 16) ^ s2, __ac_wyr8(p + 24) ^ see1, keep);
+                see2 = __ac_wymix_keep(__ac_wyr8(p + 32) ^ s3, __ac_wyr8(p + 40) ^ see2, keep);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16)
+        {
+            seed = __ac_wymix_keep(__ac_wyr8(p) ^ s1, __ac_wyr8(p + 8) ^ seed, keep);
+            i -= 16;
+            p += 16;
+        }
+        a = __ac_wyr8(p + i - 16);
+        b = __ac_wyr8(p + i - 8);
+    }
+    a ^= s1;
+    b ^= seed;
+    __ac_wymum_keep(&a, &b, keep);
+    return __ac_wymix_keep(a ^ s0 ^ len, b ^ s1, keep);
+}
+
+/*! @function
+  @abstract     wyhash of a byte string
+  @param  key   Pointer to the bytes [const void*]
+  @param  len   Number of bytes [size_t]
+  @param  seed  Seed [uint64_t]
+  @return       The 64-bit hash value [uint64_t]
+ */
+static kh_inline uint64_t kh_wyhash(const void *key, size_t len, uint64_t seed)
+{
+    return __ac_wyhash(key, len, seed, 0);
+}
+
+/*! @function
+  @abstract     wyhash of a byte string, for keys an attacker may choose
+  @param  key   Pointer to the bytes [const void*]
+  @param  len   Number of bytes [size_t]
+  @param  seed  Secret seed [uint64_t]
+  @return       The 64-bit hash value [uint64_t]
+  @discussion   A little slower than kh_wyhash(), whose seed a block equal to
+                one of its constants cancels, so that keys ending alike
+                collide whatever the seed. This one keeps the seed in play.
+                It is no cryptographic hash, but no way is known to choose
+                colliding keys without the seed.
+ */
+static kh_inline uint64_t kh_wyhash_guarded(const void *key, size_t len, uint64_t seed)
+{
+    return __ac_wyhash(key, len, seed, 1);
 }
 
+static kh_inline khint_t __ac_wyhash_string(const char *s)
+{
+    return (khint_t)kh_wyhash(s, strlen(s), KH_WYHASH_SEED);
+}
+
+static kh_inline khint_t __ac_int64_hash_seeded(uint64_t key, uint64_t seed)
+{
+    return (khint_t)__ac_wymix_keep(key ^ seed, seed ^ 0xe7037ed1a0b428dbULL, 1);
+}
+
+/*
+  The default seed of a KH_SEEDED table p: the address of the table and of
+  the stack, the time in nanoseconds and a count of the seeds drawn, mixed.
+  Someone who can only send keys cannot guess it; to draw seeds from the
+  operating system instead, define kh_seed_source(p) to, say, a function
+  that calls getrandom(), before including this header.
+ */
+static kh_inline uint64_t __ac_seed_source(const void *p)
+{
+    static atomic_uint_fast64_t n_drawn;
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    uint64_t a = (uint64_t)(uintptr_t)p ^ (uint64_t)ts.tv_sec << 32 ^ (uint64_t)ts.tv_nsec;
+    uint64_t b = (uint64_t)(uintptr_t)&ts ^ atomic_fetch_add_explicit(&n_drawn, 1, memory_order_relaxed);
+    return __ac_wymix(a ^ 0xa0761d6478bd642fULL, b ^ 0xe7037ed1a0b428dbULL);
+}
+#ifndef kh_seed_source
+#define kh_seed_source(p) __ac_seed_source(p)
+#endif
+
 /* --- BEGIN OF HASH FUNCTIONS --- */
 
 /*! @function
@@ -579,12 +2149,106 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
  */
 #define kh_int64_hash_equal(a, b) ((a) == (b))
 
+/*! @function
+  @abstract     X31 hash of a null terminated string, one byte per step
+  @param  key   Pointer to a null terminated string [const char*]
+  @return       The hash value [khint_t]
+ */
+#define kh_str_hash_x31(key) __ac_X31_hash_string(key)
+/*! @function
+  @abstract     wyhash of a null terminated string, eight or more bytes per step
+  @param  key   Pointer to a null terminated string [const char*]
+  @return       The hash value [khint_t]
+ */
+#define kh_str_hash_wy(key) __ac_wyhash_string(key)
+/*! @function
+  @abstract     wyhash of a string that need not be null terminated
+  @param  key   Pointer to the first byte [const char*]
+  @param  len   Length in bytes [size_t]
+  @return       The hash value [khint_t]
+ */
+#define kh_strn_hash_func(key, len) ((khint_t)kh_wyhash(key, len, KH_WYHASH_SEED))
+
+/* A string that need not be null terminated: the len bytes from s */
+typedef struct
+{
+    const char *s;
+    size_t len;
+} kh_strview_t;
+/*! @function
+  @abstract     Make a string view
+  @param  s     Pointer to the first byte [const char*]
+  @param  len   Length in bytes [size_t]
+  @return       The view [kh_strview_t]
+ */
+#define kh_sv(s, len) ((kh_strview_t){(s), (len)})
+/*! @function
+  @abstract     Make a string view of a null terminated string
+  @param  s     Pointer to a null terminated string [const char*]
+  @return       The view [kh_strview_t]
+ */
+#define kh_sv_str(s) kh_sv(s, strlen(s))
+/*! @function
+  @abstract     Hash function of string views
+  @param  key   The view [kh_strview_t]
+  @return       The hash value [khint_t]
+  @discussion   Equal to kh_str_hash_wy() of the same bytes null terminated.
+ */
+static kh_inline khint_t kh_sv_hash_func(kh_strview_t key)
+{
+    return (khint_t)kh_wyhash(key.s, key.len, KH_WYHASH_SEED);
+}
+/*! @function
+  @abstract     Seeded hash of a string view, for KHASH_INIT_SEEDED()
+  @param  key   The view [kh_strview_t]
+  @param  seed  Seed of the table [uint64_t]
+  @return       The hash value [khint_t]
+ */
+static kh_inline khint_t kh_sv_hash_seeded(kh_strview_t key, uint64_t seed)
+{
+    return (khint_t)kh_wyhash_guarded(key.s, key.len, seed);
+}
+/*! @function
+  @abstract     String view comparison function
+  @discussion   Compares the lengths first: keys of another length are
+                rejected without reading their bytes.
+ */
+static kh_inline int kh_sv_hash_equal(kh_strview_t a, kh_strview_t b)
+{
+    return a.len == b.len && (a.len == 0 || memcmp(a.s, b.s, a.len) == 0);
+}
+/*! @function
+  @abstract     Seeded hash of a null terminated string, for KHASH_INIT_SEEDED()
+  @param  key   Pointer to a null terminated string [const char*]
+  @param  seed  Seed of the table [uint64_t]
+  @return       The hash value [khint_t]
+ */
+#define kh_str_hash_seeded(key, seed) ((khint_t)kh_wyhash_guarded(key, strlen(key), seed))
+/*! @function
+  @abstract     Seeded hash of an integer, for KHASH_INIT_SEEDED()
+  @param  key   The integer [khint32_t]
+  @param  seed  Seed of the table [uint64_t]
+  @return       The hash value [khint_t]
+ */
+#define kh_int_hash_seeded(key, seed) __ac_int64_hash_seeded((uint32_t)(key), seed)
+/*! @function
+  @abstract     Seeded hash of a 64-bit integer, for KHASH_INIT_SEEDED()
+  @param  key   The integer [khint64_t]
+  @param  seed  Seed of the table [uint64_t]
+  @return       The hash value [khint_t]
+ */
+#define kh_int64_hash_seeded(key, seed) __ac_int64_hash_seeded((uint64_t)(key), seed)
 /*! @function
   @abstract     Another interface to const char* hash function
   @param  key   Pointer to a null terminated string [const char*]
   @return       The hash value [khint_t]
+  @discussion   Used by KHASH_SET_INIT_STR() and KHASH_MAP_INIT_STR(). It is
+                kh_str_hash_x31() unless defined to another string hash, such
+                as kh_str_hash_wy() or kh_fnv_hash_str(), before this header.
  */
-#define kh_str_hash_func(key) __ac_X31_hash_string(key)
+#ifndef kh_str_hash_func
+#define kh_str_hash_func(key) kh_str_hash_x31(key)
+#endif
 /*! @function
   @abstract     Const char* comparison function
  */
@@ -605,6 +2269,14 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
  */
 #define kh_init(name) kh_init_##name()
 
+/*! @function
+  @abstract     Initiate a hash table that takes its memory from an allocator.
+  @param  name  Name of the hash table [symbol]
+  @param  a     Allocator, which must outlive the table; NULL for the default [const kalloc_t*]
+  @return       Pointer to the hash table [khash_t(name)*]
+ */
+#define kh_init_with_alloc(name, a) kh_init_with_alloc_##name(a)
+
 /*! @function
   @abstract     Destroy a hash table.
   @param  name  Name of the hash table [symbol]
@@ -649,11 +2321,108 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
  */
 #define kh_get(name, h, k) kh_get_##name(h, k)
 
+/*! @function
+  @abstract     Retrieve many keys, overlapping their cache misses.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  keys  Keys to look up [const type of keys*]
+  @param  n     Number of keys [size_t]
+  @param  out   Receives n iterators, kh_end(h) for absent keys [khint_t*]
+  @discussion   Hashes KH_BATCH_WINDOW keys ahead of the current one and
+                prefetches their home buckets. Same results as calling
+                kh_get() on each key in turn.
+ */
+#define kh_get_batch(name, h, keys, n, out) kh_get_batch_##name(h, keys, n, out)
+
+/*! @function
+  @abstract     Insert many keys, overlapping their cache misses.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  keys  Keys to insert [const type of keys*]
+  @param  n     Number of keys [size_t]
+  @param  out   Receives n iterators to the inserted elements [khint_t*]
+  @param  rets  Receives the kh_put() return code of each key; may be NULL [int*]
+  @return       0 on success; -1 if the table could not grow [int]
+  @discussion   The table is grown up front to hold n new keys, so the
+                iterators in out stay valid after the call. KH_ROBINHOOD
+                tables look the keys up again at the end, because later
+                keys may shift earlier ones.
+ */
+#define kh_put_batch(name, h, keys, n, out, rets) kh_put_batch_##name(h, keys, n, out, rets)
+
+/*
+  Set algebra on two tables d and s of the same kind, in place on d. Every
+  key is hashed at most once: the hash s already has, stored with
+  KH_STORE_HASH or computed once, serves both to look the key up and to
+  insert it, unless the two tables are KH_SEEDED with different seeds. s
+  is only read, even in the middle of an incremental rehash; an unfinished
+  rehash of d is finished first. Keys are copied as they are, so keys of s
+  that point into its arena (kh_intern(), kh_put_copy()) live only as long
+  as s. On failure, which only allocation can cause, d is left as it was.
+ */
+
+/*! @function
+  @abstract     Add the keys of one hash table to another.
+  @param  name  Name of the hash table [symbol]
+  @param  d     Pointer to the hash table to add to [khash_t(name)*]
+  @param  s     Pointer to the hash table whose keys are added [const khash_t(name)*]
+  @return       0 on success; -1 if d could not grow [int]
+  @discussion   d grows once, up front, to hold all the keys of s, so it
+                may end up with more buckets than it needs when most of them
+                are in d already; kh_compact() gives those back. Keys new to
+                d take their values from s; keys in both keep those of d.
+ */
+#define kh_union(name, d, s) kh_union_##name(d, s)
+
+/*! @function
+  @abstract     Add the entries of one hash map to another, combining the
+                values of keys in both.
+  @param  name  Name of the hash table [symbol]
+  @param  d     Pointer to the hash table to merge into [khash_t(name)*]
+  @param  s     Pointer to the hash table merged [const khash_t(name)*]
+  @param  combine  Called as combine(&value in d, &value in s, ud) for every
+                key in both; NULL to take the value of s [void (*)(type of values*, const type of values*, void*)]
+  @param  ud    Passed to combine unchanged [void*]
+  @return       0 on success; -1 if d could not grow [int]
+  @discussion   The reduce step of a per-thread aggregation: each thread
+                fills a table of its own, and the tables are merged into
+                one at the end. d grows as for kh_union().
+ */
+#define kh_merge(name, d, s, combine, ud) kh_merge_##name(d, s, combine, ud)
+
+/*! @function
+  @abstract     Remove the keys of a hash table that another lacks.
+  @param  name  Name of the hash table [symbol]
+  @param  d     Pointer to the hash table to remove from [khash_t(name)*]
+  @param  s     Pointer to the other hash table [const khash_t(name)*]
+  @return       0 on success; -1 if out of memory [int]
+  @discussion   The keys that remain keep their values from d. d moves into
+                fresh buckets, sized for the smaller of the two tables, by
+                walking the smaller one and looking its keys up in the
+                other.
+ */
+#define kh_intersect(name, d, s) kh_intersect_##name(d, s)
+
+/*! @function
+  @abstract     Remove the keys of one hash table from another.
+  @param  name  Name of the hash table [symbol]
+  @param  d     Pointer to the hash table to remove from [khash_t(name)*]
+  @param  s     Pointer to the hash table whose keys are removed [const khash_t(name)*]
+  @return       0 on success; -1 if out of memory [int]
+  @discussion   Walks the smaller table: the keys of s are deleted from d
+                if s is smaller, as kh_del() would, and d moves into fresh
+                buckets holding the keys s lacks otherwise.
+ */
+#define kh_difference(name, d, s) kh_difference_##name(d, s)
+
 /*! @function
   @abstract     Remove a key from the hash table.
   @param  name  Name of the hash table [symbol]
   @param  h     Pointer to the hash table [khash_t(name)*]
   @param  k     Iterator to the element to be deleted [khint_t]
+  @discussion   Marks the bucket deleted, except with KH_ROBINHOOD, which
+                moves the following keys of the cluster back one bucket.
+                May call kh_compact() if a policy is set with kh_set_compact().
  */
 #define kh_del(name, h, k) kh_del_##name(h, k)
 
@@ -671,7 +2440,7 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
   @param  x     Iterator to the bucket [khint_t]
   @return       Key [type of keys]
  */
-#define kh_key(h, x) ((h)->keys[x])
+#define kh_key(h, x) ((h)->keys[(x) * sizeof((h)->key_stride)])
 
 /*! @function
   @abstract     Get value given an iterator
@@ -680,12 +2449,12 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
   @return       Value [type of values]
   @discussion   For hash sets, calling this results in segfault.
  */
-#define kh_val(h, x) ((h)->vals[x])
+#define kh_val(h, x) ((h)->vals[(x) * sizeof((h)->val_stride)])
 
 /*! @function
   @abstract     Alias of kh_val()
  */
-#define kh_value(h, x) ((h)->vals[x])
+#define kh_value(h, x) kh_val(h, x)
 
 /*! @function
   @abstract     Get the start iterator
@@ -706,7 +2475,7 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
   @param  h     Pointer to the hash table [khash_t(name)*]
   @return       Number of elements in the hash table [khint_t]
  */
-#define kh_size(h) ((h)->size)
+#define kh_size(h) ((h)->size + ((h)->old ? (h)->old->size : 0))
 
 /*! @function
   @abstract     Get the number of buckets in the hash table
@@ -715,44 +2484,204 @@ static kh_inline khint_t __ac_X31_hash_string(const char *s)
  */
 #define kh_n_buckets(h) ((h)->n_buckets)
 
+/* Iteration covers kh_end(h) buckets, followed by the old buckets of an
+   unfinished incremental rehash; these map an iteration index to a bucket */
+#define __kh_iter_end(h) (kh_end(h) + ((h)->old ? kh_end((h)->old) : 0))
+#define __kh_iter_tab(h, i) ((i) < kh_end(h) ? (h) : (h)->old)
+#define __kh_iter_pos(h, i) ((i) < kh_end(h) ? (i) : (i) - kh_end(h))
+#define __kh_iter_next(h, i, end) \
+    __kh_next_full((h)->flags, kh_end(h), (h)->old ? (h)->old->flags : NULL, i, end)
+
+/* First iteration index in [i, end) that holds a key, or end */
+static kh_inline khint_t __kh_next_full(const khint32_t *flags, khint_t n, const khint32_t *old_flags, khint_t i,
+                                        khint_t end)
+{
+    if (i < n)
+    {
+        khint_t stop = end < n ? end : n, j = __ac_next_full(flags, i, stop);
+        if (j < stop)
+            return j;
+        i = n;
+    }
+    return i < end ? n + __ac_next_full(old_flags, i - n, end - n) : end;
+}
+
+/* Start of part i of n in [0, end), rounded down to a flags word */
+static kh_inline khint_t __kh_split(khint_t end, int i, int n)
+{
+    return i >= n ? end : (khint_t)((uint64_t)(end >> 4) * i / n) << 4;
+}
+
 /*! @function
-  @abstract     Iterate over the entries in the hash table
+  @abstract     Split the iteration over a hash table into parts.
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  i     Part, from 0 to n [int]
+  @param  n     Number of parts [int]
+  @return       First iteration index of part i; part i ends where part i + 1 starts [khint_t]
+  @discussion   kh_split(h, 0, n) is kh_begin(h) and kh_split(h, n, n) is the
+                end of the whole iteration. Parts start on a multiple of 16
+                buckets, so they share no flags word, and together cover the
+                buckets of an unfinished incremental rehash too. Threads may
+                scan different parts with kh_foreach_range() at once, as long
+                as nothing modifies the table.
+ */
+#define kh_split(h, i, n) __kh_split(__kh_iter_end(h), i, n)
+
+/*! @function
+  @abstract     Iterate over the entries in part of a hash table
   @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  begin First iteration index, usually from kh_split() [khint_t]
+  @param  end   Iteration index to stop before [khint_t]
   @param  kvar  Variable to which key will be assigned
   @param  vvar  Variable to which value will be assigned
   @param  code  Block of code to execute
  */
-#define kh_foreach(h, kvar, vvar, code)                  \
-    {                                                    \
-        khint_t __i;                                     \
-        for (__i = kh_begin(h); __i != kh_end(h); ++__i) \
-        {                                                \
-            if (!kh_exist(h, __i))                       \
-                continue;                                \
-            (kvar) = kh_key(h, __i);                     \
-            (vvar) = kh_val(h, __i);                     \
-            code;                                        \
-        }                                                \
+#define kh_foreach_range(h, begin, end, kvar, vvar, code)                                           \
+    {                                                                                               \
+        khint_t __i, __n = (end);                                                                   \
+        for (__i = __kh_iter_next(h, begin, __n); __i < __n; __i = __kh_iter_next(h, __i + 1, __n)) \
+        {                                                                                           \
+            (kvar) = kh_key(__kh_iter_tab(h, __i), __kh_iter_pos(h, __i));                          \
+            (vvar) = kh_val(__kh_iter_tab(h, __i), __kh_iter_pos(h, __i));                          \
+            code;                                                                                   \
+        }                                                                                           \
     }
 
 /*! @function
-  @abstract     Iterate over the values in the hash table
+  @abstract     Iterate over the values in part of a hash table
   @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  begin First iteration index, usually from kh_split() [khint_t]
+  @param  end   Iteration index to stop before [khint_t]
   @param  vvar  Variable to which value will be assigned
   @param  code  Block of code to execute
  */
-#define kh_foreach_value(h, vvar, code)                  \
-    {                                                    \
-        khint_t __i;                                     \
-        for (__i = kh_begin(h); __i != kh_end(h); ++__i) \
-        {                                                \
-            if (!kh_exist(h, __i))                       \
-                continue;                                \
-            (vvar) = kh_val(h, __i);                     \
-            code;                                        \
-        }                                                \
+#define kh_foreach_value_range(h, begin, end, vvar, code)                                           \
+    {                                                                                               \
+        khint_t __i, __n = (end);                                                                   \
+        for (__i = __kh_iter_next(h, begin, __n); __i < __n; __i = __kh_iter_next(h, __i + 1, __n)) \
+        {                                                                                           \
+            (vvar) = kh_val(__kh_iter_tab(h, __i), __kh_iter_pos(h, __i));                          \
+            code;                                                                                   \
+        }                                                                                           \
     }
 
+/*! @function
+  @abstract     Iterate over the entries in the hash table
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  kvar  Variable to which key will be assigned
+  @param  vvar  Variable to which value will be assigned
+  @param  code  Block of code to execute
+  @discussion   Also visits entries not yet moved by an incremental rehash.
+                Empty and deleted buckets are skipped a flags word at a time.
+ */
+#define kh_foreach(h, kvar, vvar, code) kh_foreach_range(h, kh_begin(h), __kh_iter_end(h), kvar, vvar, code)
+
+/*! @function
+  @abstract     Iterate over the values in the hash table
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  vvar  Variable to which value will be assigned
+  @param  code  Block of code to execute
+ */
+#define kh_foreach_value(h, vvar, code) kh_foreach_value_range(h, kh_begin(h), __kh_iter_end(h), vvar, code)
+
+/*! @function
+  @abstract     Spread future rehashes over later operations.
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  s     Old buckets migrated per kh_put/kh_get/kh_del; 0 to rehash in one go [khint_t]
+  @discussion   When kh_put() needs to grow or clean up the table, the current
+                buckets are set aside and every later kh_put(), kh_get() and
+                kh_del() moves s of them into the new ones. Because of that,
+                kh_get() may modify the table while a migration is running.
+                Iterators from kh_get()/kh_put() always point into the new
+                buckets; a plain loop over kh_begin()..kh_end() does not see
+                the old ones, but kh_foreach() does. Steps below 4 are raised
+                to 4 so a migration always finishes before the next one.
+ */
+#define kh_set_incremental(h, s) ((h)->rehash_step = (s) > 0 && (s) < 4 ? 4 : (s))
+
+/*! @function
+  @abstract     Change the load factor and growth multiplier of one table.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  f     Load factor above which the table grows, between 0 and 1; 0 for the default [double]
+  @param  g     Growth multiplier, 2, 4 or 8; 0 for the default [int]
+  @return       0 on success; -1 if the table had to grow and could not [int]
+  @discussion   The defaults come from KH_LOAD() and KH_GROWTH() in the
+                options of KHASH_INIT(), or are 0.77 and 2. Lower factors
+                mean shorter probes and more memory. Growth stays a power
+                of two, as bucket counts are. A table already fuller than
+                f is grown at once; a larger f takes effect on later
+                inserts.
+ */
+#define kh_set_load(name, h, f, g) kh_set_load_##name(h, f, g)
+
+/*! @function
+  @abstract     Set when kh_del() calls kh_compact() automatically.
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  t     Compact once deleted buckets exceed this fraction of the buckets; 0 never [double]
+  @param  l     Shrink once the keys fill less than this fraction of the buckets; 0 never [double]
+  @discussion   Both are off by default. A shrink leaves the keys filling
+                between a quarter and a half of the load limit, so l should
+                stay below a quarter of it to avoid shrinking again soon.
+                kh_del() with a policy set may rehash the table, which moves
+                keys: do not set one while deleting in a loop over buckets.
+                h->compact.n_rehash and h->compact.n_shrink count the times
+                the table was compacted.
+ */
+#define kh_set_compact(h, t, l) ((h)->compact.max_tombstones = (t), (h)->compact.min_load = (l))
+
+/*! @function
+  @abstract     Drop deleted buckets, shrinking the table if it is mostly empty.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @return       1 if the table was rehashed or shrunk; 0 if there was nothing
+                to do; -1 if memory ran out, leaving the table unchanged [int]
+  @discussion   Finishes an incremental rehash first. Shrinks to the smallest
+                size at which the keys fill at most half of the load limit;
+                if that is the current size, rehashes in place when there
+                are deleted buckets. Iterators are invalidated.
+ */
+#define kh_compact(name, h) kh_compact_##name(h)
+
+/*! @function
+  @abstract     Advance an incremental rehash.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  n     Number of old buckets to migrate; 0 to finish [khint_t]
+  @return       1 if old buckets remain, 0 otherwise [int]
+ */
+#define kh_migrate(name, h, n) kh_migrate_##name(h, n)
+
+/*! @function
+  @abstract     Rehash a table under a new seed.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  seed  The seed; kh_seed_source(h) for a fresh one [uint64_t]
+  @return       0 on success; -1 if memory ran out, leaving the table as it was [int]
+  @discussion   For tables from KHASH_INIT_SEEDED(); a fixed seed makes a
+                table behave the same in every run, as tests want. Finishes
+                an incremental rehash first. Iterators are invalidated.
+ */
+#define kh_reseed(name, h, seed) kh_reseed_##name(h, seed)
+
+/*! @function
+  @abstract     Let kh_put() reseed a table when a new key lands far from home.
+  @param  h     Pointer to a table from KHASH_INIT_SEEDED() [khash_t(name)*]
+  @param  n     Reseed when placing a key takes more than n probes; 0 never [khint_t]
+  @discussion   Off by default. Probes are counted as by kh_stats(): buckets,
+                or groups of buckets with KH_SWISS. Random keys stay well
+                short of 64 buckets, or 8 groups; far longer probes mean the
+                seed leaked and keys were chosen against it, and kh_put()
+                rehashes the whole table under a new seed from
+                kh_seed_source(). If some key still takes too many probes
+                after that, the hash ignores its seed or n is too low, and
+                the check turns itself off. h->n_reseed counts the reseeds. The
+                check costs one more lookup per new key, and kh_put() may
+                move keys: do not set it while adding keys in a loop over
+                buckets. kh_put_batch() does not check.
+ */
+#define kh_set_reseed(h, n) ((h)->reseed_probes = (n))
+
 /* More convenient interfaces */
 
 /*! @function
@@ -801,7 +2730,187 @@ typedef const char *kh_cstr_t;
 #define KHASH_MAP_INIT_STR(name, khval_t) \
     KHASH_INIT(name, kh_cstr_t, khval_t, 1, kh_str_hash_func, kh_str_hash_equal)
 
+/*! @function
+  @abstract     Instantiate a hash set containing integer keys, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+ */
+#define KHASH_SET_INIT_INT_SEEDED(name) \
+    KHASH_INIT_SEEDED(name, khint32_t, char, 0, kh_int_hash_seeded, kh_int_hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash map containing integer keys, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+  @param  khval_t  Type of values [type]
+ */
+#define KHASH_MAP_INIT_INT_SEEDED(name, khval_t) \
+    KHASH_INIT_SEEDED(name, khint32_t, khval_t, 1, kh_int_hash_seeded, kh_int_hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash set containing 64-bit integer keys, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+ */
+#define KHASH_SET_INIT_INT64_SEEDED(name) \
+    KHASH_INIT_SEEDED(name, khint64_t, char, 0, kh_int64_hash_seeded, kh_int64_hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash map containing 64-bit integer keys, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+  @param  khval_t  Type of values [type]
+ */
+#define KHASH_MAP_INIT_INT64_SEEDED(name, khval_t) \
+    KHASH_INIT_SEEDED(name, khint64_t, khval_t, 1, kh_int64_hash_seeded, kh_int64_hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash set containing const char* keys, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+  @discussion   For keys that come from outside: unlike with
+                KHASH_SET_INIT_STR(), colliding keys cannot be worked out
+                ahead of time.
+ */
+#define KHASH_SET_INIT_STR_SEEDED(name) \
+    KHASH_INIT_SEEDED(name, kh_cstr_t, char, 0, kh_str_hash_seeded, kh_str_hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash map containing const char* keys, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+  @param  khval_t  Type of values [type]
+  @discussion   See KHASH_SET_INIT_STR_SEEDED().
+ */
+#define KHASH_MAP_INIT_STR_SEEDED(name, khval_t) \
+    KHASH_INIT_SEEDED(name, kh_cstr_t, khval_t, 1, kh_str_hash_seeded, kh_str_hash_equal)
+
+/*! @function
+  @abstract     Instantiate a hash set containing string views
+  @param  name  Name of the hash table [symbol]
+  @discussion   Keys are kh_strview_t, so a token in a larger buffer can be
+                looked up where it lies: kh_get(name, h, kh_sv(p, len)).
+                kh_put() stores the view as it is, and the caller keeps its
+                bytes alive; kh_put_copy() stores a copy the table owns.
+ */
+#define KHASH_SET_INIT_SV(name)                                                \
+    KHASH_INIT(name, kh_strview_t, char, 0, kh_sv_hash_func, kh_sv_hash_equal) \
+    __KHASH_IMPL_SV(name, static kh_inline klib_unused)
+
+/*! @function
+  @abstract     Instantiate a hash map containing string views
+  @param  name  Name of the hash table [symbol]
+  @param  khval_t  Type of values [type]
+  @discussion   See KHASH_SET_INIT_SV().
+ */
+#define KHASH_MAP_INIT_SV(name, khval_t)                                          \
+    KHASH_INIT(name, kh_strview_t, khval_t, 1, kh_sv_hash_func, kh_sv_hash_equal) \
+    __KHASH_IMPL_SV(name, static kh_inline klib_unused)
+
+/*! @function
+  @abstract     Instantiate a hash set containing string views, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+ */
+#define KHASH_SET_INIT_SV_SEEDED(name)                                                  \
+    KHASH_INIT_SEEDED(name, kh_strview_t, char, 0, kh_sv_hash_seeded, kh_sv_hash_equal) \
+    __KHASH_IMPL_SV(name, static kh_inline klib_unused)
+
+/*! @function
+  @abstract     Instantiate a hash map containing string views, hashed with a seed of its own
+  @param  name  Name of the hash table [symbol]
+  @param  khval_t  Type of values [type]
+ */
+#define KHASH_MAP_INIT_SV_SEEDED(name, khval_t)                                            \
+    KHASH_INIT_SEEDED(name, kh_strview_t, khval_t, 1, kh_sv_hash_seeded, kh_sv_hash_equal) \
+    __KHASH_IMPL_SV(name, static kh_inline klib_unused)
+
+/*! @function
+  @abstract     Insert a string view, copying its bytes if it is new.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to a table from KHASH_SET_INIT_SV() and the like [khash_t(name)*]
+  @param  k     Key [kh_strview_t]
+  @param  r     Extra return code, as for kh_put() [int*]
+  @return       Iterator to the inserted element [khint_t]
+  @discussion   A new key is stored as a view of a null terminated copy in
+                an arena of the table, which kh_clear() and kh_destroy()
+                free; a key already present is left alone, so the bytes are
+                only copied once. Deleting a key does not free its copy.
+                Such tables cannot be saved with kh_save().
+ */
+#define kh_put_copy(name, h, k, r) kh_put_copy_##name(h, k, r)
+
+/*! @function
+  @abstract     Intern a string.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to a table from KHASH_INTERN_INIT() [khash_t(name)*]
+  @param  s     Pointer to a null terminated string [const char*]
+  @return       ID of the string, or -1 if out of memory [khint32_t]
+ */
+#define kh_intern(name, h, s) kh_intern_##name(h, s, strlen(s))
+
+/*! @function
+  @abstract     Intern a string that need not be null terminated.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to a table from KHASH_INTERN_INIT() [khash_t(name)*]
+  @param  s     Pointer to the first byte; must not contain a null byte [const char*]
+  @param  len   Length in bytes [size_t]
+  @return       ID of the string, or -1 if out of memory [khint32_t]
+ */
+#define kh_intern_n(name, h, s, len) kh_intern_##name(h, s, len)
+
+/*! @function
+  @abstract     Get the ID of a string without interning it.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to a table from KHASH_INTERN_INIT() [khash_t(name)*]
+  @param  s     Pointer to a null terminated string [const char*]
+  @return       ID of the string, or -1 if it was never interned [khint32_t]
+ */
+#define kh_intern_get(name, h, s) kh_intern_get_##name(h, s)
+
+/*! @function
+  @abstract     Get the interned copy of a string from its ID.
+  @param  h     Pointer to a table from KHASH_INTERN_INIT() [khash_t(name)*]
+  @param  id    ID returned by kh_intern() [khint32_t]
+  @return       The string, valid until the table is cleared or destroyed [const char*]
+ */
+#define kh_intern_str(h, id) ((h)->arena->strs[id])
+
+/*! @function
+  @abstract     Get the number of interned strings.
+  @param  h     Pointer to a table from KHASH_INTERN_INIT() [khash_t(name)*]
+  @return       Number of IDs handed out [size_t]
+ */
+#define kh_intern_size(h) ((h)->arena ? (h)->arena->n_strs : 0)
+
 /* Macro to get probe statistics for a specific hash table type */
 #define kh_probe_stats(name, h) kh_probe_stat_##name(h)
 
+/*! @function
+  @abstract     Get the bytes a hash table holds.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @return       Bytes of live keys and values, empty buckets, tombstones and
+                bookkeeping, including buckets still being migrated and
+                interned strings [kmem_usage_t]
+  @discussion   O(1), apart from a walk over the blocks of interned strings.
+                To sum up many tables, see kmem_usage_add(); to count what
+                all the tables of a kind allocate, see kalloc_tally_t.
+ */
+#define kh_memory_usage(name, h) kh_memory_usage_##name(h)
+
+#ifdef KHASH_STATS
+/*! @function
+  @abstract     Get the running counters of a hash table.
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @return       A copy of the counters [kh_stats_t]
+  @discussion   Only with -DKHASH_STATS; without it tables carry no counters
+                and their operations count nothing. Unlike kh_probe_stats(),
+                this costs a copy, whatever the size of the table. The
+                counters are plain integers, so even kh_get() writes to the
+                table: do not look up keys in one table from several threads
+                at once.
+ */
+#define kh_stats(h) (*__kh_stats_of(h))
+
+/*! @function
+  @abstract     Set the running counters of a hash table back to zero.
+  @param  h     Pointer to the hash table [khash_t(name)*]
+ */
+#define kh_stats_reset(h) memset(__kh_stats_of(h), 0, sizeof(kh_stats_t))
+#endif
+
 #endif /* __AC_KHASH_H */
@@ -0,0 +1,911 @@
+/*
+  Adaptive sets of 32-bit integers built on khash.h.
+
+  kh_bitset_t holds the same keys as a KHASH_SET_INIT_INT table and is used
+  the same way, with kh_b_put(), kh_b_get(), kh_b_del() and kh_b_foreach(),
+  but is made for sets of IDs that are dense inside ranges. As in Roaring
+  bitmaps (Chambi, Lemire et al., 2016), keys are cut into chunks of 65536
+  by their top 16 bits; a khash map finds the container of a chunk, and the
+  container holds the low 16 bits of its keys in one of three ways:
+
+    - an array, sorted, of at most 4096 keys: 2 bytes a key;
+    - a bitmap of all 65536: 8 KiB however many keys it has;
+    - a list, sorted, of runs of consecutive keys: 4 bytes a run.
+
+  Containers change kind as keys come and go: an array that outgrows 4096
+  keys becomes a bitmap, or runs if it has few; a bitmap that drops below
+  2048 keys becomes an array; runs that would take more room than an array
+  or a bitmap become one. kh_b_compact() also turns arrays and bitmaps with
+  few runs into runs, which insertions never do. A set of IDs at 80% density
+  takes a bit for each ID of its range, about 0.16 bytes a key, where a
+  khash set takes 4 bytes of key and the flags and empty buckets around it,
+  over 5 bytes a key; a set of scattered keys, one or two to a chunk, takes
+  far more than a khash set, so keep those in one.
+
+  kh_b_union() and kh_b_intersect() build a new set chunk by chunk, and
+  kh_b_intersect_size() counts the keys two sets share without building
+  anything. Bitmaps are combined by fixed-length loops over 64-bit words,
+  which compilers turn into vector code; arrays are merged, and checked
+  against bitmaps and runs key by key.
+
+  An example:
+
+#include "khash_bitset.h"
+    kh_bitset_t *s = kh_b_init(), *t = kh_b_init();
+    for (khint32_t id = 1000; id < 50000; ++id)
+        kh_b_put(s, id, &ret); // ret as from kh_put(); -1 if out of memory
+    if (kh_b_get(s, 42)) ... // 1 if 42 is in s
+    kh_b_foreach(s, id, { use(id); });
+    kh_bitset_t *both = kh_b_intersect(s, t);
+    size_t n = kh_b_intersect_size(s, t); // kh_b_size(both), without both
+    kh_b_destroy(both);
+
+  Keys are visited in order within a chunk but chunks in no particular
+  order, as with a khash set.
+ */
+
+#ifndef __AC_KHASH_BITSET_H
+#define __AC_KHASH_BITSET_H
+
+#include "khash.h"
+
+/* Kinds of container */
+#define KH_B_ARRAY 0  /* sorted keys */
+#define KH_B_BITMAP 1 /* a bit for every key of the chunk */
+#define KH_B_RUNS 2   /* sorted pairs of the first and the last key of a run */
+
+#define __KH_B_ARRAY_MAX 4096 /* keys of an array; as large as a bitmap */
+#define __KH_B_RUNS_MAX 2048  /* runs of a run container; as large as a bitmap */
+#define __KH_B_WORDS 1024     /* 64-bit words of a bitmap */
+
+/* Container of the keys of one chunk */
+typedef struct
+{
+    union
+    {
+        uint16_t *vals; /* KH_B_ARRAY: len keys; KH_B_RUNS: len pairs of values */
+        uint64_t *bits; /* KH_B_BITMAP: __KH_B_WORDS words */
+    };
+    uint32_t n;        /* keys, 1 to 65536 */
+    uint32_t kind;     /* KH_B_ARRAY, KH_B_BITMAP or KH_B_RUNS */
+    uint32_t len, cap; /* keys or runs held and room for them; 0 for a bitmap */
+} kh_b_chunk_t;
+
+KHASH_MAP_INIT_INT(__kh_b_dir, kh_b_chunk_t)
+
+typedef struct
+{
+    khash_t(__kh_b_dir) *dir; /* top 16 bits of the keys -> container of their chunk */
+    size_t size;              /* keys in the set */
+    const kalloc_t *alloc;    /* allocator of the set, its directory and containers */
+} kh_bitset_t;
+
+/* Position of kh_b_next() in a set */
+typedef struct
+{
+    khint_t k;   /* bucket of the chunk in the directory */
+    uint32_t i;  /* next key of an array, run of a run container, or bit of a bitmap */
+    uint32_t v;  /* next key of the run, from its first */
+} kh_b_iter_t;
+
+static kh_inline int __kh_b_popcount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    x -= x >> 1 & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + (x >> 2 & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)(x * 0x0101010101010101ULL >> 56);
+#endif
+}
+
+/* Bytes allocated to a container */
+static kh_inline size_t __kh_b_bytes(const kh_b_chunk_t *c)
+{
+    return c->kind == KH_B_BITMAP ? __KH_B_WORDS * sizeof(uint64_t)
+                                  : (size_t)c->cap * sizeof(uint16_t) * (c->kind == KH_B_RUNS ? 2 : 1);
+}
+
+static kh_inline void __kh_b_free(const kalloc_t *a, kh_b_chunk_t *c)
+{
+    kalloc_free(a, c->vals, __kh_b_bytes(c));
+}
+
+/* Make room in an array or run container for len keys or runs; -1 if out of memory */
+static kh_inline int __kh_b_reserve(const kalloc_t *a, kh_b_chunk_t *c, uint32_t len)
+{
+    if (len <= c->cap)
+        return 0;
+    size_t unit = sizeof(uint16_t) * (c->kind == KH_B_RUNS ? 2 : 1);
+    uint32_t cap = c->cap < 4 ? 4 : c->cap + (c->cap >> 1);
+    if (cap < len)
+        cap = len;
+    uint16_t *v = (uint16_t *)kalloc_realloc(a, c->vals, c->cap * unit, cap * unit);
+    if (!v)
+        return -1;
+    c->vals = v;
+    c->cap = cap;
+    return 0;
+}
+
+/* Index of the first of n values, every stride-th of v, that is not less than x */
+static kh_inline uint32_t __kh_b_lower(const uint16_t *v, uint32_t n, uint32_t stride, uint32_t x)
+{
+    uint32_t lo = 0;
+    while (n > 0)
+    {
+        uint32_t half = n >> 1;
+        if (v[(lo + half) * stride] < x)
+            lo += half + 1, n -= half + 1;
+        else
+            n = half;
+    }
+    return lo;
+}
+
+static kh_inline int __kh_b_has(const kh_b_chunk_t *c, uint32_t x)
+{
+    if (c->kind == KH_B_BITMAP)
+        return c->bits[x >> 6] >> (x & 63) & 1;
+    if (c->kind == KH_B_ARRAY)
+    {
+        uint32_t i = __kh_b_lower(c->vals, c->len, 1, x);
+        return i < c->len && c->vals[i] == x;
+    }
+    uint32_t i = __kh_b_lower(c->vals + 1, c->len, 2, x); /* first run that ends at or after x */
+    return i < c->len && c->vals[2 * i] <= x;
+}
+
+/* Set (on) or clear the bits first to last */
+static kh_inline void __kh_b_mark(uint64_t *bits, uint32_t first, uint32_t last, int on)
+{
+    uint32_t w = first >> 6, lw = last >> 6;
+    uint64_t m = ~0ULL << (first & 63), lm = ~0ULL >> (63 - (last & 63));
+    if (w == lw)
+        m &= lm;
+    bits[w] = on ? bits[w] | m : bits[w] & ~m;
+    if (w == lw)
+        return;
+    while (++w < lw)
+        bits[w] = on ? ~0ULL : 0;
+    bits[lw] = on ? bits[lw] | lm : bits[lw] & ~lm;
+}
+
+/* Number of the bits first to last that are set */
+static kh_inline uint32_t __kh_b_count_range(const uint64_t *bits, uint32_t first, uint32_t last)
+{
+    uint32_t w = first >> 6, lw = last >> 6, n;
+    uint64_t m = ~0ULL << (first & 63), lm = ~0ULL >> (63 - (last & 63));
+    if (w == lw)
+        return __kh_b_popcount64(bits[w] & m & lm);
+    n = __kh_b_popcount64(bits[w] & m) + __kh_b_popcount64(bits[lw] & lm);
+    while (++w < lw)
+        n += __kh_b_popcount64(bits[w]);
+    return n;
+}
+
+static kh_inline uint32_t __kh_b_popcount(const uint64_t *bits)
+{
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < __KH_B_WORDS; ++i)
+        n += __kh_b_popcount64(bits[i]);
+    return n;
+}
+
+/* Number of runs of set bits: the bits set whose lower neighbour is clear */
+static kh_inline uint32_t __kh_b_count_runs(const uint64_t *bits)
+{
+    uint32_t n = 0;
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < __KH_B_WORDS; ++i)
+    {
+        n += __kh_b_popcount64(bits[i] & ~(bits[i] << 1 | carry));
+        carry = bits[i] >> 63;
+    }
+    return n;
+}
+
+/* Word loops over whole bitmaps; restrict lets compilers vectorise them */
+static kh_inline void __kh_b_or_words(uint64_t *restrict d, const uint64_t *restrict s)
+{
+    for (uint32_t i = 0; i < __KH_B_WORDS; ++i)
+        d[i] |= s[i];
+}
+
+static kh_inline void __kh_b_and_words(uint64_t *restrict d, const uint64_t *restrict s)
+{
+    for (uint32_t i = 0; i < __KH_B_WORDS; ++i)
+        d[i] &= s[i];
+}
+
+/* Add the keys of c to bits */
+static kh_inline void __kh_b_or_into(uint64_t *bits, const kh_b_chunk_t *c)
+{
+    if (c->kind == KH_B_BITMAP)
+        __kh_b_or_words(bits, c->bits);
+    else if (c->kind == KH_B_ARRAY)
+        for (uint32_t i = 0; i < c->len; ++i)
+            bits[c->vals[i] >> 6] |= 1ULL << (c->vals[i] & 63);
+    else
+        for (uint32_t i = 0; i < c->len; ++i)
+            __kh_b_mark(bits, c->vals[2 * i], c->vals[2 * i + 1], 1);
+}
+
+/* Keep only the keys of bits that are in c, a bitmap or runs */
+static kh_inline void __kh_b_and_into(uint64_t *bits, const kh_b_chunk_t *c)
+{
+    if (c->kind == KH_B_BITMAP)
+        __kh_b_and_words(bits, c->bits);
+    else
+    {
+        uint32_t next = 0; /* clear the gaps between runs */
+        for (uint32_t i = 0; i < c->len; next = c->vals[2 * i + 1] + 1U, ++i)
+            if (c->vals[2 * i] > next)
+                __kh_b_mark(bits, next, c->vals[2 * i] - 1U, 0);
+        if (next < 65536)
+            __kh_b_mark(bits, next, 65535, 0);
+    }
+}
+
+/* The keys of c in a new bitmap; NULL if out of memory */
+static kh_inline uint64_t *__kh_b_bits_of(const kalloc_t *a, const kh_b_chunk_t *c)
+{
+    uint64_t *bits = (uint64_t *)kalloc_calloc(a, __KH_B_WORDS * sizeof(uint64_t));
+    if (bits)
+        __kh_b_or_into(bits, c);
+    return bits;
+}
+
+/* Make c the cheapest container of the n keys of bits, a bitmap from
+   kalloc_*(a) that c takes over; c stays a bitmap if the other kind cannot
+   be allocated. Never fails. */
+static kh_inline void __kh_b_from_bits(const kalloc_t *a, kh_b_chunk_t *c, uint64_t *bits, uint32_t n)
+{
+    uint32_t runs = __kh_b_count_runs(bits), kind, len, j = 0;
+    if (n <= __KH_B_ARRAY_MAX)
+        kind = 4 * runs <= n ? KH_B_RUNS : KH_B_ARRAY;
+    else
+        kind = runs <= __KH_B_RUNS_MAX / 2 ? KH_B_RUNS : KH_B_BITMAP;
+    c->bits = bits;
+    c->n = n;
+    c->kind = KH_B_BITMAP;
+    c->len = c->cap = 0;
+    if (kind == KH_B_BITMAP)
+        return;
+    len = kind == KH_B_RUNS ? runs : n;
+    uint16_t *v = (uint16_t *)kalloc_malloc(a, (size_t)len * sizeof(uint16_t) * (kind == KH_B_RUNS ? 2 : 1));
+    if (!v)
+        return;
+    for (uint32_t w = 0; w < __KH_B_WORDS; ++w)
+        for (uint64_t b = bits[w]; b; b &= b - 1)
+        {
+            uint32_t x = w << 6 | (uint32_t)__ac_ctz64(b);
+            if (kind == KH_B_ARRAY)
+                v[j++] = (uint16_t)x;
+            else if (j && v[2 * j - 1] + 1U == x)
+                v[2 * j - 1] = (uint16_t)x;
+            else
+                v[2 * j] = v[2 * j + 1] = (uint16_t)x, ++j;
+        }
+    kalloc_free(a, bits, __KH_B_WORDS * sizeof(uint64_t));
+    c->vals = v;
+    c->kind = kind;
+    c->len = c->cap = len;
+}
+
+/* Turn c into a bitmap and then the cheapest kind; c is left as it was if out of memory */
+static kh_inline void __kh_b_convert(const kalloc_t *a, kh_b_chunk_t *c)
+{
+    uint64_t *bits = __kh_b_bits_of(a, c);
+    if (!bits)
+        return;
+    __kh_b_free(a, c);
+    __kh_b_from_bits(a, c, bits, c->n);
+}
+
+/* Add x to c; 1 if it was added, 0 if present, -1 if out of memory */
+static kh_inline int __kh_b_add(const kalloc_t *a, kh_b_chunk_t *c, uint32_t x)
+{
+    uint32_t i;
+    if (c->kind == KH_B_BITMAP)
+    {
+        if (c->bits[x >> 6] >> (x & 63) & 1)
+            return 0;
+        c->bits[x >> 6] |= 1ULL << (x & 63);
+        ++c->n;
+        return 1;
+    }
+    if (c->kind == KH_B_ARRAY)
+    {
+        i = __kh_b_lower(c->vals, c->len, 1, x);
+        if (i < c->len && c->vals[i] == x)
+            return 0;
+        if (c->len == __KH_B_ARRAY_MAX)
+        { /* too many for an array */
+            uint64_t *bits = __kh_b_bits_of(a, c);
+            if (!bits)
+                return -1;
+            bits[x >> 6] |= 1ULL << (x & 63);
+            __kh_b_free(a, c);
+            __kh_b_from_bits(a, c, bits, c->n + 1);
+            return 1;
+        }
+        if (__kh_b_reserve(a, c, c->len + 1) < 0)
+            return -1;
+        memmove(c->vals + i + 1, c->vals + i, (c->len - i) * sizeof(uint16_t));
+        c->vals[i] = (uint16_t)x;
+        ++c->len, ++c->n;
+        return 1;
+    }
+    i = __kh_b_lower(c->vals + 1, c->len, 2, x);
+    if (i < c->len && c->vals[2 * i] <= x)
+        return 0;
+    int after = i > 0 && c->vals[2 * i - 1] + 1U == x, before = i < c->len && c->vals[2 * i] == x + 1;
+    if (after && before)
+    { /* x joins two runs */
+        c->vals[2 * i - 1] = c->vals[2 * i + 1];
+        memmove(c->vals + 2 * i, c->vals + 2 * i + 2, (c->len - i - 1) * 2 * sizeof(uint16_t));
+        --c->len;
+    }
+    else if (after)
+        c->vals[2 * i - 1] = (uint16_t)x;
+    else if (before)
+        c->vals[2 * i] = (uint16_t)x;
+    else
+    {
+        if (__kh_b_reserve(a, c, c->len + 1) < 0)
+            return -1;
+        memmove(c->vals + 2 * i + 2, c->vals + 2 * i, (c->len - i) * 2 * sizeof(uint16_t));
+        c->vals[2 * i] = c->vals[2 * i + 1] = (uint16_t)x;
+        ++c->len;
+    }
+    ++c->n;
+    if (c->len > __KH_B_RUNS_MAX || (c->n <= __KH_B_ARRAY_MAX && 2 * c->len > c->n))
+        __kh_b_convert(a, c); /* runs take more room than an array or a bitmap */
+    return 1;
+}
+
+/* Remove x from c; 1 if it was removed, 0 if absent, -1 if out of memory */
+static kh_inline int __kh_b_remove(const kalloc_t *a, kh_b_chunk_t *c, uint32_t x)
+{
+    uint32_t i;
+    if (c->kind == KH_B_BITMAP)
+    {
+        if (!(c->bits[x >> 6] >> (x & 63) & 1))
+            return 0;
+        c->bits[x >> 6] &= ~(1ULL << (x & 63));
+        if (--c->n && c->n < __KH_B_ARRAY_MAX / 2)
+            __kh_b_from_bits(a, c, c->bits, c->n);
+        return 1;
+    }
+    if (c->kind == KH_B_ARRAY)
+    {
+        i = __kh_b_lower(c->vals, c->len, 1, x);
+        if (i == c->len || c->vals[i] != x)
+            return 0;
+        memmove(c->vals + i, c->vals + i + 1, (c->len - i - 1) * sizeof(uint16_t));
+        --c->len, --c->n;
+        return 1;
+    }
+    i = __kh_b_lower(c->vals + 1, c->len, 2, x);
+    if (i == c->len || c->vals[2 * i] > x)
+        return 0;
+    uint16_t *r = c->vals + 2 * i;
+    if (r[0] == r[1])
+    {
+        memmove(r, r + 2, (c->len - i - 1) * 2 * sizeof(uint16_t));
+        --c->len;
+    }
+    else if (r[0] == x)
+        ++r[0];
+    else if (r[1] == x)
+        --r[1];
+    else
+    { /* x splits its run in two */
+        if (__kh_b_reserve(a, c, c->len + 1) < 0)
+            return -1;
+        r = c->vals + 2 * i;
+        memmove(r + 2, r, (c->len - i) * 2 * sizeof(uint16_t));
+        r[1] = (uint16_t)(x - 1);
+        r[2] = (uint16_t)(x + 1);
+        ++c->len;
+    }
+    --c->n;
+    if (c->n && (c->len > __KH_B_RUNS_MAX || (c->n <= __KH_B_ARRAY_MAX && 2 * c->len > c->n)))
+        __kh_b_convert(a, c);
+    return 1;
+}
+
+/* A copy of c in d; -1 if out of memory */
+static kh_inline int __kh_b_copy(const kalloc_t *a, kh_b_chunk_t *d, const kh_b_chunk_t *c)
+{
+    *d = *c;
+    d->cap = c->len;
+    size_t bytes = __kh_b_bytes(d);
+    if (!(d->vals = (uint16_t *)kalloc_malloc(a, bytes)))
+        return -1;
+    memcpy(d->vals, c->vals, bytes);
+    return 0;
+}
+
+/* The keys of x or y in d; -1 if out of memory */
+static kh_inline int __kh_b_or(const kalloc_t *a, kh_b_chunk_t *d, const kh_b_chunk_t *x, const kh_b_chunk_t *y)
+{
+    if (x->kind == KH_B_ARRAY && y->kind == KH_B_ARRAY && x->len + y->len <= __KH_B_ARRAY_MAX)
+    {
+        uint32_t i = 0, j = 0, n = 0;
+        uint16_t *v = (uint16_t *)kalloc_malloc(a, (size_t)(x->len + y->len) * sizeof(uint16_t));
+        if (!v)
+            return -1;
+        while (i < x->len && j < y->len)
+        {
+            uint16_t p = x->vals[i], q = y->vals[j];
+            v[n++] = p < q ? p : q;
+            i += p <= q;
+            j += q <= p;
+        }
+        while (i < x->len)
+            v[n++] = x->vals[i++];
+        while (j < y->len)
+            v[n++] = y->vals[j++];
+        *d = (kh_b_chunk_t){{v}, n, KH_B_ARRAY, n, x->len + y->len};
+        return 0;
+    }
+    uint64_t *bits = __kh_b_bits_of(a, x);
+    if (!bits)
+        return -1;
+    __kh_b_or_into(bits, y);
+    __kh_b_from_bits(a, d, bits, __kh_b_popcount(bits));
+    return 0;
+}
+
+/* The keys of both x and y in d; 1 if there are some, 0 if none (d is left unset), -1 if out of memory */
+static kh_inline int __kh_b_and(const kalloc_t *a, kh_b_chunk_t *d, const kh_b_chunk_t *x, const kh_b_chunk_t *y)
+{
+    if (y->kind == KH_B_ARRAY && x->kind != KH_B_ARRAY)
+    {
+        const kh_b_chunk_t *t = x;
+        x = y, y = t;
+    }
+    if (x->kind == KH_B_ARRAY)
+    { /* at most the keys of x; merge with an array, look the rest up */
+        uint32_t i = 0, j = 0, n = 0;
+        uint16_t *v = (uint16_t *)kalloc_malloc(a, (size_t)x->len * sizeof(uint16_t));
+        if (!v)
+            return -1;
+        if (y->kind == KH_B_ARRAY)
+            while (i < x->len && j < y->len)
+            {
+                uint16_t p = x->vals[i], q = y->vals[j];
+                if (p == q)
+                    v[n++] = p;
+                i += p <= q;
+                j += q <= p;
+            }
+        else
+            for (; i < x->len; ++i)
+                if (__kh_b_has(y, x->vals[i]))
+                    v[n++] = x->vals[i];
+        if (!n)
+        {
+            kalloc_free(a, v, (size_t)x->len * sizeof(uint16_t));
+            return 0;
+        }
+        *d = (kh_b_chunk_t){{v}, n, KH_B_ARRAY, n, x->len};
+        return 1;
+    }
+    uint64_t *bits = __kh_b_bits_of(a, x);
+    uint32_t n;
+    if (!bits)
+        return -1;
+    __kh_b_and_into(bits, y);
+    if (!(n = __kh_b_popcount(bits)))
+    {
+        kalloc_free(a, bits, __KH_B_WORDS * sizeof(uint64_t));
+        return 0;
+    }
+    __kh_b_from_bits(a, d, bits, n);
+    return 1;
+}
+
+/* Number of keys in both x and y */
+static kh_inline uint32_t __kh_b_and_count(const kh_b_chunk_t *x, const kh_b_chunk_t *y)
+{
+    uint32_t i = 0, j = 0, n = 0;
+    if ((y->kind == KH_B_ARRAY && x->kind != KH_B_ARRAY) || (x->kind == KH_B_BITMAP && y->kind == KH_B_RUNS))
+    {
+        const kh_b_chunk_t *t = x;
+        x = y, y = t;
+    }
+    if (x->kind == KH_B_ARRAY && y->kind == KH_B_ARRAY)
+        while (i < x->len && j < y->len)
+        {
+            uint16_t p = x->vals[i], q = y->vals[j];
+            n += p == q;
+            i += p <= q;
+            j += q <= p;
+        }
+    else if (x->kind == KH_B_ARRAY)
+        for (; i < x->len; ++i)
+            n += __kh_b_has(y, x->vals[i]);
+    else if (x->kind == KH_B_BITMAP) /* and y too */
+        for (; i < __KH_B_WORDS; ++i)
+            n += __kh_b_popcount64(x->bits[i] & y->bits[i]);
+    else if (y->kind == KH_B_BITMAP)
+        for (; i < x->len; ++i)
+            n += __kh_b_count_range(y->bits, x->vals[2 * i], x->vals[2 * i + 1]);
+    else
+        while (i < x->len && j < y->len)
+        { /* overlaps of two lists of runs */
+            uint32_t lo = x->vals[2 * i] > y->vals[2 * j] ? x->vals[2 * i] : y->vals[2 * j];
+            uint32_t hi = x->vals[2 * i + 1] < y->vals[2 * j + 1] ? x->vals[2 * i + 1] : y->vals[2 * j + 1];
+            if (lo <= hi)
+                n += hi - lo + 1;
+            if (x->vals[2 * i + 1] <= y->vals[2 * j + 1])
+                ++i;
+            else
+                ++j;
+        }
+    return n;
+}
+
+/*! @function
+  @abstract     Create an empty set with its own allocator.
+  @param  a     Allocator, which must outlive the set; NULL for the default [const kalloc_t*]
+  @return       The set, or NULL if out of memory [kh_bitset_t*]
+ */
+static kh_inline kh_bitset_t *kh_b_init_with_alloc(const kalloc_t *a)
+{
+    kh_bitset_t *s = (kh_bitset_t *)kalloc_malloc(a, sizeof(kh_bitset_t));
+    if (!s)
+        return NULL;
+    s->size = 0;
+    s->alloc = a;
+    if (!(s->dir = kh_init_with_alloc(__kh_b_dir, a)))
+    {
+        kalloc_free(a, s, sizeof(kh_bitset_t));
+        return NULL;
+    }
+    return s;
+}
+
+/*! @function
+  @abstract     Create an empty set.
+  @return       The set, or NULL if out of memory [kh_bitset_t*]
+ */
+static kh_inline kh_bitset_t *kh_b_init(void)
+{
+    return kh_b_init_with_alloc(NULL);
+}
+
+/*! @function
+  @abstract     Remove all the keys of a set, keeping its directory.
+  @param  s     Pointer to the set [kh_bitset_t*]
+ */
+static kh_inline void kh_b_clear(kh_bitset_t *s)
+{
+    for (khint_t k = kh_begin(s->dir); k != kh_end(s->dir); ++k)
+        if (kh_exist(s->dir, k))
+            __kh_b_free(s->alloc, &kh_val(s->dir, k));
+    kh_clear(__kh_b_dir, s->dir);
+    s->size = 0;
+}
+
+/*! @function
+  @abstract     Free a set and all its containers.
+  @param  s     Pointer to the set, or NULL [kh_bitset_t*]
+ */
+static kh_inline void kh_b_destroy(kh_bitset_t *s)
+{
+    if (!s)
+        return;
+    kh_b_clear(s);
+    kh_destroy(__kh_b_dir, s->dir);
+    kalloc_free(s->alloc, s, sizeof(kh_bitset_t));
+}
+
+/*! @function
+  @abstract     Add a key to a set.
+  @param  s     Pointer to the set [kh_bitset_t*]
+  @param  key   Key [khint32_t]
+  @param  ret   If not NULL, receives the return value [int*]
+  @return       1 if the key was added, 0 if it was present, -1 if out of
+                memory, in which case the set is unchanged [int]
+ */
+static kh_inline int kh_b_put(kh_bitset_t *s, khint32_t key, int *ret)
+{
+    int absent, r = -1;
+    khint_t k = kh_put(__kh_b_dir, s->dir, (uint32_t)key >> 16, &absent);
+    if (absent >= 0)
+    {
+        kh_b_chunk_t *c = &kh_val(s->dir, k);
+        if (absent)
+            *c = (kh_b_chunk_t){{NULL}, 0, KH_B_ARRAY, 0, 0};
+        r = __kh_b_add(s->alloc, c, key & 0xffff);
+        if (r < 0 && absent)
+            kh_del(__kh_b_dir, s->dir, k);
+        s->size += r > 0;
+    }
+    if (ret)
+        *ret = r;
+    return r;
+}
+
+/*! @function
+  @abstract     Test whether a key is in a set.
+  @param  s     Pointer to the set [const kh_bitset_t*]
+  @param  key   Key [khint32_t]
+  @return       1 if the key is in the set, 0 if not [int]
+  @discussion   Unlike kh_get(), there is no bucket to return: keys of a
+                bitmap or of a run have no place of their own.
+ */
+static kh_inline int kh_b_get(const kh_bitset_t *s, khint32_t key)
+{
+    khint_t k = kh_get(__kh_b_dir, s->dir, (uint32_t)key >> 16);
+    return k != kh_end(s->dir) && __kh_b_has(&kh_val(s->dir, k), key & 0xffff);
+}
+
+/*! @function
+  @abstract     Remove a key from a set.
+  @param  s     Pointer to the set [kh_bitset_t*]
+  @param  key   Key [khint32_t]
+  @return       1 if the key was removed, 0 if it was absent, -1 if out of
+                memory, which only splitting a run needs [int]
+ */
+static kh_inline int kh_b_del(kh_bitset_t *s, khint32_t key)
+{
+    khint_t k = kh_get(__kh_b_dir, s->dir, (uint32_t)key >> 16);
+    if (k == kh_end(s->dir))
+        return 0;
+    kh_b_chunk_t *c = &kh_val(s->dir, k);
+    int r = __kh_b_remove(s->alloc, c, key & 0xffff);
+    if (r > 0)
+    {
+        --s->size;
+        if (!c->n)
+        {
+            __kh_b_free(s->alloc, c);
+            kh_del(__kh_b_dir, s->dir, k);
+        }
+    }
+    return r;
+}
+
+/*! @function
+  @abstract     Get the number of keys in a set.
+  @param  s     Pointer to the set [const kh_bitset_t*]
+  @return       Number of keys [size_t]
+ */
+#define kh_b_size(s) ((s)->size)
+
+/*! @function
+  @abstract     Step through the keys of a set.
+  @param  s     Pointer to the set [const kh_bitset_t*]
+  @param  it    Position, which starts as {0} [kh_b_iter_t*]
+  @param  key   Receives the next key [khint32_t*]
+  @return       1 if there was a next key, 0 at the end [int]
+  @discussion   The set must not change while it is being stepped through.
+ */
+static kh_inline int kh_b_next(const kh_bitset_t *s, kh_b_iter_t *it, khint32_t *key)
+{
+    for (; it->k < kh_end(s->dir); ++it->k, it->i = it->v = 0)
+    {
+        if (!kh_exist(s->dir, it->k))
+            continue;
+        const kh_b_chunk_t *c = &kh_val(s->dir, it->k);
+        uint32_t hi = (uint32_t)kh_key(s->dir, it->k) << 16;
+        if (c->kind == KH_B_ARRAY && it->i < c->len)
+        {
+            *key = (khint32_t)(hi | c->vals[it->i++]);
+            return 1;
+        }
+        if (c->kind == KH_B_RUNS && it->i < c->len)
+        {
+            uint32_t x = c->vals[2 * it->i] + it->v++;
+            if (x == c->vals[2 * it->i + 1])
+                ++it->i, it->v = 0;
+            *key = (khint32_t)(hi | x);
+            return 1;
+        }
+        for (; c->kind == KH_B_BITMAP && it->i < 65536; it->i = (it->i | 63) + 1)
+        {
+            uint64_t b = c->bits[it->i >> 6] >> (it->i & 63);
+            if (b)
+            {
+                it->i += (uint32_t)__ac_ctz64(b);
+                *key = (khint32_t)(hi | it->i++);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*! @function
+  @abstract     Iterate over the keys of a set.
+  @param  s     Pointer to the set [const kh_bitset_t*]
+  @param  kvar  Variable to which key will be assigned
+  @param  code  Block of code to execute
+ */
+#define kh_b_foreach(s, kvar, code)         \
+    {                                       \
+        kh_b_iter_t __it = {0, 0, 0};       \
+        khint32_t __key;                    \
+        while (kh_b_next(s, &__it, &__key)) \
+        {                                   \
+            (kvar) = __key;                 \
+            code;                           \
+        }                                   \
+    }
+
+/* Give s the container c of chunk hi; c is released if out of memory */
+static kh_inline int __kh_b_attach(kh_bitset_t *s, khint32_t hi, kh_b_chunk_t *c)
+{
+    int absent;
+    khint_t k = kh_put(__kh_b_dir, s->dir, hi, &absent);
+    if (absent < 0)
+    {
+        __kh_b_free(s->alloc, c);
+        return -1;
+    }
+    kh_val(s->dir, k) = *c;
+    s->size += c->n;
+    return 0;
+}
+
+/*! @function
+  @abstract     Get the keys that are in either of two sets.
+  @param  a     Pointer to a set [const kh_bitset_t*]
+  @param  b     Pointer to another set [const kh_bitset_t*]
+  @return       A new set, with the allocator of a, or NULL if out of memory [kh_bitset_t*]
+ */
+static kh_inline kh_bitset_t *kh_b_union(const kh_bitset_t *a, const kh_bitset_t *b)
+{
+    kh_bitset_t *s = kh_b_init_with_alloc(a->alloc);
+    if (!s || kh_resize(__kh_b_dir, s->dir, kh_size(a->dir) + kh_size(b->dir)) < 0)
+        goto fail;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const kh_bitset_t *x = pass ? b : a, *y = pass ? a : b;
+        for (khint_t k = kh_begin(x->dir); k != kh_end(x->dir); ++k)
+        {
+            if (!kh_exist(x->dir, k))
+                continue;
+            khint32_t hi = kh_key(x->dir, k);
+            khint_t ky = kh_get(__kh_b_dir, y->dir, hi);
+            kh_b_chunk_t c;
+            if (pass && ky != kh_end(y->dir))
+                continue; /* done in the first pass */
+            if ((ky == kh_end(y->dir) ? __kh_b_copy(s->alloc, &c, &kh_val(x->dir, k))
+                                      : __kh_b_or(s->alloc, &c, &kh_val(x->dir, k), &kh_val(y->dir, ky))) < 0 ||
+                __kh_b_attach(s, hi, &c) < 0)
+                goto fail;
+        }
+    }
+    return s;
+fail:
+    kh_b_destroy(s);
+    return NULL;
+}
+
+/*! @function
+  @abstract     Get the keys that are in both of two sets.
+  @param  a     Pointer to a set [const kh_bitset_t*]
+  @param  b     Pointer to another set [const kh_bitset_t*]
+  @return       A new set, with the allocator of a, or NULL if out of memory [kh_bitset_t*]
+ */
+static kh_inline kh_bitset_t *kh_b_intersect(const kh_bitset_t *a, const kh_bitset_t *b)
+{
+    kh_bitset_t *s = kh_b_init_with_alloc(a->alloc);
+    const kh_bitset_t *x = kh_size(a->dir) <= kh_size(b->dir) ? a : b, *y = x == a ? b : a;
+    if (!s)
+        return NULL;
+    for (khint_t k = kh_begin(x->dir); k != kh_end(x->dir); ++k)
+    {
+        if (!kh_exist(x->dir, k))
+            continue;
+        khint32_t hi = kh_key(x->dir, k);
+        khint_t ky = kh_get(__kh_b_dir, y->dir, hi);
+        kh_b_chunk_t c;
+        int r;
+        if (ky == kh_end(y->dir))
+            continue;
+        if ((r = __kh_b_and(s->alloc, &c, &kh_val(x->dir, k), &kh_val(y->dir, ky))) < 0 ||
+            (r > 0 && __kh_b_attach(s, hi, &c) < 0))
+        {
+            kh_b_destroy(s);
+            return NULL;
+        }
+    }
+    return s;
+}
+
+/*! @function
+  @abstract     Count the keys that are in both of two sets.
+  @param  a     Pointer to a set [const kh_bitset_t*]
+  @param  b     Pointer to another set [const kh_bitset_t*]
+  @return       kh_b_size() of kh_b_intersect(a, b), without building it [size_t]
+ */
+static kh_inline size_t kh_b_intersect_size(const kh_bitset_t *a, const kh_bitset_t *b)
+{
+    const kh_bitset_t *x = kh_size(a->dir) <= kh_size(b->dir) ? a : b, *y = x == a ? b : a;
+    size_t n = 0;
+    for (khint_t k = kh_begin(x->dir); k != kh_end(x->dir); ++k)
+    {
+        if (!kh_exist(x->dir, k))
+            continue;
+        khint_t ky = kh_get(__kh_b_dir, y->dir, kh_key(x->dir, k));
+        if (ky != kh_end(y->dir))
+            n += __kh_b_and_count(&kh_val(x->dir, k), &kh_val(y->dir, ky));
+    }
+    return n;
+}
+
+/*! @function
+  @abstract     Count the keys that are in either of two sets.
+  @param  a     Pointer to a set [const kh_bitset_t*]
+  @param  b     Pointer to another set [const kh_bitset_t*]
+  @return       kh_b_size() of kh_b_union(a, b), without building it [size_t]
+ */
+#define kh_b_union_size(a, b) (kh_b_size(a) + kh_b_size(b) - kh_b_intersect_size(a, b))
+
+/*! @function
+  @abstract     Store every chunk of a set in its cheapest container.
+  @param  s     Pointer to the set [kh_bitset_t*]
+  @discussion   Turns arrays and bitmaps whose keys form few runs into runs,
+                bitmaps that fit in an array into arrays, and gives back the
+                spare room of arrays and runs. Containers that cannot be
+                moved for want of memory stay as they are.
+ */
+static kh_inline void kh_b_compact(kh_bitset_t *s)
+{
+    for (khint_t k = kh_begin(s->dir); k != kh_end(s->dir); ++k)
+    {
+        if (!kh_exist(s->dir, k))
+            continue;
+        kh_b_chunk_t *c = &kh_val(s->dir, k);
+        uint32_t runs = 1;
+        if (c->kind == KH_B_ARRAY)
+            for (uint32_t i = 1; i < c->len; ++i)
+                runs += c->vals[i] != c->vals[i - 1] + 1U;
+        if (c->kind == KH_B_BITMAP)
+            __kh_b_from_bits(s->alloc, c, c->bits, c->n);
+        else if (c->kind == KH_B_ARRAY && 4 * runs <= c->n)
+            __kh_b_convert(s->alloc, c);
+        else if (c->cap > c->len)
+        {
+            size_t unit = sizeof(uint16_t) * (c->kind == KH_B_RUNS ? 2 : 1);
+            uint16_t *v = (uint16_t *)kalloc_realloc(s->alloc, c->vals, c->cap * unit, c->len * unit);
+            if (v)
+                c->vals = v, c->cap = c->len;
+        }
+    }
+}
+
+/*! @function
+  @abstract     Get the bytes a set holds.
+  @param  s     Pointer to the set [const kh_bitset_t*]
+  @return       Bytes of containers in use and their spare room; the set and
+                its directory count as bookkeeping [kmem_usage_t]
+ */
+static kh_inline kmem_usage_t kh_b_memory_usage(const kh_bitset_t *s)
+{
+    kmem_usage_t u = kh_memory_usage(__kh_b_dir, s->dir);
+    u.overhead += u.live + u.slack + u.tombstones + sizeof(kh_bitset_t);
+    u.live = u.slack = u.tombstones = 0;
+    for (khint_t k = kh_begin(s->dir); k != kh_end(s->dir); ++k)
+    {
+        if (!kh_exist(s->dir, k))
+            continue;
+        const kh_b_chunk_t *c = &kh_val(s->dir, k);
+        size_t unit = sizeof(uint16_t) * (c->kind == KH_B_RUNS ? 2 : 1);
+        if (c->kind == KH_B_BITMAP)
+            u.live += __kh_b_bytes(c);
+        else
+            u.live += c->len * unit, u.slack += (c->cap - c->len) * unit;
+    }
+    return u;
+}
+
+#endif /* __AC_KHASH_BITSET_H */
@@ -0,0 +1,725 @@
+/*
+  Concurrent hash tables built on khash.h.
+
+  KHASH_CONCURRENT_INIT() declares a read-mostly map shared by many threads.
+  Readers never lock and never issue an atomic read-modify-write: each bucket
+  carries a sequence word that writers bump around every change, and readers
+  validate the key/value they copied against it (a per-bucket seqlock).
+  Writers are serialized by a mutex. A resize builds a new bucket array and
+  publishes it with a single pointer store; the old array is freed once every
+  registered reader has left the epoch in which it could still see it.
+
+  An example:
+
+#include "khash_concurrent.h"
+KHASH_CONCURRENT_INIT(m64, khint64_t, double, kh_int64_hash_func, kh_int64_hash_equal)
+void reader(khash_c_t(m64) *h) {
+    int r = kh_c_register(m64, h); // once per reader thread
+    double v;
+    if (kh_c_get(m64, h, r, 42, &v)) use(v);
+}
+void writer(khash_c_t(m64) *h) {
+    kh_c_put(m64, h, 42, 1.5);
+    kh_c_del(m64, h, 7);
+}
+
+  Keys and values are copied in and out, so they should be plain data. A
+  reader copies a bucket while a writer may be changing it and throws the
+  copy away if the sequence word moved. So that this is not a data race,
+  buckets hold their keys and values as machine words that are only read
+  and written with relaxed atomic accesses, one per word.
+
+  KHASH_SHARDED_INIT() declares a write-heavy table split over 2^bits plain
+  khash tables. The top bits of a remix of the hash pick the shard, which
+  leaves the shard tables the whole hash for their buckets and KH_SWISS
+  tags; every shard has its own spinlock and grows on its own, so writers
+  to different shards do not contend.
+
+KHASH_SHARDED_INIT(s64, khint64_t, int, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+    khash_s_t(s64) *h = kh_s_init(s64, 6); // 64 shards
+    kh_s_put(s64, h, 42, 1); // from any thread
+ */
+
+#ifndef __AC_KHASH_CONCURRENT_H
+#define __AC_KHASH_CONCURRENT_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "khash.h"
+
+/* Maximum number of reader threads registered on one table */
+#ifndef KH_C_MAX_READERS
+#define KH_C_MAX_READERS 128
+#endif
+
+#if defined(__SSE2__)
+#define kh_cpu_relax() _mm_pause()
+#else
+#define kh_cpu_relax() ((void)0)
+#endif
+
+/* Bucket sequence words: low two bits are the state, bit 2 is set while a
+   writer is changing the bucket, and the rest counts changes. */
+#define __ac_C_EMPTY 0U
+#define __ac_C_LIVE 1U
+#define __ac_C_DEL 2U
+#define __ac_C_BUSY 4U
+#define __ac_C_STEP 8U
+
+/* Words per bucket holding a T; keys and values are copied in and out of
+   them a word at a time, so readers may copy a bucket a writer is changing */
+#define __ac_c_words(T) ((sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t))
+
+static kh_inline void __ac_c_store(atomic_uintptr_t *w, const void *p, size_t n)
+{
+    for (size_t i = 0; i < n; i += sizeof(uintptr_t))
+    {
+        uintptr_t x = 0;
+        memcpy(&x, (const char *)p + i, n - i < sizeof(x) ? n - i : sizeof(x));
+        atomic_store_explicit(w++, x, memory_order_relaxed);
+    }
+}
+
+static kh_inline void __ac_c_load(atomic_uintptr_t *w, void *p, size_t n)
+{
+    for (size_t i = 0; i < n; i += sizeof(uintptr_t))
+    {
+        uintptr_t x = atomic_load_explicit(w++, memory_order_relaxed);
+        memcpy((char *)p + i, &x, n - i < sizeof(x) ? n - i : sizeof(x));
+    }
+}
+
+/* Reader registry of a table; one cache line per reader */
+typedef struct
+{
+    _Alignas(64) _Atomic uint64_t active; /* epoch the reader entered, 0 when outside */
+} kh_c_reader_t;
+
+typedef struct
+{
+    _Atomic uint64_t epoch;
+    _Atomic int n_readers;
+    kh_c_reader_t readers[KH_C_MAX_READERS];
+} kh_c_epoch_t;
+
+static kh_inline void __ac_c_enter(kh_c_epoch_t *e, int r)
+{ /* the seq_cst store orders the announcement before the table pointer load */
+    atomic_store(&e->readers[r].active, atomic_load_explicit(&e->epoch, memory_order_relaxed));
+}
+
+static kh_inline void __ac_c_leave(kh_c_epoch_t *e, int r)
+{
+    atomic_store_explicit(&e->readers[r].active, 0, memory_order_release);
+}
+
+/* Wait until no reader can still hold a pointer loaded before the last publish */
+static kh_inline void __ac_c_synchronize(kh_c_epoch_t *e)
+{
+    uint64_t now = atomic_fetch_add(&e->epoch, 1) + 1;
+    int n = atomic_load(&e->n_readers);
+    for (int r = 0; r < n; ++r)
+    {
+        uint64_t a;
+        while ((a = atomic_load(&e->readers[r].active)) != 0 && a < now)
+            sched_yield();
+    }
+}
+
+#define __KHASH_C_TYPE(name, khkey_t, khval_t)                                     \
+    typedef struct kh_c_##name##_tab_s                                             \
+    {                                                                              \
+        khint_t n_buckets;                                                         \
+        _Atomic uint32_t *seq;                                                     \
+        atomic_uintptr_t *keys; /* __ac_c_words(khkey_t) per bucket */             \
+        atomic_uintptr_t *vals; /* __ac_c_words(khval_t) per bucket */             \
+    } kh_c_##name##_tab_t;                                                         \
+    typedef struct kh_c_##name##_s                                                 \
+    {                                                                              \
+        _Atomic(kh_c_##name##_tab_t *) tab;                                        \
+        _Atomic khint_t size;                                                      \
+        khint_t n_occupied, upper_bound; /* only touched under lock */             \
+        pthread_mutex_t lock;                                                      \
+        kh_c_epoch_t epoch;                                                        \
+    } kh_c_##name##_t;
+
+#define __KHASH_C_IMPL(name, SCOPE, khkey_t, khval_t, __hash_func, __hash_equal)                      \
+    static kh_inline klib_unused kh_c_##name##_tab_t *__kh_c_tab_alloc_##name(khint_t n_buckets)      \
+    {                                                                                                 \
+        kh_c_##name##_tab_t *t = (kh_c_##name##_tab_t *)kcalloc(1, sizeof(kh_c_##name##_tab_t));      \
+        if (!t)                                                                                       \
+            return NULL;                                                                              \
+        t->n_buckets = n_buckets;                                                                     \
+        t->seq = (_Atomic uint32_t *)kcalloc(n_buckets, sizeof(_Atomic uint32_t));                    \
+        t->keys = (atomic_uintptr_t *)kmalloc(n_buckets * __ac_c_words(khkey_t) * sizeof(uintptr_t)); \
+        t->vals = (atomic_uintptr_t *)kmalloc(n_buckets * __ac_c_words(khval_t) * sizeof(uintptr_t)); \
+        if (!t->seq || !t->keys || !t->vals)                                                          \
+        {                                                                                             \
+            kfree((void *)t->seq);                                                                    \
+            kfree((void *)t->keys);                                                                   \
+            kfree((void *)t->vals);                                                                   \
+            kfree(t);                                                                                 \
+            return NULL;                                                                              \
+        }                                                                                             \
+        return t;                                                                                     \
+    }                                                                                                 \
+    static kh_inline klib_unused void __kh_c_tab_free_##name(kh_c_##name##_tab_t *t)                  \
+    {                                                                                                 \
+        if (t)                                                                                        \
+        {                                                                                             \
+            kfree((void *)t->seq);                                                                    \
+            kfree((void *)t->keys);                                                                   \
+            kfree((void *)t->vals);                                                                   \
+            kfree(t);                                                                                 \
+        }                                                                                             \
+    }                                                                                                 \
+    static kh_inline klib_unused khkey_t __kh_c_key_##name(kh_c_##name##_tab_t *t, khint_t i)         \
+    {                                                                                                 \
+        khkey_t key;                                                                                  \
+        __ac_c_load(t->keys + (size_t)i * __ac_c_words(khkey_t), &key, sizeof(khkey_t));              \
+        return key;                                                                                   \
+    }                                                                                                 \
+    static kh_inline klib_unused khval_t __kh_c_val_##name(kh_c_##name##_tab_t *t, khint_t i)         \
+    {                                                                                                 \
+        khval_t val;                                                                                  \
+        __ac_c_load(t->vals + (size_t)i * __ac_c_words(khval_t), &val, sizeof(khval_t));              \
+        return val;                                                                                   \
+    }                                                                                                 \
+    /* Change bucket i under its sequence word; only called with the lock held */                     \
+    static kh_inline klib_unused void __kh_c_write_##name(kh_c_##name##_tab_t *t, khint_t i,          \
+                                                          const khkey_t *key, const khval_t *val,     \
+                                                          uint32_t state)                             \
+    {                                                                                                 \
+        uint32_t s = atomic_load_explicit(&t->seq[i], memory_order_relaxed);                          \
+        atomic_store_explicit(&t->seq[i], s | __ac_C_BUSY, memory_order_relaxed);                     \
+        atomic_thread_fence(memory_order_release);                                                    \
+        if (key)                                                                                      \
+            __ac_c_store(t->keys + (size_t)i * __ac_c_words(khkey_t), key, sizeof(khkey_t));          \
+        if (val)                                                                                      \
+            __ac_c_store(t->vals + (size_t)i * __ac_c_words(khval_t), val, sizeof(khval_t));          \
+        atomic_store_explicit(&t->seq[i], ((s & ~3U) + __ac_C_STEP) | state, memory_order_release);   \
+    }                                                                                                 \
+    SCOPE kh_c_##name##_t *kh_c_init_##name(void)                                                     \
+    {                                                                                                 \
+        kh_c_##name##_t *h = (kh_c_##name##_t *)aligned_alloc(64, sizeof(kh_c_##name##_t));           \
+        if (!h)                                                                                       \
+            return NULL;                                                                              \
+        memset(h, 0, sizeof(kh_c_##name##_t));                                                        \
+        kh_c_##name##_tab_t *t = __kh_c_tab_alloc_##name(4);                                          \
+        if (!t)                                                                                       \
+        {                                                                                             \
+            free(h);                                                                                  \
+            return NULL;                                                                              \
+        }                                                                                             \
+        atomic_init(&h->tab, t);                                                                      \
+        atomic_init(&h->size, 0);                                                                     \
+        h->upper_bound = __ac_upper_bound(t->n_buckets);                                              \
+        pthread_mutex_init(&h->lock, NULL);                                                           \
+        atomic_init(&h->epoch.epoch, 1);                                                              \
+        return h;                                                                                     \
+    }                                                                                                 \
+    /* No reader or writer may use the table any more */                                              \
+    SCOPE void kh_c_destroy_##name(kh_c_##name##_t *h)                                                \
+    {                                                                                                 \
+        if (h)                                                                                        \
+        {                                                                                             \
+            __kh_c_tab_free_##name(atomic_load(&h->tab));                                             \
+            pthread_mutex_destroy(&h->lock);                                                          \
+            free(h);                                                                                  \
+        }                                                                                             \
+    }                                                                                                 \
+    SCOPE int kh_c_register_##name(kh_c_##name##_t *h)                                                \
+    {                                                                                                 \
+        int r = atomic_fetch_add(&h->epoch.n_readers, 1);                                             \
+        if (r >= KH_C_MAX_READERS)                                                                    \
+        {                                                                                             \
+            atomic_fetch_sub(&h->epoch.n_readers, 1);                                                 \
+            return -1;                                                                                \
+        }                                                                                             \
+        return r;                                                                                     \
+    }                                                                                                 \
+    SCOPE int kh_c_get_##name(kh_c_##name##_t *h, int r, khkey_t key, khval_t *val)                   \
+    {                                                                                                 \
+        khint_t k = __hash_func(key), step = 0;                                                       \
+        int found = 0;                                                                                \
+        __ac_c_enter(&h->epoch, r);                                                                   \
+        kh_c_##name##_tab_t *t = atomic_load(&h->tab);                                                \
+        khint_t mask = t->n_buckets - 1, i = k & mask;                                                \
+        while (1)                                                                                     \
+        {                                                                                             \
+            uint32_t s = atomic_load_explicit(&t->seq[i], memory_order_acquire);                      \
+            if (s & __ac_C_BUSY)                                                                      \
+            { /* a writer is in this bucket; it leaves after a few stores */                          \
+                kh_cpu_relax();                                                                       \
+                continue;                                                                             \
+            }                                                                                         \
+            if ((s & 3U) == __ac_C_EMPTY)                                                             \
+                break;                                                                                \
+            if ((s & 3U) == __ac_C_LIVE)                                                              \
+            {                                                                                         \
+                khkey_t kcopy = __kh_c_key_##name(t, i);                                              \
+                khval_t vcopy = __kh_c_val_##name(t, i);                                              \
+                atomic_thread_fence(memory_order_acquire);                                            \
+                if (atomic_load_explicit(&t->seq[i], memory_order_relaxed) != s)                      \
+                    continue; /* torn copy, read the bucket again */                                  \
+                if (__hash_equal(kcopy, key))                                                         \
+                {                                                                                     \
+                    *val = vcopy;                                                                     \
+                    found = 1;                                                                        \
+                    break;                                                                            \
+                }                                                                                     \
+            }                                                                                         \
+            i = (i + (++step)) & mask;                                                                \
+            if (step > mask)                                                                          \
+                break;                                                                                \
+        }                                                                                             \
+        __ac_c_leave(&h->epoch, r);                                                                   \
+        return found;                                                                                 \
+    }                                                                                                 \
+    /* Copy the live buckets into a new array and publish it; lock held */                            \
+    static kh_inline klib_unused int __kh_c_resize_##name(kh_c_##name##_t *h, khint_t new_n_buckets)  \
+    {                                                                                                 \
+        kh_c_##name##_tab_t *t = atomic_load_explicit(&h->tab, memory_order_relaxed);                 \
+        __ac_roundup(new_n_buckets);                                                                  \
+        if (new_n_buckets < 4)                                                                        \
+            new_n_buckets = 4;                                                                        \
+        kh_c_##name##_tab_t *nt = __kh_c_tab_alloc_##name(new_n_buckets);                             \
+        if (!nt)                                                                                      \
+            return -1;                                                                                \
+        khint_t mask = new_n_buckets - 1;                                                             \
+        for (khint_t j = 0; j < t->n_buckets; ++j)                                                    \
+        {                                                                                             \
+            if ((atomic_load_explicit(&t->seq[j], memory_order_relaxed) & 3U) != __ac_C_LIVE)         \
+                continue;                                                                             \
+            khkey_t key = __kh_c_key_##name(t, j);                                                    \
+            khval_t val = __kh_c_val_##name(t, j);                                                    \
+            khint_t i = __hash_func(key) & mask, step = 0;                                            \
+            while (atomic_load_explicit(&nt->seq[i], memory_order_relaxed) != __ac_C_EMPTY)           \
+                i = (i + (++step)) & mask;                                                            \
+            __ac_c_store(nt->keys + (size_t)i * __ac_c_words(khkey_t), &key, sizeof(khkey_t));        \
+            __ac_c_store(nt->vals + (size_t)i * __ac_c_words(khval_t), &val, sizeof(khval_t));        \
+            atomic_store_explicit(&nt->seq[i], __ac_C_LIVE, memory_order_relaxed);                    \
+        }                                                                                             \
+        atomic_store(&h->tab, nt); /* readers see the new array from here on */                       \
+        h->n_occupied = atomic_load_explicit(&h->size, memory_order_relaxed);                         \
+        h->upper_bound = __ac_upper_bound(new_n_buckets);                                             \
+        __ac_c_synchronize(&h->epoch);                                                                \
+        __kh_c_tab_free_##name(t);                                                                    \
+        return 0;                                                                                     \
+    }                                                                                                 \
+    SCOPE int kh_c_put_##name(kh_c_##name##_t *h, khkey_t key, khval_t val)                           \
+    {                                                                                                 \
+        int ret;                                                                                      \
+        pthread_mutex_lock(&h->lock);                                                                 \
+        if (h->n_occupied >= h->upper_bound)                                                          \
+        {                                                                                             \
+            khint_t size = atomic_load_explicit(&h->size, memory_order_relaxed);                      \
+            khint_t n = atomic_load_explicit(&h->tab, memory_order_relaxed)->n_buckets;               \
+            if (__kh_c_resize_##name(h, n > (size << 1) ? n - 1 : n + 1) < 0)                         \
+            {                                                                                         \
+                pthread_mutex_unlock(&h->lock);                                                       \
+                return -1;                                                                            \
+            }                                                                                         \
+        }                                                                                             \
+        kh_c_##name##_tab_t *t = atomic_load_explicit(&h->tab, memory_order_relaxed);                 \
+        khint_t mask = t->n_buckets - 1, i = __hash_func(key) & mask, step = 0, site = t->n_buckets;  \
+        while (1)                                                                                     \
+        {                                                                                             \
+            uint32_t st = atomic_load_explicit(&t->seq[i], memory_order_relaxed) & 3U;                \
+            if (st == __ac_C_EMPTY)                                                                   \
+                break;                                                                                \
+            if (st == __ac_C_DEL && site == t->n_buckets)                                             \
+                site = i;                                                                             \
+            if (st == __ac_C_LIVE && __hash_equal(__kh_c_key_##name(t, i), key))                      \
+            { /* present: replace the value */                                                        \
+                __kh_c_write_##name(t, i, NULL, &val, __ac_C_LIVE);                                   \
+                pthread_mutex_unlock(&h->lock);                                                       \
+                return 0;                                                                             \
+            }                                                                                         \
+            i = (i + (++step)) & mask;                                                                \
+        }                                                                                             \
+        if (site != t->n_buckets)                                                                     \
+        { /* reuse a deleted bucket */                                                                \
+            i = site;                                                                                 \
+            ret = 2;                                                                                  \
+        }                                                                                             \
+        else                                                                                          \
+        {                                                                                             \
+            ++h->n_occupied;                                                                          \
+            ret = 1;                                                                                  \
+        }                                                                                             \
+        __kh_c_write_##name(t, i, &key, &val, __ac_C_LIVE);                                           \
+        atomic_fetch_add_explicit(&h->size, 1, memory_order_relaxed);                                 \
+        pthread_mutex_unlock(&h->lock);                                                               \
+        return ret;                                                                                   \
+    }                                                                                                 \
+    SCOPE int kh_c_del_##name(kh_c_##name##_t *h, khkey_t key)                                        \
+    {                                                                                                 \
+        int found = 0;                                                                                \
+        pthread_mutex_lock(&h->lock);                                                                 \
+        kh_c_##name##_tab_t *t = atomic_load_explicit(&h->tab, memory_order_relaxed);                 \
+        khint_t mask = t->n_buckets - 1, i = __hash_func(key) & mask, step = 0;                       \
+        while (step <= mask)                                                                          \
+        {                                                                                             \
+            uint32_t st = atomic_load_explicit(&t->seq[i], memory_order_relaxed) & 3U;                \
+            if (st == __ac_C_EMPTY)                                                                   \
+                break;                                                                                \
+            if (st == __ac_C_LIVE && __hash_equal(__kh_c_key_##name(t, i), key))                      \
+            {                                                                                         \
+                __kh_c_write_##name(t, i, NULL, NULL, __ac_C_DEL);                                    \
+                atomic_fetch_sub_explicit(&h->size, 1, memory_order_relaxed);                         \
+                found = 1;                                                                            \
+                break;                                                                                \
+            }                                                                                         \
+            i = (i + (++step)) & mask;                                                                \
+        }                                                                                             \
+        pthread_mutex_unlock(&h->lock);                                                               \
+        return found;                                                                                 \
+    }
+
+/*! @function
+  @abstract     Instantiate a concurrent read-mostly hash map
+  @param  name  Name of the hash table [symbol]
+  @param  khkey_t  Type of keys [type]
+  @param  khval_t  Type of values [type]
+  @param  __hash_func  Hash function, as for KHASH_INIT()
+  @param  __hash_equal  Comparison function, as for KHASH_INIT()
+ */
+#define KHASH_CONCURRENT_INIT(name, khkey_t, khval_t, __hash_func, __hash_equal) \
+    __KHASH_C_TYPE(name, khkey_t, khval_t)                                       \
+    __KHASH_C_IMPL(name, static kh_inline klib_unused, khkey_t, khval_t, __hash_func, __hash_equal)
+
+/*!
+  @abstract Type of the concurrent hash table.
+  @param  name  Name of the hash table [symbol]
+ */
+#define khash_c_t(name) kh_c_##name##_t
+
+/*! @function
+  @abstract     Initiate a concurrent hash table.
+  @param  name  Name of the hash table [symbol]
+  @return       Pointer to the hash table [khash_c_t(name)*]
+ */
+#define kh_c_init(name) kh_c_init_##name()
+
+/*! @function
+  @abstract     Destroy a concurrent hash table; no thread may still use it.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_c_t(name)*]
+ */
+#define kh_c_destroy(name, h) kh_c_destroy_##name(h)
+
+/*! @function
+  @abstract     Register the calling thread as a reader.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_c_t(name)*]
+  @return       Reader slot for kh_c_get(), or -1 if KH_C_MAX_READERS are taken [int]
+ */
+#define kh_c_register(name, h) kh_c_register_##name(h)
+
+/*! @function
+  @abstract     Look up a key without taking a lock.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_c_t(name)*]
+  @param  r     Slot from kh_c_register(), used by one thread at a time [int]
+  @param  k     Key [type of keys]
+  @param  v     Receives a copy of the value if the key is present [type of values*]
+  @return       1 if the key is present; 0 otherwise [int]
+ */
+#define kh_c_get(name, h, r, k, v) kh_c_get_##name(h, r, k, v)
+
+/*! @function
+  @abstract     Insert a key or replace its value.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_c_t(name)*]
+  @param  k     Key [type of keys]
+  @param  v     Value [type of values]
+  @return       -1 if the table could not grow; 0 if the key was present;
+                1 or 2 if it was added, as for kh_put() [int]
+ */
+#define kh_c_put(name, h, k, v) kh_c_put_##name(h, k, v)
+
+/*! @function
+  @abstract     Remove a key.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_c_t(name)*]
+  @param  k     Key [type of keys]
+  @return       1 if the key was present; 0 otherwise [int]
+ */
+#define kh_c_del(name, h, k) kh_c_del_##name(h, k)
+
+/*! @function
+  @abstract     Get the number of elements in a concurrent hash table
+  @param  h     Pointer to the hash table [khash_c_t(name)*]
+  @return       Number of elements [khint_t]
+ */
+#define kh_c_size(h) atomic_load_explicit(&(h)->size, memory_order_relaxed)
+
+/* Shard locks: test-and-test-and-set, yielding when the holder was preempted */
+static kh_inline void __ac_s_lock(atomic_int *l)
+{
+    int spins = 0;
+    while (atomic_exchange_explicit(l, 1, memory_order_acquire))
+    {
+        while (atomic_load_explicit(l, memory_order_relaxed))
+        {
+            if (++spins < 64)
+                kh_cpu_relax();
+            else
+                sched_yield();
+        }
+    }
+}
+
+static kh_inline void __ac_s_unlock(atomic_int *l)
+{
+    atomic_store_explicit(l, 0, memory_order_release);
+}
+
+#define __KHASH_S_TYPE(name)           \
+    typedef struct                     \
+    {                                  \
+        _Alignas(64) atomic_int lock;  \
+        kh_##name##_t *h;              \
+    } kh_s_##name##_shard_t;           \
+    typedef struct kh_s_##name##_s     \
+    {                                  \
+        int bits;                      \
+        kh_s_##name##_shard_t *shards; \
+    } kh_s_##name##_t;
+
+#define __KHASH_S_IMPL(name, SCOPE, khkey_t, khval_t, kh_opts, __hash_func)                                      \
+    /* The top bits of a remix of the hash: the shard tables index buckets with its low bits, and KH_SWISS       \
+       takes its tags from the top ones, so neither may be constant within a shard */                            \
+    static kh_inline klib_unused kh_s_##name##_shard_t *__kh_s_shard_##name(const kh_s_##name##_t *h, khint_t k) \
+    {                                                                                                            \
+        return &h->shards[h->bits ? splittable64((uint64_t)k) >> (64 - h->bits) : 0];                            \
+    }                                                                                                            \
+    SCOPE void kh_s_destroy_##name(kh_s_##name##_t *h)                                                           \
+    {                                                                                                            \
+        if (h)                                                                                                   \
+        {                                                                                                        \
+            for (int s = 0; s < 1 << h->bits; ++s)                                                               \
+                kh_destroy_##name(h->shards[s].h);                                                               \
+            free(h->shards);                                                                                     \
+            kfree(h);                                                                                            \
+        }                                                                                                        \
+    }                                                                                                            \
+    SCOPE kh_s_##name##_t *kh_s_init_##name(int bits)                                                            \
+    {                                                                                                            \
+        if (bits < 0 || bits > 16)                                                                               \
+            return NULL;                                                                                         \
+        kh_s_##name##_t *h = (kh_s_##name##_t *)kcalloc(1, sizeof(kh_s_##name##_t));                             \
+        if (!h)                                                                                                  \
+            return NULL;                                                                                         \
+        h->shards = (kh_s_##name##_shard_t *)aligned_alloc(64, sizeof(kh_s_##name##_shard_t) << bits);           \
+        if (!h->shards)                                                                                          \
+        {                                                                                                        \
+            kfree(h);                                                                                            \
+            return NULL;                                                                                         \
+        }                                                                                                        \
+        memset(h->shards, 0, sizeof(kh_s_##name##_shard_t) << bits);                                             \
+        h->bits = bits;                                                                                          \
+        for (int s = 0; s < 1 << bits; ++s)                                                                      \
+        {                                                                                                        \
+            atomic_init(&h->shards[s].lock, 0);                                                                  \
+            if (!(h->shards[s].h = kh_init_##name()))                                                            \
+            {                                                                                                    \
+                kh_s_destroy_##name(h);                                                                          \
+                return NULL;                                                                                     \
+            }                                                                                                    \
+        }                                                                                                        \
+        return h;                                                                                                \
+    }                                                                                                            \
+    SCOPE int kh_s_get_##name(kh_s_##name##_t *h, khkey_t key, khval_t *val)                                     \
+    {                                                                                                            \
+        khint_t k = __hash_func(key);                                                                            \
+        kh_s_##name##_shard_t *s = __kh_s_shard_##name(h, k);                                                    \
+        __ac_s_lock(&s->lock);                                                                                   \
+        khint_t x = s->h->old ? kh_get_##name(s->h, key) : __kh_get_hashed_##name(s->h, key, k);                 \
+        int found = x != kh_end(s->h);                                                                           \
+        if (found && ((kh_opts) & KH_MAP) && val)                                                                \
+            *val = kh_val(s->h, x);                                                                              \
+        __ac_s_unlock(&s->lock);                                                                                 \
+        return found;                                                                                            \
+    }                                                                                                            \
+    SCOPE int kh_s_put_##name(kh_s_##name##_t *h, khkey_t key, khval_t val)                                      \
+    {                                                                                                            \
+        int ret;                                                                                                 \
+        khint_t k = __hash_func(key);                                                                            \
+        kh_s_##name##_shard_t *s = __kh_s_shard_##name(h, k);                                                    \
+        __ac_s_lock(&s->lock);                                                                                   \
+        khint_t x = __kh_put_hashed_##name(s->h, key, k, &ret);                                                  \
+        if (ret >= 0 && ((kh_opts) & KH_MAP))                                                                    \
+            kh_val(s->h, x) = val;                                                                               \
+        __ac_s_unlock(&s->lock);                                                                                 \
+        return ret;                                                                                              \
+    }                                                                                                            \
+    SCOPE int kh_s_del_##name(kh_s_##name##_t *h, khkey_t key)                                                   \
+    {                                                                                                            \
+        kh_s_##name##_shard_t *s = __kh_s_shard_##name(h, __hash_func(key));                                     \
+        __ac_s_lock(&s->lock);                                                                                   \
+        khint_t x = kh_get_##name(s->h, key);                                                                    \
+        int found = x != kh_end(s->h);                                                                           \
+        if (found)                                                                                               \
+            kh_del_##name(s->h, x);                                                                              \
+        __ac_s_unlock(&s->lock);                                                                                 \
+        return found;                                                                                            \
+    }                                                                                                            \
+    SCOPE khint_t kh_s_size_##name(kh_s_##name##_t *h)                                                           \
+    {                                                                                                            \
+        khint_t n = 0;                                                                                           \
+        for (int s = 0; s < 1 << h->bits; ++s)                                                                   \
+        {                                                                                                        \
+            __ac_s_lock(&h->shards[s].lock);                                                                     \
+            n += kh_size(h->shards[s].h);                                                                        \
+            __ac_s_unlock(&h->shards[s].lock);                                                                   \
+        }                                                                                                        \
+        return n;                                                                                                \
+    }                                                                                                            \
+    /* Pools the per-shard statistics as if all keys lived in one table */                                       \
+    SCOPE kh_probe_stat_t kh_s_probe_stat_##name(kh_s_##name##_t *h)                                             \
+    {                                                                                                            \
+        kh_probe_stat_t stats = {0, 0.0, 0.0};                                                                   \
+        double n = 0.0, sum = 0.0, sum_squares = 0.0;                                                            \
+        for (int s = 0; s < 1 << h->bits; ++s)                                                                   \
+        {                                                                                                        \
+            __ac_s_lock(&h->shards[s].lock);                                                                     \
+            kh_probe_stat_t st = kh_probe_stat_##name(h->shards[s].h);                                           \
+            double m = kh_size(h->shards[s].h);                                                                  \
+            __ac_s_unlock(&h->shards[s].lock);                                                                   \
+            if (st.max_probes > stats.max_probes)                                                                \
+                stats.max_probes = st.max_probes;                                                                \
+            n += m;                                                                                              \
+            sum += st.avg_probes * m;                                                                            \
+            sum_squares += (st.variance + st.avg_probes * st.avg_probes) * m;                                    \
+        }                                                                                                        \
+        if (n > 0)                                                                                               \
+        {                                                                                                        \
+            stats.avg_probes = sum / n;                                                                          \
+            stats.variance = sum_squares / n - stats.avg_probes * stats.avg_probes;                              \
+        }                                                                                                        \
+        return stats;                                                                                            \
+    }                                                                                                            \
+    /* Sums the shards, plus the shard array and the header */                                                   \
+    SCOPE kmem_usage_t kh_s_memory_usage_##name(kh_s_##name##_t *h)                                              \
+    {                                                                                                            \
+        kmem_usage_t u = {0, 0, 0, sizeof(kh_s_##name##_t) + (sizeof(kh_s_##name##_shard_t) << h->bits)};        \
+        for (int s = 0; s < 1 << h->bits; ++s)                                                                   \
+        {                                                                                                        \
+            __ac_s_lock(&h->shards[s].lock);                                                                     \
+            kmem_usage_add(&u, kh_memory_usage_##name(h->shards[s].h));                                          \
+            __ac_s_unlock(&h->shards[s].lock);                                                                   \
+        }                                                                                                        \
+        return u;                                                                                                \
+    }
+
+/*! @function
+  @abstract     Instantiate a sharded hash table for concurrent writers
+  @param  name  Name of the hash table [symbol]
+  @param  khkey_t  Type of keys [type]
+  @param  khval_t  Type of values [type]
+  @param  kh_opts  Options, as for KHASH_INIT() [int]
+  @param  __hash_func  Hash function, as for KHASH_INIT()
+  @param  __hash_equal  Comparison function, as for KHASH_INIT()
+  @discussion   Also instantiates the plain table `name` used for the shards.
+ */
+#define KHASH_SHARDED_INIT(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)         \
+    KHASH_INIT(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)                     \
+    __KHASH_S_TYPE(name)                                                                       \
+    __KHASH_S_IMPL(name, static kh_inline klib_unused, khkey_t, khval_t, kh_opts, __hash_func)
+
+/*!
+  @abstract Type of the sharded hash table.
+  @param  name  Name of the hash table [symbol]
+ */
+#define khash_s_t(name) kh_s_##name##_t
+
+/*! @function
+  @abstract     Initiate a sharded hash table.
+  @param  name  Name of the hash table [symbol]
+  @param  bits  log2 of the number of shards, 0 to 16 [int]
+  @return       Pointer to the hash table, NULL on failure [khash_s_t(name)*]
+ */
+#define kh_s_init(name, bits) kh_s_init_##name(bits)
+
+/*! @function
+  @abstract     Destroy a sharded hash table; no thread may still use it.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+ */
+#define kh_s_destroy(name, h) kh_s_destroy_##name(h)
+
+/*! @function
+  @abstract     Look up a key.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @param  k     Key [type of keys]
+  @param  v     Receives a copy of the value if present; may be NULL [type of values*]
+  @return       1 if the key is present; 0 otherwise [int]
+ */
+#define kh_s_get(name, h, k, v) kh_s_get_##name(h, k, v)
+
+/*! @function
+  @abstract     Insert a key or replace its value.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @param  k     Key [type of keys]
+  @param  v     Value; ignored for sets [type of values]
+  @return       As the ret of kh_put() [int]
+ */
+#define kh_s_put(name, h, k, v) kh_s_put_##name(h, k, v)
+
+/*! @function
+  @abstract     Remove a key.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @param  k     Key [type of keys]
+  @return       1 if the key was present; 0 otherwise [int]
+ */
+#define kh_s_del(name, h, k) kh_s_del_##name(h, k)
+
+/*! @function
+  @abstract     Get the number of elements in a sharded hash table
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @return       Number of elements [khint_t]
+ */
+#define kh_s_size(name, h) kh_s_size_##name(h)
+
+/*! @function
+  @abstract     Probe statistics over all shards
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @return       Statistics as if the shards were one table [kh_probe_stat_t]
+ */
+#define kh_s_probe_stats(name, h) kh_s_probe_stat_##name(h)
+
+/*! @function
+  @abstract     Bytes held by all shards
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @return       Bytes as for kh_memory_usage() [kmem_usage_t]
+ */
+#define kh_s_memory_usage(name, h) kh_s_memory_usage_##name(h)
+
+/*! @function
+  @abstract     Iterate over the entries of all shards
+  @param  h     Pointer to the hash table [khash_s_t(name)*]
+  @param  kvar  Variable to which key will be assigned
+  @param  vvar  Variable to which value will be assigned
+  @param  code  Block of code to execute
+  @discussion   Each shard is locked while it is visited, so code must not call
+                back into the table; `break` only leaves the current shard.
+ */
+#define kh_s_foreach(h, kvar, vvar, code)                     \
+    {                                                         \
+        for (int __s = 0; __s < 1 << (h)->bits; ++__s)        \
+        {                                                     \
+            __ac_s_lock(&(h)->shards[__s].lock);              \
+            kh_foreach((h)->shards[__s].h, kvar, vvar, code); \
+            __ac_s_unlock(&(h)->shards[__s].lock);            \
+        }                                                     \
+    }
+
+#endif /* __AC_KHASH_CONCURRENT_H */
@@ -0,0 +1,539 @@
+/*
+  Frozen hash tables built on khash.h.
+
+  kh_freeze() compiles a populated khash table into an immutable table
+  indexed by a minimal perfect hash function: n keys fill exactly n slots,
+  and a lookup hashes the key, reads one 16-bit displacement and compares
+  the key in the only slot it can be in. Nothing is probed and no slot is
+  left empty, which suits data that is built once and then served
+  read-only for a long time.
+
+  An example:
+
+#include "khash_frozen.h"
+KHASH_MAP_INIT_INT64(m64, double)
+KHASH_FROZEN_MAP_INIT_INT64(f64, m64, double) // frozen copies of m64 tables
+    khash_f_t(f64) *f = kh_freeze(f64, h); // h is left as it was
+    khint_t k = kh_f_get(f64, f, 42);
+    if (k != kh_f_end(f)) use(kh_f_val(f, k));
+    kh_f_save(f64, f, "f64.khf");
+    kh_f_destroy(f64, f);
+    f = kh_f_load(f64, "f64.khf"); // mapped, like kh_load_mmap()
+
+  The hash function follows PTHash (Pibiri and Trani, SIGIR 2021). Keys are
+  spread over about n/3 groups; the groups, largest first, each search for
+  the displacement that sends all of their keys to free slots of a table 1%
+  larger than n, and the used slots past n are then remapped to the slots
+  below n that stayed free. Building takes a few passes over the keys and
+  about 20 bytes of scratch memory per key.
+
+  Keys are hashed to 64 bits by a function of the frozen table, not the one
+  of the source table: splittable64() for integers and kh_wyhash() for
+  strings. A frozen string table copies the strings into a block of its own
+  and stores offsets into it, so it outlives its source table and is saved
+  like any other. Slots 0 to kh_f_end() - 1 all hold a key, so iteration is
+  a plain loop.
+ */
+
+#ifndef __AC_KHASH_FROZEN_H
+#define __AC_KHASH_FROZEN_H
+
+#include "khash_mmap.h"
+
+#define KH_FROZEN_VERSION 1
+#define __KH_F_MAX 0x7ffffffe /* keys of a frozen table; fits khint_t in either width */
+#define __KH_F_PILOTS 65536 /* displacements tried per group */
+
+/* Arrays of a frozen table in the file, in this order */
+enum
+{
+    __KH_F_PILOT,
+    __KH_F_REMAP,
+    __KH_F_KEYS,
+    __KH_F_VALS,
+    __KH_F_STRS,
+    __KH_F_N
+};
+
+/* Start of a file written by kh_f_save(), in the byte order of the host that wrote it */
+typedef struct
+{
+    char magic[8]; /* "KHFROZEN" */
+    uint32_t version; /* KH_FROZEN_VERSION */
+    uint32_t kind; /* 1 for a map, plus 2 for string keys */
+    uint32_t key_size, val_size; /* of a stored key and of a value */
+    uint32_t byte_order; /* 0x01020304 */
+    uint32_t n_slots, n_groups, unused;
+    uint64_t size, seed, strs_size;
+    uint64_t offset[__KH_F_N]; /* of each array from the start of the file; 0 if absent */
+    uint64_t file_size;
+} kh_f_header_t;
+
+/* 64-bit hash functions of the keys of the frozen versions of KHASH_MAP_INIT_INT/INT64/STR */
+static kh_inline uint64_t kh_f_int32_hash64(khint32_t key)
+{
+    return splittable64(key);
+}
+
+static kh_inline uint64_t kh_f_int64_hash64(khint64_t key)
+{
+    return splittable64(key);
+}
+
+static kh_inline uint64_t kh_f_str_hash64(kh_cstr_t s)
+{
+    return kh_wyhash(s, strlen(s), KH_WYHASH_SEED);
+}
+
+/* Fast range reduction: the group of a hash, and the slot of a hash under a displacement */
+static kh_inline uint32_t __kh_f_group(uint64_t h, uint32_t n_groups)
+{
+    return (uint32_t)((h & 0xffffffffU) * n_groups >> 32);
+}
+
+static kh_inline uint32_t __kh_f_slot(uint64_t h, uint32_t pilot, uint32_t n_slots)
+{
+    return (uint32_t)((splittable64(h ^ pilot * 0x9e3779b97f4a7c15ULL) >> 32) * n_slots >> 32);
+}
+
+#define __kh_f_taken(t, p) ((t)[(p) >> 6] >> ((p) & 63) & 1)
+
+/* Find a displacement for every group so that the n keys with hashes hs
+   land in distinct slots, and remap the slots from n up to free slots below
+   n. Returns 1 and the final slot of every key in slot on success; 0 if some
+   group found no displacement, which another seed may fix; -1 if two keys
+   have the same hash or memory ran out. */
+static kh_inline int __kh_f_build(const uint64_t *hs, uint32_t n, uint32_t n_slots, uint32_t n_groups,
+                                  uint16_t *pilots, uint32_t *remap, uint32_t *slot)
+{
+    uint32_t *start = (uint32_t *)kcalloc((size_t)n_groups + 1, sizeof(uint32_t)); /* keys of group g */
+    uint32_t *fill = (uint32_t *)kmalloc((size_t)n_groups * sizeof(uint32_t));
+    uint32_t *order = (uint32_t *)kmalloc((size_t)n * sizeof(uint32_t)); /* keys by group */
+    uint32_t *groups = (uint32_t *)kmalloc((size_t)n_groups * sizeof(uint32_t)); /* groups by size */
+    uint64_t *taken = (uint64_t *)kcalloc(((size_t)n_slots + 63) / 64, sizeof(uint64_t));
+    uint32_t *by_size = NULL, *tmp = NULL, max_size = 0, g, j, k;
+    int ret = -1;
+    if (!start || !fill || !order || !groups || !taken)
+        goto end;
+    for (j = 0; j < n; ++j)
+        ++start[__kh_f_group(hs[j], n_groups) + 1];
+    for (g = 0; g < n_groups; ++g)
+    {
+        if (start[g + 1] > max_size)
+            max_size = start[g + 1];
+        start[g + 1] += start[g];
+        fill[g] = start[g];
+    }
+    for (j = 0; j < n; ++j)
+        order[fill[__kh_f_group(hs[j], n_groups)]++] = j;
+    if (!(by_size = (uint32_t *)kcalloc((size_t)max_size + 2, sizeof(uint32_t))) ||
+        !(tmp = (uint32_t *)kmalloc((size_t)max_size * sizeof(uint32_t))))
+        goto end;
+    for (g = 0; g < n_groups; ++g) /* counting sort, largest groups first */
+        ++by_size[max_size - (start[g + 1] - start[g]) + 1];
+    for (k = 0; k <= max_size; ++k)
+        by_size[k + 1] += by_size[k];
+    for (g = 0; g < n_groups; ++g)
+        groups[by_size[max_size - (start[g + 1] - start[g])]++] = g;
+    for (uint32_t i = 0; i < n_groups; ++i)
+    {
+        const uint32_t *key = order + start[groups[i]];
+        uint32_t size = start[groups[i] + 1] - start[groups[i]], pilot;
+        if (size == 0)
+        { /* only absent keys look here */
+            pilots[groups[i]] = 0;
+            continue;
+        }
+        for (j = 0; j < size; ++j) /* no displacement separates equal hashes */
+            for (k = j + 1; k < size; ++k)
+                if (hs[key[j]] == hs[key[k]])
+                    goto end;
+        for (pilot = 0; pilot < __KH_F_PILOTS; ++pilot)
+        {
+            for (k = 0; k < size; ++k)
+            {
+                uint32_t p = __kh_f_slot(hs[key[k]], pilot, n_slots);
+                if (__kh_f_taken(taken, p))
+                    break;
+                taken[p >> 6] |= 1ULL << (p & 63);
+                tmp[k] = p;
+            }
+            if (k == size)
+                break;
+            while (k--) /* give back the slots of a partial fit */
+                taken[tmp[k] >> 6] &= ~(1ULL << (tmp[k] & 63));
+        }
+        if (pilot == __KH_F_PILOTS)
+        {
+            ret = 0;
+            goto end;
+        }
+        pilots[groups[i]] = (uint16_t)pilot;
+        for (k = 0; k < size; ++k)
+            slot[key[k]] = tmp[k];
+    }
+    for (uint32_t p = n, q = 0; p < n_slots; ++p)
+    {
+        remap[p - n] = 0;
+        if (__kh_f_taken(taken, p))
+        {
+            while (__kh_f_taken(taken, q))
+                ++q;
+            remap[p - n] = q++;
+        }
+    }
+    for (j = 0; j < n; ++j)
+        if (slot[j] >= n)
+            slot[j] = remap[slot[j] - n];
+    ret = 1;
+end:
+    kfree(start);
+    kfree(fill);
+    kfree(order);
+    kfree(groups);
+    kfree(taken);
+    kfree(by_size);
+    kfree(tmp);
+    return ret;
+}
+
+/* Sizes in bytes of the arrays of a frozen table with the given header */
+static kh_inline void __kh_f_sizes(const kh_f_header_t *hd, uint64_t size[__KH_F_N])
+{
+    size[__KH_F_PILOT] = (uint64_t)hd->n_groups * sizeof(uint16_t);
+    size[__KH_F_REMAP] = (uint64_t)(hd->n_slots - hd->size) * sizeof(uint32_t);
+    size[__KH_F_KEYS] = hd->size * hd->key_size;
+    size[__KH_F_VALS] = hd->kind & 1 ? hd->size * hd->val_size : 0;
+    size[__KH_F_STRS] = hd->strs_size;
+}
+
+/* How each kind of key is stored: as it is, or as an offset into f->strs */
+#define __kh_f_pod_is_str 0
+#define __kh_f_pod_bytes(key) ((void)(key), 0)
+#define __kh_f_pod_store(f, x, key, pos) ((void)(pos), (f)->keys[x] = (key))
+#define __kh_f_pod_key(f, x) ((f)->keys[x])
+#define __kh_f_pod_eq(f, x, key, __hash_equal) __hash_equal((f)->keys[x], key)
+#define __kh_f_pod_bad(f, x) 0
+#define __kh_f_str_is_str 1
+#define __kh_f_str_bytes(key) (strlen(key) + 1)
+#define __kh_f_str_store(f, x, key, pos) \
+    ((f)->keys[x] = (pos), (pos) += strlen(key) + 1, memcpy((f)->strs + (f)->keys[x], key, (pos) - (f)->keys[x]))
+#define __kh_f_str_key(f, x) ((const char *)(f)->strs + (f)->keys[x])
+#define __kh_f_str_eq(f, x, key, __hash_equal) (strcmp((f)->strs + (f)->keys[x], key) == 0)
+#define __kh_f_str_bad(f, x) ((uint64_t)(f)->keys[x] >= (f)->strs_size) /* an offset out of a mapped file */
+
+#define __KHASH_FROZEN_TYPE(name, kstore_t, khval_t)                                     \
+    typedef struct kh_f_##name##_s                                                       \
+    {                                                                                    \
+        khint_t size; /* number of keys, which fill slots 0 to size - 1 */               \
+        uint32_t n_slots, n_groups; /* range of the displaced slots; number of groups */ \
+        uint64_t seed;                                                                   \
+        uint16_t *pilots; /* displacement of each group */                               \
+        uint32_t *remap; /* final slot of each displaced slot from size up */            \
+        kstore_t *keys;                                                                  \
+        khval_t *vals;                                                                   \
+        char *strs; /* the strings of a table with string keys */                        \
+        uint64_t strs_size;                                                              \
+        char *base; /* the mapped file of a table from kh_f_load(), or NULL */           \
+        size_t len;                                                                      \
+    } kh_f_##name##_t;
+
+#define __KHASH_FROZEN_IMPL(name, SCOPE, src, khkey_t, kstore_t, khval_t, kh_is_map, __hash64, __hash_equal, __key_kind) \
+    SCOPE void kh_f_destroy_##name(kh_f_##name##_t *f)                                                                   \
+    {                                                                                                                    \
+        if (!f)                                                                                                          \
+            return;                                                                                                      \
+        if (f->base)                                                                                                     \
+            munmap(f->base, f->len);                                                                                     \
+        else                                                                                                             \
+        {                                                                                                                \
+            kfree(f->pilots);                                                                                            \
+            kfree(f->remap);                                                                                             \
+            kfree(f->keys);                                                                                              \
+            kfree(f->vals);                                                                                              \
+            kfree(f->strs);                                                                                              \
+        }                                                                                                                \
+        kfree(f);                                                                                                        \
+    }                                                                                                                    \
+    SCOPE khint_t kh_f_get_##name(const kh_f_##name##_t *f, khkey_t key)                                                 \
+    {                                                                                                                    \
+        if (!f->size)                                                                                                    \
+            return 0;                                                                                                    \
+        uint64_t h = splittable64(__hash64(key) ^ f->seed);                                                              \
+        uint32_t x = __kh_f_slot(h, f->pilots[__kh_f_group(h, f->n_groups)], f->n_slots);                                \
+        if (x >= (uint32_t)f->size)                                                                                      \
+            x = f->remap[x - f->size];                                                                                   \
+        return __kh_f_##__key_kind##_eq(f, x, key, __hash_equal) ? (khint_t)x : f->size;                                 \
+    }                                                                                                                    \
+    SCOPE khkey_t kh_f_key_##name(const kh_f_##name##_t *f, khint_t x)                                                   \
+    {                                                                                                                    \
+        return __kh_f_##__key_kind##_key(f, x);                                                                          \
+    }                                                                                                                    \
+    SCOPE kh_f_##name##_t *kh_freeze_##name(const kh_##src##_t *h)                                                       \
+    {                                                                                                                    \
+        khint_t i, n_iter = __kh_iter_end(h);                                                                            \
+        uint64_t n = 0, n_bytes = 0, pos = 0;                                                                            \
+        for (i = 0; i < n_iter; ++i)                                                                                     \
+            if (kh_exist(__kh_iter_tab(h, i), __kh_iter_pos(h, i)))                                                      \
+            {                                                                                                            \
+                ++n;                                                                                                     \
+                n_bytes += __kh_f_##__key_kind##_bytes(kh_key(__kh_iter_tab(h, i), __kh_iter_pos(h, i)));                \
+            }                                                                                                            \
+        kh_f_##name##_t *f = n <= __KH_F_MAX ? (kh_f_##name##_t *)kcalloc(1, sizeof(kh_f_##name##_t)) : NULL;            \
+        if (!f || !n)                                                                                                    \
+            return f;                                                                                                    \
+        f->size = (khint_t)n;                                                                                            \
+        f->n_slots = (uint32_t)(n + n / 99 + 1); /* 99% full before the remapping */                                     \
+        f->n_groups = (uint32_t)(n / 3 + 1);                                                                             \
+        f->strs_size = n_bytes;                                                                                          \
+        uint64_t *hs = (uint64_t *)kmalloc(n * sizeof(uint64_t));                                                        \
+        uint32_t *slot = (uint32_t *)kmalloc(n * sizeof(uint32_t));                                                      \
+        f->pilots = (uint16_t *)kmalloc((size_t)f->n_groups * sizeof(uint16_t));                                         \
+        f->remap = (uint32_t *)kmalloc((size_t)(f->n_slots - n) * sizeof(uint32_t));                                     \
+        f->keys = (kstore_t *)kmalloc(n * sizeof(kstore_t));                                                             \
+        f->vals = (kh_is_map) ? (khval_t *)kmalloc(n * sizeof(khval_t)) : NULL;                                          \
+        f->strs = n_bytes ? (char *)kmalloc(n_bytes) : NULL;                                                             \
+        int ret = -1;                                                                                                    \
+        if (hs && slot && f->pilots && f->remap && f->keys && (!(kh_is_map) || f->vals) && (!n_bytes || f->strs))        \
+        { /* a group may find no displacement; then start over with another seed */                                      \
+            ret = 0;                                                                                                     \
+            for (int attempt = 0; attempt < 8 && ret == 0; ++attempt)                                                    \
+            {                                                                                                            \
+                f->seed = splittable64(attempt + 1);                                                                     \
+                uint64_t j = 0;                                                                                          \
+                for (i = 0; i < n_iter; ++i)                                                                             \
+                    if (kh_exist(__kh_iter_tab(h, i), __kh_iter_pos(h, i)))                                              \
+                        hs[j++] = splittable64(__hash64(kh_key(__kh_iter_tab(h, i), __kh_iter_pos(h, i))) ^ f->seed);    \
+                ret = __kh_f_build(hs, (uint32_t)n, f->n_slots, f->n_groups, f->pilots, f->remap, slot);                 \
+            }                                                                                                            \
+        }                                                                                                                \
+        if (ret == 1)                                                                                                    \
+        {                                                                                                                \
+            uint64_t j = 0;                                                                                              \
+            for (i = 0; i < n_iter; ++i)                                                                                 \
+            {                                                                                                            \
+                const kh_##src##_t *t = __kh_iter_tab(h, i);                                                             \
+                khint_t x = __kh_iter_pos(h, i);                                                                         \
+                if (!kh_exist(t, x))                                                                                     \
+                    continue;                                                                                            \
+                __kh_f_##__key_kind##_store(f, slot[j], kh_key(t, x), pos);                                              \
+                if ((kh_is_map) && t->vals)                                                                              \
+                    memcpy(&f->vals[slot[j]], &kh_val(t, x), sizeof(khval_t));                                           \
+                ++j;                                                                                                     \
+            }                                                                                                            \
+        }                                                                                                                \
+        kfree(hs);                                                                                                       \
+        kfree(slot);                                                                                                     \
+        if (ret != 1)                                                                                                    \
+        {                                                                                                                \
+            kh_f_destroy_##name(f);                                                                                      \
+            return NULL;                                                                                                 \
+        }                                                                                                                \
+        return f;                                                                                                        \
+    }                                                                                                                    \
+    static kh_inline void __kh_f_header_##name(kh_f_header_t *hd)                                                        \
+    {                                                                                                                    \
+        memset(hd, 0, sizeof(kh_f_header_t));                                                                            \
+        memcpy(hd->magic, "KHFROZEN", sizeof(hd->magic));                                                                \
+        hd->version = KH_FROZEN_VERSION;                                                                                 \
+        hd->kind = ((kh_is_map) ? 1 : 0) | (__kh_f_##__key_kind##_is_str ? 2 : 0);                                       \
+        hd->key_size = sizeof(kstore_t);                                                                                 \
+        hd->val_size = sizeof(khval_t);                                                                                  \
+        hd->byte_order = 0x01020304;                                                                                     \
+    }                                                                                                                    \
+    SCOPE int kh_f_save_##name(const kh_f_##name##_t *f, const char *path)                                               \
+    {                                                                                                                    \
+        kh_f_header_t hd;                                                                                                \
+        uint64_t size[__KH_F_N];                                                                                         \
+        __kh_f_header_##name(&hd);                                                                                       \
+        hd.n_slots = f->n_slots;                                                                                         \
+        hd.n_groups = f->n_groups;                                                                                       \
+        hd.size = f->size;                                                                                               \
+        hd.seed = f->seed;                                                                                               \
+        hd.strs_size = f->strs_size;                                                                                     \
+        __kh_f_sizes(&hd, size);                                                                                         \
+        hd.file_size = __kh_mmap_layout(sizeof(kh_f_header_t), __KH_F_N, size, hd.offset);                               \
+        const void *array[__KH_F_N] = {f->pilots, f->remap, f->keys, f->vals, f->strs};                                  \
+        return __kh_mmap_write(path, &hd, sizeof(kh_f_header_t), __KH_F_N, array, size, hd.offset, hd.file_size);        \
+    }                                                                                                                    \
+    SCOPE kh_f_##name##_t *kh_f_load_##name(const char *path)                                                            \
+    {                                                                                                                    \
+        kh_f_header_t expect;                                                                                            \
+        uint64_t size[__KH_F_N];                                                                                         \
+        size_t len;                                                                                                      \
+        __kh_f_header_##name(&expect);                                                                                   \
+        char *base = __kh_mmap_map(path, sizeof(kh_f_header_t), &len);                                                   \
+        if (!base)                                                                                                       \
+            return NULL;                                                                                                 \
+        const kh_f_header_t *hd = (const kh_f_header_t *)base;                                                           \
+        int ok = memcmp(hd->magic, expect.magic, sizeof(hd->magic)) == 0 && hd->version == expect.version &&             \
+                 hd->kind == expect.kind && hd->key_size == expect.key_size && hd->val_size == expect.val_size &&        \
+                 hd->byte_order == expect.byte_order && hd->file_size == len && hd->size <= __KH_F_MAX &&                \
+                 hd->size <= hd->n_slots && (hd->size ? hd->n_groups > 0 : hd->n_slots == 0 && hd->n_groups == 0) &&     \
+                 (__kh_f_##__key_kind##_is_str ? hd->size == 0 || (hd->strs_size > 0) : hd->strs_size == 0);             \
+        if (ok)                                                                                                          \
+        {                                                                                                                \
+            __kh_f_sizes(hd, size);                                                                                      \
+            ok = __kh_mmap_check(sizeof(kh_f_header_t), __KH_F_N, size, hd->offset, hd->file_size) &&                    \
+                 (!hd->strs_size || base[hd->offset[__KH_F_STRS] + hd->strs_size - 1] == 0);                             \
+        }                                                                                                                \
+        kh_f_##name##_t *f = ok ? (kh_f_##name##_t *)kcalloc(1, sizeof(kh_f_##name##_t)) : NULL;                         \
+        if (!f)                                                                                                          \
+        {                                                                                                                \
+            munmap(base, len);                                                                                           \
+            return NULL;                                                                                                 \
+        }                                                                                                                \
+        f->base = base;                                                                                                  \
+        f->len = len;                                                                                                    \
+        f->size = (khint_t)hd->size;                                                                                     \
+        f->n_slots = hd->n_slots;                                                                                        \
+        f->n_groups = hd->n_groups;                                                                                      \
+        f->seed = hd->seed;                                                                                              \
+        f->strs_size = hd->strs_size;                                                                                    \
+        void *array[__KH_F_N];                                                                                           \
+        for (int a = 0; a < __KH_F_N; ++a)                                                                               \
+            array[a] = hd->offset[a] ? base + hd->offset[a] : NULL;                                                      \
+        f->pilots = (uint16_t *)array[__KH_F_PILOT];                                                                     \
+        f->remap = (uint32_t *)array[__KH_F_REMAP];                                                                      \
+        f->keys = (kstore_t *)array[__KH_F_KEYS];                                                                        \
+        f->vals = (khval_t *)array[__KH_F_VALS];                                                                         \
+        f->strs = (char *)array[__KH_F_STRS];                                                                            \
+        /* Every index the file holds must stay inside it: remapped slots below size, string offsets within strs */      \
+        ok = 1;                                                                                                          \
+        for (uint32_t j = 0; j < f->n_slots - (uint32_t)f->size && ok; ++j)                                              \
+            ok = f->remap[j] < (uint32_t)f->size;                                                                        \
+        for (khint_t x = 0; x < f->size && ok && __kh_f_##__key_kind##_is_str; ++x)                                      \
+            ok = !__kh_f_##__key_kind##_bad(f, x);                                                                       \
+        /* A different hash function or a corrupt file sends keys to other slots; sample a few to catch it */            \
+        for (khint_t x = 0; x < f->size && ok; x += f->size / 16 ? f->size / 16 : 1)                                     \
+            ok = kh_f_get_##name(f, kh_f_key_##name(f, x)) == x;                                                         \
+        if (!ok)                                                                                                         \
+        {                                                                                                                \
+            kh_f_destroy_##name(f);                                                                                      \
+            return NULL;                                                                                                 \
+        }                                                                                                                \
+        return f;                                                                                                        \
+    }
+
+/*! @function
+  @abstract     Instantiate a frozen hash table with plain-data keys
+  @param  name  Name of the frozen table [symbol]
+  @param  src   Name of the khash table it is frozen from [symbol]
+  @param  khkey_t  Type of keys; plain data [type]
+  @param  khval_t  Type of values [type]
+  @param  kh_is_map  1 for a map, 0 for a set; must match src [int]
+  @param  __hash64  64-bit hash function of the keys; equal keys must have equal hashes [uint64_t (khkey_t)]
+  @param  __hash_equal  Comparison function, as for KHASH_INIT()
+ */
+#define KHASH_FROZEN_INIT(name, src, khkey_t, khval_t, kh_is_map, __hash64, __hash_equal)                        \
+    __KHASH_FROZEN_TYPE(name, khkey_t, khval_t)                                                                  \
+    __KHASH_FROZEN_IMPL(name, static kh_inline klib_unused, src, khkey_t, khkey_t, khval_t, kh_is_map, __hash64, \
+                        __hash_equal, pod)
+
+/*! @function
+  @abstract     Instantiate a frozen hash table with C string keys
+  @param  name  Name of the frozen table [symbol]
+  @param  src   Name of the khash table it is frozen from, keyed by kh_cstr_t [symbol]
+  @param  khval_t  Type of values [type]
+  @param  kh_is_map  1 for a map, 0 for a set; must match src [int]
+  @discussion   The frozen table keeps copies of the strings.
+ */
+#define KHASH_FROZEN_STR_INIT(name, src, khval_t, kh_is_map)                                               \
+    __KHASH_FROZEN_TYPE(name, khint64_t, khval_t)                                                          \
+    __KHASH_FROZEN_IMPL(name, static kh_inline klib_unused, src, kh_cstr_t, khint64_t, khval_t, kh_is_map, \
+                        kh_f_str_hash64, kh_str_hash_equal, str)
+
+/* --- frozen versions of the tables of KHASH_MAP_INIT_INT/INT64/STR --- */
+
+#define KHASH_FROZEN_MAP_INIT_INT(name, src, khval_t) \
+    KHASH_FROZEN_INIT(name, src, khint32_t, khval_t, 1, kh_f_int32_hash64, kh_int_hash_equal)
+
+#define KHASH_FROZEN_MAP_INIT_INT64(name, src, khval_t) \
+    KHASH_FROZEN_INIT(name, src, khint64_t, khval_t, 1, kh_f_int64_hash64, kh_int64_hash_equal)
+
+#define KHASH_FROZEN_MAP_INIT_STR(name, src, khval_t) KHASH_FROZEN_STR_INIT(name, src, khval_t, 1)
+
+/*!
+  @abstract Type of the frozen hash table.
+  @param  name  Name of the frozen table [symbol]
+ */
+#define khash_f_t(name) kh_f_##name##_t
+
+/*! @function
+  @abstract     Compile a hash table into a frozen one.
+  @param  name  Name of the frozen table [symbol]
+  @param  h     Pointer to the source table, which is not changed [const khash_t(src)*]
+  @return       Pointer to the frozen table; NULL if memory ran out, there are
+                more than 2^31 - 2 keys, or two keys have the same 64-bit hash [khash_f_t(name)*]
+ */
+#define kh_freeze(name, h) kh_freeze_##name(h)
+
+/*! @function
+  @abstract     Destroy a frozen hash table.
+  @param  name  Name of the frozen table [symbol]
+  @param  f     Pointer to the frozen table [khash_f_t(name)*]
+ */
+#define kh_f_destroy(name, f) kh_f_destroy_##name(f)
+
+/*! @function
+  @abstract     Look up a key in a frozen hash table.
+  @param  name  Name of the frozen table [symbol]
+  @param  f     Pointer to the frozen table [const khash_f_t(name)*]
+  @param  k     Key [type of keys]
+  @return       Slot of the key; kh_f_end(f) if it is absent [khint_t]
+ */
+#define kh_f_get(name, f, k) kh_f_get_##name(f, k)
+
+/*! @function
+  @abstract     Get the key in a slot.
+  @param  name  Name of the frozen table [symbol]
+  @param  f     Pointer to the frozen table [const khash_f_t(name)*]
+  @param  x     Slot, below kh_f_end(f) [khint_t]
+  @return       Key [type of keys]
+ */
+#define kh_f_key(name, f, x) kh_f_key_##name(f, x)
+
+/*! @function
+  @abstract     Get the value in a slot of a frozen map.
+  @param  f     Pointer to the frozen table [const khash_f_t(name)*]
+  @param  x     Slot, below kh_f_end(f) [khint_t]
+  @return       Value [type of values]
+ */
+#define kh_f_val(f, x) ((f)->vals[x])
+
+/*! @function
+  @abstract     End of the slots of a frozen table, which all hold a key.
+  @param  f     Pointer to the frozen table [const khash_f_t(name)*]
+  @return       The number of keys [khint_t]
+ */
+#define kh_f_end(f) ((f)->size)
+
+/*! @function
+  @abstract     Get the number of keys in a frozen table.
+  @param  f     Pointer to the frozen table [const khash_f_t(name)*]
+  @return       Number of keys [khint_t]
+ */
+#define kh_f_size(f) ((f)->size)
+
+/*! @function
+  @abstract     Write a frozen table to a file.
+  @param  name  Name of the frozen table [symbol]
+  @param  f     Pointer to the frozen table [const khash_f_t(name)*]
+  @param  path  File to create or overwrite [const char*]
+  @return       0 on success, -1 on failure [int]
+ */
+#define kh_f_save(name, f, path) kh_f_save_##name(f, path)
+
+/*! @function
+  @abstract     Map a frozen table written by kh_f_save().
+  @param  name  Name of the frozen table [symbol]
+  @param  path  File to map [const char*]
+  @return       Pointer to the frozen table, NULL on failure [khash_f_t(name)*]
+  @discussion   The arrays are used in place, as with kh_load_mmap(). Fails if
+                the file is truncated, was written for other types, holds a
+                remapped slot or a string offset out of range, or the keys
+                it samples do not hash to their slots.
+ */
+#define kh_f_load(name, path) kh_f_load_##name(path)
+
+#endif /* __AC_KHASH_FROZEN_H */
@@ -0,0 +1,369 @@
+/*
+  On-disk hash tables built on khash.h.
+
+  KHASH_MMAP_INIT() declares a table that kh_save() writes to a file and
+  kh_load_mmap() maps back into memory. The file holds the bucket arrays
+  exactly as they sit in memory, each aligned to KH_MMAP_ALIGN bytes after a
+  fixed header, so loading is one mmap() and a few checks: no parsing, no
+  copying, and the pages are read in as lookups first touch them.
+
+  An example:
+
+#include "khash_mmap.h"
+KHASH_MMAP_INIT(m64, khint64_t, double, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+    // at build time
+    kh_save(m64, h, "m64.kh");
+    // at every start
+    khash_t(m64) *h = kh_load_mmap(m64, "m64.kh");
+    khint_t k = kh_get(m64, h, 42);
+    kh_destroy(m64, h);
+
+  Keys and values are written byte for byte, so they must be plain data:
+  a table of pointers, such as one keyed by C strings, does not survive the
+  trip. The file must be loaded by a program built with the same key and
+  value types, engine options, khint_t width, byte order and hash function,
+  and for KH_SWISS tables the same KH_GROUP_WIDTH, which follows -march;
+  kh_load_mmap() rejects files that do not match.
+
+  The mapping is private: a loaded table is a normal table and may be
+  modified, and the pages it writes to are copied on write, so the file is
+  never changed. Buckets that move to memory of their own on a resize are
+  allocated with kmalloc().
+ */
+
+#ifndef __AC_KHASH_MMAP_H
+#define __AC_KHASH_MMAP_H
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "khash.h"
+
+#define KH_MMAP_VERSION 1
+#define KH_MMAP_ALIGN 64 /* a cache line; also the alignment of every array in the file */
+
+/* Arrays of a table in the file, in this order */
+enum
+{
+    __KH_MMAP_FLAGS,
+    __KH_MMAP_KEYS,
+    __KH_MMAP_VALS,
+    __KH_MMAP_CTRL,
+    __KH_MMAP_HASHES,
+    __KH_MMAP_N
+};
+
+/* Start of every file, in the byte order of the host that wrote it; 128 bytes */
+typedef struct
+{
+    char magic[8]; /* "KHASHMAP" */
+    uint32_t version; /* KH_MMAP_VERSION */
+    uint32_t opts; /* engine options of the table, without KH_LOAD() and KH_GROWTH() */
+    uint32_t key_size, val_size, khint_size; /* sizeof(khkey_t), sizeof(khval_t), sizeof(khint_t) */
+    uint32_t byte_order; /* 0x01020304 */
+    uint64_t n_buckets, size, n_occupied, upper_bound;
+    double max_load;
+    int32_t grow_shift;
+    uint32_t group_width; /* KH_GROUP_WIDTH of a KH_SWISS table, which -march decides; 0 for other engines */
+    uint64_t offset[__KH_MMAP_N]; /* of each array from the start of the file; 0 if absent */
+    uint64_t file_size;
+} kh_mmap_header_t;
+
+/* A mapped file and the allocator of the table that lives in it */
+typedef struct
+{
+    kalloc_t alloc; /* ctx points back to this struct */
+    char *base;
+    size_t len;
+    void *table; /* releasing it unmaps the file */
+} kh_mmap_t;
+
+static kh_inline int __kh_mmap_owns(const kh_mmap_t *m, const void *p)
+{
+    return (const char *)p >= m->base && (const char *)p < m->base + m->len;
+}
+
+static kh_inline void *__kh_mmap_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return kmalloc(size);
+}
+
+/* Mapped arrays are never grown in place: they move to the heap instead */
+static kh_inline void *__kh_mmap_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    if (!__kh_mmap_owns((kh_mmap_t *)ctx, p))
+        return krealloc(p, new_size);
+    void *q = kmalloc(new_size);
+    if (q)
+        memcpy(q, p, old_size < new_size ? old_size : new_size);
+    return q;
+}
+
+static kh_inline void __kh_mmap_release(void *ctx, void *p, size_t size)
+{
+    kh_mmap_t *m = (kh_mmap_t *)ctx;
+    (void)size;
+    if (__kh_mmap_owns(m, p))
+        return;
+    if (p == m->table)
+    { /* kh_destroy() releases the table struct last */
+        kfree(p);
+        munmap(m->base, m->len);
+        kfree(m);
+    }
+    else
+        kfree(p);
+}
+
+/* Sizes in bytes of the arrays of a table with the given header */
+static kh_inline void __kh_mmap_sizes(const kh_mmap_header_t *hd, uint64_t size[__KH_MMAP_N])
+{
+    size[__KH_MMAP_FLAGS] = hd->n_buckets ? __ac_fsize(hd->n_buckets) * sizeof(khint32_t) : 0;
+    size[__KH_MMAP_KEYS] = hd->n_buckets * hd->key_size;
+    size[__KH_MMAP_VALS] = hd->opts & KH_MAP && !(hd->opts & KH_INTERLEAVED) ? hd->n_buckets * hd->val_size : 0;
+    size[__KH_MMAP_CTRL] = hd->opts & (KH_SWISS | KH_ROBINHOOD) ? hd->n_buckets : 0;
+    size[__KH_MMAP_HASHES] = hd->opts & KH_STORE_HASH ? hd->n_buckets * hd->khint_size : 0;
+}
+
+/* Place n arrays after a header of hd_size bytes, each at a multiple of
+   KH_MMAP_ALIGN and empty ones at offset 0; returns the size of the file */
+static kh_inline uint64_t __kh_mmap_layout(uint64_t hd_size, int n, const uint64_t size[], uint64_t offset[])
+{
+    uint64_t pos = hd_size;
+    for (int i = 0; i < n; ++i)
+    {
+        pos = (pos + KH_MMAP_ALIGN - 1) / KH_MMAP_ALIGN * KH_MMAP_ALIGN;
+        offset[i] = size[i] ? pos : 0;
+        pos += size[i];
+    }
+    return (pos + KH_MMAP_ALIGN - 1) / KH_MMAP_ALIGN * KH_MMAP_ALIGN;
+}
+
+/* Write the header and the arrays laid out by __kh_mmap_layout(); returns 0 on success, -1 on failure */
+static kh_inline int __kh_mmap_write(const char *path, const void *hd, uint64_t hd_size, int n,
+                                     const void *const array[], const uint64_t size[], const uint64_t offset[],
+                                     uint64_t file_size)
+{
+    static const char zeros[KH_MMAP_ALIGN];
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return -1;
+    int ok = fwrite(hd, 1, hd_size, fp) == hd_size;
+    for (uint64_t pos = hd_size; ok && pos < file_size;)
+    {
+        int i = 0;
+        while (i < n && (!size[i] || offset[i] != pos))
+            ++i;
+        if (i < n)
+        { /* the next array */
+            ok = fwrite(array[i], 1, size[i], fp) == size[i];
+            pos += size[i];
+        }
+        else
+        { /* padding up to it */
+            size_t pad = KH_MMAP_ALIGN - pos % KH_MMAP_ALIGN;
+            ok = fwrite(zeros, 1, pad, fp) == pad;
+            pos += pad;
+        }
+    }
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+/* Check that arrays lie inside the file where __kh_mmap_layout() would put them */
+static kh_inline int __kh_mmap_check(uint64_t hd_size, int n, const uint64_t size[], const uint64_t offset[],
+                                     uint64_t file_size)
+{
+    for (int i = 0; i < n; ++i)
+        if (size[i] ? offset[i] < hd_size || offset[i] % KH_MMAP_ALIGN != 0 || size[i] > file_size ||
+                          offset[i] > file_size - size[i]
+                    : offset[i] != 0)
+            return 0;
+    return 1;
+}
+
+/* Map a whole file privately; returns NULL if it cannot be mapped or is
+   shorter than min_size bytes. Writes to the mapping never reach the file. */
+static kh_inline char *__kh_mmap_map(const char *path, uint64_t min_size, size_t *len)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    char *base = NULL;
+    if (fstat(fd, &st) == 0 && (uint64_t)st.st_size >= min_size && st.st_size > 0)
+    {
+        *len = (size_t)st.st_size;
+        base = (char *)mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (base == (char *)MAP_FAILED)
+            base = NULL;
+    }
+    close(fd);
+    return base;
+}
+
+/* Map a file and check its header against the expected one; returns NULL if
+   the file cannot be used. The arrays are at m->base + hd->offset[i]. */
+static kh_inline kh_mmap_t *__kh_mmap_open(const char *path, const kh_mmap_header_t *expect)
+{
+    kh_mmap_t *m = (kh_mmap_t *)kcalloc(1, sizeof(kh_mmap_t));
+    if (!m)
+        return NULL;
+    if (!(m->base = __kh_mmap_map(path, sizeof(kh_mmap_header_t), &m->len)))
+    {
+        kfree(m);
+        return NULL;
+    }
+    const kh_mmap_header_t *hd = (const kh_mmap_header_t *)m->base;
+    uint64_t size[__KH_MMAP_N];
+    int ok = memcmp(hd->magic, expect->magic, sizeof(hd->magic)) == 0 && hd->version == expect->version &&
+             hd->opts == expect->opts && hd->key_size == expect->key_size && hd->val_size == expect->val_size &&
+             hd->khint_size == expect->khint_size && hd->byte_order == expect->byte_order &&
+             hd->file_size == m->len && (hd->n_buckets & (hd->n_buckets - 1)) == 0 &&
+             hd->n_buckets <= (uint64_t)1 << (hd->khint_size * 8 - 2) && hd->size <= hd->n_occupied &&
+             hd->n_occupied <= hd->n_buckets && hd->upper_bound <= hd->n_buckets &&
+             hd->group_width == expect->group_width && (hd->n_buckets == 0 || hd->n_buckets >= hd->group_width);
+    if (ok)
+    {
+        __kh_mmap_sizes(hd, size);
+        ok = __kh_mmap_check(sizeof(kh_mmap_header_t), __KH_MMAP_N, size, hd->offset, hd->file_size);
+    }
+    if (!ok)
+    {
+        munmap(m->base, m->len);
+        kfree(m);
+        return NULL;
+    }
+    m->alloc = (kalloc_t){__kh_mmap_alloc, __kh_mmap_resize, __kh_mmap_release, m};
+    return m;
+}
+
+#define __KHASH_MMAP_IMPL(name, SCOPE, khkey_t, khval_t, kh_opts)                                              \
+    static kh_inline void __kh_mmap_header_##name(kh_mmap_header_t *hd)                                        \
+    {                                                                                                          \
+        memset(hd, 0, sizeof(kh_mmap_header_t));                                                               \
+        memcpy(hd->magic, "KHASHMAP", sizeof(hd->magic));                                                      \
+        hd->version = KH_MMAP_VERSION;                                                                         \
+        hd->opts = (kh_opts) & 0xff & ~KH_INTERLEAVED;                                                         \
+        hd->key_size = sizeof(khkey_t);                                                                        \
+        if (sizeof(((kh_##name##_t *)0)->key_stride) > 1) /* the keys array holds the pairs */                 \
+        {                                                                                                      \
+            hd->opts |= KH_INTERLEAVED;                                                                        \
+            hd->key_size = sizeof(kh_##name##_pair_t);                                                         \
+        }                                                                                                      \
+        hd->val_size = sizeof(khval_t);                                                                        \
+        hd->khint_size = sizeof(khint_t);                                                                      \
+        hd->byte_order = 0x01020304;                                                                           \
+        hd->group_width = (kh_opts) & KH_SWISS ? KH_GROUP_WIDTH : 0; /* probe groups must line up */           \
+    }                                                                                                          \
+    SCOPE int kh_save_##name(kh_##name##_t *h, const char *path)                                               \
+    {                                                                                                          \
+        kh_mmap_header_t hd;                                                                                   \
+        if (h->arena) /* interned keys point into the arena */                                                 \
+            return -1;                                                                                         \
+        kh_migrate_##name(h, 0);                                                                               \
+        __kh_mmap_header_##name(&hd);                                                                          \
+        hd.n_buckets = h->n_buckets;                                                                           \
+        hd.size = h->size;                                                                                     \
+        hd.n_occupied = h->n_occupied;                                                                         \
+        hd.upper_bound = h->upper_bound;                                                                       \
+        hd.max_load = h->max_load;                                                                             \
+        hd.grow_shift = h->grow_shift;                                                                         \
+        const void *array[__KH_MMAP_N] = {h->flags, h->keys, h->vals, h->ctrl, h->hashes};                     \
+        uint64_t size[__KH_MMAP_N];                                                                            \
+        __kh_mmap_sizes(&hd, size);                                                                            \
+        hd.file_size = __kh_mmap_layout(sizeof(kh_mmap_header_t), __KH_MMAP_N, size, hd.offset);               \
+        return __kh_mmap_write(path, &hd, sizeof(kh_mmap_header_t), __KH_MMAP_N, array, size, hd.offset,       \
+                               hd.file_size);                                                                  \
+    }                                                                                                          \
+    SCOPE kh_##name##_t *kh_load_mmap_##name(const char *path)                                                 \
+    {                                                                                                          \
+        kh_mmap_header_t expect;                                                                               \
+        __kh_mmap_header_##name(&expect);                                                                      \
+        kh_mmap_t *m = __kh_mmap_open(path, &expect);                                                          \
+        if (!m)                                                                                                \
+            return NULL;                                                                                       \
+        const kh_mmap_header_t *hd = (const kh_mmap_header_t *)m->base;                                        \
+        kh_##name##_t *h = kh_init_with_alloc_##name(&m->alloc);                                               \
+        if (!h)                                                                                                \
+        {                                                                                                      \
+            munmap(m->base, m->len);                                                                           \
+            kfree(m);                                                                                          \
+            return NULL;                                                                                       \
+        }                                                                                                      \
+        m->table = h;                                                                                          \
+        h->n_buckets = (khint_t)hd->n_buckets;                                                                 \
+        h->size = (khint_t)hd->size;                                                                           \
+        h->n_occupied = (khint_t)hd->n_occupied;                                                               \
+        h->upper_bound = (khint_t)hd->upper_bound;                                                             \
+        if (hd->max_load > 0.0 && hd->max_load < 1.0)                                                          \
+            h->max_load = hd->max_load;                                                                        \
+        if (hd->grow_shift >= 1 && hd->grow_shift <= 3)                                                        \
+            h->grow_shift = hd->grow_shift;                                                                    \
+        void *array[__KH_MMAP_N];                                                                              \
+        for (int i = 0; i < __KH_MMAP_N; ++i)                                                                  \
+            array[i] = hd->offset[i] ? m->base + hd->offset[i] : NULL;                                         \
+        h->flags = (khint32_t *)array[__KH_MMAP_FLAGS];                                                        \
+        h->keys = (khkey_t *)array[__KH_MMAP_KEYS];                                                            \
+        h->vals = (khval_t *)array[__KH_MMAP_VALS];                                                            \
+        __kh_pair_vals_##name(h);                                                                              \
+        h->ctrl = (uint8_t *)array[__KH_MMAP_CTRL];                                                            \
+        h->hashes = (khint_t *)array[__KH_MMAP_HASHES];                                                        \
+        /* A different hash function sends lookups to the wrong buckets; sample a few keys to catch it */      \
+        for (khint_t i = 0, n = 0; i < h->n_buckets && n < 16; i += h->n_buckets / 16 ? h->n_buckets / 16 : 1) \
+        {                                                                                                      \
+            khint_t x = i;                                                                                     \
+            while (x < h->n_buckets && !kh_exist(h, x))                                                        \
+                ++x;                                                                                           \
+            if (x == h->n_buckets)                                                                             \
+                break;                                                                                         \
+            if (kh_get_##name(h, kh_key(h, x)) != x)                                                           \
+            {                                                                                                  \
+                kh_destroy_##name(h);                                                                          \
+                return NULL;                                                                                   \
+            }                                                                                                  \
+            ++n;                                                                                               \
+        }                                                                                                      \
+        return h;                                                                                              \
+    }
+
+/*! @function
+  @abstract     Instantiate a hash table that can be saved to and mapped from a file
+  @param  name  Name of the hash table [symbol]
+  @param  khkey_t  Type of keys; plain data [type]
+  @param  khval_t  Type of values; plain data [type]
+  @param  kh_opts  Options, as for KHASH_INIT() [int]
+  @param  __hash_func  Hash function, as for KHASH_INIT()
+  @param  __hash_equal  Comparison function, as for KHASH_INIT()
+  @discussion   Also instantiates the plain table `name`, which kh_load_mmap() returns.
+ */
+#define KHASH_MMAP_INIT(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal) \
+    KHASH_INIT(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)          \
+    __KHASH_MMAP_IMPL(name, static kh_inline klib_unused, khkey_t, khval_t, kh_opts)
+
+/*! @function
+  @abstract     Write a hash table to a file.
+  @param  name  Name of the hash table [symbol]
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  path  File to create or overwrite [const char*]
+  @return       0 on success; -1 if the file cannot be written or the table interns its keys [int]
+  @discussion   Finishes an incremental rehash first. The file records the
+                buckets as they are, deleted ones included; kh_compact() first
+                if the table has seen many deletions.
+ */
+#define kh_save(name, h, path) kh_save_##name(h, path)
+
+/*! @function
+  @abstract     Map a hash table written by kh_save().
+  @param  name  Name of the hash table [symbol]
+  @param  path  File to map [const char*]
+  @return       Pointer to the hash table, NULL on failure [khash_t(name)*]
+  @discussion   Fails if the file is truncated, was written for other types
+                or options, or its keys do not hash to their buckets. The
+                table is released with kh_destroy(), which also unmaps the file.
+ */
+#define kh_load_mmap(name, path) kh_load_mmap_##name(path)
+
+#endif /* __AC_KHASH_MMAP_H */
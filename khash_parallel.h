@@ -0,0 +1,448 @@
+/*
+  Multi-threaded operations on khash.h tables.
+
+  KHASH_PARALLEL_INIT() declares a table together with kh_build(), which
+  loads it from arrays of keys and values on several threads:
+
+#include "khash_parallel.h"
+KHASH_PARALLEL_INIT(m64, khint64_t, double, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+static void add(double *acc, const double *v, void *ctx) { *acc += *v; }
+    khash_t(m64) *h = kh_build(m64, keys, vals, n, 8); // a later value replaces an earlier one
+    khash_t(m64) *g = kh_build_combine(m64, keys, vals, n, 8, add, NULL); // or is added to it
+
+  kh_build() sizes the table for n keys up front and never resizes it.
+  The threads first hash their slices of the input and count the keys
+  bound for each region of buckets, sized to stay in cache; then they
+  scatter the key indices by region, keeping the input order within each
+  region; and finally they take whole regions and insert their keys. A key
+  whose probe would leave its region is set aside and inserted on one
+  thread at the end, so no two threads touch the same bucket. Equal keys
+  always share a region, so they are seen in input order whatever the
+  number of threads.
+
+  Only the default engine fills regions in parallel: KH_SWISS and
+  KH_ROBINHOOD tables are hashed and partitioned on all threads, then
+  filled one region after another on the calling thread.
+
+  kh_par_scan() hands each thread its own part of a table, split with
+  kh_split(), to read with kh_foreach_range().
+
+  Tables declared this way also resize on several threads once they hold
+  KH_PAR_RESIZE_MIN keys: kh_resize(), and so kh_put(), moves the keys into
+  new arrays region by region, the same way. This needs the old and the new
+  arrays at once; if they do not fit, or for KH_SWISS and KH_ROBINHOOD
+  tables, the resize happens in place on one thread as usual.
+ */
+
+#ifndef __AC_KHASH_PARALLEL_H
+#define __AC_KHASH_PARALLEL_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "khash.h"
+
+#define KH_PAR_MAX_THREADS 256
+
+/* Bytes of buckets in a region of kh_build(); it should fit a core's L2 cache */
+#ifndef KH_BUILD_REGION_BYTES
+#define KH_BUILD_REGION_BYTES (1 << 18)
+#endif
+
+/* Tables with fewer keys resize on one thread */
+#ifndef KH_PAR_RESIZE_MIN
+#define KH_PAR_RESIZE_MIN (1 << 20)
+#endif
+
+/* Threads of a resize; 0 for one per online processor */
+#ifndef KH_PAR_THREADS
+#define KH_PAR_THREADS 0
+#endif
+
+static kh_inline int __kh_par_clamp(long n_threads)
+{
+    return n_threads < 1 ? 1 : n_threads > KH_PAR_MAX_THREADS ? KH_PAR_MAX_THREADS : (int)n_threads;
+}
+
+static kh_inline int __kh_par_threads(void)
+{
+    return __kh_par_clamp(KH_PAR_THREADS > 0 ? KH_PAR_THREADS : sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+typedef struct
+{
+    void (*fn)(void *arg, int t);
+    void *arg;
+    int t;
+} __kh_par_job_t;
+
+static void *__kh_par_thread(void *p)
+{
+    __kh_par_job_t *job = (__kh_par_job_t *)p;
+    job->fn(job->arg, job->t);
+    return NULL;
+}
+
+/* Run fn(arg, t) for t from 0 to n_threads - 1, each on its own thread, the
+   calling one included; a thread that cannot be started runs on the caller */
+static kh_inline void __kh_par_run(int n_threads, void (*fn)(void *arg, int t), void *arg)
+{
+    pthread_t tid[KH_PAR_MAX_THREADS];
+    __kh_par_job_t job[KH_PAR_MAX_THREADS];
+    int started[KH_PAR_MAX_THREADS];
+    for (int t = 1; t < n_threads; ++t)
+    {
+        job[t] = (__kh_par_job_t){fn, arg, t};
+        started[t] = pthread_create(&tid[t], NULL, __kh_par_thread, &job[t]) == 0;
+    }
+    fn(arg, 0);
+    for (int t = 1; t < n_threads; ++t)
+    {
+        if (started[t])
+            pthread_join(tid[t], NULL);
+        else
+            fn(arg, t);
+    }
+}
+
+typedef struct
+{
+    void (*fn)(void *arg, int t, khint_t begin, khint_t end);
+    void *arg;
+    khint_t end;
+    int n_threads;
+} __kh_par_scan_t;
+
+static void __kh_par_scan_part(void *p, int t)
+{
+    __kh_par_scan_t *s = (__kh_par_scan_t *)p;
+    s->fn(s->arg, t, __kh_split(s->end, t, s->n_threads), __kh_split(s->end, t + 1, s->n_threads));
+}
+
+static kh_inline void __kh_par_scan(khint_t end, int n_threads,
+                                    void (*fn)(void *arg, int t, khint_t begin, khint_t end), void *arg)
+{
+    __kh_par_scan_t s = {fn, arg, end, __kh_par_clamp(n_threads)};
+    __kh_par_run(s.n_threads, __kh_par_scan_part, &s);
+}
+
+#define __KHASH_PARALLEL_IMPL(name, SCOPE, khkey_t, khval_t, kh_opts, __hash_func)                                  \
+    typedef struct                                                                                                  \
+    {                                                                                                               \
+        kh_##name##_t *h; /* the table filled */                                                                    \
+        const kh_##name##_t *src; /* when resizing, the table whose buckets are moved to h; NULL in kh_build() */   \
+        const khkey_t *keys;                                                                                        \
+        const khval_t *vals;                                                                                        \
+        void (*combine)(khval_t *acc, const khval_t *v, void *ctx);                                                 \
+        void *ctx;                                                                                                  \
+        size_t key_step, val_step; /* keys[] and vals[] entries apart: 1, or the pair strides in a resize */        \
+        khint_t n, n_regions; /* keys[] and vals[] run up to n */                                                   \
+        int n_threads, shift; /* the region of bucket x is x >> shift */                                            \
+        khint_t *hs; /* hash of each key */                                                                         \
+        khint_t *idx; /* keys by region; the ones set aside move to the front of their region */                    \
+        khint_t *cnt; /* keys per thread and region; then where each thread scatters them */                        \
+        khint_t *start; /* first key of each region in idx */                                                       \
+        khint_t *n_aside; /* keys set aside in each region */                                                       \
+        khint_t *n_new; /* keys inserted by each thread */                                                          \
+        atomic_size_t next; /* next region to fill */                                                               \
+    } __kh_build_##name##_t;                                                                                        \
+    /* First bucket probed for a hash; KH_SWISS probes whole groups */                                              \
+    static kh_inline khint_t __kh_home_##name(const kh_##name##_t *h, khint_t k)                                    \
+    {                                                                                                               \
+        if ((kh_opts) & KH_SWISS)                                                                                   \
+            return ((k >> __ac_GROUP_LOG2) & ((h->n_buckets >> __ac_GROUP_LOG2) - 1)) << __ac_GROUP_LOG2;           \
+        return k & (h->n_buckets - 1);                                                                              \
+    }                                                                                                               \
+    /* Is there a key at i? In a resize, only the full buckets of the old table */                                  \
+    static kh_inline int __kh_build_has_##name(const __kh_build_##name##_t *b, khint_t i)                           \
+    {                                                                                                               \
+        return !b->src || !__ac_iseither(b->src->flags, i);                                                         \
+    }                                                                                                               \
+    /* A key equal to one already in bucket x: replace or combine the value */                                      \
+    static kh_inline void __kh_build_dup_##name(__kh_build_##name##_t *b, khint_t x, khint_t i)                     \
+    {                                                                                                               \
+        if (!((kh_opts) & KH_MAP) || !b->vals)                                                                      \
+            return;                                                                                                 \
+        if (b->combine)                                                                                             \
+            b->combine(&kh_val(b->h, x), &b->vals[i * b->val_step], b->ctx);                                        \
+        else                                                                                                        \
+            kh_val(b->h, x) = b->vals[i * b->val_step];                                                             \
+    }                                                                                                               \
+    static void __kh_build_hash_##name(void *arg, int t)                                                            \
+    {                                                                                                               \
+        __kh_build_##name##_t *b = (__kh_build_##name##_t *)arg;                                                    \
+        khint_t *cnt = b->cnt + (size_t)t * b->n_regions;                                                           \
+        khint_t lo = (khint_t)((uint64_t)b->n * t / b->n_threads);                                                  \
+        khint_t hi = (khint_t)((uint64_t)b->n * (t + 1) / b->n_threads);                                            \
+        for (khint_t i = lo; i < hi; ++i)                                                                           \
+        {                                                                                                           \
+            if (!__kh_build_has_##name(b, i))                                                                       \
+                continue;                                                                                           \
+            b->hs[i] = b->src ? __kh_hash_at_##name(b->src, i)                                                      \
+                              : __kh_hash_##name(b->h, b->keys[i * b->key_step]);                                   \
+            ++cnt[__kh_home_##name(b->h, b->hs[i]) >> b->shift];                                                    \
+        }                                                                                                           \
+    }                                                                                                               \
+    static void __kh_build_scatter_##name(void *arg, int t)                                                         \
+    {                                                                                                               \
+        __kh_build_##name##_t *b = (__kh_build_##name##_t *)arg;                                                    \
+        khint_t *cnt = b->cnt + (size_t)t * b->n_regions;                                                           \
+        khint_t lo = (khint_t)((uint64_t)b->n * t / b->n_threads);                                                  \
+        khint_t hi = (khint_t)((uint64_t)b->n * (t + 1) / b->n_threads);                                            \
+        for (khint_t i = lo; i < hi; ++i)                                                                           \
+            if (__kh_build_has_##name(b, i))                                                                        \
+                b->idx[cnt[__kh_home_##name(b->h, b->hs[i]) >> b->shift]++] = i;                                    \
+    }                                                                                                               \
+    /* Insert key i if its probe stays in buckets [lo, hi); returns 1 if it is new, 0 if it was there, -1 if it     \
+       left the region. The table is fresh, so there are no deleted buckets, and the keys of a resize differ. */    \
+    static kh_inline int __kh_build_place_##name(__kh_build_##name##_t *b, khint_t i, khint_t lo, khint_t hi)       \
+    {                                                                                                               \
+        kh_##name##_t *h = b->h;                                                                                    \
+        khint_t k = b->hs[i], mask = h->n_buckets - 1, x = k & mask, step = 0;                                      \
+        while (x >= lo && x < hi)                                                                                   \
+        {                                                                                                           \
+            if (__ac_isempty(h->flags, x))                                                                          \
+            {                                                                                                       \
+                kh_key(h, x) = b->keys[i * b->key_step];                                                            \
+                __ac_set_isboth_false(h->flags, x);                                                                 \
+                if ((kh_opts) & KH_STORE_HASH)                                                                      \
+                    h->hashes[x] = k;                                                                               \
+                if ((kh_opts) & KH_MAP && b->vals)                                                                  \
+                    kh_val(h, x) = b->vals[i * b->val_step];                                                        \
+                return 1;                                                                                           \
+            }                                                                                                       \
+            if (!b->src && __kh_key_eq_##name(h, x, b->keys[i * b->key_step], k))                                   \
+            {                                                                                                       \
+                __kh_build_dup_##name(b, x, i);                                                                     \
+                return 0;                                                                                           \
+            }                                                                                                       \
+            x = (x + (++step)) & mask;                                                                              \
+        }                                                                                                           \
+        return -1;                                                                                                  \
+    }                                                                                                               \
+    static void __kh_build_fill_##name(void *arg, int t)                                                            \
+    {                                                                                                               \
+        __kh_build_##name##_t *b = (__kh_build_##name##_t *)arg;                                                    \
+        khint_t n_new = 0;                                                                                          \
+        size_t r;                                                                                                   \
+        while ((r = atomic_fetch_add(&b->next, 1)) < (size_t)b->n_regions)                                          \
+        {                                                                                                           \
+            khint_t lo = (khint_t)r << b->shift, hi = lo + ((khint_t)1 << b->shift), n_aside = 0;                   \
+            for (khint_t j = b->start[r]; j < b->start[r + 1]; ++j)                                                 \
+            {                                                                                                       \
+                khint_t i = b->idx[j];                                                                              \
+                int ret = __kh_build_place_##name(b, i, lo, hi);                                                    \
+                if (ret < 0)                                                                                        \
+                    b->idx[b->start[r] + n_aside++] = i;                                                            \
+                else                                                                                                \
+                    n_new += ret;                                                                                   \
+            }                                                                                                       \
+            b->n_aside[r] = n_aside;                                                                                \
+        }                                                                                                           \
+        b->n_new[t] = n_new;                                                                                        \
+    }                                                                                                               \
+    /* Insert at most n_keys keys into b->h, which must have room for all; returns 0, or -1 if out of memory */     \
+    static int __kh_build_run_##name(__kh_build_##name##_t *b, khint_t n_keys)                                      \
+    {                                                                                                               \
+        kh_##name##_t *h = b->h;                                                                                    \
+        int ret = -1;                                                                                               \
+        { /* regions of KH_BUILD_REGION_BYTES, but at least 1024 buckets so no flags word or group is shared */     \
+            size_t bytes = sizeof(khkey_t) + ((kh_opts) & KH_MAP ? sizeof(khval_t) : 0) +                           \
+                           ((kh_opts) & KH_STORE_HASH ? sizeof(khint_t) : 0);                                       \
+            b->shift = 10;                                                                                          \
+            while (b->shift < 30 && ((size_t)2 << b->shift) * bytes <= KH_BUILD_REGION_BYTES)                       \
+                ++b->shift;                                                                                         \
+            while (((khint_t)1 << b->shift) > h->n_buckets)                                                         \
+                --b->shift;                                                                                         \
+        }                                                                                                           \
+        b->n_regions = h->n_buckets >> b->shift;                                                                    \
+        b->hs = (khint_t *)kmalloc((size_t)b->n * sizeof(khint_t));                                                 \
+        b->idx = (khint_t *)kmalloc((size_t)n_keys * sizeof(khint_t));                                              \
+        b->cnt = (khint_t *)kcalloc((size_t)b->n_threads * b->n_regions, sizeof(khint_t));                          \
+        b->start = (khint_t *)kmalloc(((size_t)b->n_regions + 1) * sizeof(khint_t));                                \
+        b->n_aside = (khint_t *)kmalloc((size_t)b->n_regions * sizeof(khint_t));                                    \
+        b->n_new = (khint_t *)kcalloc((size_t)b->n_threads, sizeof(khint_t));                                       \
+        if (!b->hs || !b->idx || !b->cnt || !b->start || !b->n_aside || !b->n_new)                                  \
+            goto end;                                                                                               \
+        __kh_par_run(b->n_threads, __kh_build_hash_##name, b);                                                      \
+        khint_t pos = 0;                                                                                            \
+        for (khint_t r = 0; r < b->n_regions; ++r)                                                                  \
+        { /* region by region, each thread's keys after those of the threads before it */                           \
+            b->start[r] = pos;                                                                                      \
+            for (int t = 0; t < b->n_threads; ++t)                                                                  \
+            {                                                                                                       \
+                khint_t c = b->cnt[(size_t)t * b->n_regions + r];                                                   \
+                b->cnt[(size_t)t * b->n_regions + r] = pos;                                                         \
+                pos += c;                                                                                           \
+            }                                                                                                       \
+        }                                                                                                           \
+        b->start[b->n_regions] = pos;                                                                               \
+        __kh_par_run(b->n_threads, __kh_build_scatter_##name, b);                                                   \
+        if ((kh_opts) & KH_SWISS || __kh_robinhood(kh_opts))                                                        \
+        { /* filled below, one region at a time */                                                                  \
+            for (khint_t r = 0; r < b->n_regions; ++r)                                                              \
+                b->n_aside[r] = b->start[r + 1] - b->start[r];                                                      \
+        }                                                                                                           \
+        else                                                                                                        \
+        {                                                                                                           \
+            atomic_init(&b->next, 0);                                                                               \
+            __kh_par_run(b->n_threads, __kh_build_fill_##name, b);                                                  \
+            for (int t = 0; t < b->n_threads; ++t)                                                                  \
+                h->size += b->n_new[t];                                                                             \
+            h->n_occupied = h->size;                                                                                \
+        }                                                                                                           \
+        for (khint_t r = 0; r < b->n_regions; ++r)                                                                  \
+            for (khint_t j = b->start[r]; j < b->start[r] + b->n_aside[r]; ++j)                                     \
+            {                                                                                                       \
+                khint_t i = b->idx[j];                                                                              \
+                khint_t x = __kh_insert_##name(h, b->keys[i * b->key_step], b->hs[i], &ret);                        \
+                if (!ret)                                                                                           \
+                    __kh_build_dup_##name(b, x, i);                                                                 \
+                else if ((kh_opts) & KH_MAP && b->vals)                                                             \
+                    kh_val(h, x) = b->vals[i * b->val_step];                                                        \
+            }                                                                                                       \
+        ret = 0;                                                                                                    \
+    end:                                                                                                            \
+        kfree(b->hs);                                                                                               \
+        kfree(b->idx);                                                                                              \
+        kfree(b->cnt);                                                                                              \
+        kfree(b->start);                                                                                            \
+        kfree(b->n_aside);                                                                                          \
+        kfree(b->n_new);                                                                                            \
+        return ret;                                                                                                 \
+    }                                                                                                               \
+    SCOPE kh_##name##_t *kh_build_combine_##name(const khkey_t *keys, const khval_t *vals, size_t n, int n_threads, \
+                                                 void (*combine)(khval_t *acc, const khval_t *v, void *ctx),        \
+                                                 void *ctx)                                                         \
+    {                                                                                                               \
+        kh_##name##_t *h = kh_init_##name();                                                                        \
+        if (!h || n == 0)                                                                                           \
+            return h;                                                                                               \
+        if ((double)n / h->max_load + 1 >= (double)((khint_t)1 << (sizeof(khint_t) * 8 - 2)) ||                     \
+            kh_resize_##name(h, (khint_t)(n / h->max_load) + 1) < 0)                                                \
+        {                                                                                                           \
+            kh_destroy_##name(h);                                                                                   \
+            return NULL;                                                                                            \
+        }                                                                                                           \
+        __kh_build_##name##_t b;                                                                                    \
+        memset(&b, 0, sizeof(b));                                                                                   \
+        b.h = h;                                                                                                    \
+        b.keys = keys;                                                                                              \
+        b.vals = vals;                                                                                              \
+        b.key_step = b.val_step = 1;                                                                                \
+        b.combine = combine;                                                                                        \
+        b.ctx = ctx;                                                                                                \
+        b.n = (khint_t)n;                                                                                           \
+        b.n_threads = __kh_par_clamp(n_threads);                                                                    \
+        if (__kh_build_run_##name(&b, b.n) < 0)                                                                     \
+        {                                                                                                           \
+            kh_destroy_##name(h);                                                                                   \
+            return NULL;                                                                                            \
+        }                                                                                                           \
+        return h;                                                                                                   \
+    }                                                                                                               \
+    SCOPE kh_##name##_t *kh_build_##name(const khkey_t *keys, const khval_t *vals, size_t n, int n_threads)         \
+    {                                                                                                               \
+        return kh_build_combine_##name(keys, vals, n, n_threads, NULL, NULL);                                       \
+    }                                                                                                               \
+    /* The resize hook of khash.h: moves the keys of a large table into new arrays on several threads */            \
+    static int __kh_par_resize_##name(kh_##name##_t *h, khint_t new_n_buckets)                                      \
+    {                                                                                                               \
+        int n_threads = __kh_par_threads();                                                                         \
+        if ((kh_opts) & KH_SWISS || __kh_robinhood(kh_opts) || n_threads < 2 || h->size < KH_PAR_RESIZE_MIN)        \
+            return 1;                                                                                               \
+        kh_##name##_t dst = *h; /* same options and allocator, new buckets */                                       \
+        dst.size = dst.n_occupied = 0;                                                                              \
+        dst.old = NULL;                                                                                             \
+        if (__kh_alloc_buckets_##name(&dst, new_n_buckets) < 0)                                                     \
+            return 1;                                                                                               \
+        __kh_build_##name##_t b;                                                                                    \
+        memset(&b, 0, sizeof(b));                                                                                   \
+        b.h = &dst;                                                                                                 \
+        b.src = h;                                                                                                  \
+        b.keys = h->keys;                                                                                           \
+        b.vals = h->vals;                                                                                           \
+        b.key_step = sizeof(h->key_stride);                                                                         \
+        b.val_step = sizeof(h->val_stride);                                                                         \
+        b.n = h->n_buckets;                                                                                         \
+        b.n_threads = n_threads;                                                                                    \
+        if (__kh_build_run_##name(&b, h->size) < 0)                                                                 \
+            goto fail;                                                                                              \
+        __kh_free_buckets_##name(h);                                                                                \
+        h->flags = dst.flags;                                                                                       \
+        h->keys = dst.keys;                                                                                         \
+        h->vals = dst.vals;                                                                                         \
+        h->hashes = dst.hashes;                                                                                     \
+        h->n_buckets = new_n_buckets;                                                                               \
+        h->n_occupied = h->size;                                                                                    \
+        h->upper_bound = __ac_load_bound(h->n_buckets, h->max_load);                                                \
+        return 0;                                                                                                   \
+    fail: /* the new arrays did not fit next to the old ones; kh_resize() reuses the old ones */                    \
+        __kh_free_buckets_##name(&dst);                                                                             \
+        return 1;                                                                                                   \
+    }
+
+/*! @function
+  @abstract     Instantiate a hash table with multi-threaded operations
+  @param  name  Name of the hash table [symbol]
+  @param  khkey_t  Type of keys [type]
+  @param  khval_t  Type of values [type]
+  @param  kh_opts  Options, as for KHASH_INIT() [int]
+  @param  __hash_func  Hash function, as for KHASH_INIT()
+  @param  __hash_equal  Comparison function, as for KHASH_INIT()
+  @discussion   Also instantiates the plain table `name`, except that
+                kh_resize() moves the keys of tables with at least
+                KH_PAR_RESIZE_MIN keys on KH_PAR_THREADS threads.
+ */
+#define KHASH_PARALLEL_INIT(name, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal)                           \
+    __KHASH_TYPE(name, khkey_t, khval_t, kh_opts)                                                                 \
+    __KHASH_HASH(name, khkey_t, __hash_func)                                                                      \
+    static int __kh_par_resize_##name(kh_##name##_t *h, khint_t new_n_buckets);                                   \
+    __KHASH_IMPL_HOOKED(name, static kh_inline klib_unused, khkey_t, khval_t, kh_opts, __hash_func, __hash_equal, \
+                        __kh_par_resize_##name)                                                                   \
+    __KHASH_PARALLEL_IMPL(name, static kh_inline klib_unused, khkey_t, khval_t, kh_opts, __hash_func)
+
+/*! @function
+  @abstract     Build a hash table from arrays of keys and values on several threads.
+  @param  name  Name of the hash table [symbol]
+  @param  keys  Keys [const khkey_t*]
+  @param  vals  Values, one per key; NULL for a set, or to leave the values unset [const khval_t*]
+  @param  n     Number of keys [size_t]
+  @param  n_threads  Threads to use, the calling one included [int]
+  @return       Pointer to the new hash table, NULL on failure [khash_t(name)*]
+  @discussion   When a key occurs more than once, the value of its last
+                occurrence is kept. The table is sized for n distinct keys.
+ */
+#define kh_build(name, keys, vals, n, n_threads) kh_build_##name(keys, vals, n, n_threads)
+
+/*! @function
+  @abstract     Build a hash table from arrays, combining the values of equal keys.
+  @param  name  Name of the hash table [symbol]
+  @param  keys  Keys [const khkey_t*]
+  @param  vals  Values, one per key [const khval_t*]
+  @param  n     Number of keys [size_t]
+  @param  n_threads  Threads to use, the calling one included [int]
+  @param  combine  Called as combine(&acc, &v, ctx) for every occurrence of a
+                key after the first, in input order [void (*)(khval_t*, const khval_t*, void*)]
+  @param  ctx   Handed to combine [void*]
+  @return       Pointer to the new hash table, NULL on failure [khash_t(name)*]
+  @discussion   combine runs on any of the threads, but never on two
+                occurrences of the same key at once.
+ */
+#define kh_build_combine(name, keys, vals, n, n_threads, combine, ctx) \
+    kh_build_combine_##name(keys, vals, n, n_threads, combine, ctx)
+
+/*! @function
+  @abstract     Scan a hash table on several threads.
+  @param  h     Pointer to the hash table [khash_t(name)*]
+  @param  n_threads  Threads to use, the calling one included [int]
+  @param  fn    Called once on each thread t as fn(arg, t, begin, end), where
+                [begin, end) is kh_split(h, t, n_threads) to kh_split(h, t + 1,
+                n_threads); iterate it with kh_foreach_range()
+                [void (*)(void*, int, khint_t, khint_t)]
+  @param  arg   Handed to fn [void*]
+  @discussion   The table must not change during the scan.
+ */
+#define kh_par_scan(h, n_threads, fn, arg) __kh_par_scan(__kh_iter_end(h), n_threads, fn, arg)
+
+#endif /* __AC_KHASH_PARALLEL_H */
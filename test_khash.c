@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include "khash.h"
 
 // Declare test hash tables
@@ -8,6 +9,56 @@ KHASH_MAP_INIT_INT(int32, int) // int -> int hash map
 KHASH_MAP_INIT_STR(str, int)   // string -> int hash map
 KHASH_SET_INIT_INT(intset)     // int set
 
+// Same maps on the control-byte engine
+KHASH_INIT(swiss32, khint32_t, int, KH_MAP | KH_SWISS, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(swissstr, kh_cstr_t, int, KH_MAP | KH_SWISS, kh_str_hash_func, kh_str_hash_equal)
+
+// String maps with each of the string hashes
+KHASH_INIT(sx31, kh_cstr_t, int, KH_MAP, kh_str_hash_x31, kh_str_hash_equal)
+KHASH_INIT(sfnv, kh_cstr_t, int, KH_MAP, kh_fnv_hash_str, kh_str_hash_equal)
+KHASH_INIT(swy, kh_cstr_t, int, KH_MAP, kh_str_hash_wy, kh_str_hash_equal)
+
+// Interning table
+KHASH_INTERN_INIT(atoms)
+
+// String maps that keep each key's hash
+KHASH_INIT(hstr, kh_cstr_t, int, KH_MAP | KH_STORE_HASH, kh_str_hash_func, kh_str_hash_equal)
+KHASH_INIT(swisshstr, kh_cstr_t, int, KH_MAP | KH_SWISS | KH_STORE_HASH, kh_str_hash_func, kh_str_hash_equal)
+
+// Robin Hood maps
+KHASH_INIT(rh32, khint32_t, int, KH_MAP | KH_ROBINHOOD, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(rhstr, kh_cstr_t, int, KH_MAP | KH_ROBINHOOD | KH_STORE_HASH, kh_str_hash_func, kh_str_hash_equal)
+
+// Tables with their own load factor and growth
+KHASH_INIT(sparse32, khint32_t, int, KH_MAP | KH_LOAD(50) | KH_GROWTH(4), kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(dense32, khint32_t, char, KH_SET | KH_ROBINHOOD | KH_LOAD(90), kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(denseswiss, khint32_t, char, KH_SET | KH_SWISS | KH_LOAD(90), kh_int32_hash_func, kh_int_hash_equal)
+
+// Maps keeping keys and values side by side
+typedef struct
+{
+    char c[3];
+} rgb_t;
+KHASH_INIT(kv32, khint32_t, int, KH_MAP | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(kvswiss, khint64_t, int, KH_MAP | KH_SWISS | KH_INTERLEAVED, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_INIT(kvrh, khint32_t, khint64_t, KH_MAP | KH_ROBINHOOD | KH_STORE_HASH | KH_INTERLEAVED, kh_int32_hash_func,
+           kh_int_hash_equal)
+KHASH_INIT(kvrgb, khint32_t, rgb_t, KH_MAP | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(kvset, khint32_t, char, KH_SET | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+
+// Tables hashed with a seed of their own
+KHASH_MAP_INIT_STR_SEEDED(sstr, int)
+KHASH_MAP_INIT_INT64_SEEDED(s64, int)
+KHASH_INIT_SEEDED(sswiss, khint64_t, int, KH_MAP | KH_SWISS | KH_STORE_HASH, kh_int64_hash_seeded, kh_int64_hash_equal)
+KHASH_INIT_SEEDED(srh, khint32_t, char, KH_SET | KH_ROBINHOOD, kh_int_hash_seeded, kh_int_hash_equal)
+#define seedless_hash(key, seed) ((void)(seed), (khint_t)(key) & ~(khint_t)0xfff) // ignores its seed
+KHASH_INIT_SEEDED(sbad, khint32_t, char, KH_SET, seedless_hash, kh_int_hash_equal)
+
+// Tables of string views
+KHASH_MAP_INIT_SV(sv, int)
+KHASH_SET_INIT_SV_SEEDED(svseeded)
+KHASH_INIT(svswiss, kh_strview_t, int, KH_MAP | KH_SWISS | KH_STORE_HASH, kh_sv_hash_func, kh_sv_hash_equal)
+
 void test_int_hash_map()
 {
     printf("Testing integer hash map...\n");
@@ -155,6 +206,59 @@ void test_iteration()
     printf("Iteration tests passed!\n");
 }
 
+// Inserts a corpus, then prints probe statistics and lookup time for one string hash
+#define PROBE_STRING_HASH(name, label, keys, n)                                                   \
+    {                                                                                             \
+        khash_t(name) *h = kh_init(name);                                                         \
+        int ret;                                                                                  \
+        for (int i = 0; i < n; i++)                                                               \
+            kh_put(name, h, keys[i], &ret);                                                       \
+        kh_probe_stat_t st = kh_probe_stats(name, h);                                             \
+        clock_t t0 = clock();                                                                     \
+        for (int rep = 0; rep < 5; rep++)                                                         \
+            for (int i = 0; i < n; i++)                                                           \
+                assert(kh_get(name, h, keys[i]) != kh_end(h));                                    \
+        double ns = (double)(clock() - t0) / CLOCKS_PER_SEC * 1e9 / (5.0 * n);                    \
+        printf("    %-5s avg probes %5.2f  max %4d  variance %7.2f  %6.1f ns/get\n", label,       \
+               st.avg_probes, st.max_probes, st.variance, ns);                                    \
+        assert(st.avg_probes >= 1.0);                                                             \
+        if (strcmp(label, "wy") == 0) /* a good hash stays near the ideal of ~1.5 at this load */ \
+            assert(st.avg_probes < 2.5);                                                          \
+        kh_destroy(name, h);                                                                      \
+    }
+
+// Probe lengths of the string hashes on a few kinds of keys
+static void probe_string_hashes()
+{
+    enum
+    {
+        N = 20000
+    };
+    static char buf[N][96];
+    static const char *keys[N];
+    const char *corpora[] = {"sequential ids", "URLs", "hex digests"};
+    for (int c = 0; c < 3; c++)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            unsigned x = (unsigned)i * 2654435761u;
+            if (c == 0)
+                snprintf(buf[i], sizeof(buf[i]), "user%06d", i);
+            else if (c == 1)
+                snprintf(buf[i], sizeof(buf[i]), "https://www.example.org/products/category-%u/item-%d.html", x % 97, i);
+            else
+                snprintf(buf[i], sizeof(buf[i]), "%08x%08x%08x%08x", x, x ^ 0xdeadbeefu, x * 31u, (unsigned)i);
+            keys[i] = buf[i];
+        }
+        printf("  %s:\n", corpora[c]);
+        PROBE_STRING_HASH(sx31, "x31", keys, N);
+        PROBE_STRING_HASH(sfnv, "fnv", keys, N);
+        PROBE_STRING_HASH(swy, "wy", keys, N);
+    }
+    // The length-aware variant agrees with the null terminated one
+    assert(kh_strn_hash_func("hello world", 5) == kh_str_hash_wy("hello"));
+}
+
 void test_probe_statistics()
 {
     printf("Testing hash table probe statistics...\n");
@@ -208,9 +312,1212 @@ void test_probe_statistics()
     printf("  Probe variance: %.2f\n", stats.variance);
 
     kh_destroy(int32, h);
+
+    printf("\nString hashes on string corpora...\n");
+    probe_string_hashes();
     printf("Probe statistics tests passed!\n");
 }
 
+void test_swiss_engine()
+{
+    printf("Testing control-byte (KH_SWISS) engine...\n");
+
+    khash_t(swiss32) *h = kh_init(swiss32);
+    khash_t(int32) *ref = kh_init(int32);
+    int ret;
+
+    // Mixed inserts and deletes, checked against the default engine
+    for (int i = 0; i < 20000; i++)
+    {
+        int key = (i * 7919) % 5003;
+        khint_t k = kh_get(swiss32, h, key);
+        khint_t r = kh_get(int32, ref, key);
+        assert((k == kh_end(h)) == (r == kh_end(ref)));
+        if (k != kh_end(h))
+        {
+            assert(kh_value(h, k) == kh_value(ref, r));
+            if (i % 3 == 0)
+            {
+                kh_del(swiss32, h, k);
+                kh_del(int32, ref, r);
+                continue;
+            }
+        }
+        k = kh_put(swiss32, h, key, &ret);
+        assert(ret >= 0);
+        kh_value(h, k) = i;
+        r = kh_put(int32, ref, key, &ret);
+        kh_value(ref, r) = i;
+    }
+    assert(kh_size(h) == kh_size(ref));
+
+    int count = 0;
+    int32_t key, value;
+    kh_foreach(h, key, value, {
+        khint_t r = kh_get(int32, ref, key);
+        assert(r != kh_end(ref) && kh_value(ref, r) == value);
+        count++;
+    });
+    assert(count == (int)kh_size(ref));
+
+    // Misses on a table that only ever grew
+    for (int i = 5003; i < 6000; i++)
+        assert(kh_get(swiss32, h, i) == kh_end(h));
+
+    kh_probe_stat_t stats = kh_probe_stats(swiss32, h);
+    printf("  Maximum group probes: %d\n", stats.max_probes);
+    printf("  Average group probes: %.2f\n", stats.avg_probes);
+
+    kh_clear(swiss32, h);
+    assert(kh_size(h) == 0);
+    assert(kh_get(swiss32, h, 7919) == kh_end(h));
+
+    kh_destroy(swiss32, h);
+    kh_destroy(int32, ref);
+
+    khash_t(swissstr) *s = kh_init(swissstr);
+    khint_t k = kh_put(swissstr, s, "hello", &ret);
+    assert(ret == 1);
+    kh_value(s, k) = 42;
+    k = kh_put(swissstr, s, "hello", &ret);
+    assert(ret == 0);
+    k = kh_get(swissstr, s, "hello");
+    assert(k != kh_end(s) && kh_value(s, k) == 42);
+    assert(kh_get(swissstr, s, "world") == kh_end(s));
+    kh_del(swissstr, s, k);
+    assert(kh_get(swissstr, s, "hello") == kh_end(s));
+    kh_destroy(swissstr, s);
+
+    printf("Control-byte engine tests passed!\n");
+}
+
+void test_batch()
+{
+    printf("Testing batched lookup and insertion...\n");
+
+    enum { N = 1000 };
+    khint32_t keys[N];
+    khint_t its[N];
+    int rets[N];
+    for (int i = 0; i < N; i++)
+        keys[i] = i * 3 % 1500; // keys repeat after 500 entries
+
+    khash_t(int32) *h = kh_init(int32);
+    assert(kh_put_batch(int32, h, keys, N, its, rets) == 0);
+    for (int i = 0; i < N; i++)
+    {
+        assert(kh_key(h, its[i]) == keys[i]);
+        assert(rets[i] == (i < 500 ? 1 : 0));
+        kh_value(h, its[i]) = keys[i] * 10;
+    }
+    assert(kh_size(h) == 500);
+
+    // Half of the lookups miss
+    for (int i = 0; i < N; i++)
+        keys[i] = i * 3 / 2;
+    kh_get_batch(int32, h, keys, N, its);
+    for (int i = 0; i < N; i++)
+    {
+        assert(its[i] == kh_get(int32, h, keys[i]));
+        if (its[i] != kh_end(h))
+            assert(kh_value(h, its[i]) == keys[i] * 10);
+    }
+
+    khash_t(swiss32) *s = kh_init(swiss32);
+    kh_get_batch(swiss32, s, keys, N, its); // empty table
+    for (int i = 0; i < N; i++)
+        assert(its[i] == kh_end(s));
+    assert(kh_put_batch(swiss32, s, keys, N, its, NULL) == 0);
+    kh_get_batch(swiss32, s, keys, N, its);
+    for (int i = 0; i < N; i++)
+        assert(its[i] != kh_end(s) && kh_key(s, its[i]) == keys[i]);
+
+    kh_destroy(int32, h);
+    kh_destroy(swiss32, s);
+    printf("Batch tests passed!\n");
+}
+
+// Re-puts present keys into a full table, so that the first one starts an incremental rehash
+#define CHECK_REPUT_AT_GROWTH(name)                                                         \
+    {                                                                                       \
+        khash_t(name) *h = kh_init(name);                                                   \
+        kh_set_incremental(h, 8);                                                           \
+        khint_t x;                                                                          \
+        int ret;                                                                            \
+        for (int i = 0; !kh_n_buckets(h) || h->old || h->n_occupied < h->upper_bound; i++) \
+        {                                                                                   \
+            x = kh_put(name, h, i, &ret);                                                   \
+            kh_value(h, x) = i * 2;                                                         \
+        }                                                                                   \
+        khint_t n = kh_size(h);                                                             \
+        x = kh_put(name, h, 0, &ret);                                                       \
+        assert(ret == 0 && h->old != NULL && kh_size(h) == n && kh_value(h, x) == 0);       \
+        for (khint_t i = 0; i < n; i++)                                                     \
+        { /* count the keys a second time */                                                \
+            x = kh_put(name, h, i, &ret);                                                   \
+            assert(ret == 0);                                                               \
+            kh_value(h, x)++;                                                               \
+        }                                                                                   \
+        kh_migrate(name, h, 0);                                                             \
+        assert(kh_size(h) == n);                                                            \
+        for (khint_t i = 0; i < n; i++)                                                     \
+            assert(kh_value(h, kh_get(name, h, i)) == (int)i * 2 + 1);                      \
+        kh_destroy(name, h);                                                                \
+    }
+
+void test_incremental_rehash()
+{
+    printf("Testing incremental rehashing...\n");
+
+    khash_t(int32) *h = kh_init(int32);
+    khash_t(swiss32) *s = kh_init(swiss32);
+    kh_set_incremental(h, 8);
+    kh_set_incremental(s, 8);
+    int ret, migrations = 0;
+    static char deleted[50000];
+
+    for (int i = 0; i < 50000; i++)
+    {
+        khint_t k = kh_put(int32, h, i, &ret);
+        assert(ret > 0);
+        kh_value(h, k) = i * 10;
+        k = kh_put(swiss32, s, i, &ret);
+        assert(ret > 0);
+        kh_value(s, k) = i * 10;
+
+        if (i % 3 == 0) // delete some keys, possibly still in the old buckets
+        {
+            kh_del(int32, h, kh_get(int32, h, i / 2));
+            kh_del(swiss32, s, kh_get(swiss32, s, i / 2));
+            deleted[i / 2] = 1;
+        }
+
+        if (h->old && i % 1000 == 0)
+        { // in the middle of a migration: counts, iteration and lookups agree
+            migrations++;
+            khint_t count = 0;
+            int32_t key, value;
+            kh_foreach(h, key, value, {
+                assert(value == key * 10);
+                count++;
+            });
+            assert(count == kh_size(h));
+            kh_probe_stat_t stats = kh_probe_stats(int32, h);
+            assert(stats.max_probes >= 1 && stats.avg_probes >= 1.0);
+        }
+    }
+    assert(migrations > 0);
+    assert(kh_size(h) == kh_size(s));
+
+    for (int i = 0; i < 50000; i++)
+    {
+        khint_t k = kh_get(int32, h, i);
+        assert((k == kh_end(h)) == deleted[i]);
+        if (!deleted[i])
+            assert(kh_value(h, k) == i * 10);
+        k = kh_get(swiss32, s, i);
+        assert((k == kh_end(s)) == deleted[i]);
+        if (!deleted[i])
+            assert(kh_value(s, k) == i * 10);
+    }
+
+    kh_migrate(int32, h, 0);
+    assert(h->old == NULL);
+
+    // Destroying in the middle of a migration must not leak
+    while (!s->old)
+        kh_put(swiss32, s, 100000 + kh_size(s), &ret);
+    kh_destroy(int32, h);
+    kh_destroy(swiss32, s);
+
+    // A put that starts the rehash still finds the key among the buckets it set aside
+    CHECK_REPUT_AT_GROWTH(int32);
+    CHECK_REPUT_AT_GROWTH(swiss32);
+    CHECK_REPUT_AT_GROWTH(rh32);
+    printf("Incremental rehash tests passed!\n");
+}
+
+#define CHECK_STORED_HASH(name, h, keys, n)                                  \
+    {                                                                        \
+        int ret;                                                             \
+        for (int i = 0; i < n; i++)                                          \
+        {                                                                    \
+            khint_t k = kh_put(name, h, keys[i], &ret);                      \
+            assert(ret > 0);                                                 \
+            kh_value(h, k) = i;                                              \
+        }                                                                    \
+        for (int i = 0; i < n; i += 3)                                       \
+            kh_del(name, h, kh_get(name, h, keys[i]));                       \
+        kh_resize(name, h, kh_n_buckets(h) * 2); /* rehash from the cache */ \
+        for (int i = 0; i < n; i++)                                          \
+        {                                                                    \
+            khint_t k = kh_get(name, h, keys[i]);                            \
+            assert((k == kh_end(h)) == (i % 3 == 0));                        \
+            if (k != kh_end(h))                                              \
+                assert(kh_value(h, k) == i);                                 \
+        }                                                                    \
+        for (khint_t k = kh_begin(h); k != kh_end(h); ++k)                   \
+            if (kh_exist(h, k))                                              \
+                assert(h->hashes[k] == kh_str_hash_func(kh_key(h, k)));      \
+    }
+
+void test_stored_hash()
+{
+    printf("Testing stored hashes (KH_STORE_HASH)...\n");
+
+    enum
+    {
+        N = 5000
+    };
+    static char buf[N][32];
+    static const char *keys[N];
+    for (int i = 0; i < N; i++)
+    {
+        snprintf(buf[i], sizeof(buf[i]), "https://example.com/%d", i * 31);
+        keys[i] = buf[i];
+    }
+
+    khash_t(hstr) *h = kh_init(hstr);
+    CHECK_STORED_HASH(hstr, h, keys, N);
+    kh_probe_stat_t stats = kh_probe_stats(hstr, h);
+    assert(stats.avg_probes >= 1.0);
+    kh_destroy(hstr, h);
+
+    khash_t(swisshstr) *s = kh_init(swisshstr);
+    CHECK_STORED_HASH(swisshstr, s, keys, N);
+    kh_destroy(swisshstr, s);
+
+    // Keys still in the old buckets during an incremental rehash
+    h = kh_init(hstr);
+    kh_set_incremental(h, 8);
+    CHECK_STORED_HASH(hstr, h, keys, N);
+    kh_destroy(hstr, h);
+
+    printf("Stored hash tests passed!\n");
+}
+
+void test_intern()
+{
+    printf("Testing string interning...\n");
+
+    khash_t(atoms) *h = kh_init(atoms);
+    assert(kh_intern_get(atoms, h, "none") == -1);
+
+    // The table keeps its own copy, so the caller's buffer can be reused
+    char buf[32];
+    strcpy(buf, "alpha");
+    assert(kh_intern(atoms, h, buf) == 0);
+    strcpy(buf, "beta");
+    assert(kh_intern(atoms, h, buf) == 1);
+    assert(kh_intern(atoms, h, "alpha") == 0);
+    assert(kh_intern_n(atoms, h, "beta-gamma", 4) == 1);
+    assert(kh_intern_n(atoms, h, "beta-gamma", 10) == 2);
+    assert(strcmp(kh_intern_str(h, 0), "alpha") == 0);
+    assert(strcmp(kh_intern_str(h, 2), "beta-gamma") == 0);
+
+    // Enough strings for several arena blocks and table resizes
+    const char *first = kh_intern_str(h, 0);
+    for (int i = 0; i < 100000; i++)
+    {
+        snprintf(buf, sizeof(buf), "atom-%d", i % 60000);
+        khint32_t id = kh_intern(atoms, h, buf);
+        assert(id == (khint32_t)(i < 60000 ? i + 3 : i - 60000 + 3));
+    }
+    assert(kh_size(h) == 60003 && kh_intern_size(h) == 60003);
+    assert(kh_intern_str(h, 0) == first); // pointers are stable
+    for (khint32_t id = 3; id < 60003; id++)
+    {
+        snprintf(buf, sizeof(buf), "atom-%d", id - 3);
+        assert(strcmp(kh_intern_str(h, id), buf) == 0);
+        assert(kh_intern_get(atoms, h, buf) == id);
+    }
+
+    // Duplicates do not consume arena space
+    size_t bytes = h->arena->bytes;
+    assert(kh_intern(atoms, h, "atom-7") == 10);
+    assert(h->arena->bytes == bytes);
+
+    kh_clear(atoms, h);
+    assert(kh_intern_size(h) == 0);
+    assert(kh_intern(atoms, h, "beta") == 0);
+
+    kh_destroy(atoms, h); // frees the arena too
+    printf("Interning tests passed!\n");
+}
+
+// Allocator that checks every release against the bytes handed out
+typedef struct
+{
+    long calls, blocks;
+    size_t bytes;
+} counting_ctx_t;
+
+static void *counting_alloc(void *ctx, size_t size)
+{
+    counting_ctx_t *c = ctx;
+    c->calls++, c->blocks++, c->bytes += size;
+    return malloc(size);
+}
+
+static void *counting_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    counting_ctx_t *c = ctx;
+    assert(c->bytes >= old_size);
+    c->calls++, c->bytes += new_size - old_size;
+    return realloc(p, new_size);
+}
+
+static void counting_release(void *ctx, void *p, size_t size)
+{
+    counting_ctx_t *c = ctx;
+    assert(p != NULL && c->blocks > 0 && c->bytes >= size);
+    c->blocks--, c->bytes -= size;
+    free(p);
+}
+
+void test_allocator()
+{
+    printf("Testing per-table allocators...\n");
+
+    counting_ctx_t ctx = {0, 0, 0};
+    kalloc_t a = {counting_alloc, counting_resize, counting_release, &ctx};
+    int ret;
+
+    // Plain engine, with an incremental migration left in flight
+    khash_t(int32) *h = kh_init_with_alloc(int32, &a);
+    assert(h != NULL && h->alloc == &a);
+    kh_set_incremental(h, 8);
+    for (int i = 0; i < 20000; i++)
+    {
+        khint_t k = kh_put(int32, h, i, &ret);
+        kh_value(h, k) = i;
+    }
+    while (!h->old)
+        kh_put(int32, h, 20000 + kh_size(h), &ret);
+    for (int i = 0; i < 20000; i += 2)
+        kh_del(int32, h, kh_get(int32, h, i));
+    for (int i = 1; i < 20000; i += 2)
+        assert(kh_value(h, kh_get(int32, h, i)) == i);
+    long calls = ctx.calls;
+    assert(calls > 0 && ctx.bytes > 0);
+    kh_destroy(int32, h);
+    assert(ctx.blocks == 0 && ctx.bytes == 0);
+
+    // Control-byte engine with stored hashes, shrunk by kh_resize
+    khash_t(swisshstr) *s = kh_init_with_alloc(swisshstr, &a);
+    static char keys[1000][16];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(keys[i], sizeof(keys[i]), "k%d", i);
+        khint_t k = kh_put(swisshstr, s, keys[i], &ret);
+        kh_value(s, k) = i;
+    }
+    for (int i = 0; i < 900; i++)
+        kh_del(swisshstr, s, kh_get(swisshstr, s, keys[i]));
+    kh_resize(swisshstr, s, 0);
+    for (int i = 900; i < 1000; i++)
+        assert(kh_value(s, kh_get(swisshstr, s, keys[i])) == i);
+    kh_destroy(swisshstr, s);
+    assert(ctx.blocks == 0 && ctx.bytes == 0);
+
+    // The interning arena takes its blocks from the table's allocator
+    khash_t(atoms) *t = kh_init_with_alloc(atoms, &a);
+    char buf[32];
+    for (int i = 0; i < 50000; i++)
+    {
+        snprintf(buf, sizeof(buf), "atom-%d", i);
+        assert(kh_intern(atoms, t, buf) == (khint32_t)i);
+    }
+    assert(ctx.bytes > 50000 * 6);
+    kh_clear(atoms, t);
+    kh_intern(atoms, t, "again");
+    kh_destroy(atoms, t);
+    assert(ctx.blocks == 0 && ctx.bytes == 0);
+
+    // Tables without an allocator never reach it
+    calls = ctx.calls;
+    h = kh_init(int32);
+    kh_put(int32, h, 1, &ret);
+    kh_destroy(int32, h);
+    assert(ctx.calls == calls);
+    printf("Allocator tests passed!\n");
+}
+
+void test_robinhood()
+{
+    printf("Testing Robin Hood engine...\n");
+
+    khash_t(rh32) *h = kh_init(rh32);
+    int ret;
+    assert(kh_get(rh32, h, 1) == kh_end(h));
+    khint_t k = kh_put(rh32, h, 1, &ret);
+    assert(ret == 1);
+    kh_value(h, k) = 10;
+    k = kh_put(rh32, h, 1, &ret);
+    assert(ret == 0 && kh_value(h, k) == 10);
+    kh_del(rh32, h, k);
+    assert(kh_get(rh32, h, 1) == kh_end(h) && kh_size(h) == 0);
+
+    // Identity hashes with a small table: long clusters that wrap around
+    for (int i = 0; i < 2000; i++)
+    {
+        k = kh_put(rh32, h, i * 64, &ret);
+        assert(ret == 1);
+        kh_value(h, k) = i;
+    }
+    for (int i = 0; i < 2000; i += 3)
+        kh_del(rh32, h, kh_get(rh32, h, i * 64));
+    for (int i = 0; i < 2000; i++)
+    {
+        k = kh_get(rh32, h, i * 64);
+        assert((k == kh_end(h)) == (i % 3 == 0));
+        if (i % 3)
+            assert(kh_value(h, k) == i);
+    }
+    assert(h->n_occupied == h->size); // no tombstones
+
+    // Every key sits at or after its home bucket, and distances are exact
+    khint_t mask = kh_n_buckets(h) - 1;
+    for (k = 0; k < kh_end(h); k++)
+        if (kh_exist(h, k))
+            assert(((k - kh_int32_hash_func(kh_key(h, k))) & mask) == (khint_t)h->ctrl[k] - 1);
+        else
+            assert(h->ctrl[k] == 0);
+
+    // Sustained 50/50 churn keeps probes bounded, unlike tombstones
+    khash_t(int32) *q = kh_init(int32);
+    kh_clear(rh32, h);
+    uint32_t next = 0;
+    for (; next < 10000; next++)
+    {
+        kh_put(rh32, h, (khint32_t)splittable64(next), &ret);
+        kh_put(int32, q, (khint32_t)splittable64(next), &ret);
+    }
+    kh_probe_stat_t first = kh_probe_stats(rh32, h), last = first;
+    int quad_max = 0;
+    for (int round = 0; round < 20; round++)
+    {
+        for (int i = 0; i < 10000; i++, next++)
+        { // insert one key, delete the oldest
+            kh_put(rh32, h, (khint32_t)splittable64(next), &ret);
+            kh_del(rh32, h, kh_get(rh32, h, (khint32_t)splittable64(next - 10000)));
+            kh_put(int32, q, (khint32_t)splittable64(next), &ret);
+            kh_del(int32, q, kh_get(int32, q, (khint32_t)splittable64(next - 10000)));
+        }
+        assert(kh_size(h) == 10000 && h->n_occupied == 10000);
+        last = kh_probe_stats(rh32, h);
+        assert(last.max_probes <= 2 * first.max_probes + 4);
+        assert(last.variance <= 2 * first.variance + 1.0);
+        kh_probe_stat_t s = kh_probe_stats(int32, q);
+        if (s.max_probes > quad_max)
+            quad_max = s.max_probes;
+    }
+    printf("  churn: Robin Hood avg %.3f max %d var %.3f (start max %d), quadratic worst max %d\n",
+           last.avg_probes, last.max_probes, last.variance, first.max_probes, quad_max);
+    for (uint32_t i = next - 10000; i < next; i++)
+        assert(kh_get(rh32, h, (khint32_t)splittable64(i)) != kh_end(h));
+    kh_destroy(int32, q);
+
+    // Incremental migration out of a Robin Hood table
+    kh_clear(rh32, h);
+    kh_set_incremental(h, 4);
+    for (int i = 0; i < 30000; i++)
+    {
+        k = kh_put(rh32, h, i, &ret);
+        kh_value(h, k) = -i;
+        if (h->old && i % 2)
+            kh_del(rh32, h, kh_get(rh32, h, i - 1));
+    }
+    khint_t count = 0;
+    int32_t key, val;
+    kh_foreach(h, key, val, {
+        assert(val == -key);
+        count++;
+    });
+    assert(count == kh_size(h));
+    kh_migrate(rh32, h, 0);
+    kh_destroy(rh32, h);
+
+    // Stored hashes, and batched inserts whose iterators shift
+    khash_t(rhstr) *t = kh_init(rhstr);
+    static char words[500][16];
+    const char *wp[500];
+    khint_t its[500];
+    for (int i = 0; i < 500; i++)
+    {
+        snprintf(words[i], sizeof(words[i]), "w%d", i);
+        wp[i] = words[i];
+    }
+    assert(kh_put_batch(rhstr, t, wp, 500, its, NULL) == 0);
+    for (int i = 0; i < 500; i++)
+    {
+        assert(strcmp(kh_key(t, its[i]), wp[i]) == 0);
+        kh_value(t, its[i]) = i;
+    }
+    for (int i = 0; i < 500; i += 2)
+        kh_del(rhstr, t, kh_get(rhstr, t, wp[i]));
+    kh_resize(rhstr, t, 0);
+    for (int i = 0; i < 500; i++)
+    {
+        k = kh_get(rhstr, t, wp[i]);
+        assert((k == kh_end(t)) == (i % 2 == 0));
+        if (i % 2)
+            assert(kh_value(t, k) == i && t->hashes[k] == kh_str_hash_func(wp[i]));
+    }
+    kh_destroy(rhstr, t);
+    printf("Robin Hood tests passed!\n");
+}
+
+void test_compact()
+{
+    printf("Testing compaction...\n");
+
+    // Explicit kh_compact(): deleted buckets are dropped, then the table shrinks
+    khash_t(int32) *h = kh_init(int32);
+    int ret;
+    assert(kh_compact(int32, h) == 0);
+    for (int i = 0; i < 100000; i++)
+    {
+        khint_t k = kh_put(int32, h, i, &ret);
+        kh_value(h, k) = i;
+    }
+    khint_t peak = kh_n_buckets(h);
+    for (int i = 0; i < 100000; i += 2)
+        kh_del(int32, h, kh_get(int32, h, i));
+    assert(h->n_occupied - h->size == 50000);
+    assert(kh_compact(int32, h) == 1);
+    assert(h->n_occupied == h->size && kh_n_buckets(h) == peak);
+    assert(h->compact.n_rehash == 1 && h->compact.n_shrink == 0);
+    assert(kh_compact(int32, h) == 0);
+    for (int i = 1; i < 99000; i += 2)
+        kh_del(int32, h, kh_get(int32, h, i));
+    assert(kh_size(h) == 500);
+    assert(kh_compact(int32, h) == 1 && h->compact.n_shrink == 1);
+    assert(kh_n_buckets(h) == 2048); // 500 keys fill a quarter to a half of 0.77
+    for (int i = 99000; i < 100000; i++)
+    {
+        khint_t k = kh_get(int32, h, i);
+        assert((k == kh_end(h)) == (i % 2 == 0));
+        if (i % 2)
+            assert(kh_value(h, k) == i);
+    }
+    kh_destroy(int32, h);
+
+    // Automatic policy on each engine, through a burst and a steady churn
+    khash_t(swiss32) *s = kh_init(swiss32);
+    khash_t(rh32) *r = kh_init(rh32);
+    h = kh_init(int32);
+    kh_set_compact(h, 0.2, 0.05);
+    kh_set_compact(s, 0.2, 0.05);
+    kh_set_compact(r, 0.2, 0.05);
+    for (int i = 0; i < 200000; i++)
+    {
+        kh_put(int32, h, i, &ret);
+        kh_put(swiss32, s, i, &ret);
+        kh_put(rh32, r, i, &ret);
+    }
+    for (int i = 0; i < 199000; i++)
+    {
+        kh_del(int32, h, kh_get(int32, h, i));
+        kh_del(swiss32, s, kh_get(swiss32, s, i));
+        kh_del(rh32, r, kh_get(rh32, r, i));
+        assert(h->n_occupied - h->size <= 0.2 * kh_n_buckets(h) + 1);
+    }
+    assert(h->compact.n_rehash > 0 && h->compact.n_shrink > 0);
+    assert(s->compact.n_shrink > 0);
+    assert(r->compact.n_rehash == 0 && r->compact.n_shrink > 0); // no tombstones to drop
+    assert(kh_size(h) >= 0.05 * kh_n_buckets(h) && kh_n_buckets(h) < 200000 / 8);
+    assert(kh_size(s) >= 0.05 * kh_n_buckets(s) && kh_size(r) >= 0.05 * kh_n_buckets(r));
+    for (int i = 199000; i < 200000; i++)
+        assert(kh_get(int32, h, i) != kh_end(h) && kh_get(swiss32, s, i) != kh_end(s) &&
+               kh_get(rh32, r, i) != kh_end(r));
+    kh_destroy(swiss32, s);
+    kh_destroy(rh32, r);
+
+    // Once a steady churn has settled, it only rehashes in place
+    khint_t shrinks = 0, rehashes = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        if (i == 100000)
+            shrinks = h->compact.n_shrink, rehashes = h->compact.n_rehash;
+        kh_put(int32, h, 200000 + i, &ret);
+        kh_del(int32, h, kh_get(int32, h, 199000 + i));
+    }
+    assert(kh_size(h) == 1000 && h->compact.n_shrink == shrinks && h->compact.n_rehash > rehashes);
+    printf("  %d rehashes, %d shrinks\n", (int)h->compact.n_rehash, (int)h->compact.n_shrink);
+
+    // kh_compact() finishes an incremental rehash first
+    kh_set_incremental(h, 4);
+    while (!h->old)
+        kh_put(int32, h, 500000 + kh_size(h), &ret);
+    assert(kh_compact(int32, h) >= 0 && h->old == NULL);
+    kh_destroy(int32, h);
+    printf("Compaction tests passed!\n");
+}
+
+void test_load_factor()
+{
+    printf("Testing per-table load factors...\n");
+
+    khash_t(sparse32) *sp = kh_init(sparse32);
+    khash_t(dense32) *de = kh_init(dense32);
+    khash_t(denseswiss) *ds = kh_init(denseswiss);
+    khash_t(int32) *h = kh_init(int32);
+    assert(sp->max_load == 0.5 && sp->grow_shift == 2);
+    assert(de->max_load == 0.9 && de->grow_shift == 1);
+    assert(h->max_load == __ac_HASH_UPPER && h->grow_shift == 1);
+    int ret;
+    khint_t sp_prev = 0;
+    for (int i = 0; i < 110000; i++)
+    {
+        khint_t k = kh_put(sparse32, sp, i, &ret);
+        kh_value(sp, k) = i;
+        kh_put(dense32, de, i, &ret);
+        kh_put(denseswiss, ds, i, &ret);
+        kh_put(int32, h, i, &ret);
+        assert(kh_size(sp) <= 0.5 * kh_n_buckets(sp) + 1);
+        assert(kh_size(de) <= 0.9 * kh_n_buckets(de) + 1 && kh_size(ds) <= 0.9 * kh_n_buckets(ds) + 1);
+        if (kh_n_buckets(sp) != sp_prev)
+        { // grows four times at a time
+            assert(sp_prev < 4 || kh_n_buckets(sp) == sp_prev * 4);
+            sp_prev = kh_n_buckets(sp);
+        }
+    }
+    assert(kh_n_buckets(de) == 131072 && kh_n_buckets(ds) == 131072 && kh_n_buckets(h) == 262144);
+    assert(kh_n_buckets(sp) == 262144);
+    for (int i = 0; i < 110000; i++)
+        assert(kh_value(sp, kh_get(sparse32, sp, i)) == i && kh_get(dense32, de, i) != kh_end(de) &&
+               kh_get(denseswiss, ds, i) != kh_end(ds));
+    kh_probe_stat_t s_sparse = kh_probe_stats(sparse32, sp), s_dense = kh_probe_stats(dense32, de);
+    printf("  load %.2f: avg probes %.3f; load %.2f: avg probes %.3f\n", (double)kh_size(sp) / kh_n_buckets(sp),
+           s_sparse.avg_probes, (double)kh_size(de) / kh_n_buckets(de), s_dense.avg_probes);
+    assert(s_sparse.avg_probes < s_dense.avg_probes);
+
+    // Lowering the load factor of a full table grows it at once
+    assert(kh_set_load(int32, h, 0.3, 0) == 0);
+    assert(kh_n_buckets(h) == 524288 && h->upper_bound == (khint_t)(0.3 * 524288 + 0.5));
+    assert(kh_set_load(int32, h, 0.0, 8) == 0 && h->max_load == __ac_HASH_UPPER && h->grow_shift == 3);
+    for (int i = 110000; i < 500000; i++)
+        kh_put(int32, h, i, &ret);
+    assert(kh_n_buckets(h) == 4194304); // 524288 * 8
+    for (int i = 0; i < 500000; i++)
+        assert(kh_get(int32, h, i) != kh_end(h));
+
+    // The bound always leaves a free bucket
+    assert(__ac_load_bound(4, 0.99) == 3 && __ac_load_bound(1024, 0.5) == 512);
+
+    kh_destroy(sparse32, sp);
+    kh_destroy(dense32, de);
+    kh_destroy(denseswiss, ds);
+    kh_destroy(int32, h);
+    printf("Load factor tests passed!\n");
+}
+
+void test_range_iteration()
+{
+    printf("Testing range-split iteration...\n");
+
+    int ret;
+    khash_t(int32) *h = kh_init(int32);
+    kh_set_incremental(h, 8);
+    for (int n = 0; n < 3; n++)
+    { // an empty table, a table with deleted buckets, one in the middle of a rehash
+        khint_t count = 0;
+        long sum = 0, want = 0;
+        for (khint_t k = kh_begin(h); k != kh_end(h); ++k)
+            if (kh_exist(h, k))
+                want += kh_value(h, k);
+        if (h->old)
+            for (khint_t k = kh_begin(h->old); k != kh_end(h->old); ++k)
+                if (kh_exist(h->old, k))
+                    want += kh_value(h->old, k);
+        for (int parts = 1; parts <= 7; parts++)
+        {
+            assert(kh_split(h, 0, parts) == kh_begin(h));
+            for (int i = 0; i < parts; i++)
+            {
+                khint_t begin = kh_split(h, i, parts), end = kh_split(h, i + 1, parts);
+                assert(begin % 16 == 0 && begin <= end);
+                int32_t key, value;
+                kh_foreach_range(h, begin, end, key, value, {
+                    assert(value == key * 3);
+                    count++;
+                    sum += value;
+                });
+            }
+        }
+        assert(count == 7 * kh_size(h) && sum == 7 * want);
+
+        if (n == 0)
+        {
+            for (int i = 0; i < 3000; i++)
+            {
+                khint_t k = kh_put(int32, h, i, &ret);
+                kh_value(h, k) = i * 3;
+            }
+            kh_migrate(int32, h, 0);
+            for (int i = 0; i < 3000; i += 2)
+                kh_del(int32, h, kh_get(int32, h, i));
+        }
+        else
+            for (int i = 3000; !h->old; i++)
+            {
+                khint_t k = kh_put(int32, h, i, &ret);
+                kh_value(h, k) = i * 3;
+            }
+    }
+
+    // Skips whole flags words, but stops on every full bucket
+    for (khint_t i = 0; i <= kh_end(h); i++)
+    {
+        khint_t j = __ac_next_full(h->flags, i, kh_end(h)), x = i;
+        while (x < kh_end(h) && !kh_exist(h, x))
+            ++x;
+        assert(j == x);
+    }
+    kh_destroy(int32, h);
+    printf("Range-split iteration tests passed!\n");
+}
+
+void test_memory_usage()
+{
+    printf("Testing memory usage reports...\n");
+
+    // The report accounts for every byte the table allocated
+    kalloc_tally_t t;
+    kalloc_tally_init(&t, NULL);
+    int ret;
+    khash_t(int32) *h = kh_init_with_alloc(int32, &t.a);
+    kmem_usage_t u = kh_memory_usage(int32, h);
+    assert(u.live == 0 && u.slack == 0 && u.tombstones == 0 && kmem_usage_total(u) == kalloc_tally_bytes(&t));
+    for (int i = 0; i < 10000; i++)
+        kh_put(int32, h, i, &ret);
+    for (int i = 0; i < 10000; i += 4)
+        kh_del(int32, h, kh_get(int32, h, i));
+    u = kh_memory_usage(int32, h);
+    size_t bucket = sizeof(khint32_t) + sizeof(int);
+    assert(u.live == kh_size(h) * bucket && u.tombstones == 2500 * bucket);
+    assert(u.slack == (kh_end(h) - 10000) * bucket && kmem_usage_total(u) == kalloc_tally_bytes(&t));
+    kh_set_incremental(h, 8); // in the middle of a migration
+    while (!h->old)
+        kh_put(int32, h, 10000 + kh_size(h), &ret);
+    u = kh_memory_usage(int32, h);
+    assert(u.live == kh_size(h) * bucket && kmem_usage_total(u) == kalloc_tally_bytes(&t));
+    kh_destroy(int32, h);
+    assert(kalloc_tally_bytes(&t) == 0 && t.n_blocks == 0 && kalloc_tally_peak(&t) >= kmem_usage_total(u));
+
+    // Control bytes and stored hashes are overhead; sets have no values
+    khash_t(swisshstr) *s = kh_init_with_alloc(swisshstr, &t.a);
+    kh_put(swisshstr, s, "a", &ret);
+    kh_put(swisshstr, s, "b", &ret);
+    u = kh_memory_usage(swisshstr, s);
+    assert(u.live == 2 * (sizeof(kh_cstr_t) + sizeof(int)) && kmem_usage_total(u) == kalloc_tally_bytes(&t));
+    khash_t(dense32) *d = kh_init_with_alloc(dense32, &t.a);
+    for (int i = 0; i < 1000; i++)
+        kh_put(dense32, d, i, &ret);
+    kmem_usage_t all = u;
+    u = kh_memory_usage(dense32, d);
+    assert(u.live == 1000 * sizeof(khint32_t) && u.tombstones == 0);
+    kmem_usage_add(&all, u);
+    assert(kmem_usage_total(all) == kalloc_tally_bytes(&t));
+    kh_destroy(swisshstr, s);
+    kh_destroy(dense32, d);
+
+    // Interned strings, and the slack of their blocks
+    khash_t(atoms) *a = kh_init_with_alloc(atoms, &t.a);
+    char buf[32];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(buf, sizeof(buf), "atom-%d", i);
+        kh_intern(atoms, a, buf);
+    }
+    u = kh_memory_usage(atoms, a);
+    assert(u.live > a->arena->bytes && u.slack > KH_ARENA_BLOCK - a->arena->bytes);
+    assert(kmem_usage_total(u) == kalloc_tally_bytes(&t));
+    kh_destroy(atoms, a);
+    assert(kalloc_tally_bytes(&t) == 0);
+    printf("Memory usage tests passed!\n");
+}
+
+// Fills, deletes from and grows an interleaved map against a plain one
+#define CHECK_INTERLEAVED(name, key_t, val_t)                                                    \
+    {                                                                                            \
+        kalloc_tally_t t;                                                                        \
+        kalloc_tally_init(&t, NULL);                                                             \
+        khash_t(name) *h = kh_init_with_alloc(name, &t.a);                                       \
+        khash_t(int32) *ref = kh_init(int32);                                                    \
+        kh_set_incremental(h, 16);                                                               \
+        for (int i = 0; i < 50000; i++)                                                          \
+        {                                                                                        \
+            key_t key = (key_t)i * 7;                                                            \
+            khint_t x = kh_put(name, h, key, &ret);                                              \
+            kh_value(h, x) = (val_t)i;                                                           \
+            x = kh_put(int32, ref, (khint32_t)key, &ret);                                        \
+            kh_value(ref, x) = i;                                                                \
+            if (i % 3 == 0)                                                                      \
+            {                                                                                    \
+                kh_del(name, h, kh_get(name, h, (key_t)(i / 2) * 7));                            \
+                kh_del(int32, ref, kh_get(int32, ref, (khint32_t)(i / 2) * 7));                  \
+            }                                                                                    \
+        }                                                                                        \
+        assert(kh_size(h) == kh_size(ref));                                                      \
+        for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)                                   \
+        {                                                                                        \
+            if (!kh_exist(ref, k))                                                               \
+                continue;                                                                        \
+            khint_t x = kh_get(name, h, (key_t)kh_key(ref, k));                                  \
+            assert(x != kh_end(h) || h->old);                                                    \
+            if (x != kh_end(h))                                                                  \
+                assert(kh_key(h, x) == (key_t)kh_key(ref, k) && kh_val(h, x) == kh_val(ref, k)); \
+        }                                                                                        \
+        assert(kmem_usage_total(kh_memory_usage(name, h)) == kalloc_tally_bytes(&t));            \
+        kh_resize(name, h, kh_end(h) * 2);                                                       \
+        key_t key;                                                                               \
+        val_t val;                                                                               \
+        khint_t n = 0;                                                                           \
+        kh_foreach(h, key, val, {                                                                \
+            assert(kh_value(ref, kh_get(int32, ref, (khint32_t)key)) == val);                    \
+            n++;                                                                                 \
+        });                                                                                      \
+        assert(n == kh_size(ref));                                                               \
+        kh_destroy(name, h);                                                                     \
+        kh_destroy(int32, ref);                                                                  \
+        assert(kalloc_tally_bytes(&t) == 0);                                                     \
+    }
+
+void test_interleaved()
+{
+    printf("Testing interleaved buckets...\n");
+    int ret;
+
+    // One array of pairs, walked with a constant stride
+    assert(sizeof(((khash_t(kv32) *)0)->key_stride) == 2 && sizeof(((khash_t(kv32) *)0)->val_stride) == 2);
+    assert(sizeof(((khash_t(kvrh) *)0)->key_stride) == 4 && sizeof(((khash_t(kvrh) *)0)->val_stride) == 2);
+    khash_t(kv32) *h = kh_init(kv32);
+    khint_t x = kh_put(kv32, h, 5, &ret);
+    kh_value(h, x) = 50;
+    assert((char *)&kh_val(h, x) - (char *)&kh_key(h, x) == offsetof(kh_kv32_pair_t, val));
+    kh_destroy(kv32, h);
+    CHECK_INTERLEAVED(kv32, khint32_t, int);
+    CHECK_INTERLEAVED(kvswiss, khint64_t, int);
+    CHECK_INTERLEAVED(kvrh, khint32_t, khint64_t);
+
+    // Pairs that cannot be walked with a stride, and sets, keep separate arrays
+    assert(sizeof(((khash_t(kvrgb) *)0)->key_stride) == 1 && sizeof(((khash_t(kvset) *)0)->key_stride) == 1);
+    khash_t(kvrgb) *g = kh_init(kvrgb);
+    for (int i = 0; i < 1000; i++)
+    {
+        x = kh_put(kvrgb, g, i, &ret);
+        kh_value(g, x) = (rgb_t){{(char)i, 0, 1}};
+    }
+    for (int i = 0; i < 1000; i++)
+        assert(kh_value(g, kh_get(kvrgb, g, i)).c[0] == (char)i);
+    kh_destroy(kvrgb, g);
+    printf("Interleaved bucket tests passed!\n");
+}
+
+// Rehashes a seeded table under a new seed, halfway through an incremental rehash
+#define CHECK_RESEED(name, n)                                       \
+    {                                                               \
+        khash_t(name) *h = kh_init(name);                           \
+        kh_set_incremental(h, 16);                                  \
+        for (int i = 0; i < (n); i++)                               \
+            kh_put(name, h, i * 3, &ret);                           \
+        assert(kh_reseed(name, h, 12345) == 0 && h->seed == 12345); \
+        assert(!h->old && kh_size(h) == (khint_t)(n));              \
+        for (int i = 0; i < (n); i++)                               \
+            assert(kh_get(name, h, i * 3) != kh_end(h));            \
+        assert(kh_get(name, h, 1) == kh_end(h));                    \
+        kh_destroy(name, h);                                        \
+    }
+
+void test_seeded()
+{
+    printf("Testing seeded hashing...\n");
+    int ret;
+
+    // Every table draws its own seed
+    khash_t(sstr) *h = kh_init(sstr), *g = kh_init(sstr);
+    assert(h->seed != g->seed);
+    kh_destroy(sstr, g);
+
+    // Keys made of "Aa" and "BB" blocks share one X31 hash, but not one seeded hash
+    enum
+    {
+        N_BLOCKS = 12,
+        N_KEYS = 1 << N_BLOCKS
+    };
+    char(*keys)[2 * N_BLOCKS + 1] = malloc(N_KEYS * sizeof(*keys));
+    khash_t(sx31) *x31 = kh_init(sx31);
+    kh_reseed(sstr, h, 1);
+    for (int i = 0; i < N_KEYS; i++)
+    {
+        for (int j = 0; j < N_BLOCKS; j++)
+            memcpy(keys[i] + 2 * j, i >> j & 1 ? "BB" : "Aa", 2);
+        keys[i][2 * N_BLOCKS] = 0;
+        assert(kh_str_hash_x31(keys[i]) == kh_str_hash_x31(keys[0]));
+        kh_put(sx31, x31, keys[i], &ret);
+        khint_t x = kh_put(sstr, h, keys[i], &ret);
+        kh_value(h, x) = i;
+    }
+    assert(kh_probe_stats(sx31, x31).max_probes >= N_KEYS / 2);
+    assert(kh_probe_stats(sstr, h).max_probes < 32);
+    for (int i = 0; i < N_KEYS; i++)
+        assert(kh_value(h, kh_get(sstr, h, keys[i])) == i);
+    kh_destroy(sx31, x31);
+    kh_destroy(sstr, h);
+    free(keys);
+
+    // A block equal to a wyhash constant cancels the seed of kh_wyhash(), but not of kh_wyhash_guarded()
+    uint64_t s1 = 0xe7037ed1a0b428dbULL;
+    uint8_t k1[32], k2[32];
+    memcpy(k1, &s1, 8);
+    memset(k1 + 8, 'a', 24);
+    memcpy(k2, k1, 32);
+    k2[8] = 'b';
+    assert(kh_wyhash(k1, 32, 1) == kh_wyhash(k2, 32, 1) && kh_wyhash(k1, 32, 2) == kh_wyhash(k2, 32, 2));
+    assert(kh_wyhash_guarded(k1, 32, 1) != kh_wyhash_guarded(k2, 32, 1));
+
+    CHECK_RESEED(s64, 20000);
+    CHECK_RESEED(sswiss, 20000);
+    CHECK_RESEED(srh, 20000);
+
+    // Keys chosen against a leaked seed: kh_put() notices the long probe and reseeds
+    khash_t(s64) *l = kh_init(s64);
+    kh_reseed(s64, l, 7);
+    kh_set_reseed(l, 32);
+    int n = 0;
+    for (khint64_t k = 0; n < 300; k++)
+        if ((kh_int64_hash_seeded(k, 7) & 0xfff) == 0)
+        {
+            khint_t x = kh_put(s64, l, k, &ret);
+            kh_value(l, x) = n++;
+            assert(ret == 1 && kh_value(l, kh_get(s64, l, k)) == n - 1);
+        }
+    assert(l->n_reseed == 1 && l->seed != 7 && l->reseed_probes == 32);
+    assert(kh_size(l) == 300 && kh_probe_stats(s64, l).max_probes <= 32);
+    kh_destroy(s64, l);
+
+    // A hash that ignores its seed: one reseed, then the check gives up
+    khash_t(sbad) *b = kh_init(sbad);
+    kh_set_reseed(b, 16);
+    for (int i = 1; i <= 200; i++)
+        kh_put(sbad, b, i << 12, &ret);
+    assert(b->n_reseed == 1 && b->reseed_probes == 0 && kh_size(b) == 200);
+    for (int i = 1; i <= 200; i++)
+        assert(kh_get(sbad, b, i << 12) != kh_end(b));
+    kh_destroy(sbad, b);
+    printf("Seeded hashing tests passed!\n");
+}
+
+void test_string_view()
+{
+    printf("Testing string view keys...\n");
+    int ret;
+
+    // Count the words of a buffer in place: no copies, no null terminators
+    char buf[] = "to be or not to be that is the question to";
+    kalloc_tally_t t;
+    kalloc_tally_init(&t, NULL);
+    khash_t(sv) *h = kh_init_with_alloc(sv, &t.a);
+    for (char *p = buf, *end = buf + strlen(buf); p < end;)
+    {
+        size_t len = strcspn(p, " ");
+        khint_t x = kh_put_copy(sv, h, kh_sv(p, len), &ret);
+        assert(ret >= 0);
+        kh_value(h, x) = ret ? 1 : kh_value(h, x) + 1;
+        p += len + 1;
+    }
+    assert(kh_size(h) == 8);
+    memset(buf, 'x', sizeof(buf) - 1); // the table kept copies of its own
+    assert(kh_value(h, kh_get(sv, h, kh_sv_str("to"))) == 3);
+    assert(kh_value(h, kh_get(sv, h, kh_sv_str("be"))) == 2);
+    assert(kh_value(h, kh_get(sv, h, kh_sv("question mark", 8))) == 1);
+    assert(kh_get(sv, h, kh_sv("question", 7)) == kh_end(h)); // a prefix is another key
+    assert(kh_get(sv, h, kh_sv_str("xx")) == kh_end(h));
+    khint_t x = kh_get(sv, h, kh_sv_str("question"));
+    assert(strcmp(kh_key(h, x).s, "question") == 0); // copies are null terminated
+    kh_del(sv, h, kh_get(sv, h, kh_sv_str("or")));
+    assert(kh_get(sv, h, kh_sv_str("or")) == kh_end(h) && kh_size(h) == 7);
+    assert(kmem_usage_total(kh_memory_usage(sv, h)) == kalloc_tally_bytes(&t));
+
+    // kh_put() keeps the caller's bytes; the empty string is a key like any other
+    const char *words = "alphabetagamma";
+    x = kh_put(sv, h, kh_sv(words + 5, 4), &ret);
+    assert(ret == 1 && kh_key(h, x).s == words + 5);
+    kh_put(sv, h, kh_sv(NULL, 0), &ret);
+    assert(ret == 1 && kh_get(sv, h, kh_sv("", 0)) != kh_end(h));
+    assert(kh_sv_hash_func(kh_sv(words, 5)) == kh_str_hash_wy("alpha"));
+    kh_destroy(sv, h);
+    assert(kalloc_tally_bytes(&t) == 0);
+
+    // Other engines and seeded hashing, against one another
+    khash_t(svseeded) *s = kh_init(svseeded);
+    khash_t(svswiss) *w = kh_init(svswiss);
+    char key[16];
+    for (int i = 0; i < 20000; i++)
+    {
+        int len = snprintf(key, sizeof(key), "k%d", i * 7);
+        kh_put_copy(svseeded, s, kh_sv(key, len), &ret);
+        assert(ret == 1);
+        x = kh_put(svswiss, w, kh_sv(kh_key(s, kh_get(svseeded, s, kh_sv(key, len))).s, len), &ret);
+        kh_value(w, x) = i;
+    }
+    for (int i = 0; i < 20000; i++)
+    {
+        int len = snprintf(key, sizeof(key), "k%d", i * 7);
+        assert(kh_get(svseeded, s, kh_sv(key, len)) != kh_end(s));
+        assert(kh_value(w, kh_get(svswiss, w, kh_sv(key, len))) == i);
+    }
+    kh_destroy(svswiss, w);
+    kh_destroy(svseeded, s);
+    printf("String view tests passed!\n");
+}
+
+static void sum_values(int *d, const int *s, void *ud)
+{
+    *d += *s;
+    (*(int *)ud)++;
+}
+
+// Checks the set algebra of one kind of map against brute force, with a and b of n_a and n_b keys sharing a third
+#define CHECK_ALGEBRA(name, n_a, n_b)                                                                  \
+    {                                                                                                  \
+        khash_t(name) *a = kh_init(name), *b = kh_init(name), *d;                                      \
+        for (int i = 0; i < (n_a); i++)                                                                \
+        {                                                                                              \
+            khint_t x = kh_put(name, a, i * 3, &ret);                                                  \
+            kh_value(a, x) = i;                                                                        \
+        }                                                                                              \
+        for (int i = 0; i < (n_b); i++)                                                                \
+        {                                                                                              \
+            khint_t x = kh_put(name, b, i * 2, &ret);                                                  \
+            kh_value(b, x) = -i;                                                                       \
+        }                                                                                              \
+        for (int op = 0; op < 4; op++)                                                                 \
+        {                                                                                              \
+            d = kh_init(name);                                                                         \
+            assert(kh_union(name, d, a) == 0 && kh_size(d) == (khint_t)(n_a));                         \
+            if (op == 0)                                                                               \
+                assert(kh_union(name, d, b) == 0);                                                     \
+            else if (op == 1)                                                                          \
+                assert(kh_intersect(name, d, b) == 0);                                                 \
+            else if (op == 2)                                                                          \
+                assert(kh_difference(name, d, b) == 0);                                                \
+            else                                                                                       \
+                assert(kh_merge(name, d, b, NULL, NULL) == 0);                                         \
+            khint_t n = 0;                                                                             \
+            for (int i = 0; i < 3 * ((n_a) > (n_b) ? (n_a) : (n_b)); i++)                              \
+            {                                                                                          \
+                int in_a = i % 3 == 0 && i / 3 < (n_a), in_b = i % 2 == 0 && i / 2 < (n_b);            \
+                int want = op == 0 || op == 3 ? in_a || in_b : op == 1 ? in_a && in_b : in_a && !in_b; \
+                khint_t x = kh_get(name, d, i);                                                        \
+                assert((x != kh_end(d)) == want);                                                      \
+                if (!want)                                                                             \
+                    continue;                                                                          \
+                n++;                                                                                   \
+                assert(kh_value(d, x) == (in_a && (op != 3 || !in_b) ? i / 3 : -(i / 2)));             \
+            }                                                                                          \
+            assert(kh_size(d) == n);                                                                   \
+            kh_destroy(name, d);                                                                       \
+        }                                                                                              \
+        kh_destroy(name, a);                                                                           \
+        kh_destroy(name, b);                                                                           \
+    }
+
+void test_set_algebra()
+{
+    printf("Testing set algebra...\n");
+    int ret, calls = 0;
+
+    // Both walks of intersect and difference, on every engine
+    CHECK_ALGEBRA(int32, 3000, 1000);
+    CHECK_ALGEBRA(int32, 1000, 3000);
+    CHECK_ALGEBRA(swiss32, 3000, 1000);
+    CHECK_ALGEBRA(swiss32, 1000, 3000);
+    CHECK_ALGEBRA(rh32, 3000, 1000);
+    CHECK_ALGEBRA(rh32, 1000, 3000);
+    CHECK_ALGEBRA(kv32, 3000, 1000);
+    CHECK_ALGEBRA(kv32, 1000, 3000);
+    CHECK_ALGEBRA(s64, 3000, 1000); // tables seeded apart: keys are hashed again
+    CHECK_ALGEBRA(s64, 1000, 3000);
+
+    // Merge combines the values of shared keys; a table merged into itself combines each with itself
+    khash_t(int32) *a = kh_init(int32), *b = kh_init(int32);
+    for (int i = 0; i < 1000; i++)
+    {
+        khint_t x = kh_put(int32, a, i, &ret);
+        kh_value(a, x) = 1;
+        x = kh_put(int32, b, i + 500, &ret);
+        kh_value(b, x) = 10;
+    }
+    assert(kh_merge(int32, a, b, sum_values, &calls) == 0 && calls == 500 && kh_size(a) == 1500);
+    for (int i = 0; i < 1500; i++)
+        assert(kh_value(a, kh_get(int32, a, i)) == (i < 500 ? 1 : i < 1000 ? 11 : 10));
+    calls = 0;
+    assert(kh_merge(int32, a, a, sum_values, &calls) == 0 && calls == 1500);
+    assert(kh_value(a, kh_get(int32, a, 700)) == 22);
+    assert(kh_union(int32, a, a) == 0 && kh_intersect(int32, a, a) == 0 && kh_size(a) == 1500);
+    assert(kh_difference(int32, a, a) == 0 && kh_size(a) == 0);
+    kh_destroy(int32, a);
+    kh_destroy(int32, b);
+
+    // Sets, and stored string hashes carried over rather than recomputed
+    khash_t(intset) *s = kh_init(intset), *t = kh_init(intset);
+    for (int i = 0; i < 100; i++)
+    {
+        kh_put(intset, s, i, &ret);
+        kh_put(intset, t, i + 50, &ret);
+    }
+    assert(kh_intersect(intset, s, t) == 0 && kh_size(s) == 50 && kh_get(intset, s, 49) == kh_end(s));
+    assert(kh_union(intset, s, t) == 0 && kh_size(s) == 100 && kh_get(intset, s, 149) != kh_end(s));
+    kh_destroy(intset, s);
+    kh_destroy(intset, t);
+    static const char *words[] = {"alpha", "beta", "gamma", "delta", "epsilon"};
+    khash_t(hstr) *h = kh_init(hstr), *g = kh_init(hstr);
+    for (int i = 0; i < 5; i++)
+    {
+        khint_t x = kh_put(hstr, i < 3 ? h : g, words[i], &ret);
+        kh_value(i < 3 ? h : g, x) = i;
+    }
+    kh_put(hstr, g, "alpha", &ret);
+    assert(kh_difference(hstr, h, g) == 0 && kh_size(h) == 2 && kh_get(hstr, h, "alpha") == kh_end(h));
+    assert(kh_union(hstr, h, g) == 0 && kh_size(h) == 5);
+    for (khint_t x = kh_begin(h); x != kh_end(h); ++x)
+        if (kh_exist(h, x))
+            assert(h->hashes[x] == kh_str_hash_func(kh_key(h, x)));
+    kh_destroy(hstr, h);
+    kh_destroy(hstr, g);
+
+    // A source halfway through an incremental rehash is read from both halves and left as it was
+    kalloc_tally_t tally;
+    kalloc_tally_init(&tally, NULL);
+    a = kh_init(int32), b = kh_init(int32);
+    kh_set_incremental(b, 16);
+    for (int i = 0; i < 20000 && !(i > 10000 && b->old); i++)
+    {
+        khint_t x = kh_put(int32, b, i, &ret);
+        kh_value(b, x) = i;
+    }
+    assert(b->old != NULL);
+    khint_t n_b = kh_size(b), b_size = b->size, b_old = b->old->size;
+    assert(kh_union(int32, a, b) == 0 && kh_size(a) == n_b && kh_end(a) >= n_b);
+    assert(b->old != NULL && b->size == b_size && b->old->size == b_old);
+    for (khint_t i = 0; i < n_b; i++)
+        assert(kh_value(a, kh_get(int32, a, i)) == (int)i);
+    kh_destroy(int32, a);
+    a = kh_init_with_alloc(int32, &tally.a);
+    for (int i = 0; i < 40000; i += 2)
+        kh_put(int32, a, i, &ret);
+    assert(kh_intersect(int32, a, b) == 0 && kh_size(a) == (n_b + 1) / 2);
+    assert(kh_difference(int32, a, b) == 0 && kh_size(a) == 0);
+    assert(b->old != NULL && b->size == b_size && b->old->size == b_old);
+    kh_destroy(int32, a);
+    kh_destroy(int32, b);
+    assert(kalloc_tally_bytes(&tally) == 0);
+    printf("Set algebra tests passed!\n");
+}
+
 int main()
 {
     printf("Starting khash.h unit tests...\n\n");
@@ -221,6 +1528,21 @@ int main()
     test_resize();
     test_iteration();
     test_probe_statistics(); // Add the new test
+    test_swiss_engine();
+    test_batch();
+    test_incremental_rehash();
+    test_stored_hash();
+    test_intern();
+    test_allocator();
+    test_robinhood();
+    test_compact();
+    test_load_factor();
+    test_range_iteration();
+    test_memory_usage();
+    test_interleaved();
+    test_seeded();
+    test_string_view();
+    test_set_algebra();
 
     printf("\nAll tests passed successfully!\n");
     return 0;
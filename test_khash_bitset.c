@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <assert.h>
+#include "khash_bitset.h"
+
+// Reference sets to check the bitsets against
+KHASH_SET_INIT_INT(ref)
+
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+
+static uint64_t rng_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Kind of the container of the chunk of key
+static int chunk_kind(const kh_bitset_t *s, khint32_t key)
+{
+    khint_t k = kh_get(__kh_b_dir, s->dir, (uint32_t)key >> 16);
+    assert(k != kh_end(s->dir));
+    return (int)kh_val(s->dir, k).kind;
+}
+
+// s holds exactly the keys of r: every key once, and chunks in ascending order inside
+static void check_same(const kh_bitset_t *s, const khash_t(ref) *r)
+{
+    khint32_t key, prev = 0;
+    size_t n = 0;
+    assert(kh_b_size(s) == (size_t)kh_size(r));
+    kh_b_foreach(s, key, {
+        assert(kh_get(ref, r, key) != kh_end(r));
+        assert(n == 0 || (uint32_t)key >> 16 != (uint32_t)prev >> 16 || (uint32_t)key > (uint32_t)prev);
+        prev = key;
+        n++;
+    });
+    assert(n == (size_t)kh_size(r));
+    size_t in_chunks = 0;
+    for (khint_t k = kh_begin(s->dir); k != kh_end(s->dir); ++k)
+        if (kh_exist(s->dir, k))
+        {
+            const kh_b_chunk_t *c = &kh_val(s->dir, k);
+            assert(c->n > 0);
+            in_chunks += c->n;
+            if (c->kind == KH_B_ARRAY)
+                assert(c->len == c->n && c->n <= __KH_B_ARRAY_MAX);
+            else if (c->kind == KH_B_RUNS)
+                assert(c->len <= __KH_B_RUNS_MAX);
+            else
+                assert(__kh_b_popcount(c->bits) == c->n);
+        }
+    assert(in_chunks == (size_t)kh_size(r));
+}
+
+void test_bitset_basic()
+{
+    printf("Testing bitset put, get and del...\n");
+
+    kh_bitset_t *s = kh_b_init();
+    int ret;
+    khint32_t key;
+    assert(kh_b_size(s) == 0 && !kh_b_get(s, 0));
+    kh_b_foreach(s, key, assert(0));
+
+    const khint32_t keys[] = {0, 1, 65535, 65536, 0x7fffffff, 0x80000000U, 0xfffffffeU, 0xffffffffU};
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        assert(kh_b_put(s, keys[i], &ret) == 1 && ret == 1);
+        assert(kh_b_put(s, keys[i], NULL) == 0);
+    }
+    assert(kh_b_size(s) == 8);
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        assert(kh_b_get(s, keys[i]) && !kh_b_get(s, keys[i] ^ 0x100));
+    assert(!kh_b_get(s, 2) && !kh_b_get(s, 65537) && !kh_b_get(s, 0xfffffffdU));
+
+    khint64_t sum = 0;
+    kh_b_foreach(s, key, sum += key);
+    khint64_t want = 0;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        want += keys[i];
+    assert(sum == want);
+
+    // Stepping by hand stops at the end and stays there
+    kh_b_iter_t it = {0, 0, 0};
+    size_t n = 0;
+    while (kh_b_next(s, &it, &key))
+        n++;
+    assert(n == 8 && !kh_b_next(s, &it, &key));
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+    {
+        assert(kh_b_del(s, keys[i]) == 1 && kh_b_del(s, keys[i]) == 0);
+        assert(!kh_b_get(s, keys[i]));
+    }
+    assert(kh_b_size(s) == 0 && kh_size(s->dir) == 0);
+    assert(kh_b_del(s, 12345) == 0);
+
+    kh_b_put(s, 7, &ret);
+    kh_b_clear(s);
+    assert(kh_b_size(s) == 0 && !kh_b_get(s, 7));
+    kh_b_destroy(s);
+    kh_b_destroy(NULL);
+
+    printf("Bitset put, get and del tests passed!\n");
+}
+
+void test_bitset_kinds()
+{
+    printf("Testing bitset containers...\n");
+
+    kh_bitset_t *s = kh_b_init();
+    khash_t(ref) *r = kh_init(ref);
+    int ret;
+
+    // Consecutive keys: an array, then a single run once the array is full
+    for (khint32_t x = 0; x < __KH_B_ARRAY_MAX; x++)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    assert(chunk_kind(s, 0) == KH_B_ARRAY);
+    kh_b_put(s, __KH_B_ARRAY_MAX, &ret), kh_put(ref, r, __KH_B_ARRAY_MAX, &ret);
+    assert(chunk_kind(s, 0) == KH_B_RUNS && kh_val(s->dir, kh_get(__kh_b_dir, s->dir, 0)).len == 1);
+    check_same(s, r);
+
+    // Runs grow at either end, join, and split
+    for (khint32_t x = 6000; x < 7000; x++)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    kh_b_put(s, 5999, &ret), kh_put(ref, r, 5999, &ret);
+    for (khint32_t x = __KH_B_ARRAY_MAX + 1; x < 5999; x++)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    assert(chunk_kind(s, 0) == KH_B_RUNS && kh_val(s->dir, kh_get(__kh_b_dir, s->dir, 0)).len == 1);
+    for (khint32_t x = 100; x < 7000; x += 100)
+    {
+        assert(kh_b_del(s, x) == 1);
+        kh_del(ref, r, kh_get(ref, r, x));
+    }
+    assert(chunk_kind(s, 0) == KH_B_RUNS && kh_val(s->dir, kh_get(__kh_b_dir, s->dir, 0)).len == 70);
+    kh_b_del(s, 0), kh_del(ref, r, kh_get(ref, r, 0));
+    kh_b_del(s, 6999), kh_del(ref, r, kh_get(ref, r, 6999));
+    check_same(s, r);
+
+    // Keys one apart are too many runs: a bitmap, which keeps them in 8 KiB
+    for (khint32_t x = 65536; x < 65536 + 2 * 6000; x += 2)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    assert(chunk_kind(s, 65536) == KH_B_BITMAP);
+    check_same(s, r);
+    // Emptying it down to 2047 keys turns it back into an array
+    for (khint32_t x = 65536, left = 6000; left > __KH_B_ARRAY_MAX / 2 - 1; x += 2)
+    {
+        kh_b_del(s, x), kh_del(ref, r, kh_get(ref, r, x));
+        left--;
+        assert(chunk_kind(s, 65536) == (left >= __KH_B_ARRAY_MAX / 2 ? KH_B_BITMAP : KH_B_ARRAY));
+    }
+    assert(chunk_kind(s, 65536) == KH_B_ARRAY);
+    check_same(s, r);
+
+    // Isolated keys added to runs make them more than an array would take
+    for (khint32_t x = 3 * 65536; x < 3 * 65536 + 5000; x++)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    assert(chunk_kind(s, 3 * 65536) == KH_B_RUNS);
+    for (khint32_t x = 3 * 65536 + 5000; x < 3 * 65536 + 5000 + 2 * 1500; x += 2)
+        kh_b_put(s, x + 1, &ret), kh_put(ref, r, x + 1, &ret);
+    assert(chunk_kind(s, 3 * 65536) == KH_B_RUNS);
+    check_same(s, r);
+    for (khint32_t x = 3 * 65536; x < 3 * 65536 + 4900; x++)
+        kh_b_del(s, x), kh_del(ref, r, kh_get(ref, r, x));
+    assert(chunk_kind(s, 3 * 65536) == KH_B_ARRAY);
+    check_same(s, r);
+
+    // Compaction turns an array of a few runs into runs, and a sparse bitmap into an array
+    for (khint32_t x = 5 * 65536; x < 5 * 65536 + 1000; x++)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    for (khint32_t x = 6 * 65536; x < 6 * 65536 + 2 * 5000; x += 2)
+        kh_b_put(s, x, &ret), kh_put(ref, r, x, &ret);
+    for (khint32_t x = 6 * 65536 + 2 * 3000; x < 6 * 65536 + 2 * 5000; x += 2)
+        kh_b_del(s, x), kh_del(ref, r, kh_get(ref, r, x));
+    assert(chunk_kind(s, 5 * 65536) == KH_B_ARRAY && chunk_kind(s, 6 * 65536) == KH_B_BITMAP);
+    size_t before = kmem_usage_total(kh_b_memory_usage(s));
+    kh_b_compact(s);
+    assert(chunk_kind(s, 5 * 65536) == KH_B_RUNS && chunk_kind(s, 6 * 65536) == KH_B_ARRAY);
+    assert(kmem_usage_total(kh_b_memory_usage(s)) < before);
+    check_same(s, r);
+
+    kh_destroy(ref, r);
+    kh_b_destroy(s);
+
+    printf("Bitset container tests passed!\n");
+}
+
+// Draw a key of the given pattern: 0 dense, 1 scattered, 2 in long runs, 3 mixed
+static khint32_t draw(int pattern)
+{
+    switch (pattern == 3 ? (int)(rng_next() % 3) : pattern)
+    {
+    case 0:
+        return (khint32_t)(rng_next() % 300000);
+    case 1:
+        return (khint32_t)rng_next();
+    default:
+    {
+        khint32_t base = (khint32_t)(rng_next() % 64) * 4096 + 1000000;
+        return base + (khint32_t)(rng_next() % 3000);
+    }
+    }
+}
+
+void test_bitset_random()
+{
+    printf("Testing bitsets against khash sets...\n");
+
+    for (int pattern = 0; pattern < 4; pattern++)
+    {
+        kh_bitset_t *s = kh_b_init();
+        khash_t(ref) *r = kh_init(ref);
+        int ret, ret2;
+        for (int round = 0; round < 4; round++)
+        {
+            // Fill up, then take most of it away again
+            int n_ops = round % 2 ? 150000 : 300000, p_del = round % 2 ? 80 : 25;
+            for (int i = 0; i < n_ops; i++)
+            {
+                khint32_t x = draw(pattern);
+                if ((int)(rng_next() % 100) < p_del)
+                {
+                    khint_t k = kh_get(ref, r, x);
+                    assert(kh_b_del(s, x) == (k != kh_end(r)));
+                    if (k != kh_end(r))
+                        kh_del(ref, r, k);
+                }
+                else
+                {
+                    kh_put(ref, r, x, &ret); // 2 if it took a deleted bucket
+                    assert(kh_b_put(s, x, &ret2) == (ret > 0) && ret2 == (ret > 0));
+                }
+            }
+            for (int i = 0; i < 100000; i++)
+            {
+                khint32_t x = draw(pattern);
+                assert(kh_b_get(s, x) == (kh_get(ref, r, x) != kh_end(r)));
+            }
+            check_same(s, r);
+            if (round == 2)
+            {
+                kh_b_compact(s);
+                check_same(s, r);
+            }
+        }
+        kh_destroy(ref, r);
+        kh_b_destroy(s);
+    }
+
+    printf("Bitsets against khash sets tests passed!\n");
+}
+
+// A bitset with n keys of the given pattern, and the same keys in r
+static kh_bitset_t *random_set(int pattern, int n, khash_t(ref) *r)
+{
+    kh_bitset_t *s = kh_b_init();
+    int ret;
+    for (int i = 0; i < n; i++)
+    {
+        khint32_t x = draw(pattern);
+        kh_b_put(s, x, &ret);
+        kh_put(ref, r, x, &ret);
+    }
+    if (n % 2)
+        kh_b_compact(s); // runs as well as arrays and bitmaps
+    return s;
+}
+
+void test_bitset_ops()
+{
+    printf("Testing bitset union and intersection...\n");
+
+    kalloc_tally_t t;
+    kalloc_tally_init(&t, NULL);
+    const int sizes[] = {0, 10, 5001, 60000, 150001};
+    for (int pa = 0; pa < 4; pa++)
+        for (int pb = 0; pb < 4; pb++)
+            for (int ia = 0; ia < 5; ia++)
+            {
+                int ib = (ia + pa + pb) % 5;
+                khash_t(ref) *ra = kh_init(ref), *rb = kh_init(ref), *ru = kh_init(ref), *ri = kh_init(ref);
+                kh_bitset_t *a = random_set(pa, sizes[ia], ra), *b = random_set(pb, sizes[ib], rb);
+                khint32_t key;
+                int ret;
+                for (khint_t k = kh_begin(ra); k != kh_end(ra); ++k)
+                    if (kh_exist(ra, k))
+                    {
+                        kh_put(ref, ru, kh_key(ra, k), &ret);
+                        if (kh_get(ref, rb, kh_key(ra, k)) != kh_end(rb))
+                            kh_put(ref, ri, kh_key(ra, k), &ret);
+                    }
+                for (khint_t k = kh_begin(rb); k != kh_end(rb); ++k)
+                    if (kh_exist(rb, k))
+                        kh_put(ref, ru, kh_key(rb, k), &ret);
+
+                kh_bitset_t *ta = kh_b_init_with_alloc(&t.a), *u, *i;
+                kh_b_foreach(a, key, kh_b_put(ta, key, &ret));
+                u = kh_b_union(ta, b);
+                i = kh_b_intersect(ta, b);
+                assert(u && i && u->alloc == &t.a && i->alloc == &t.a);
+                check_same(u, ru);
+                check_same(i, ri);
+                assert(kh_b_intersect_size(a, b) == (size_t)kh_size(ri));
+                assert(kh_b_intersect_size(b, a) == (size_t)kh_size(ri));
+                assert(kh_b_union_size(a, b) == (size_t)kh_size(ru));
+
+                // Intersecting with the union gives the set back
+                kh_bitset_t *back = kh_b_intersect(b, u);
+                check_same(back, rb);
+                assert(kh_b_intersect_size(u, a) == kh_b_size(a));
+                kh_b_destroy(back);
+
+                // The tally holds exactly what the sets report
+                kmem_usage_t m = kh_b_memory_usage(ta);
+                kmem_usage_add(&m, kh_b_memory_usage(u));
+                kmem_usage_add(&m, kh_b_memory_usage(i));
+                assert(kmem_usage_total(m) == kalloc_tally_bytes(&t));
+
+                kh_b_destroy(ta);
+                kh_b_destroy(u);
+                kh_b_destroy(i);
+                assert(kalloc_tally_bytes(&t) == 0);
+                kh_b_destroy(a);
+                kh_b_destroy(b);
+                kh_destroy(ref, ra);
+                kh_destroy(ref, rb);
+                kh_destroy(ref, ru);
+                kh_destroy(ref, ri);
+            }
+
+    printf("Bitset union and intersection tests passed!\n");
+}
+
+void test_bitset_memory()
+{
+    printf("Testing bitset memory use...\n");
+
+    // IDs at 80% density in a range take far less than in a khash set
+    kh_bitset_t *s = kh_b_init();
+    khash_t(ref) *r = kh_init(ref);
+    int ret;
+    for (khint32_t x = 0; x < 1000000; x++)
+        if (rng_next() % 5)
+        {
+            kh_b_put(s, 5000000 + x, &ret);
+            kh_put(ref, r, 5000000 + x, &ret);
+        }
+    size_t bytes = kmem_usage_total(kh_b_memory_usage(s)), ref_bytes = kmem_usage_total(kh_memory_usage(ref, r));
+    printf("  %d keys: %.2f bytes a key, against %.2f in a khash set\n", (int)kh_size(r),
+           (double)bytes / kh_size(r), (double)ref_bytes / kh_size(r));
+    assert(bytes * 3 < ref_bytes);
+    check_same(s, r);
+
+    // Long runs take almost nothing once compacted
+    kh_b_clear(s);
+    for (khint32_t x = 0; x < 1000000; x++)
+        kh_b_put(s, x, &ret);
+    kh_b_compact(s);
+    assert(kmem_usage_total(kh_b_memory_usage(s)) < 4096);
+
+    kh_destroy(ref, r);
+    kh_b_destroy(s);
+
+    printf("Bitset memory use tests passed!\n");
+}
+
+// Allocator that fails once its budget is spent
+typedef struct
+{
+    size_t left;
+} budget_t;
+
+static void *budget_alloc(void *ctx, size_t size)
+{
+    budget_t *b = (budget_t *)ctx;
+    if (b->left == 0)
+        return NULL;
+    b->left--;
+    return malloc(size);
+}
+
+static void *budget_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    budget_t *b = (budget_t *)ctx;
+    (void)old_size;
+    if (b->left == 0)
+        return NULL;
+    b->left--;
+    return realloc(p, new_size);
+}
+
+static void budget_release(void *ctx, void *p, size_t size)
+{
+    (void)ctx, (void)size;
+    free(p);
+}
+
+void test_bitset_oom()
+{
+    printf("Testing bitsets out of memory...\n");
+
+    // However early memory runs out, the set holds what it reported
+    for (size_t budget = 0; budget < 200; budget += 7)
+    {
+        budget_t b = {budget};
+        kalloc_t a = {budget_alloc, budget_resize, budget_release, &b};
+        kh_bitset_t *s = kh_b_init_with_alloc(&a);
+        if (!s)
+            continue;
+        khash_t(ref) *r = kh_init(ref);
+        int ret;
+        for (int i = 0; i < 50000; i++)
+        {
+            khint32_t x = draw(3);
+            if (rng_next() % 4 == 0)
+            {
+                int d = kh_b_del(s, x);
+                khint_t k = kh_get(ref, r, x);
+                assert(d == -1 || d == (k != kh_end(r)));
+                if (d == 1)
+                    kh_del(ref, r, k);
+            }
+            else if (kh_b_put(s, x, &ret) > 0)
+                kh_put(ref, r, x, &ret);
+        }
+        check_same(s, r);
+        kh_bitset_t *u = kh_b_union(s, s), *i = kh_b_intersect(s, s);
+        if (u)
+            check_same(u, r);
+        if (i)
+            check_same(i, r);
+        kh_b_destroy(u);
+        kh_b_destroy(i);
+        kh_b_destroy(s);
+        kh_destroy(ref, r);
+    }
+
+    printf("Bitsets out of memory tests passed!\n");
+}
+
+int main()
+{
+    test_bitset_basic();
+    test_bitset_kinds();
+    test_bitset_random();
+    test_bitset_ops();
+    test_bitset_memory();
+    test_bitset_oom();
+    printf("\nAll tests passed successfully!\n");
+    return 0;
+}
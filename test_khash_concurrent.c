@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <assert.h>
+#include "khash_concurrent.h"
+
+// Declare test hash tables
+KHASH_CONCURRENT_INIT(c64, khint64_t, khint64_t, kh_int64_hash_func, kh_int64_hash_equal)
+typedef struct
+{
+    khint64_t a, b;
+    khint32_t c;
+} wide_t; // spans several words, the last one in part
+KHASH_CONCURRENT_INIT(cw, khint32_t, wide_t, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_SHARDED_INIT(s64, khint64_t, khint64_t, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_SHARDED_INIT(si, khint32_t, khint32_t, KH_MAP | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+static long n_compares;
+#define counted_equal(a, b) (n_compares++, (a) == (b))
+KHASH_SHARDED_INIT(sw, khint32_t, khint32_t, KH_MAP | KH_SWISS, kh_int32_hash_func, counted_equal)
+
+void test_concurrent_basic()
+{
+    printf("Testing concurrent hash map (single thread)...\n");
+
+    khash_c_t(c64) *h = kh_c_init(c64);
+    assert(h != NULL);
+    int r = kh_c_register(c64, h);
+    assert(r == 0);
+
+    khint64_t v;
+    assert(kh_c_get(c64, h, r, 5, &v) == 0);
+    assert(kh_c_put(c64, h, 5, 10) == 1);
+    assert(kh_c_get(c64, h, r, 5, &v) == 1 && v == 10);
+    assert(kh_c_put(c64, h, 5, 20) == 0);
+    assert(kh_c_get(c64, h, r, 5, &v) == 1 && v == 20);
+    assert(kh_c_del(c64, h, 5) == 1);
+    assert(kh_c_del(c64, h, 5) == 0);
+    assert(kh_c_get(c64, h, r, 5, &v) == 0);
+    assert(kh_c_size(h) == 0);
+
+    // Grow through several resizes
+    for (khint64_t i = 0; i < 10000; i++)
+        assert(kh_c_put(c64, h, i, i * 2) > 0);
+    assert(kh_c_size(h) == 10000);
+    for (khint64_t i = 0; i < 10000; i++)
+        assert(kh_c_get(c64, h, r, i, &v) == 1 && v == i * 2);
+
+    kh_c_destroy(c64, h);
+    printf("Concurrent basic tests passed!\n");
+}
+
+enum
+{
+    N_READERS = 4,
+    N_KEYS = 20000
+};
+
+typedef struct
+{
+    khash_c_t(c64) *h;
+    _Atomic int *stop;
+    long lookups;
+} reader_arg_t;
+
+static void *reader_main(void *p)
+{
+    reader_arg_t *a = p;
+    int r = kh_c_register(c64, a->h);
+    assert(r >= 0);
+    khint64_t v, i = 0;
+    while (!atomic_load(a->stop))
+    {
+        // Writers only ever store key * 3 as the value, so any other value is a torn read
+        if (kh_c_get(c64, a->h, r, i, &v))
+            assert(v == i * 3);
+        a->lookups++;
+        i = (i + 7) % N_KEYS;
+    }
+    return NULL;
+}
+
+void test_concurrent_readers()
+{
+    printf("Testing concurrent readers against a writer...\n");
+
+    khash_c_t(c64) *h = kh_c_init(c64);
+    _Atomic int stop = 0;
+    pthread_t tid[N_READERS];
+    reader_arg_t args[N_READERS];
+    for (int t = 0; t < N_READERS; t++)
+    {
+        args[t] = (reader_arg_t){h, &stop, 0};
+        pthread_create(&tid[t], NULL, reader_main, &args[t]);
+    }
+
+    // Inserts force resizes; deletes leave tombstones that are reused
+    for (int round = 0; round < 3; round++)
+    {
+        for (khint64_t i = 0; i < N_KEYS; i++)
+            kh_c_put(c64, h, i, i * 3);
+        for (khint64_t i = 0; i < N_KEYS; i += 2)
+            kh_c_del(c64, h, i);
+    }
+    atomic_store(&stop, 1);
+
+    long lookups = 0;
+    for (int t = 0; t < N_READERS; t++)
+    {
+        pthread_join(tid[t], NULL);
+        lookups += args[t].lookups;
+    }
+    assert(kh_c_size(h) == N_KEYS / 2);
+    printf("  %ld lookups during updates\n", lookups);
+
+    kh_c_destroy(c64, h);
+    printf("Concurrent reader tests passed!\n");
+}
+
+typedef struct
+{
+    khash_c_t(cw) *h;
+    _Atomic int *stop;
+} wide_reader_arg_t;
+
+static void *wide_reader_main(void *p)
+{
+    wide_reader_arg_t *a = p;
+    int r = kh_c_register(cw, a->h);
+    wide_t v;
+    for (khint32_t i = 0; !atomic_load(a->stop); i = (i + 1) % 1000)
+        if (kh_c_get(cw, a->h, r, i, &v)) // every field is written from the same round
+            assert(v.a % 1000 == (khint64_t)i && v.b == v.a * 3 && v.c == (khint32_t)(v.a / 1000));
+    return NULL;
+}
+
+void test_concurrent_wide()
+{
+    printf("Testing concurrent map with multi-word values...\n");
+
+    khash_c_t(cw) *h = kh_c_init(cw);
+    _Atomic int stop = 0;
+    pthread_t tid[N_READERS];
+    wide_reader_arg_t arg = {h, &stop};
+    for (int t = 0; t < N_READERS; t++)
+        pthread_create(&tid[t], NULL, wide_reader_main, &arg);
+    for (khint32_t round = 0; round < 200; round++)
+        for (khint32_t i = 0; i < 1000; i++)
+        {
+            khint64_t a = (khint64_t)round * 1000 + i;
+            kh_c_put(cw, h, i, ((wide_t){a, a * 3, round}));
+        }
+    atomic_store(&stop, 1);
+    for (int t = 0; t < N_READERS; t++)
+        pthread_join(tid[t], NULL);
+
+    int r = kh_c_register(cw, h);
+    wide_t v;
+    assert(kh_c_size(h) == 1000 && kh_c_get(cw, h, r, 999, &v) && v.a == 199999 && v.c == 199);
+    kh_c_destroy(cw, h);
+    printf("Concurrent multi-word tests passed!\n");
+}
+
+enum
+{
+    N_WRITERS = 4,
+    N_PER_WRITER = 20000
+};
+
+typedef struct
+{
+    khash_s_t(s64) *h;
+    khint64_t base;
+} writer_arg_t;
+
+static void *writer_main(void *p)
+{
+    writer_arg_t *a = p;
+    for (khint64_t i = 0; i < N_PER_WRITER; i++)
+        assert(kh_s_put(s64, a->h, a->base + i, a->base + i + 1) > 0);
+    for (khint64_t i = 0; i < N_PER_WRITER; i += 4)
+        assert(kh_s_del(s64, a->h, a->base + i) == 1);
+    return NULL;
+}
+
+void test_sharded()
+{
+    printf("Testing sharded hash map...\n");
+
+    khash_s_t(s64) *h = kh_s_init(s64, 4);
+    assert(h != NULL);
+    khint64_t v;
+    assert(kh_s_put(s64, h, 7, 70) == 1);
+    assert(kh_s_put(s64, h, 7, 71) == 0);
+    assert(kh_s_get(s64, h, 7, &v) == 1 && v == 71);
+    assert(kh_s_del(s64, h, 7) == 1);
+    assert(kh_s_get(s64, h, 7, NULL) == 0);
+
+    // Writers on disjoint key ranges, resizing their shards as they go
+    pthread_t tid[N_WRITERS];
+    writer_arg_t args[N_WRITERS];
+    for (int t = 0; t < N_WRITERS; t++)
+    {
+        args[t] = (writer_arg_t){h, (khint64_t)t * N_PER_WRITER};
+        pthread_create(&tid[t], NULL, writer_main, &args[t]);
+    }
+    for (int t = 0; t < N_WRITERS; t++)
+        pthread_join(tid[t], NULL);
+
+    khint_t expected = N_WRITERS * (N_PER_WRITER - N_PER_WRITER / 4);
+    assert(kh_s_size(s64, h) == expected);
+    for (khint64_t i = 0; i < N_WRITERS * N_PER_WRITER; i++)
+        assert(kh_s_get(s64, h, i, &v) == (i % 4 != 0) && (i % 4 == 0 || v == i + 1));
+
+    // Every shard got a share of the keys, and foreach sees all of them
+    for (int s = 0; s < 1 << h->bits; s++)
+        assert(kh_size(h->shards[s].h) > 0);
+    khint64_t key, val;
+    khint_t seen = 0;
+    kh_s_foreach(h, key, val, {
+        assert(val == key + 1);
+        seen++;
+    });
+    assert(seen == expected);
+
+    kh_probe_stat_t stats = kh_s_probe_stats(s64, h);
+    assert(stats.max_probes >= 1 && stats.avg_probes >= 1.0 && stats.variance >= 0.0);
+    printf("  %d shards: avg probes %.3f, max %d\n", 1 << h->bits, stats.avg_probes, stats.max_probes);
+    kmem_usage_t u = kh_s_memory_usage(s64, h);
+    assert(u.live == expected * 2 * sizeof(khint64_t) && u.tombstones > 0 && u.slack > 0);
+
+    kh_s_destroy(s64, h);
+    printf("Sharded tests passed!\n");
+}
+
+// Single-threaded round trip through the shards of one engine or bucket layout
+#define CHECK_SHARDED(name, bits)                                                               \
+    {                                                                                           \
+        khash_s_t(name) *h = kh_s_init(name, bits);                                             \
+        khint32_t v = 0;                                                                        \
+        for (khint32_t i = 0; i < 1000; i++)                                                    \
+            assert(kh_s_put(name, h, i, i * 7 + 1) == 1);                                       \
+        for (khint32_t i = 0; i < 1000; i += 3)                                                 \
+            assert(kh_s_del(name, h, i) == 1);                                                  \
+        assert(kh_s_size(name, h) == 666);                                                      \
+        for (khint32_t i = 0; i < 1000; i++)                                                    \
+            assert(kh_s_get(name, h, i, &v) == (i % 3 != 0) && (i % 3 == 0 || v == i * 7 + 1)); \
+        kh_s_destroy(name, h);                                                                  \
+    }
+
+void test_sharded_layouts()
+{
+    printf("Testing sharded engines and layouts...\n");
+    CHECK_SHARDED(si, 0);
+    CHECK_SHARDED(si, 4);
+    CHECK_SHARDED(sw, 0);
+    CHECK_SHARDED(sw, 8);
+
+    // The shard index is independent of the KH_SWISS tags, so misses still rarely reach a key
+    for (int bits = 0; bits <= 8; bits += 4)
+    {
+        khash_s_t(sw) *h = kh_s_init(sw, bits);
+        for (khint32_t i = 0; i < 100000; i++)
+            kh_s_put(sw, h, i, i);
+        n_compares = 0;
+        for (khint32_t i = 100000; i < 200000; i++)
+            assert(kh_s_get(sw, h, i, NULL) == 0);
+        printf("  %d shards: %.3f key compares per miss\n", 1 << bits, n_compares / 1e5);
+        assert(n_compares < 100000 / 2);
+        kh_s_destroy(sw, h);
+    }
+    printf("Sharded layout tests passed!\n");
+}
+
+int main()
+{
+    printf("Starting khash_concurrent.h unit tests...\n\n");
+
+    test_concurrent_basic();
+    test_concurrent_readers();
+    test_concurrent_wide();
+    test_sharded();
+    test_sharded_layouts();
+
+    printf("\nAll tests passed successfully!\n");
+    return 0;
+}
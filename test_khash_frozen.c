@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <assert.h>
+#include "khash_frozen.h"
+
+#define TMP_PATH "test_khash_frozen.tmp"
+
+// Declare test hash tables
+KHASH_MAP_INIT_INT(m32, int)
+KHASH_MAP_INIT_INT64(m64, khint64_t)
+KHASH_MAP_INIT_STR(mstr, int)
+KHASH_SET_INIT_INT64(s64)
+KHASH_INIT(swiss64, khint64_t, khint64_t, KH_MAP | KH_SWISS, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_FROZEN_MAP_INIT_INT(f32, m32, int)
+KHASH_FROZEN_MAP_INIT_INT64(f64, m64, khint64_t)
+KHASH_FROZEN_MAP_INIT_STR(fstr, mstr, int)
+KHASH_FROZEN_INIT(fs64, s64, khint64_t, char, 0, kh_f_int64_hash64, kh_int64_hash_equal)
+KHASH_FROZEN_INIT(fswiss64, swiss64, khint64_t, khint64_t, 1, kh_f_int64_hash64, kh_int64_hash_equal)
+
+static khint64_t collide_hash64(khint64_t key)
+{
+    return key >> 1; // keys 2k and 2k + 1 cannot be told apart
+}
+KHASH_FROZEN_INIT(fbad64, m64, khint64_t, khint64_t, 1, collide_hash64, kh_int64_hash_equal)
+
+void test_frozen_int()
+{
+    printf("Testing frozen integer maps...\n");
+
+    int ret;
+    for (int n = 0; n <= 100000; n = n ? n * 10 : 1)
+    {
+        khash_t(m32) *h = kh_init(m32);
+        for (int i = 0; i < n; i++)
+        {
+            khint_t k = kh_put(m32, h, i * 3 - n, &ret);
+            kh_value(h, k) = i;
+        }
+        khash_f_t(f32) *f = kh_freeze(f32, h);
+        assert(f != NULL && kh_f_size(f) == (khint_t)n && kh_f_end(f) == (khint_t)n);
+        for (int i = -n - 10; i < 3 * n; i++)
+        {
+            khint_t x = kh_f_get(f32, f, i);
+            khint_t k = kh_get(m32, h, i);
+            assert((x == kh_f_end(f)) == (k == kh_end(h)));
+            if (k != kh_end(h))
+                assert(kh_f_key(f32, f, x) == i && kh_f_val(f, x) == kh_value(h, k));
+        }
+        // Every slot holds a key, and every key has its own slot
+        khint64_t sum = 0;
+        for (khint_t x = 0; x < kh_f_end(f); x++)
+        {
+            assert(kh_f_get(f32, f, kh_f_key(f32, f, x)) == x);
+            sum += kh_f_val(f, x);
+        }
+        assert(sum == (khint64_t)n * (n - 1) / 2);
+        kh_f_destroy(f32, f);
+        kh_destroy(m32, h);
+    }
+
+    // 64-bit keys, with a source table in the middle of an incremental rehash
+    khash_t(m64) *h = kh_init(m64);
+    kh_set_incremental(h, 16);
+    for (khint64_t i = 0; i < 50000; i++)
+    {
+        khint_t k = kh_put(m64, h, splittable64(i), &ret);
+        kh_value(h, k) = i;
+    }
+    khash_f_t(f64) *f = kh_freeze(f64, h);
+    assert(f != NULL && kh_f_size(f) == 50000);
+    for (khint64_t i = 0; i < 100000; i++)
+    {
+        khint_t x = kh_f_get(f64, f, splittable64(i));
+        assert(i < 50000 ? x != kh_f_end(f) && kh_f_val(f, x) == i : x == kh_f_end(f));
+    }
+    kh_f_destroy(f64, f);
+
+    // No displacement separates keys with the same 64-bit hash
+    kh_clear(m64, h);
+    for (khint64_t i = 0; i < 100; i++)
+        kh_put(m64, h, i, &ret);
+    assert(kh_freeze(fbad64, h) == NULL);
+    kh_destroy(m64, h);
+
+    printf("Frozen integer map tests passed!\n");
+}
+
+// Overwrites n bytes at offset off into array a of a saved frozen table
+static void patch_frozen(int a, uint64_t off, const void *p, size_t n)
+{
+    kh_f_header_t hd;
+    FILE *fp = fopen(TMP_PATH, "r+b");
+    assert(fp && fread(&hd, sizeof(hd), 1, fp) == 1);
+    fseek(fp, (long)(hd.offset[a] + off), SEEK_SET);
+    assert(fwrite(p, 1, n, fp) == n);
+    fclose(fp);
+}
+
+void test_frozen_other()
+{
+    printf("Testing frozen string maps, sets and other engines...\n");
+
+    int ret;
+    char buf[32], (*strs)[16] = malloc(20000 * sizeof(*strs));
+    khash_t(mstr) *h = kh_init(mstr);
+    for (int i = 0; i < 20000; i++)
+    {
+        snprintf(strs[i], sizeof(strs[i]), "key-%d", i);
+        khint_t k = kh_put(mstr, h, strs[i], &ret);
+        kh_value(h, k) = i;
+    }
+    khash_f_t(fstr) *f = kh_freeze(fstr, h);
+    assert(f != NULL && kh_f_size(f) == 20000);
+    // The frozen table has copies of the strings
+    memset(strs, 0, 20000 * sizeof(*strs));
+    free(strs);
+    kh_destroy(mstr, h);
+    for (int i = 0; i < 40000; i++)
+    {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        khint_t x = kh_f_get(fstr, f, buf);
+        if (i < 20000)
+            assert(x != kh_f_end(f) && kh_f_val(f, x) == i && strcmp(kh_f_key(fstr, f, x), buf) == 0);
+        else
+            assert(x == kh_f_end(f));
+    }
+    assert(kh_f_get(fstr, f, "") == kh_f_end(f));
+
+    assert(kh_f_save(fstr, f, TMP_PATH) == 0);
+    khash_f_t(fstr) *g = kh_f_load(fstr, TMP_PATH);
+    assert(g != NULL && g->base != NULL && kh_f_size(g) == 20000);
+    for (int i = 0; i < 40000; i++)
+    {
+        snprintf(buf, sizeof(buf), "key-%d", i);
+        assert(kh_f_get(fstr, g, buf) == kh_f_get(fstr, f, buf));
+    }
+    kh_f_destroy(fstr, g);
+
+    // Indexes into the file are all checked, not only those of the sampled keys
+    khint64_t far = f->strs_size + 1000;
+    patch_frozen(__KH_F_KEYS, sizeof(khint64_t), &far, sizeof(far)); // slot 1 is not sampled
+    assert(kh_f_load(fstr, TMP_PATH) == NULL);
+    assert(kh_f_save(fstr, f, TMP_PATH) == 0);
+    uint32_t slot = 0x7fffffff;
+    patch_frozen(__KH_F_REMAP, (f->n_slots - f->size - 1) * sizeof(uint32_t), &slot, sizeof(slot));
+    assert(kh_f_load(fstr, TMP_PATH) == NULL);
+    kh_f_destroy(fstr, f);
+
+    khash_t(s64) *s = kh_init(s64);
+    for (khint64_t i = 0; i < 1000; i++)
+        kh_put(s64, s, i * i, &ret);
+    khash_f_t(fs64) *fs = kh_freeze(fs64, s);
+    assert(fs != NULL && fs->vals == NULL);
+    for (khint64_t i = 0; i < 1000 * 1000; i++)
+        assert((kh_f_get(fs64, fs, i) != kh_f_end(fs)) == (kh_get(s64, s, i) != kh_end(s)));
+    kh_f_destroy(fs64, fs);
+    kh_destroy(s64, s);
+
+    khash_t(swiss64) *w = kh_init(swiss64);
+    for (khint64_t i = 0; i < 5000; i++)
+    {
+        khint_t k = kh_put(swiss64, w, i, &ret);
+        kh_value(w, k) = i + 1;
+    }
+    khash_f_t(fswiss64) *fw = kh_freeze(fswiss64, w);
+    for (khint64_t i = 0; i < 5000; i++)
+        assert(kh_f_val(fw, kh_f_get(fswiss64, fw, i)) == i + 1);
+    kh_f_destroy(fswiss64, fw);
+    kh_destroy(swiss64, w);
+
+    remove(TMP_PATH);
+    printf("Frozen string map, set and engine tests passed!\n");
+}
+
+void test_frozen_save()
+{
+    printf("Testing saved frozen tables...\n");
+
+    int ret;
+    khash_t(m64) *h = kh_init(m64);
+    for (khint64_t i = 0; i < 30000; i++)
+    {
+        khint_t k = kh_put(m64, h, i * 11, &ret);
+        kh_value(h, k) = i;
+    }
+    khash_f_t(f64) *f = kh_freeze(f64, h);
+    assert(kh_f_save(f64, f, TMP_PATH) == 0);
+    khash_f_t(f64) *g = kh_f_load(f64, TMP_PATH);
+    assert(g != NULL && kh_f_size(g) == 30000);
+    for (khint64_t i = 0; i < 330000; i++)
+    {
+        khint_t x = kh_f_get(f64, g, i);
+        assert(x == kh_f_get(f64, f, i));
+        if (x != kh_f_end(g))
+            assert(kh_f_key(f64, g, x) == i && kh_f_val(g, x) == i / 11);
+    }
+    kh_f_destroy(f64, g);
+
+    assert(kh_f_load(fs64, TMP_PATH) == NULL); // a set
+    assert(kh_f_load(f32, TMP_PATH) == NULL); // other types
+    assert(kh_f_load(fbad64, TMP_PATH) == NULL); // other hash function
+
+    FILE *fp = fopen(TMP_PATH, "r+b"); // truncate by one byte
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    rewind(fp);
+    char *buf = malloc(len);
+    size_t n = fread(buf, 1, len, fp);
+    assert(n == (size_t)len);
+    fclose(fp);
+    fp = fopen(TMP_PATH, "wb");
+    fwrite(buf, 1, len - 1, fp);
+    fclose(fp);
+    assert(kh_f_load(f64, TMP_PATH) == NULL);
+    free(buf);
+
+    // An empty table saves and loads too
+    khash_t(m64) *e = kh_init(m64);
+    khash_f_t(f64) *fe = kh_freeze(f64, e);
+    assert(fe != NULL && kh_f_size(fe) == 0 && kh_f_get(f64, fe, 1) == kh_f_end(fe));
+    assert(kh_f_save(f64, fe, TMP_PATH) == 0);
+    kh_f_destroy(f64, fe);
+    fe = kh_f_load(f64, TMP_PATH);
+    assert(fe != NULL && kh_f_size(fe) == 0 && kh_f_get(f64, fe, 1) == kh_f_end(fe));
+    kh_f_destroy(f64, fe);
+    kh_destroy(m64, e);
+
+    kh_f_destroy(f64, f);
+    kh_destroy(m64, h);
+    remove(TMP_PATH);
+    printf("Saved frozen table tests passed!\n");
+}
+
+int main()
+{
+    printf("Starting khash_frozen.h unit tests...\n\n");
+
+    test_frozen_int();
+    test_frozen_other();
+    test_frozen_save();
+
+    printf("\nAll tests passed successfully!\n");
+    return 0;
+}
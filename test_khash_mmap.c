@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <assert.h>
+#include "khash_mmap.h"
+
+#define TMP_PATH "test_khash_mmap.tmp"
+
+static khint_t bad_hash(khint64_t key)
+{
+    return kh_int64_hash_func(key) ^ 0x5555;
+}
+
+// Declare test hash tables
+KHASH_MMAP_INIT(m64, khint64_t, khint64_t, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_MMAP_INIT(swiss64, khint64_t, char, KH_SET | KH_SWISS, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_MMAP_INIT(rh32, khint32_t, double, KH_MAP | KH_ROBINHOOD | KH_STORE_HASH, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_MMAP_INIT(bad64, khint64_t, khint64_t, KH_MAP, bad_hash, kh_int64_hash_equal)
+KHASH_MMAP_INIT(s64, khint64_t, char, KH_SET, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_MMAP_INIT(kv32, khint32_t, int, KH_MAP | KH_INTERLEAVED, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_MMAP_INIT(m32, khint32_t, int, KH_MAP, kh_int32_hash_func, kh_int_hash_equal)
+
+// The whole file, to check that modifying a mapped table leaves it alone
+static char *read_file(const char *path, long *len)
+{
+    FILE *fp = fopen(path, "rb");
+    assert(fp != NULL);
+    fseek(fp, 0, SEEK_END);
+    *len = ftell(fp);
+    rewind(fp);
+    char *buf = malloc(*len);
+    size_t n = fread(buf, 1, *len, fp);
+    assert(n == (size_t)*len);
+    fclose(fp);
+    return buf;
+}
+
+void test_round_trip()
+{
+    printf("Testing save and load of a map...\n");
+
+    int ret;
+    khash_t(m64) *h = kh_init(m64);
+    for (khint64_t i = 0; i < 5000; i++)
+    {
+        khint_t k = kh_put(m64, h, i * 7919, &ret);
+        kh_value(h, k) = i;
+    }
+    for (khint64_t i = 0; i < 5000; i += 3) // leave deleted buckets behind
+        kh_del(m64, h, kh_get(m64, h, i * 7919));
+    assert(kh_save(m64, h, TMP_PATH) == 0);
+
+    khash_t(m64) *g = kh_load_mmap(m64, TMP_PATH);
+    assert(g != NULL);
+    assert(kh_size(g) == kh_size(h) && kh_end(g) == kh_end(h));
+    for (khint64_t i = 0; i < 10000; i++)
+    {
+        khint_t x = kh_get(m64, h, i * 7919), y = kh_get(m64, g, i * 7919);
+        assert(x == y);
+        if (x != kh_end(h))
+            assert(kh_value(g, y) == kh_value(h, x));
+    }
+
+    // The loaded table is an ordinary table; changing it leaves the file as it was
+    long len0, len1;
+    char *before = read_file(TMP_PATH, &len0);
+    for (khint64_t i = 5000; i < 20000; i++) // forces resizes
+    {
+        khint_t k = kh_put(m64, g, i * 7919, &ret);
+        kh_value(g, k) = i;
+    }
+    for (khint64_t i = 1; i < 5000; i += 3)
+        kh_del(m64, g, kh_get(m64, g, i * 7919));
+    for (khint64_t i = 0; i < 20000; i++)
+    {
+        khint_t k = kh_get(m64, g, i * 7919);
+        if (i >= 5000 || i % 3 == 2)
+            assert(k != kh_end(g) && kh_value(g, k) == i);
+        else
+            assert(k == kh_end(g));
+    }
+    kh_destroy(m64, g);
+    char *after = read_file(TMP_PATH, &len1);
+    assert(len0 == len1 && memcmp(before, after, len0) == 0);
+    free(before);
+    free(after);
+
+    // Modify the mapped buckets in place without a resize
+    g = kh_load_mmap(m64, TMP_PATH);
+    assert(g != NULL);
+    khint_t k = kh_get(m64, g, 2 * 7919);
+    kh_value(g, k) = 42;
+    kh_del(m64, g, kh_get(m64, g, 5 * 7919));
+    assert(kh_get(m64, g, 5 * 7919) == kh_end(g));
+    kh_destroy(m64, g);
+    g = kh_load_mmap(m64, TMP_PATH);
+    assert(kh_value(g, kh_get(m64, g, 2 * 7919)) == 2);
+    assert(kh_get(m64, g, 5 * 7919) != kh_end(g));
+    kh_destroy(m64, g);
+
+    kh_destroy(m64, h);
+    remove(TMP_PATH);
+    printf("Map save and load tests passed!\n");
+}
+
+void test_engines()
+{
+    printf("Testing save and load of other engines...\n");
+
+    int ret;
+    khash_t(swiss64) *s = kh_init(swiss64);
+    for (khint64_t i = 0; i < 3000; i++)
+        kh_put(swiss64, s, splittable64(i), &ret);
+    assert(kh_save(swiss64, s, TMP_PATH) == 0);
+    khash_t(swiss64) *t = kh_load_mmap(swiss64, TMP_PATH);
+    assert(t != NULL && kh_size(t) == 3000);
+    for (khint64_t i = 0; i < 6000; i++)
+        assert(kh_get(swiss64, t, splittable64(i)) == kh_get(swiss64, s, splittable64(i)));
+    kh_put(swiss64, t, 1, &ret);
+    assert(ret == 1 && kh_get(swiss64, t, 1) != kh_end(t));
+    kh_destroy(swiss64, t);
+    kh_destroy(swiss64, s);
+
+    khash_t(rh32) *h = kh_init(rh32);
+    for (khint32_t i = 0; i < 3000; i++)
+    {
+        khint_t k = kh_put(rh32, h, i * 13, &ret);
+        kh_value(h, k) = i * 0.5;
+    }
+    assert(kh_save(rh32, h, TMP_PATH) == 0);
+    khash_t(rh32) *g = kh_load_mmap(rh32, TMP_PATH);
+    assert(g != NULL && kh_size(g) == 3000 && g->hashes != NULL);
+    for (khint32_t i = 0; i < 6000; i++)
+    {
+        khint_t k = kh_get(rh32, g, i * 13);
+        assert(k == kh_get(rh32, h, i * 13));
+        if (i < 3000)
+            assert(kh_value(g, k) == i * 0.5);
+    }
+    for (khint32_t i = 0; i < 3000; i += 2)
+        kh_del(rh32, g, kh_get(rh32, g, i * 13));
+    assert(kh_size(g) == 1500 && kh_get(rh32, g, 13) != kh_end(g));
+    kh_destroy(rh32, g);
+    kh_destroy(rh32, h);
+
+    // Interleaved keys and values are one array in the file
+    khash_t(kv32) *p = kh_init(kv32);
+    for (int i = 0; i < 3000; i++)
+    {
+        khint_t k = kh_put(kv32, p, i * 3, &ret);
+        kh_value(p, k) = -i;
+    }
+    assert(kh_save(kv32, p, TMP_PATH) == 0);
+    khash_t(kv32) *q = kh_load_mmap(kv32, TMP_PATH);
+    assert(q != NULL && kh_size(q) == 3000 && kh_load_mmap(m32, TMP_PATH) == NULL);
+    for (int i = 0; i < 3000; i++)
+        assert(kh_value(q, kh_get(kv32, q, i * 3)) == -i);
+    for (int i = 3000; i < 6000; i++) // grows out of the file
+    {
+        khint_t k = kh_put(kv32, q, i * 3, &ret);
+        kh_value(q, k) = -i;
+    }
+    for (int i = 0; i < 6000; i++)
+        assert(kh_value(q, kh_get(kv32, q, i * 3)) == -i);
+    kh_destroy(kv32, q);
+    kh_destroy(kv32, p);
+
+    // An empty table has no arrays at all
+    khash_t(m64) *e = kh_init(m64);
+    assert(kh_save(m64, e, TMP_PATH) == 0);
+    kh_destroy(m64, e);
+    e = kh_load_mmap(m64, TMP_PATH);
+    assert(e != NULL && kh_size(e) == 0 && kh_get(m64, e, 1) == kh_end(e));
+    kh_put(m64, e, 1, &ret);
+    assert(kh_size(e) == 1);
+    kh_destroy(m64, e);
+
+    remove(TMP_PATH);
+    printf("Engine save and load tests passed!\n");
+}
+
+void test_bad_files()
+{
+    printf("Testing rejected files...\n");
+
+    int ret;
+    khash_t(m64) *h = kh_init(m64);
+    for (khint64_t i = 0; i < 1000; i++)
+    {
+        khint_t k = kh_put(m64, h, i, &ret);
+        kh_value(h, k) = i;
+    }
+    assert(kh_save(m64, h, TMP_PATH) == 0);
+
+    assert(kh_load_mmap(m64, "test_khash_mmap.missing") == NULL);
+    assert(kh_load_mmap(s64, TMP_PATH) == NULL);   // a set of the same key type
+    assert(kh_load_mmap(rh32, TMP_PATH) == NULL);  // other types
+    assert(kh_load_mmap(bad64, TMP_PATH) == NULL); // keys do not hash to their buckets
+
+    long len;
+    char *buf = read_file(TMP_PATH, &len);
+    FILE *fp = fopen(TMP_PATH, "wb"); // truncated
+    fwrite(buf, 1, len - 1, fp);
+    fclose(fp);
+    assert(kh_load_mmap(m64, TMP_PATH) == NULL);
+    buf[0] = 'X'; // wrong magic
+    fp = fopen(TMP_PATH, "wb");
+    fwrite(buf, 1, len, fp);
+    fclose(fp);
+    assert(kh_load_mmap(m64, TMP_PATH) == NULL);
+    buf[0] = 'K';
+    ((kh_mmap_header_t *)buf)->offset[__KH_MMAP_VALS] = len; // array past the end
+    fp = fopen(TMP_PATH, "wb");
+    fwrite(buf, 1, len, fp);
+    fclose(fp);
+    assert(kh_load_mmap(m64, TMP_PATH) == NULL);
+    free(buf);
+
+    // KH_SWISS files saved by a build with other probe groups, and ones too small for a group
+    khash_t(swiss64) *s = kh_init(swiss64);
+    for (khint64_t i = 0; i < 1000; i++)
+        kh_put(swiss64, s, i, &ret);
+    assert(kh_save(swiss64, s, TMP_PATH) == 0);
+    buf = read_file(TMP_PATH, &len);
+    kh_mmap_header_t *hd = (kh_mmap_header_t *)buf;
+    assert(hd->group_width == KH_GROUP_WIDTH);
+    hd->group_width = KH_GROUP_WIDTH == 16 ? 32 : 16;
+    fp = fopen(TMP_PATH, "wb");
+    fwrite(buf, 1, len, fp);
+    fclose(fp);
+    assert(kh_load_mmap(swiss64, TMP_PATH) == NULL);
+    hd->group_width = KH_GROUP_WIDTH;
+    hd->n_buckets = KH_GROUP_WIDTH / 2;
+    fp = fopen(TMP_PATH, "wb");
+    fwrite(buf, 1, len, fp);
+    fclose(fp);
+    assert(kh_load_mmap(swiss64, TMP_PATH) == NULL);
+    free(buf);
+    kh_destroy(swiss64, s);
+
+    kh_destroy(m64, h);
+    remove(TMP_PATH);
+    printf("Rejected file tests passed!\n");
+}
+
+int main()
+{
+    printf("Starting khash_mmap.h unit tests...\n\n");
+
+    test_round_trip();
+    test_engines();
+    test_bad_files();
+
+    printf("\nAll tests passed successfully!\n");
+    return 0;
+}
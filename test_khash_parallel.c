@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <assert.h>
+#define KH_PAR_THREADS 4 // resize on threads even on one core, and even small tables
+#define KH_PAR_RESIZE_MIN 1000
+#include "khash_parallel.h"
+
+// Declare test hash tables
+KHASH_PARALLEL_INIT(m64, khint64_t, khint64_t, KH_MAP, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_PARALLEL_INIT(m32, khint32_t, int, KH_MAP | KH_STORE_HASH, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_PARALLEL_INIT(swiss64, khint64_t, khint64_t, KH_MAP | KH_SWISS, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_PARALLEL_INIT(rh64, khint64_t, khint64_t, KH_MAP | KH_ROBINHOOD, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_PARALLEL_INIT(s64, khint64_t, char, KH_SET, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_PARALLEL_INIT(kv64, khint64_t, khint64_t, KH_MAP | KH_INTERLEAVED, kh_int64_hash_func, kh_int64_hash_equal)
+KHASH_MAP_INIT_INT64(ref64, khint64_t)
+
+// Not commutative, so the result tells the order in which values were combined
+static void fold(khint64_t *acc, const khint64_t *v, void *ctx)
+{
+    *acc = (khint64_t)((uint64_t)*acc * 31 + *v);
+    atomic_fetch_add((atomic_long *)ctx, 1); // combine may run on any thread
+}
+
+typedef struct
+{
+    khash_t(m64) *h;
+    khint64_t sum[8];
+    khint_t count[8];
+} scan_t;
+
+static void scan_part(void *arg, int t, khint_t begin, khint_t end)
+{
+    scan_t *s = arg;
+    khint64_t key, val;
+    kh_foreach_range(s->h, begin, end, key, val, {
+        assert(val == key * 2);
+        s->sum[t] += val;
+        s->count[t]++;
+    });
+}
+
+#define CHECK_BUILD(name, keys, vals, n)                                       \
+    for (int n_threads = 1; n_threads <= 4; n_threads += 3)                    \
+    {                                                                          \
+        int ret;                                                               \
+        khash_t(name) *ref = kh_init(name);                                    \
+        for (size_t i = 0; i < (n); i++)                                       \
+        {                                                                      \
+            khint_t k = kh_put(name, ref, (keys)[i], &ret);                    \
+            kh_value(ref, k) = (vals)[i];                                      \
+        }                                                                      \
+        khash_t(name) *h = kh_build(name, keys, vals, n, n_threads);           \
+        assert(h != NULL && kh_size(h) == kh_size(ref));                       \
+        for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)                 \
+        {                                                                      \
+            if (!kh_exist(ref, k))                                             \
+                continue;                                                      \
+            khint_t x = kh_get(name, h, kh_key(ref, k));                       \
+            assert(x != kh_end(h) && kh_value(h, x) == kh_value(ref, k));      \
+        }                                                                      \
+        /* The table grows as usual afterwards */                              \
+        for (size_t i = 0; i < (n); i++)                                       \
+            kh_put(name, h, (keys)[i] + 1000003, &ret);                        \
+        for (size_t i = 0; i < (n); i++)                                       \
+            assert(kh_get(name, h, (keys)[i]) != kh_end(h));                   \
+        kh_destroy(name, h);                                                   \
+        kh_destroy(name, ref);                                                 \
+    }
+
+void test_build()
+{
+    printf("Testing bulk builds...\n");
+
+    size_t n = 300000;
+    khint64_t *keys = malloc(n * sizeof(*keys)), *vals = malloc(n * sizeof(*vals));
+    int *ivals = malloc(n * sizeof(*ivals));
+    khint32_t *ikeys = malloc(n * sizeof(*ikeys));
+    for (size_t i = 0; i < n; i++)
+    {
+        keys[i] = splittable64(i) % 200000; // about a third are repeats
+        vals[i] = i;
+        ikeys[i] = (khint32_t)keys[i] * 7;
+        ivals[i] = (int)i;
+    }
+    CHECK_BUILD(m64, keys, vals, n);
+    CHECK_BUILD(m32, ikeys, ivals, n);
+    CHECK_BUILD(swiss64, keys, vals, n);
+    CHECK_BUILD(rh64, keys, vals, n);
+    CHECK_BUILD(kv64, keys, vals, n);
+    CHECK_BUILD(m64, keys, vals, 1000);
+    CHECK_BUILD(m64, keys, vals, 1);
+
+    // Nothing to build
+    khash_t(m64) *h = kh_build(m64, keys, vals, 0, 4);
+    assert(h != NULL && kh_size(h) == 0 && kh_get(m64, h, 1) == kh_end(h));
+    kh_destroy(m64, h);
+
+    // A set has no values
+    khash_t(s64) *s = kh_build(s64, keys, NULL, n, 4);
+    assert(s != NULL && s->vals == NULL);
+    for (size_t i = 0; i < n; i++)
+        assert(kh_get(s64, s, keys[i]) != kh_end(s));
+    assert(kh_get(s64, s, 200000) == kh_end(s));
+    kh_destroy(s64, s);
+
+    free(keys);
+    free(vals);
+    free(ikeys);
+    free(ivals);
+    printf("Bulk build tests passed!\n");
+}
+
+void test_build_combine()
+{
+    printf("Testing bulk builds with combined values...\n");
+
+    size_t n = 200000;
+    khint64_t *keys = malloc(n * sizeof(*keys)), *vals = malloc(n * sizeof(*vals));
+    for (size_t i = 0; i < n; i++)
+    {
+        keys[i] = splittable64(i) % 5000;
+        vals[i] = splittable64(i + n) % 1000;
+    }
+    int ret;
+    khash_t(m64) *ref = kh_init(m64);
+    for (size_t i = 0; i < n; i++)
+    {
+        khint_t k = kh_put(m64, ref, keys[i], &ret);
+        kh_value(ref, k) = ret ? vals[i] : (khint64_t)((uint64_t)kh_value(ref, k) * 31 + vals[i]);
+    }
+    for (int n_threads = 1; n_threads <= 8; n_threads *= 2)
+    {
+        atomic_long calls = 0;
+        khash_t(m64) *h = kh_build_combine(m64, keys, vals, n, n_threads, fold, &calls);
+        assert(h != NULL && kh_size(h) == kh_size(ref) && calls == (long)(n - kh_size(ref)));
+        for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)
+            if (kh_exist(ref, k))
+                assert(kh_value(h, kh_get(m64, h, kh_key(ref, k))) == kh_value(ref, k));
+        kh_destroy(m64, h);
+    }
+    // The same on the serial engines
+    atomic_long calls = 0;
+    khash_t(swiss64) *w = kh_build_combine(swiss64, keys, vals, n, 4, fold, &calls);
+    assert(w != NULL && kh_size(w) == kh_size(ref) && calls == (long)(n - kh_size(ref)));
+    for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)
+        if (kh_exist(ref, k))
+            assert(kh_value(w, kh_get(swiss64, w, kh_key(ref, k))) == kh_value(ref, k));
+    kh_destroy(swiss64, w);
+
+    kh_destroy(m64, ref);
+    free(keys);
+    free(vals);
+    printf("Combined bulk build tests passed!\n");
+}
+
+void test_resize()
+{
+    printf("Testing multi-threaded resizes...\n");
+
+    int ret;
+    khash_t(m64) *h = kh_init(m64);
+    khash_t(ref64) *ref = kh_init(ref64);
+    for (khint64_t i = 0; i < 200000; i++)
+    {
+        khint64_t key = (khint64_t)splittable64(i);
+        khint_t k = kh_put(m64, h, key, &ret);
+        kh_value(h, k) = i;
+        k = kh_put(ref64, ref, key, &ret);
+        kh_value(ref, k) = i;
+        if (i % 3 == 0) // deleted buckets are dropped on the way
+        {
+            kh_del(m64, h, kh_get(m64, h, (khint64_t)splittable64(i / 2)));
+            kh_del(ref64, ref, kh_get(ref64, ref, (khint64_t)splittable64(i / 2)));
+        }
+    }
+    // Same buckets as a table resized on one thread
+    assert(kh_size(h) == kh_size(ref) && kh_end(h) == kh_end(ref));
+    for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)
+        if (kh_exist(ref, k))
+            assert(kh_value(h, kh_get(m64, h, kh_key(ref, k))) == kh_value(ref, k));
+    // Shrink, then grow again
+    for (khint64_t i = 0; i < 150000; i++)
+    {
+        kh_del(m64, h, kh_get(m64, h, (khint64_t)splittable64(i)));
+        kh_del(ref64, ref, kh_get(ref64, ref, (khint64_t)splittable64(i)));
+    }
+    assert(kh_resize(m64, h, (khint_t)(kh_size(h) / h->max_load) + 1) == 0 && kh_end(h) < kh_end(ref));
+    assert(kh_size(h) == kh_size(ref) && kh_size(h) >= KH_PAR_RESIZE_MIN);
+    for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)
+        if (kh_exist(ref, k))
+            assert(kh_value(h, kh_get(m64, h, kh_key(ref, k))) == kh_value(ref, k));
+    assert(kh_resize(m64, h, kh_end(ref) * 4) == 0);
+    for (khint_t k = kh_begin(ref); k != kh_end(ref); ++k)
+        if (kh_exist(ref, k))
+            assert(kh_value(h, kh_get(m64, h, kh_key(ref, k))) == kh_value(ref, k));
+    kh_destroy(m64, h);
+    kh_destroy(ref64, ref);
+
+    // Interleaved keys and values move as pairs
+    khash_t(kv64) *p = kh_init(kv64);
+    for (khint64_t i = 0; i < 100000; i++)
+    {
+        khint_t k = kh_put(kv64, p, (khint64_t)splittable64(i), &ret);
+        kh_value(p, k) = i;
+    }
+    for (khint64_t i = 0; i < 100000; i++)
+        assert(kh_value(p, kh_get(kv64, p, (khint64_t)splittable64(i))) == i);
+    kh_destroy(kv64, p);
+
+    // Stored hashes move with their keys
+    khash_t(m32) *g = kh_init(m32);
+    for (int i = 0; i < 100000; i++)
+    {
+        khint_t k = kh_put(m32, g, (khint32_t)i * 11, &ret);
+        kh_value(g, k) = i;
+    }
+    for (int i = 0; i < 200000; i++)
+    {
+        khint_t k = kh_get(m32, g, (khint32_t)i * 11);
+        assert(i < 100000 ? k != kh_end(g) && kh_value(g, k) == i && g->hashes[k] == kh_int32_hash_func(i * 11)
+                          : k == kh_end(g));
+    }
+    kh_destroy(m32, g);
+
+    printf("Multi-threaded resize tests passed!\n");
+}
+
+void test_scan()
+{
+    printf("Testing parallel scans...\n");
+
+    int ret;
+    khash_t(m64) *h = kh_init(m64);
+    kh_set_incremental(h, 4);
+    khint64_t want = 0;
+    for (khint64_t i = 0; i < 100000 || !h->old; i++) // stop in the middle of a rehash
+    {
+        khint_t k = kh_put(m64, h, i, &ret);
+        kh_value(h, k) = i * 2;
+        want += i * 2;
+    }
+    for (int n_threads = 1; n_threads <= 8; n_threads++)
+    {
+        scan_t s = {h, {0}, {0}};
+        kh_par_scan(h, n_threads, scan_part, &s);
+        khint64_t sum = 0;
+        khint_t count = 0;
+        for (int t = 0; t < 8; t++)
+            sum += s.sum[t], count += s.count[t];
+        assert(sum == want && count == kh_size(h));
+    }
+    kh_destroy(m64, h);
+    printf("Parallel scan tests passed!\n");
+}
+
+int main()
+{
+    printf("Starting khash_parallel.h unit tests...\n\n");
+
+    test_build();
+    test_build_combine();
+    test_resize();
+    test_scan();
+
+    printf("\nAll tests passed successfully!\n");
+    return 0;
+}
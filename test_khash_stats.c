@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <assert.h>
+#define KHASH_STATS
+#include "khash.h"
+
+// Declare test hash tables
+KHASH_MAP_INIT_INT(m32, int)
+KHASH_INIT(swiss32, khint32_t, int, KH_MAP | KH_SWISS, kh_int32_hash_func, kh_int_hash_equal)
+KHASH_INIT(rh32, khint32_t, int, KH_MAP | KH_ROBINHOOD, kh_int32_hash_func, kh_int_hash_equal)
+
+// Every lookup is a hit or a miss, and lands in one histogram bin
+#define CHECK_LOOKUPS(s, hits, misses)                                                     \
+    do                                                                                     \
+    {                                                                                      \
+        uint64_t __n = 0, __p = 0;                                                         \
+        for (int __i = 0; __i < KH_STATS_HIST; __i++)                                      \
+            __n += (s).probe_hist[__i], __p += (uint64_t)__i * (s).probe_hist[__i];        \
+        assert((s).n_hit == (hits) && (s).n_miss == (misses) && __n == (hits) + (misses)); \
+        assert(__p <= (s).n_probe && (s).n_probe >= (hits));                               \
+    } while (0)
+
+void test_counters()
+{
+    printf("Testing running counters...\n");
+
+    int ret;
+    khash_t(m32) *h = kh_init(m32);
+    kh_stats_t s = kh_stats(h);
+    assert(s.n_hit == 0 && s.n_put == 0 && s.n_resize == 0);
+    assert(kh_get(m32, h, 1) == kh_end(h)); // an empty table visits no bucket
+    s = kh_stats(h);
+    assert(s.n_miss == 1 && s.probe_hist[0] == 1 && s.n_probe == 0);
+
+    for (int i = 0; i < 10000; i++)
+    {
+        khint_t k = kh_put(m32, h, i, &ret);
+        kh_value(h, k) = i;
+    }
+    for (int i = 0; i < 100; i++)
+        kh_put(m32, h, i, &ret); // already there
+    s = kh_stats(h);
+    assert(s.n_put == 10100 && s.n_insert == 10000);
+    assert(s.n_resize >= 10 && s.resize_ns > 0); // 4 buckets to 16384
+
+    kh_stats_reset(h);
+    for (int i = 0; i < 20000; i++)
+        kh_get(m32, h, i);
+    s = kh_stats(h);
+    CHECK_LOOKUPS(s, 10000, 10000);
+    assert(s.n_put == 0 && s.n_resize == 0);
+
+    khint_t out[1000];
+    int keys[1000];
+    for (int i = 0; i < 1000; i++)
+        keys[i] = i * 20;
+    kh_get_batch(m32, h, keys, 1000, out);
+    s = kh_stats(h);
+    CHECK_LOOKUPS(s, 10500, 10500);
+
+    for (int i = 0; i < 5000; i++)
+        kh_del(m32, h, kh_get(m32, h, i));
+    kh_del(m32, h, kh_end(h)); // nothing to delete
+    s = kh_stats(h);
+    assert(s.n_del == 5000);
+    kh_destroy(m32, h);
+
+    printf("Running counter tests passed!\n");
+}
+
+void test_engines()
+{
+    printf("Testing counters of the other engines...\n");
+
+    int ret;
+    khash_t(swiss32) *w = kh_init(swiss32);
+    khash_t(rh32) *r = kh_init(rh32);
+    kh_set_incremental(r, 16);
+    for (int i = 0; i < 30000; i++)
+    {
+        kh_put(swiss32, w, i, &ret);
+        kh_put(rh32, r, i, &ret);
+    }
+    kh_stats_reset(w);
+    kh_stats_reset(r);
+    for (int i = 0; i < 60000; i++)
+    {
+        kh_get(swiss32, w, i);
+        kh_get(rh32, r, i); // some of these still search the old buckets
+    }
+    kh_stats_t sw = kh_stats(w), sr = kh_stats(r);
+    CHECK_LOOKUPS(sw, 30000, 30000);
+    CHECK_LOOKUPS(sr, 30000, 30000);
+    assert(sw.n_probe < sr.n_probe); // a group holds many buckets
+    kh_destroy(swiss32, w);
+    kh_destroy(rh32, r);
+
+    printf("Engine counter tests passed!\n");
+}
+
+int main()
+{
+    printf("Starting KHASH_STATS unit tests...\n\n");
+
+    test_counters();
+    test_engines();
+
+    printf("\nAll tests passed successfully!\n");
+    return 0;
+}
@@ -152,6 +152,81 @@ void test_memory_failure()
     printf("Memory failure test passed\n");
 }
 
+// Bump allocator over a fixed buffer; fails once the buffer is used up
+typedef struct
+{
+    char buf[1000];
+    size_t used, released;
+} bump_t;
+
+static void *bump_alloc(void *ctx, size_t size)
+{
+    bump_t *b = ctx;
+    if (b->used + size > sizeof(b->buf))
+        return NULL;
+    b->used += size;
+    return b->buf + b->used - size;
+}
+
+static void *bump_resize(void *ctx, void *p, size_t old_size, size_t new_size)
+{
+    void *q = bump_alloc(ctx, new_size);
+    if (q)
+        memcpy(q, p, old_size < new_size ? old_size : new_size);
+    return q;
+}
+
+static void bump_release(void *ctx, void *p, size_t size)
+{
+    (void)p;
+    ((bump_t *)ctx)->released += size;
+}
+
+void test_vec_allocator()
+{
+    bump_t b = {{0}, 0, 0};
+    kalloc_t a = {bump_alloc, bump_resize, bump_release, &b};
+    vec_int v;
+    vec_int_init_with_alloc(&v, &a);
+    assert(v.alloc == &a && v.data == NULL);
+
+    // Capacities 2, 4, ..., 64 take 504 bytes; 128 does not fit
+    for (int i = 0; i < 64; i++)
+        assert(vec_int_push(&v, i) == 0);
+    assert((char *)v.data >= b.buf && (char *)v.data < b.buf + sizeof(b.buf));
+    assert(b.used == 504);
+    assert(vec_int_push(&v, 64) == -1);
+    assert(v.size == 64 && v.capacity == 64 && vec_int_get(&v, 63) == 63);
+
+    // Move hands the allocator over; the source keeps its own
+    vec_int moved;
+    vec_int_init(&moved);
+    vec_int_move(&moved, &v);
+    assert(moved.alloc == &a && v.alloc == &a && v.data == NULL);
+
+    vec_int_destroy(&moved);
+    assert(b.released == 64 * sizeof(int));
+    assert(moved.alloc == &a && moved.data == NULL);
+    vec_int_destroy(&v);
+    printf("Allocator test passed\n");
+}
+
+void test_vec_memory_usage()
+{
+    kalloc_tally_t t;
+    kalloc_tally_init(&t, NULL);
+    vec_int v;
+    vec_int_init_with_alloc(&v, &t.a);
+    for (int i = 0; i < 5; i++)
+        vec_int_push(&v, i);
+    kmem_usage_t u = vec_int_memory_usage(&v);
+    assert(u.live == 5 * sizeof(int) && u.slack == 3 * sizeof(int));
+    assert(kmem_usage_total(u) == kalloc_tally_bytes(&t));
+    vec_int_destroy(&v);
+    assert(kalloc_tally_bytes(&t) == 0 && kalloc_tally_peak(&t) == 8 * sizeof(int));
+    printf("Memory usage test passed\n");
+}
+
 int main()
 {
     test_vec_init();
@@ -160,6 +235,8 @@ int main()
     test_vec_copy_move();
     test_memory_stress();
     test_memory_failure();
+    test_vec_allocator();
+    test_vec_memory_usage();
     printf("All tests passed!\n");
     return 0;
 }
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "kalloc.h"
 
 /**
  * @brief Define vector implementation for a given data type.
@@ -12,9 +13,10 @@
 #define VEC_IMPL(dtype, vtype)                                                \
     typedef struct                                                            \
     {                                                                         \
-        size_t size;     /* current number of elements */                     \
-        size_t capacity; /* allocated capacity */                             \
-        dtype *data;     /* array pointer */                                  \
+        size_t size;           /* current number of elements */               \
+        size_t capacity;       /* allocated capacity */                       \
+        dtype *data;           /* array pointer */                            \
+        const kalloc_t *alloc; /* allocator, NULL for the default */          \
     } vtype;                                                                  \
                                                                               \
     /* Initialize vector */                                                   \
@@ -23,11 +25,18 @@
         memset(v, 0, sizeof(vtype));                                          \
     }                                                                         \
                                                                               \
+    /* Initialize vector using allocator a, which must outlive it */          \
+    static inline void vtype##_init_with_alloc(vtype *v, const kalloc_t *a)   \
+    {                                                                         \
+        memset(v, 0, sizeof(vtype));                                          \
+        v->alloc = a;                                                         \
+    }                                                                         \
+                                                                              \
     /* Free vector memory */                                                  \
     static inline void vtype##_destroy(vtype *v)                              \
     {                                                                         \
-        free(v->data);                                                        \
-        memset(v, 0, sizeof(vtype));                                          \
+        kalloc_free(v->alloc, v->data, sizeof(dtype) * v->capacity);          \
+        vtype##_init_with_alloc(v, v->alloc);                                 \
     }                                                                         \
                                                                               \
     /* Get element at index */                                                \
@@ -54,11 +63,21 @@
         return v->data[--(v->size)];                                          \
     }                                                                         \
                                                                               \
+    /* Bytes held by the vector, not counting its struct */                   \
+    static inline kmem_usage_t vtype##_memory_usage(const vtype *v)           \
+    {                                                                         \
+        kmem_usage_t u = {sizeof(dtype) * v->size,                            \
+                          sizeof(dtype) * (v->capacity - v->size), 0, 0};     \
+        return u;                                                             \
+    }                                                                         \
+                                                                              \
     /* Reserve vector data */                                                 \
     static inline int vtype##_reserve(vtype *v, size_t capacity)              \
     {                                                                         \
+        size_t old_size = sizeof(dtype) * v->capacity;                        \
         dtype *new_data;                                                      \
-        new_data = (dtype *)realloc(v->data, sizeof(dtype) * capacity);       \
+        new_data = (dtype *)kalloc_realloc(v->alloc, v->data, old_size,       \
+                                           sizeof(dtype) * capacity);         \
         if (!new_data)                                                        \
             return -1;                                                        \
         v->data = new_data;                                                   \
@@ -95,9 +114,9 @@
     /* Move vector */                                                         \
     static inline void vtype##_move(vtype *restrict dst, vtype *restrict src) \
     {                                                                         \
-        free(dst->data);                                                      \
+        kalloc_free(dst->alloc, dst->data, sizeof(dtype) * dst->capacity);    \
         memcpy(dst, src, sizeof(vtype));                                      \
-        memset(src, 0, sizeof(vtype));                                        \
+        vtype##_init_with_alloc(src, src->alloc);                             \
     }
 
 #endif // VEC_H_